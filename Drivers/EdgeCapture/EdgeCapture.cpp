@@ -0,0 +1,327 @@
+/*
+ * EdgeCapture.cpp
+ */
+
+#include "EdgeCapture.h"
+
+#if defined(DRIVERS_HOST)
+	#include "FastGpio.h"
+#endif
+
+static_assert((EDGE_CAPTURE_RING_SIZE & (EDGE_CAPTURE_RING_SIZE - 1u)) == 0u, "EdgeCapture: EDGE_CAPTURE_RING_SIZE must be a power of two");
+static_assert(EDGE_CAPTURE_MAX_PINS <= 4u, "EdgeCapture: at most 4 pins, one ISR trampoline per pin");
+static_assert((EDGE_CAPTURE_MAX_PINS * EDGE_CAPTURE_MAX_SUBSCRIBERS) <= 127u, "EdgeCapture: handles must fit int8_t");
+
+#if (EDGE_CAPTURE_USE_PCINT == 1) && defined(__AVR__) && defined(digitalPinToPCICR)
+	#define EDGE_CAPTURE_PCINT
+#endif
+
+namespace Drivers
+{
+	namespace EdgeCapture
+	{
+		typedef struct
+		{
+			bool Used;
+			uint8_t Pin;
+			int8_t Interrupt;			/* external interrupt number, NOT_AN_INTERRUPT when on a pin change interrupt */
+			int8_t PcintGroup;			/* pin change group when Interrupt is NOT_AN_INTERRUPT */
+			uint8_t LastLevel;
+			uint8_t SubscribersMask;
+			volatile uint16_t Head;		/* free running, written only by the ISR/Inject */
+			uint16_t Tails[EDGE_CAPTURE_MAX_SUBSCRIBERS];
+			uint8_t Overruns[EDGE_CAPTURE_MAX_SUBSCRIBERS];
+			EdgeEvent Ring[EDGE_CAPTURE_RING_SIZE];
+		} Slot;
+
+		static Slot _Slots[EDGE_CAPTURE_MAX_PINS];
+
+		static inline uint8_t _ReadLevel(uint8_t Pin)
+		{
+#if defined(DRIVERS_HOST)
+			/* Direct register read so the host doesn't charge a digitalRead() to the bus time */
+			return (FastGpioHost::Ports[Pin / 8u] >> (Pin % 8u)) & 1u;
+#else
+			return Vfb_DigitalRead(Pin);
+#endif
+		}
+
+		static inline void _Record(Slot &slot, uint8_t Level, uint32_t TimeUs)
+		{
+			uint16_t head = slot.Head;
+			EdgeEvent &event = slot.Ring[head & (EDGE_CAPTURE_RING_SIZE - 1u)];
+			event.TimeUs = TimeUs;
+			event.Level = Level;
+			slot.LastLevel = Level;
+			slot.Head = (uint16_t)(head + 1u);
+		}
+
+		template<uint8_t SlotNo>
+		static void _Isr()
+		{
+			Slot &slot = _Slots[SlotNo % EDGE_CAPTURE_MAX_PINS];
+			_Record(slot, _ReadLevel(slot.Pin), (uint32_t)micros());
+		}
+
+		typedef void (*IsrFunction)(void);
+		static const IsrFunction _Isrs[4] = { _Isr<0>, _Isr<1>, _Isr<2>, _Isr<3> };
+
+#if defined(EDGE_CAPTURE_PCINT)
+		static void _PcintIsr(int8_t Group)
+		{
+			uint32_t now = (uint32_t)micros();
+			for( uint8_t s = 0; s < EDGE_CAPTURE_MAX_PINS; s++ )
+			{
+				Slot &slot = _Slots[s];
+				if( slot.Used && (slot.Interrupt == NOT_AN_INTERRUPT) && (slot.PcintGroup == Group) )
+				{
+					/* The vector is shared by the whole port, only pins that changed get an edge */
+					uint8_t level = _ReadLevel(slot.Pin);
+					if( level != slot.LastLevel )
+					{
+						_Record(slot, level, now);
+					}
+				}
+			}
+		}
+#endif
+
+		static inline bool _Decode(int8_t Handle, Slot *&slot, uint8_t &sub)
+		{
+			if( (Handle < 0) || ((uint8_t)Handle >= (EDGE_CAPTURE_MAX_PINS * EDGE_CAPTURE_MAX_SUBSCRIBERS)) )
+			{
+				return false;
+			}
+			slot = &_Slots[(uint8_t)Handle / EDGE_CAPTURE_MAX_SUBSCRIBERS];
+			sub = (uint8_t)Handle % EDGE_CAPTURE_MAX_SUBSCRIBERS;
+			return slot->Used && (slot->SubscribersMask & (1u << sub));
+		}
+
+		static bool _Attach(Slot &slot, uint8_t SlotNo)
+		{
+			slot.Interrupt = (int8_t)digitalPinToInterrupt(slot.Pin);
+			slot.PcintGroup = -1;
+			slot.LastLevel = _ReadLevel(slot.Pin);
+
+			if( slot.Interrupt != NOT_AN_INTERRUPT )
+			{
+				attachInterrupt((uint8_t)slot.Interrupt, _Isrs[SlotNo], CHANGE);
+				return true;
+			}
+
+#if defined(EDGE_CAPTURE_PCINT)
+			if( digitalPinToPCICR(slot.Pin) != 0 )
+			{
+				slot.PcintGroup = (int8_t)digitalPinToPCICRbit(slot.Pin);
+				{
+					Vfb_CriticalSection cs;
+					*digitalPinToPCMSK(slot.Pin) |= _BV(digitalPinToPCMSKbit(slot.Pin));
+					*digitalPinToPCICR(slot.Pin) |= _BV(digitalPinToPCICRbit(slot.Pin));
+				}
+				return true;
+			}
+#endif
+			return false;
+		}
+
+		static void _Detach(Slot &slot)
+		{
+			if( slot.Interrupt != NOT_AN_INTERRUPT )
+			{
+				detachInterrupt((uint8_t)slot.Interrupt);
+			}
+#if defined(EDGE_CAPTURE_PCINT)
+			else
+			{
+				/* The group stays enabled, other pins of the port may still use it */
+				Vfb_CriticalSection cs;
+				*digitalPinToPCMSK(slot.Pin) &= (uint8_t)~_BV(digitalPinToPCMSKbit(slot.Pin));
+			}
+#endif
+		}
+
+		int8_t Subscribe(uint8_t Pin)
+		{
+			int8_t freeSlot = -1;
+			uint8_t s;
+
+			for( s = 0; s < EDGE_CAPTURE_MAX_PINS; s++ )
+			{
+				if( _Slots[s].Used && (_Slots[s].Pin == Pin) )
+				{
+					break;
+				}
+				if( !_Slots[s].Used && (freeSlot < 0) )
+				{
+					freeSlot = (int8_t)s;
+				}
+			}
+
+			if( s == EDGE_CAPTURE_MAX_PINS )
+			{
+				if( freeSlot < 0 )
+				{
+					return INVALID_HANDLE;
+				}
+
+				s = (uint8_t)freeSlot;
+				Slot &slot = _Slots[s];
+				slot.Pin = Pin;
+				slot.Head = 0;
+				slot.SubscribersMask = 0;
+				if( !_Attach(slot, s) )
+				{
+					return INVALID_HANDLE;
+				}
+				slot.Used = true;
+			}
+
+			Slot &slot = _Slots[s];
+			for( uint8_t sub = 0; sub < EDGE_CAPTURE_MAX_SUBSCRIBERS; sub++ )
+			{
+				if( !(slot.SubscribersMask & (1u << sub)) )
+				{
+					{
+						Vfb_CriticalSection cs;
+						slot.Tails[sub] = slot.Head;
+					}
+					slot.Overruns[sub] = 0;
+					slot.SubscribersMask |= (uint8_t)(1u << sub);
+					return (int8_t)(s * EDGE_CAPTURE_MAX_SUBSCRIBERS + sub);
+				}
+			}
+
+			return INVALID_HANDLE;
+		}
+
+		void Unsubscribe(int8_t Handle)
+		{
+			Slot *slot;
+			uint8_t sub;
+			if( !_Decode(Handle, slot, sub) )
+			{
+				return;
+			}
+
+			slot->SubscribersMask &= (uint8_t)~(1u << sub);
+			if( slot->SubscribersMask == 0u )
+			{
+				_Detach(*slot);
+				slot->Used = false;
+			}
+		}
+
+		/* Copies the oldest unread edge, skipping what the ISR already overwrote */
+		static bool _Read(int8_t Handle, EdgeEvent &Event, bool Consume)
+		{
+			Slot *slot;
+			uint8_t sub;
+			if( !_Decode(Handle, slot, sub) )
+			{
+				return false;
+			}
+
+			bool found = false;
+			{
+				Vfb_CriticalSection cs;
+				uint16_t head = slot->Head;
+				uint16_t tail = slot->Tails[sub];
+				uint16_t pending = (uint16_t)(head - tail);
+				if( pending > EDGE_CAPTURE_RING_SIZE )
+				{
+					uint16_t lost = (uint16_t)(pending - EDGE_CAPTURE_RING_SIZE);
+					slot->Overruns[sub] = (lost > (uint16_t)(0xFFu - slot->Overruns[sub])) ? 0xFFu : (uint8_t)(slot->Overruns[sub] + lost);
+					tail = (uint16_t)(head - EDGE_CAPTURE_RING_SIZE);
+					slot->Tails[sub] = tail;
+				}
+				if( tail != head )
+				{
+					Event = slot->Ring[tail & (EDGE_CAPTURE_RING_SIZE - 1u)];
+					if( Consume )
+					{
+						slot->Tails[sub] = (uint16_t)(tail + 1u);
+					}
+					found = true;
+				}
+			}
+
+			return found;
+		}
+
+		bool Pop(int8_t Handle, EdgeEvent &Event)
+		{
+			return _Read(Handle, Event, true);
+		}
+
+		bool Peek(int8_t Handle, EdgeEvent &Event)
+		{
+			return _Read(Handle, Event, false);
+		}
+
+		uint16_t Available(int8_t Handle)
+		{
+			Slot *slot;
+			uint8_t sub;
+			if( !_Decode(Handle, slot, sub) )
+			{
+				return 0;
+			}
+
+			uint16_t pending;
+			{
+				Vfb_CriticalSection cs;
+				pending = (uint16_t)(slot->Head - slot->Tails[sub]);
+			}
+
+			return (pending > EDGE_CAPTURE_RING_SIZE) ? EDGE_CAPTURE_RING_SIZE : pending;
+		}
+
+		void Flush(int8_t Handle)
+		{
+			Slot *slot;
+			uint8_t sub;
+			if( !_Decode(Handle, slot, sub) )
+			{
+				return;
+			}
+
+			Vfb_CriticalSection cs;
+			slot->Tails[sub] = slot->Head;
+		}
+
+		uint8_t Overruns(int8_t Handle)
+		{
+			Slot *slot;
+			uint8_t sub;
+			return _Decode(Handle, slot, sub) ? slot->Overruns[sub] : 0u;
+		}
+
+		void Inject(uint8_t Pin, uint8_t Level, uint32_t TimeUs)
+		{
+			for( uint8_t s = 0; s < EDGE_CAPTURE_MAX_PINS; s++ )
+			{
+				if( _Slots[s].Used && (_Slots[s].Pin == Pin) )
+				{
+					{
+						Vfb_CriticalSection cs;
+						_Record(_Slots[s], Level, TimeUs);
+					}
+					return;
+				}
+			}
+		}
+	}
+
+} /* namespace Drivers */
+
+#if defined(EDGE_CAPTURE_PCINT)
+	#if defined(PCINT0_vect)
+		ISR(PCINT0_vect) { Drivers::EdgeCapture::_PcintIsr(0); }
+	#endif
+	#if defined(PCINT1_vect)
+		ISR(PCINT1_vect) { Drivers::EdgeCapture::_PcintIsr(1); }
+	#endif
+	#if defined(PCINT2_vect)
+		ISR(PCINT2_vect) { Drivers::EdgeCapture::_PcintIsr(2); }
+	#endif
+#endif
@@ -0,0 +1,76 @@
+/*
+ * EdgeCapture.h
+ *
+ *  Shared edge timestamping service. EdgeCapture owns the pin interrupts: the ISR only stores
+ *  micros() and the new level into a ring buffer of the pin, drivers subscribe to a pin and
+ *  consume the edges from their Update()/MainFunction() whenever they get to run, so the
+ *  measured timings don't depend on the main loop load.
+ *
+ *  - one ring per pin, shared by all subscribers of that pin, each subscriber has its own
+ *    read index. The ISR never waits for a reader: a subscriber that falls more than
+ *    EDGE_CAPTURE_RING_SIZE edges behind loses the oldest ones (counted in Overruns())
+ *  - external interrupts are used when the pin has one. With EDGE_CAPTURE_USE_PCINT == 1 the
+ *    AVR pin change interrupts are used for the other pins (this defines the PCINTx vectors,
+ *    so it can't be combined with libraries that define them too, e.g. SoftwareSerial)
+ *  - Inject() feeds a timestamped edge through the same path as the ISR, used by host tests
+ */
+
+#ifndef EDGE_CAPTURE_H
+#define EDGE_CAPTURE_H
+
+#include "HAL.h"
+
+/* Pins that can be captured at the same time */
+#ifndef EDGE_CAPTURE_MAX_PINS
+	#define EDGE_CAPTURE_MAX_PINS			2u
+#endif
+
+/* Edges kept per pin, power of two. 128 hold a whole NEC frame (68 edges) for a reader that polls
+ * less often than once per frame; 5 bytes each on AVR, lower it when no IR receiver is used */
+#ifndef EDGE_CAPTURE_RING_SIZE
+	#define EDGE_CAPTURE_RING_SIZE			128u
+#endif
+
+/* Subscribers per pin */
+#ifndef EDGE_CAPTURE_MAX_SUBSCRIBERS
+	#define EDGE_CAPTURE_MAX_SUBSCRIBERS	2u
+#endif
+
+#ifndef EDGE_CAPTURE_USE_PCINT
+	#define EDGE_CAPTURE_USE_PCINT			0
+#endif
+
+namespace Drivers
+{
+	typedef struct
+	{
+		uint32_t TimeUs;			/* micros() when the edge was seen */
+		uint8_t Level;				/* level after the edge */
+	} EdgeEvent;
+
+	namespace EdgeCapture
+	{
+		static const int8_t INVALID_HANDLE = -1;
+
+		/* Starts capturing the pin on the first subscriber. INVALID_HANDLE when the pin has no usable interrupt or no slot is free */
+		int8_t Subscribe(uint8_t Pin);
+		/* Stops capturing the pin after its last subscriber is gone */
+		void Unsubscribe(int8_t Handle);
+
+		/* Oldest unread edge of the subscriber, false if there is none */
+		bool Pop(int8_t Handle, EdgeEvent &Event);
+		/* Oldest unread edge without consuming it */
+		bool Peek(int8_t Handle, EdgeEvent &Event);
+		uint16_t Available(int8_t Handle);
+		/* Drops the unread edges of the subscriber */
+		void Flush(int8_t Handle);
+		/* Edges the subscriber lost because it was too far behind, saturates at 255 */
+		uint8_t Overruns(int8_t Handle);
+
+		/* Records an edge as if the interrupt of the pin fired at TimeUs. Does nothing if the pin isn't captured */
+		void Inject(uint8_t Pin, uint8_t Level, uint32_t TimeUs);
+	}
+
+} /* namespace Drivers */
+
+#endif /* EDGE_CAPTURE_H */
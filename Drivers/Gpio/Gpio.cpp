@@ -4,153 +4,62 @@ namespace Drivers
 {
 	Gpio::Gpio(uint8_t PinNo) :_PinNo(PinNo), _Mode(INPUT)
 	{
-		Vfb_SetPinMode(this->_PinNo, this->_Mode);
+		this->_Init();
 	}
 
 	Gpio::Gpio(uint8_t PinNo, uint8_t Mode) : _PinNo(PinNo), _Mode(Mode)
 	{
-		Vfb_SetPinMode(this->_PinNo, this->_Mode);
+		this->_Init();
 	}
 
 	Gpio::~Gpio()
 	{
 	}
 
-	void Gpio::Set()
+	void Gpio::_Init()
 	{
-			if(this->_Mode == INPUT)
-			{
-				#if DRIVERS_DEBUG == 1
-					ERR_PRINT("[ERR][GpioBase] Set(): Can't SET a pin set as INPUT: ");
-					ERR_PRINTLN(this->_PinNo);
-				#endif
-				return;
-			}
+		bool pinOk = (this->_PinNo > 0);
+#if defined(NUM_DIGITAL_PINS)
+		pinOk = pinOk && (this->_PinNo < NUM_DIGITAL_PINS);
+#endif
+		bool modeOk = (this->_Mode == INPUT) || (this->_Mode == OUTPUT) || (this->_Mode == INPUT_PULLUP);
 
-			if(this->_PinNo <= 0 )
-			{
-				#if DRIVERS_DEBUG == 1
-					ERR_PRINT("[ERR][GpioBase] Set(): Setting invalid pin or not initialized: ");
-					ERR_PRINTLN(this->_PinNo);
-				#endif
-				return;
-			}
-			Vfb_DigitalWrite(this->_PinNo, HIGH);
-	}
-
-	void Gpio::Clear()
-	{
-		if(this->_Mode == INPUT)
+		if( !pinOk )
 		{
-			#if DRIVERS_DEBUG == 1
-				ERR_PRINT("[ERR][GpioBase] Clear(): Can't CLEAR a pin set as INPUT: ");
-				ERR_PRINTLN(this->_PinNo);
-			#endif
-			return;
+			ErrorRing::Report(ErrorCode::GPIO_INVALID_PIN, this->_PinNo);
 		}
-
-		if(this->_PinNo <= 0 )
+		else if( !modeOk )
 		{
-			#if DRIVERS_DEBUG == 1
-				ERR_PRINT("[ERR][GpioBase] Clear(): Clearing invalid pin or not initialized: ");
-				ERR_PRINTLN(this->_PinNo);
-			#endif
-			return;
+			ErrorRing::Report(ErrorCode::GPIO_INVALID_MODE, this->_PinNo);
 		}
-		Vfb_DigitalWrite(this->_PinNo, LOW);
-	}
 
-	void Gpio::Write(uint8_t LogicalLevel)
-	{
-		if(this->_Mode == INPUT)
-		{
-			#if DRIVERS_DEBUG == 1
-				ERR_PRINT("[ERR][GpioBase] Write(): Can't WRITE a pin set as INPUT: ");
-				ERR_PRINTLN(this->_PinNo);
-			#endif
-			return;
-		}
+		this->_Valid = pinOk && modeOk;
+		this->_Writable = this->_Valid && (this->_Mode != INPUT);
 
-		if(this->_PinNo <= 0 )
+		if( this->_Valid )
 		{
-			#if DRIVERS_DEBUG == 1
-				ERR_PRINT("[ERR][GpioBase] Write(): Writing invalid pin or not initialized: ");
-				ERR_PRINTLN(this->_PinNo);
-			#endif
-			return;
+			Vfb_SetPinMode(this->_PinNo, this->_Mode);
 		}
-
-		Vfb_DigitalWrite(this->_PinNo, LogicalLevel);
-	}
-
-	void Gpio::Toggle()
-	{
-		if(this->_Mode == INPUT)
-		{
-			#if DRIVERS_DEBUG == 1
-				ERR_PRINT("[ERR][GpioBase] Toggle(): Can't TOGGLE a pin set as INPUT: ");
-				ERR_PRINTLN(this->_PinNo);
-			#endif
-			return;
-		}
-
-		if(this->_PinNo <= 0 )
-		{
-			#if DRIVERS_DEBUG == 1
-				ERR_PRINT("[ERR][GpioBase] Toggle(): Toggling invalid pin or not initialized: ");
-				ERR_PRINTLN(this->_PinNo);
-			#endif
-			return;
-		}
-		Vfb_DigitalToggle(this->_PinNo);
-	}
-
-	uint8_t Gpio::Read()
-	{
-		if(this->_PinNo <= 0 )
-		{
-			#if DRIVERS_DEBUG == 1
-				ERR_PRINT("[ERR][GpioBase] Read(): Invalid pin number or not initialized: ");
-				ERR_PRINTLN(this->_PinNo);
-			#endif
-		}
-		return Vfb_DigitalRead(this->_PinNo);
 	}
 
 	uint16_t Gpio::ReadAnalog()
 	{
-		if(this->_PinNo <= 0 )
-		{
-			#if DRIVERS_DEBUG == 1
-				ERR_PRINT("[ERR][GpioBase] ReadAnalog(): Invalid pin number or not initialized: ");
-				ERR_PRINTLN(this->_PinNo);
-			#endif
-		}
 		return (uint16_t)Vfb_AnalogRead(this->_PinNo);
 	}
 
-	uint8_t Gpio::GetPinNo()
+	uint8_t Gpio::GetPinNo() const
 	{
-		if(this->_PinNo <= 0 )
-		{
-			#if DRIVERS_DEBUG == 1
-				ERR_PRINT("[ERR][GpioBase] GetPinNo(): Invalid pin number or not initialized: ");
-				ERR_PRINTLN(this->_PinNo);
-			#endif
-		}
 		return this->_PinNo;
 	}
 
-	uint8_t Gpio::GetPinMode()
+	uint8_t Gpio::GetPinMode() const
 	{
-		if(this->_PinNo <= 0 )
-		{
-			#if DRIVERS_DEBUG == 1
-				ERR_PRINT("[ERR][GpioBase] GetPinNo(): Invalid pin number or not initialized: ");
-				ERR_PRINTLN(this->_PinNo);
-			#endif
-		}
 		return this->_Mode;
 	}
 
+	bool Gpio::IsValid() const
+	{
+		return this->_Valid;
+	}
+
 } /* namespace Drivers */
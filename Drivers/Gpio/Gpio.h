@@ -2,6 +2,18 @@
 #define GPIO_H
 
 #include "HAL.h"
+#include "ErrorRing.h"
+
+/*
+ * Pin number and mode are validated once, in the constructor, and faults are recorded in the
+ * ErrorRing. Set/Clear/Toggle/Write only test one flag computed there.
+ * GPIO_RUNTIME_CHECKS == 1 additionally reports every rejected write (useful while bringing up
+ * a board, costs a call on the rejected path only).
+ * For pins known at compile time use FastGpio, misuse is rejected with static_assert there.
+ */
+#ifndef GPIO_RUNTIME_CHECKS
+	#define GPIO_RUNTIME_CHECKS		0
+#endif
 
 namespace Drivers
 {
@@ -12,18 +24,63 @@ namespace Drivers
 			Gpio(uint8_t PinNo, uint8_t Mode);
 			virtual ~Gpio();
 
-			void Set();
-			void Clear();
-			void Toggle();
-			void Write(uint8_t LogicalLevel);
-			uint8_t Read();
+			inline void Set()
+			{
+				if( this->_Writable )
+					Vfb_DigitalWrite(this->_PinNo, HIGH);
+				else
+					this->_Rejected();
+			}
+
+			inline void Clear()
+			{
+				if( this->_Writable )
+					Vfb_DigitalWrite(this->_PinNo, LOW);
+				else
+					this->_Rejected();
+			}
+
+			inline void Toggle()
+			{
+				if( this->_Writable )
+					Vfb_DigitalToggle(this->_PinNo);
+				else
+					this->_Rejected();
+			}
+
+			inline void Write(uint8_t LogicalLevel)
+			{
+				if( this->_Writable )
+					Vfb_DigitalWrite(this->_PinNo, LogicalLevel);
+				else
+					this->_Rejected();
+			}
+
+			inline uint8_t Read()
+			{
+				return Vfb_DigitalRead(this->_PinNo);
+			}
+
 			uint16_t ReadAnalog();
-			uint8_t GetPinNo();
-			uint8_t GetPinMode();
+			uint8_t GetPinNo() const;
+			uint8_t GetPinMode() const;
+			/* False when the constructor rejected the pin number or the mode */
+			bool IsValid() const;
 
 		private:
 			uint8_t _PinNo = 0u;
 			uint8_t _Mode = INPUT;
+			bool _Valid = false;
+			bool _Writable = false;
+
+			void _Init();
+
+			inline void _Rejected()
+			{
+#if GPIO_RUNTIME_CHECKS == 1
+				ErrorRing::Report(this->_Valid ? ErrorCode::GPIO_WRITE_ON_INPUT : ErrorCode::GPIO_INVALID_PIN, this->_PinNo);
+#endif
+			}
 	};
 
 } /* namespace Drivers */
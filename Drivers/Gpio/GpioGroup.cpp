@@ -0,0 +1,160 @@
+/*
+ * GpioGroup.cpp
+ */
+
+#include "GpioGroup.h"
+
+static_assert(GPIO_GROUP_MAX_PINS <= 32u, "GpioGroup: the pattern holds at most 32 pins");
+
+#if defined(DRIVERS_HOST) || defined(portOutputRegister)
+	#define GPIO_GROUP_PORT_ACCESS
+#endif
+
+namespace Drivers
+{
+	GpioGroup::GpioGroup(const uint8_t *Pins, uint8_t PinsNo, uint8_t Mode)
+	{
+		for( uint8_t i = 0; i < PinsNo; i++ )
+		{
+			uint8_t pin = Pins[i];
+			uint8_t port = 0;
+			uint8_t portIndex = GPIO_GROUP_MAX_PORTS;
+
+#if defined(GPIO_GROUP_PORT_ACCESS)
+			port = digitalPinToPort(pin);
+			if( port == NOT_A_PORT )
+			{
+				ErrorRing::Report(ErrorCode::GPIO_INVALID_PIN, pin);
+				this->_Valid = false;
+				continue;
+			}
+			portIndex = this->_FindPort(port);
+#else
+			portIndex = 0;
+#endif
+			if( (this->_PinsNo >= GPIO_GROUP_MAX_PINS) || (portIndex >= GPIO_GROUP_MAX_PORTS) )
+			{
+				ErrorRing::Report(ErrorCode::GPIO_GROUP_LIMIT, pin);
+				this->_Valid = false;
+				continue;
+			}
+
+#if defined(GPIO_GROUP_PORT_ACCESS)
+			if( portIndex == this->_PortsNo )
+			{
+				this->_Ports[portIndex] = port;
+				this->_PortMask[portIndex] = 0;
+				this->_PortsNo++;
+			}
+			this->_PinMask[this->_PinsNo] = digitalPinToBitMask(pin);
+			this->_PortMask[portIndex] |= this->_PinMask[this->_PinsNo];
+#endif
+			this->_PinPort[this->_PinsNo] = portIndex;
+			this->_Pins[this->_PinsNo] = pin;
+			this->_PinsNo++;
+
+			Vfb_SetPinMode(pin, Mode);
+		}
+	}
+
+	void GpioGroup::Write(uint32_t Pattern)
+	{
+#if defined(GPIO_GROUP_PORT_ACCESS)
+		uint8_t values[GPIO_GROUP_MAX_PORTS] = {0};
+
+		/* Scatter the pattern into per-port values before touching any register */
+		for( uint8_t i = 0; i < this->_PinsNo; i++ )
+		{
+			if( Pattern & 1u )
+			{
+				values[this->_PinPort[i]] |= this->_PinMask[i];
+			}
+			Pattern >>= 1;
+		}
+
+		for( uint8_t p = 0; p < this->_PortsNo; p++ )
+		{
+	#if defined(DRIVERS_HOST)
+			uint8_t port = this->_Ports[p] - 1u;
+			FastGpioHost::Store(port, (FastGpioHost::Ports[port] & (uint8_t)~this->_PortMask[p]) | values[p]);
+	#else
+			volatile uint8_t *out = portOutputRegister(this->_Ports[p]);
+			{
+				Vfb_CriticalSection cs;
+				*out = (*out & (uint8_t)~this->_PortMask[p]) | values[p];
+			}
+	#endif
+		}
+#else
+		for( uint8_t i = 0; i < this->_PinsNo; i++ )
+		{
+			Vfb_DigitalWrite(this->_Pins[i], (Pattern & 1u) ? HIGH : LOW);
+			Pattern >>= 1;
+		}
+#endif
+	}
+
+	uint32_t GpioGroup::Read()
+	{
+		uint32_t result = 0;
+
+#if defined(GPIO_GROUP_PORT_ACCESS)
+		uint8_t values[GPIO_GROUP_MAX_PORTS];
+
+		/* One load per port, all pins of a port are sampled at the same instant */
+		for( uint8_t p = 0; p < this->_PortsNo; p++ )
+		{
+	#if defined(DRIVERS_HOST)
+			FastGpioHost::Loads++;
+			values[p] = FastGpioHost::Ports[this->_Ports[p] - 1u];
+	#else
+			values[p] = *portInputRegister(this->_Ports[p]);
+	#endif
+		}
+
+		for( uint8_t i = this->_PinsNo; i > 0; i-- )
+		{
+			result <<= 1;
+			if( values[this->_PinPort[i - 1u]] & this->_PinMask[i - 1u] )
+			{
+				result |= 1u;
+			}
+		}
+#else
+		for( uint8_t i = this->_PinsNo; i > 0; i-- )
+		{
+			result = (result << 1) | (Vfb_DigitalRead(this->_Pins[i - 1u]) ? 1u : 0u);
+		}
+#endif
+		return result;
+	}
+
+	uint8_t GpioGroup::GetPinsNo() const
+	{
+		return this->_PinsNo;
+	}
+
+	uint8_t GpioGroup::GetPortsNo() const
+	{
+		return this->_PortsNo;
+	}
+
+	bool GpioGroup::IsValid() const
+	{
+		return this->_Valid;
+	}
+
+	uint8_t GpioGroup::_FindPort(uint8_t Port)
+	{
+		for( uint8_t p = 0; p < this->_PortsNo; p++ )
+		{
+			if( this->_Ports[p] == Port )
+			{
+				return p;
+			}
+		}
+		/* New port, GPIO_GROUP_MAX_PORTS when there is no room left */
+		return (this->_PortsNo < GPIO_GROUP_MAX_PORTS) ? this->_PortsNo : GPIO_GROUP_MAX_PORTS;
+	}
+
+} /* namespace Drivers */
@@ -0,0 +1,63 @@
+/*
+ * GpioGroup.h
+ *
+ *  A set of pins written and read as one value. Bit i of the pattern belongs to the i-th pin
+ *  passed to the constructor. The per-port masks are computed once, so Write() does a single
+ *  read-modify-write per port touched (inside a critical section, no intermediate states on
+ *  pins of the same port) and Read() a single load per port.
+ *
+ *  Cores that don't provide portOutputRegister() fall back to one Vfb_DigitalWrite per pin.
+ */
+
+#ifndef GPIO_GROUP_H
+#define GPIO_GROUP_H
+
+#include "HAL.h"
+#include "ErrorRing.h"
+
+#if defined(DRIVERS_HOST)
+	#include "FastGpio.h"
+#endif
+
+#ifndef GPIO_GROUP_MAX_PINS
+	#define GPIO_GROUP_MAX_PINS		8u
+#endif
+
+#ifndef GPIO_GROUP_MAX_PORTS
+	#define GPIO_GROUP_MAX_PORTS	4u
+#endif
+
+namespace Drivers
+{
+	class GpioGroup
+	{
+	public:
+		GpioGroup(const uint8_t *Pins, uint8_t PinsNo, uint8_t Mode = OUTPUT);
+
+		void Write(uint32_t Pattern);
+		uint32_t Read();
+
+		uint8_t GetPinsNo() const;
+		uint8_t GetPortsNo() const;
+		/* False when a pin was invalid or didn't fit the group limits, such pins are left out */
+		bool IsValid() const;
+
+	private:
+		uint8_t _Pins[GPIO_GROUP_MAX_PINS];
+		uint8_t _PinsNo = 0;
+		/* Port index and port bit of every pin */
+		uint8_t _PinPort[GPIO_GROUP_MAX_PINS];
+		uint8_t _PinMask[GPIO_GROUP_MAX_PINS];
+
+		uint8_t _Ports[GPIO_GROUP_MAX_PORTS];
+		uint8_t _PortMask[GPIO_GROUP_MAX_PORTS];
+		uint8_t _PortsNo = 0;
+
+		bool _Valid = true;
+
+		uint8_t _FindPort(uint8_t Port);
+	};
+
+} /* namespace Drivers */
+
+#endif /* GPIO_GROUP_H */
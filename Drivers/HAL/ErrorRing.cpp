@@ -0,0 +1,115 @@
+/*
+ * ErrorRing.cpp
+ */
+
+#include "ErrorRing.h"
+
+static_assert((ERROR_RING_SIZE & (ERROR_RING_SIZE - 1u)) == 0u, "ErrorRing: ERROR_RING_SIZE must be a power of two");
+static_assert(ERROR_RING_SIZE <= 128u, "ErrorRing: ERROR_RING_SIZE must fit the 8 bit indexes");
+
+namespace Drivers
+{
+	namespace ErrorRing
+	{
+		static ErrorEntry _Entries[ERROR_RING_SIZE];
+		/* Free running indexes, the slot is index & (ERROR_RING_SIZE - 1) */
+		static volatile uint8_t _Head = 0;
+		static volatile uint8_t _Tail = 0;
+		static volatile uint8_t _Dropped = 0;
+		static uint8_t _ReportedDrops = 0;
+
+		void Report(ErrorCode Code, uint8_t Arg)
+		{
+			uint16_t now = (uint16_t)millis();
+
+			Vfb_CriticalSection cs;
+			uint8_t head = _Head;
+			if( (uint8_t)(head - _Tail) >= ERROR_RING_SIZE )
+			{
+				if( _Dropped != 0xFFu )
+				{
+					_Dropped++;
+				}
+			}
+			else
+			{
+				ErrorEntry &entry = _Entries[head & (ERROR_RING_SIZE - 1u)];
+				entry.Code = Code;
+				entry.Arg = Arg;
+				entry.TimeMs = now;
+				_Head = (uint8_t)(head + 1u);
+			}
+		}
+
+		bool Pop(ErrorEntry &Entry)
+		{
+			uint8_t tail = _Tail;
+			if( tail == _Head )
+			{
+				return false;
+			}
+
+			Entry = _Entries[tail & (ERROR_RING_SIZE - 1u)];
+			/* Single consumer: the slot is released only after it was copied */
+			_Tail = (uint8_t)(tail + 1u);
+			return true;
+		}
+
+		uint8_t Pending()
+		{
+			return (uint8_t)(_Head - _Tail);
+		}
+
+		uint8_t Dropped()
+		{
+			return _Dropped;
+		}
+
+		void Clear()
+		{
+			{
+				Vfb_CriticalSection cs;
+				_Tail = _Head;
+				_Dropped = 0;
+			}
+			_ReportedDrops = 0;
+		}
+
+		const char *GetName(ErrorCode Code)
+		{
+			switch( Code )
+			{
+				case ErrorCode::GPIO_INVALID_PIN:		return "[Gpio] invalid pin or not initialized";
+				case ErrorCode::GPIO_INVALID_MODE:		return "[Gpio] invalid pin mode";
+				case ErrorCode::GPIO_WRITE_ON_INPUT:	return "[Gpio] write on a pin set as INPUT";
+				case ErrorCode::GPIO_GROUP_LIMIT:		return "[GpioGroup] too many pins or ports";
+				default:								return "[?] unknown error";
+			}
+		}
+
+		void MainFunction()
+		{
+#if DRIVERS_DEBUG == 1
+			ErrorEntry entry;
+			for( uint8_t i = 0; (i < ERROR_RING_FLUSH_PER_CALL) && Pop(entry); i++ )
+			{
+				ERR_PRINT("[ERR]");
+				ERR_PRINT(GetName(entry.Code));
+				ERR_PRINT(": ");
+				ERR_PRINT(entry.Arg);
+				ERR_PRINT(" @");
+				ERR_PRINTLN(entry.TimeMs);
+			}
+
+			uint8_t dropped = _Dropped;
+			if( dropped != _ReportedDrops )
+			{
+				ERR_PRINT("[ERR][ErrorRing] dropped: ");
+				ERR_PRINTLN(dropped);
+				_ReportedDrops = dropped;
+			}
+#endif
+		}
+	}
+
+} /* namespace Drivers */
@@ -0,0 +1,66 @@
+/*
+ * ErrorRing.h
+ *
+ *  Deferred error reporting for the drivers. Faults are recorded as small codes (no strings,
+ *  no Serial) so Report() can be called from hot paths and from interrupts, and are printed
+ *  or handed to the application later from ErrorRing::MainFunction() in the main loop.
+ *
+ *  Report() is not lock-free: it takes a critical section of a few instructions, because any
+ *  interrupt may report while another one or the main loop is halfway through and AVR has no
+ *  compare-and-swap to claim a slot with. Pop() never blocks. When the ring is full new entries
+ *  are dropped and counted.
+ */
+
+#ifndef ERROR_RING_H
+#define ERROR_RING_H
+
+#include "HAL.h"
+
+/* Number of entries, must be a power of two not larger than 128 */
+#ifndef ERROR_RING_SIZE
+	#define ERROR_RING_SIZE		16u
+#endif
+
+/* Entries printed by one MainFunction() call when DRIVERS_DEBUG == 1 */
+#ifndef ERROR_RING_FLUSH_PER_CALL
+	#define ERROR_RING_FLUSH_PER_CALL	4u
+#endif
+
+namespace Drivers
+{
+	enum class ErrorCode : uint8_t
+	{
+		NONE = 0,
+		GPIO_INVALID_PIN = 1,		/* Arg: pin number */
+		GPIO_INVALID_MODE = 2,		/* Arg: pin number */
+		GPIO_WRITE_ON_INPUT = 3,	/* Arg: pin number */
+		GPIO_GROUP_LIMIT = 4,		/* Arg: pin number that didn't fit GPIO_GROUP_MAX_PINS/PORTS */
+	};
+
+	typedef struct
+	{
+		ErrorCode Code;
+		uint8_t Arg;
+		uint16_t TimeMs;			/* lower 16 bits of millis() when reported */
+	} ErrorEntry;
+
+	namespace ErrorRing
+	{
+		void Report(ErrorCode Code, uint8_t Arg);
+
+		/* Oldest entry first, false when the ring is empty */
+		bool Pop(ErrorEntry &Entry);
+		uint8_t Pending();
+		/* Entries lost because the ring was full, saturates at 255 */
+		uint8_t Dropped();
+		void Clear();
+
+		const char *GetName(ErrorCode Code);
+
+		/* Prints pending entries with ERR_PRINT when DRIVERS_DEBUG == 1, otherwise leaves them for Pop() */
+		void MainFunction();
+	}
+
+} /* namespace Drivers */
+
+#endif /* ERROR_RING_H */
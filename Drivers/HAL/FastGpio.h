@@ -0,0 +1,188 @@
+/*
+ * FastGpio.h
+ *
+ *  Compile-time resolved GPIO. The pin number and mode are template parameters so the
+ *  port register and the bit mask are known at compile time and every Set/Clear/Toggle
+ *  ends up as a single store (sbi/cbi on AVR) instead of a digitalWrite() table lookup.
+ *
+ *  Backends:
+ *   - DRIVERS_HOST: register array in FastGpioHost, counts every load/store so host
+ *     benchmarks can measure the number of port accesses per operation
+ *   - ATmega328P/328PB/168/88: direct PORTx/PINx access, pin map of the UNO/Nano boards
+ *   - anything else: falls back to the Vfb_* HAL macros (same cost as Gpio)
+ *
+ *  FastGpio has the same interface as Gpio so drivers templated on the pin type
+ *  (HC595T, X11StepperT, LEDT) accept either of them. What Gpio checks in its constructor
+ *  is checked here with static_assert: out of range pins, unknown modes and writes to a
+ *  pin declared as INPUT do not compile.
+ */
+
+#ifndef FAST_GPIO_H
+#define FAST_GPIO_H
+
+#include "HAL.h"
+
+#if defined(DRIVERS_HOST)
+	#define FAST_GPIO_BACKEND_HOST
+#elif defined(__AVR_ATmega328P__) || defined(__AVR_ATmega328PB__) || defined(__AVR_ATmega328__) || defined(__AVR_ATmega168__) || defined(__AVR_ATmega168P__) || defined(__AVR_ATmega88P__)
+	#define FAST_GPIO_BACKEND_AVR_328
+#else
+	#define FAST_GPIO_BACKEND_GENERIC
+#endif
+
+#ifndef FAST_GPIO_HOST_PORTS
+	#define FAST_GPIO_HOST_PORTS	10u
+#endif
+
+namespace Drivers
+{
+#if defined(FAST_GPIO_BACKEND_HOST)
+	/* Simulated port registers, 8 pins per port: pin N lives in port N/8, bit N%8 */
+	namespace FastGpioHost
+	{
+		extern volatile uint8_t Ports[FAST_GPIO_HOST_PORTS];
+		extern volatile uint8_t Ddrs[FAST_GPIO_HOST_PORTS];
+		extern volatile uint32_t Stores;
+		extern volatile uint32_t Loads;
+		/* Called after every store, used by the host simulation to log edges and charge time */
+		extern void (*StoreHook)(uint8_t Port, uint8_t OldValue, uint8_t NewValue);
+
+		void ResetCounters();
+
+		inline void Store(uint8_t Port, uint8_t Value)
+		{
+			uint8_t OldValue = Ports[Port];
+			Ports[Port] = Value;
+			Stores++;
+			if( StoreHook != nullptr )
+			{
+				StoreHook(Port, OldValue, Value);
+			}
+		}
+	}
+
+	template<uint8_t PinNo>
+	struct FastGpioPin
+	{
+		static_assert(PinNo < (FAST_GPIO_HOST_PORTS * 8u), "FastGpio: pin number out of range");
+
+		static const uint8_t Port = PinNo / 8u;
+		static const uint8_t Mask = (uint8_t)(1u << (PinNo % 8u));
+	};
+#elif defined(FAST_GPIO_BACKEND_AVR_328)
+	/* UNO/Nano pin map: D0-D7 -> PORTD, D8-D13 -> PORTB, A0-A5 (14-19) -> PORTC */
+	template<uint8_t PinNo>
+	struct FastGpioPin
+	{
+		static_assert(PinNo < 20u, "FastGpio: pin number out of range for ATmega328 pin map");
+
+		/* I/O space addresses of PINx, DDRx is PINx+1 and PORTx is PINx+2 */
+		static const uint8_t PinIo = (PinNo < 8u) ? 0x09u : ((PinNo < 14u) ? 0x03u : 0x06u);
+		static const uint8_t DdrIo = PinIo + 1u;
+		static const uint8_t PortIo = PinIo + 2u;
+		static const uint8_t Mask = (uint8_t)(1u << ((PinNo < 8u) ? PinNo : ((PinNo < 14u) ? (PinNo - 8u) : (PinNo - 14u))));
+	};
+#endif
+
+	template<uint8_t PinNo, uint8_t Mode = OUTPUT>
+	class FastGpio
+	{
+		static_assert((Mode == INPUT) || (Mode == OUTPUT) || (Mode == INPUT_PULLUP), "FastGpio: invalid pin mode");
+#if defined(FAST_GPIO_BACKEND_GENERIC) && defined(NUM_DIGITAL_PINS)
+		static_assert(PinNo < NUM_DIGITAL_PINS, "FastGpio: pin number out of range");
+#endif
+
+	public:
+		FastGpio()
+		{
+			Init();
+		}
+
+		static inline void Init()
+		{
+#if defined(FAST_GPIO_BACKEND_HOST)
+			if( Mode == OUTPUT )
+				FastGpioHost::Ddrs[Pin::Port] |= Pin::Mask;
+			else
+				FastGpioHost::Ddrs[Pin::Port] &= (uint8_t)~Pin::Mask;
+#else
+			Vfb_SetPinMode(PinNo, Mode);
+#endif
+		}
+
+		static inline void Set()
+		{
+			static_assert(Mode != INPUT, "FastGpio: can't write a pin set as INPUT");
+#if defined(FAST_GPIO_BACKEND_HOST)
+			FastGpioHost::Store(Pin::Port, FastGpioHost::Ports[Pin::Port] | Pin::Mask);
+#elif defined(FAST_GPIO_BACKEND_AVR_328)
+			_SFR_IO8(Pin::PortIo) |= Pin::Mask;
+#else
+			Vfb_DigitalWrite(PinNo, HIGH);
+#endif
+		}
+
+		static inline void Clear()
+		{
+			static_assert(Mode != INPUT, "FastGpio: can't write a pin set as INPUT");
+#if defined(FAST_GPIO_BACKEND_HOST)
+			FastGpioHost::Store(Pin::Port, FastGpioHost::Ports[Pin::Port] & (uint8_t)~Pin::Mask);
+#elif defined(FAST_GPIO_BACKEND_AVR_328)
+			_SFR_IO8(Pin::PortIo) &= (uint8_t)~Pin::Mask;
+#else
+			Vfb_DigitalWrite(PinNo, LOW);
+#endif
+		}
+
+		static inline void Toggle()
+		{
+			static_assert(Mode != INPUT, "FastGpio: can't write a pin set as INPUT");
+#if defined(FAST_GPIO_BACKEND_HOST)
+			FastGpioHost::Store(Pin::Port, FastGpioHost::Ports[Pin::Port] ^ Pin::Mask);
+#elif defined(FAST_GPIO_BACKEND_AVR_328)
+			/* Writing a one to PINx toggles PORTx, no read needed */
+			_SFR_IO8(Pin::PinIo) = Pin::Mask;
+#else
+			Vfb_DigitalToggle(PinNo);
+#endif
+		}
+
+		static inline void Write(uint8_t LogicalLevel)
+		{
+			if( LogicalLevel )
+				Set();
+			else
+				Clear();
+		}
+
+		static inline uint8_t Read()
+		{
+#if defined(FAST_GPIO_BACKEND_HOST)
+			FastGpioHost::Loads++;
+			return (FastGpioHost::Ports[Pin::Port] & Pin::Mask) ? HIGH : LOW;
+#elif defined(FAST_GPIO_BACKEND_AVR_328)
+			return (_SFR_IO8(Pin::PinIo) & Pin::Mask) ? HIGH : LOW;
+#else
+			return Vfb_DigitalRead(PinNo);
+#endif
+		}
+
+		static inline uint8_t GetPinNo()
+		{
+			return PinNo;
+		}
+
+		static inline uint8_t GetPinMode()
+		{
+			return Mode;
+		}
+
+	private:
+#if !defined(FAST_GPIO_BACKEND_GENERIC)
+		typedef FastGpioPin<PinNo> Pin;
+#endif
+	};
+
+} /* namespace Drivers */
+
+#endif /* FAST_GPIO_H */
@@ -4,7 +4,9 @@
 
 #include "Arduino.h"
 
-#define DRIVERS_DEBUG 1
+#ifndef DRIVERS_DEBUG
+	#define DRIVERS_DEBUG 1
+#endif
 
 #define ERR_PRINTLN(arg)	(Serial.println(arg))
 #define ERR_PRINT(arg)		(Serial.print(arg))
@@ -24,4 +26,56 @@ typedef enum
 #define Vfb_AnalogRead(pin)				analogRead(pin)
 #define Vfb_AnalogWrite(pin, value);	analogWrite(pin, value)
 
+/*
+ * Short critical section usable from thread and interrupt context. Interrupts are off from the
+ * declaration to the end of the enclosing scope, then the state found on entry is restored, so
+ * sections nest and can be used inside ISRs:
+ *
+ *	{
+ *		Vfb_CriticalSection cs;
+ *		...
+ *	}
+ *
+ * Saved state: SREG on AVR, PRIMASK on Cortex-M, PS on ESP8266, the interrupt level on ESP32.
+ * Other cores fall back to noInterrupts()/interrupts(), which re-enables interrupts on exit even
+ * when they were off: don't use it from an ISR there. The host build has nothing to mask.
+ */
+class Vfb_CriticalSection
+{
+public:
+#if defined(__AVR__)
+	inline Vfb_CriticalSection() : _State(SREG) { cli(); }
+	inline ~Vfb_CriticalSection() { SREG = this->_State; }
+#elif defined(__ARM_ARCH_PROFILE) && (__ARM_ARCH_PROFILE == 'M')
+	inline Vfb_CriticalSection()
+	{
+		__asm__ volatile ("mrs %0, primask" : "=r" (this->_State));
+		__asm__ volatile ("cpsid i" ::: "memory");
+	}
+	inline ~Vfb_CriticalSection() { __asm__ volatile ("msr primask, %0" :: "r" (this->_State) : "memory"); }
+#elif defined(ESP8266)
+	inline Vfb_CriticalSection() : _State(xt_rsil(15)) {}
+	inline ~Vfb_CriticalSection() { xt_wsr_ps(this->_State); }
+#elif defined(ESP32)
+	inline Vfb_CriticalSection() : _State(portSET_INTERRUPT_MASK_FROM_ISR()) {}
+	inline ~Vfb_CriticalSection() { portCLEAR_INTERRUPT_MASK_FROM_ISR(this->_State); }
+#elif defined(DRIVERS_HOST)
+	inline Vfb_CriticalSection() {}
+	inline ~Vfb_CriticalSection() {}
+#else
+	inline Vfb_CriticalSection() { noInterrupts(); }
+	inline ~Vfb_CriticalSection() { interrupts(); }
+#endif
+
+private:
+#if defined(__AVR__)
+	uint8_t _State;
+#elif (defined(__ARM_ARCH_PROFILE) && (__ARM_ARCH_PROFILE == 'M')) || defined(ESP8266) || defined(ESP32)
+	uint32_t _State;
+#endif
+
+	Vfb_CriticalSection(const Vfb_CriticalSection &) = delete;
+	Vfb_CriticalSection &operator=(const Vfb_CriticalSection &) = delete;
+};
+
 #endif /* _HAL_H_ */
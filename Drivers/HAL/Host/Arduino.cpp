@@ -0,0 +1,867 @@
+/*
+ * Arduino.cpp (host)
+ *
+ *  Virtual time, simulated pin bank and serial port behind the host Arduino.h.
+ */
+
+#if defined(DRIVERS_HOST)
+
+#include "Arduino.h"
+#include "FastGpio.h"
+#include "SPI.h"
+
+#if defined(__GLIBC__)
+	#include <malloc.h>
+#endif
+
+using namespace Drivers;
+
+#if defined(__GLIBC__)
+/*
+ * Heap accounting. mallinfo() can't be used: chunks parked in the per-thread cache still
+ * count as in use, so a driver built after another one was deleted shows 0 bytes. The
+ * allocator entry points are wrapped instead (new/delete end up here as well).
+ */
+extern "C"
+{
+	void *__libc_malloc(size_t size);
+	void *__libc_calloc(size_t count, size_t size);
+	void *__libc_realloc(void *ptr, size_t size);
+	void __libc_free(void *ptr);
+}
+
+namespace
+{
+	size_t HeapBytes = 0;
+}
+
+extern "C"
+{
+	void *malloc(size_t size)
+	{
+		void *ptr = __libc_malloc(size);
+		HeapBytes += (ptr != NULL) ? malloc_usable_size(ptr) : 0u;
+		return ptr;
+	}
+
+	void *calloc(size_t count, size_t size)
+	{
+		void *ptr = __libc_calloc(count, size);
+		HeapBytes += (ptr != NULL) ? malloc_usable_size(ptr) : 0u;
+		return ptr;
+	}
+
+	void *realloc(void *ptr, size_t size)
+	{
+		size_t old = (ptr != NULL) ? malloc_usable_size(ptr) : 0u;
+		void *resized = __libc_realloc(ptr, size);
+		if( (resized != NULL) || (size == 0u) )
+		{
+			HeapBytes -= old;
+			HeapBytes += (resized != NULL) ? malloc_usable_size(resized) : 0u;
+		}
+		return resized;
+	}
+
+	void free(void *ptr)
+	{
+		HeapBytes -= (ptr != NULL) ? malloc_usable_size(ptr) : 0u;
+		__libc_free(ptr);
+	}
+}
+#else
+namespace
+{
+	/* No allocator hooks outside glibc, heap figures read 0 */
+	size_t HeapBytes = 0;
+}
+#endif
+
+namespace
+{
+	const HostSim::CostModel DefaultCosts =
+	{
+		3500u,		/* DigitalWriteNs: ~56 cycles of table lookups in digitalWrite() */
+		3200u,		/* DigitalReadNs */
+		4000u,		/* PinModeNs */
+		4500u,		/* AnalogWriteNs */
+		112000u,	/* AnalogReadNs: one ADC conversion at the default prescaler */
+		125u,		/* FastGpioStoreNs: sbi/cbi, 2 cycles */
+		375u,		/* SpiByteNs: SPDR load, SPIF poll and loop, ~6 cycles */
+	};
+
+	uint64_t NowNs = 0;
+	uint64_t BusNs = 0;
+	HostSim::CostModel Costs = DefaultCosts;
+
+	uint8_t Modes[HOST_SIM_PINS];
+	uint16_t Analog[HOST_SIM_PINS];
+
+	struct
+	{
+		void (*Handler)(void);
+		int Mode;
+	} Interrupts[HOST_SIM_PINS];
+
+	/* Periodic timer interrupt, fired from Advance() at every period boundary */
+	void (*TimerIsr)(void) = nullptr;
+	uint64_t TimerPeriodNs = 0;
+	uint64_t TimerNextNs = 0;
+	bool InTimerIsr = false;
+
+	bool EdgeLogging = true;
+	HostSim::Edge Edges[HOST_SIM_EDGE_LOG_SIZE];
+	uint32_t EdgeHead = 0, EdgeCount = 0;
+
+	void Charge(uint32_t ns)
+	{
+		BusNs += ns;
+		HostSim::Advance(ns);
+	}
+
+	void LogEdge(uint8_t pin, uint8_t level)
+	{
+		if( !EdgeLogging )
+		{
+			return;
+		}
+
+		Edges[EdgeHead].Pin = pin;
+		Edges[EdgeHead].Level = level;
+		Edges[EdgeHead].TimeNs = NowNs;
+		EdgeHead = (EdgeHead + 1u) % HOST_SIM_EDGE_LOG_SIZE;
+		if( EdgeCount < HOST_SIM_EDGE_LOG_SIZE )
+		{
+			EdgeCount++;
+		}
+	}
+
+	void FireInterrupt(uint8_t pin, uint8_t level)
+	{
+		if( Interrupts[pin].Handler == nullptr )
+		{
+			return;
+		}
+
+		int mode = Interrupts[pin].Mode;
+		if( (mode == CHANGE) || ((mode == RISING) && (level == HIGH)) || ((mode == FALLING) && (level == LOW)) )
+		{
+			Interrupts[pin].Handler();
+		}
+	}
+
+	/* Every level change goes through here, no matter if it came from digitalWrite(), FastGpio or SetInput() */
+	void PortChanged(uint8_t port, uint8_t oldValue, uint8_t newValue)
+	{
+		uint8_t changed = oldValue ^ newValue;
+		for( uint8_t bit = 0; (bit < 8u) && changed; bit++, changed >>= 1 )
+		{
+			if( changed & 1u )
+			{
+				uint8_t pin = (uint8_t)(port * 8u + bit);
+				uint8_t level = (newValue >> bit) & 1u;
+				LogEdge(pin, level);
+				FireInterrupt(pin, level);
+			}
+		}
+	}
+
+	void FastGpioStored(uint8_t port, uint8_t oldValue, uint8_t newValue)
+	{
+		Charge(Costs.FastGpioStoreNs);
+		PortChanged(port, oldValue, newValue);
+	}
+
+	void WriteLevel(uint8_t pin, uint8_t level)
+	{
+		uint8_t port = pin / 8u;
+		uint8_t mask = (uint8_t)(1u << (pin % 8u));
+		uint8_t oldValue = FastGpioHost::Ports[port];
+		uint8_t newValue = level ? (oldValue | mask) : (oldValue & (uint8_t)~mask);
+
+		FastGpioHost::Ports[port] = newValue;
+		PortChanged(port, oldValue, newValue);
+	}
+
+	struct Init
+	{
+		Init()
+		{
+			HostSim::Reset();
+		}
+	} InitOnLoad;
+}
+
+/*
+ * Pins and time
+ */
+
+void pinMode(uint8_t pin, uint8_t mode)
+{
+	if( pin >= HOST_SIM_PINS )
+	{
+		return;
+	}
+
+	Charge(Costs.PinModeNs);
+	Modes[pin] = mode;
+	if( mode == OUTPUT )
+		FastGpioHost::Ddrs[pin / 8u] |= (uint8_t)(1u << (pin % 8u));
+	else
+		FastGpioHost::Ddrs[pin / 8u] &= (uint8_t)~(1u << (pin % 8u));
+}
+
+void digitalWrite(uint8_t pin, uint8_t val)
+{
+	if( pin >= HOST_SIM_PINS )
+	{
+		return;
+	}
+
+	Charge(Costs.DigitalWriteNs);
+	WriteLevel(pin, (val == LOW) ? LOW : HIGH);
+}
+
+int digitalRead(uint8_t pin)
+{
+	if( pin >= HOST_SIM_PINS )
+	{
+		return LOW;
+	}
+
+	Charge(Costs.DigitalReadNs);
+	return (FastGpioHost::Ports[pin / 8u] >> (pin % 8u)) & 1u;
+}
+
+int analogRead(uint8_t pin)
+{
+	if( pin >= HOST_SIM_PINS )
+	{
+		return 0;
+	}
+
+	Charge(Costs.AnalogReadNs);
+	return Analog[pin];
+}
+
+void analogWrite(uint8_t pin, int val)
+{
+	if( pin >= HOST_SIM_PINS )
+	{
+		return;
+	}
+
+	Charge(Costs.AnalogWriteNs);
+	Analog[pin] = (uint16_t)val;
+	/* Like the AVR core: 0 and 255 end up as plain digital levels */
+	if( val <= 0 )
+		WriteLevel(pin, LOW);
+	else if( val >= 255 )
+		WriteLevel(pin, HIGH);
+}
+
+unsigned long millis()
+{
+	return (unsigned long)(NowNs / 1000000u);
+}
+
+unsigned long micros()
+{
+	return (unsigned long)(NowNs / 1000u);
+}
+
+void delay(unsigned long ms)
+{
+	HostSim::Advance((uint64_t)ms * 1000000u);
+}
+
+void delayMicroseconds(unsigned int us)
+{
+	HostSim::Advance((uint64_t)us * 1000u);
+}
+
+void attachInterrupt(uint8_t interruptNum, void (*userFunc)(void), int mode)
+{
+	if( interruptNum < HOST_SIM_PINS )
+	{
+		Interrupts[interruptNum].Handler = userFunc;
+		Interrupts[interruptNum].Mode = mode;
+	}
+}
+
+void detachInterrupt(uint8_t interruptNum)
+{
+	if( interruptNum < HOST_SIM_PINS )
+	{
+		Interrupts[interruptNum].Handler = nullptr;
+	}
+}
+
+void tone(uint8_t pin, unsigned int frequency, unsigned long duration)
+{
+	(void)frequency;
+	(void)duration;
+	Charge(Costs.DigitalWriteNs);
+	WriteLevel(pin, HIGH);
+}
+
+void noTone(uint8_t pin)
+{
+	Charge(Costs.DigitalWriteNs);
+	WriteLevel(pin, LOW);
+}
+
+/*
+ * Simulation controls
+ */
+
+namespace HostSim
+{
+	void Reset()
+	{
+		::NowNs = 0;
+		BusNs = 0;
+		TimerIsr = nullptr;
+		InTimerIsr = false;
+		::Costs = DefaultCosts;
+		memset((void *)FastGpioHost::Ports, 0, sizeof(FastGpioHost::Ports));
+		memset((void *)FastGpioHost::Ddrs, 0, sizeof(FastGpioHost::Ddrs));
+		memset(Modes, INPUT, sizeof(Modes));
+		memset(Analog, 0, sizeof(Analog));
+		memset(Interrupts, 0, sizeof(Interrupts));
+		FastGpioHost::ResetCounters();
+		FastGpioHost::StoreHook = FastGpioStored;
+		EdgeLogging = true;
+		ClearEdges();
+	}
+
+	uint64_t NowNs()
+	{
+		return ::NowNs;
+	}
+
+	void Advance(uint64_t ns)
+	{
+		uint64_t end = ::NowNs + ns;
+
+		/* Time spent inside the ISR itself doesn't fire it again, like on a core with interrupts masked in ISRs */
+		while( (TimerIsr != nullptr) && !InTimerIsr && (TimerNextNs <= end) )
+		{
+			if( TimerNextNs > ::NowNs )
+			{
+				::NowNs = TimerNextNs;
+			}
+			TimerNextNs += TimerPeriodNs;
+
+			InTimerIsr = true;
+			TimerIsr();
+			InTimerIsr = false;
+
+			/* The ISR consumed virtual time, the caller's interval still ends at the same instant */
+			if( ::NowNs > end )
+			{
+				end = ::NowNs;
+			}
+		}
+
+		if( end > ::NowNs )
+		{
+			::NowNs = end;
+		}
+	}
+
+	void SetTimerInterrupt(uint32_t periodNs, void (*isr)(void))
+	{
+		TimerIsr = (periodNs != 0u) ? isr : nullptr;
+		TimerPeriodNs = periodNs;
+		TimerNextNs = ::NowNs + periodNs;
+	}
+
+	CostModel &Costs()
+	{
+		return ::Costs;
+	}
+
+	uint64_t BusTimeNs()
+	{
+		return BusNs;
+	}
+
+	void ResetBusTime()
+	{
+		BusNs = 0;
+	}
+
+	void SetInput(uint8_t pin, uint8_t level)
+	{
+		if( pin < HOST_SIM_PINS )
+		{
+			WriteLevel(pin, level ? HIGH : LOW);
+		}
+	}
+
+	uint8_t GetLevel(uint8_t pin)
+	{
+		return (pin < HOST_SIM_PINS) ? ((FastGpioHost::Ports[pin / 8u] >> (pin % 8u)) & 1u) : LOW;
+	}
+
+	uint8_t GetMode(uint8_t pin)
+	{
+		return (pin < HOST_SIM_PINS) ? Modes[pin] : INPUT;
+	}
+
+	uint8_t GetAnalog(uint8_t pin)
+	{
+		return (pin < HOST_SIM_PINS) ? (uint8_t)Analog[pin] : 0;
+	}
+
+	void SetAnalogInput(uint8_t pin, uint16_t value)
+	{
+		if( pin < HOST_SIM_PINS )
+		{
+			Analog[pin] = value;
+		}
+	}
+
+	void SetEdgeLogging(bool enable)
+	{
+		EdgeLogging = enable;
+	}
+
+	uint32_t EdgeCount()
+	{
+		return ::EdgeCount;
+	}
+
+	const Edge &GetEdge(uint32_t index)
+	{
+		uint32_t oldest = (EdgeHead + HOST_SIM_EDGE_LOG_SIZE - ::EdgeCount) % HOST_SIM_EDGE_LOG_SIZE;
+		return Edges[(oldest + index) % HOST_SIM_EDGE_LOG_SIZE];
+	}
+
+	void ClearEdges()
+	{
+		EdgeHead = 0;
+		::EdgeCount = 0;
+	}
+
+	size_t HeapInUse()
+	{
+		return HeapBytes;
+	}
+}
+
+/*
+ * String
+ */
+
+namespace
+{
+	std::string NumberToString(unsigned long value, unsigned char base, bool negative)
+	{
+		char buf[8 * sizeof(unsigned long) + 2];
+		char *p = &buf[sizeof(buf) - 1];
+		*p = '\0';
+
+		if( base < 2 )
+		{
+			base = 10;
+		}
+
+		do
+		{
+			unsigned long digit = value % base;
+			*--p = (char)((digit < 10) ? ('0' + digit) : ('A' + digit - 10));
+			value /= base;
+		} while( value );
+
+		if( negative )
+		{
+			*--p = '-';
+		}
+
+		return std::string(p);
+	}
+
+	std::string FloatToString(double value, unsigned char decimalPlaces)
+	{
+		char buf[64];
+		snprintf(buf, sizeof(buf), "%.*f", (int)decimalPlaces, value);
+		return std::string(buf);
+	}
+}
+
+String::String(const char *cstr) : _Str(cstr ? cstr : "") {}
+String::String(const std::string &str) : _Str(str) {}
+String::String(char c) : _Str(1, c) {}
+String::String(unsigned char value, unsigned char base) : _Str(NumberToString(value, base, false)) {}
+String::String(int value, unsigned char base) : _Str((base == 10) ? NumberToString((unsigned long)(value < 0 ? -(long)value : value), base, value < 0) : NumberToString((unsigned int)value, base, false)) {}
+String::String(unsigned int value, unsigned char base) : _Str(NumberToString(value, base, false)) {}
+String::String(long value, unsigned char base) : _Str((base == 10) ? NumberToString((unsigned long)(value < 0 ? -value : value), base, value < 0) : NumberToString((unsigned long)value, base, false)) {}
+String::String(unsigned long value, unsigned char base) : _Str(NumberToString(value, base, false)) {}
+String::String(float value, unsigned char decimalPlaces) : _Str(FloatToString(value, decimalPlaces)) {}
+String::String(double value, unsigned char decimalPlaces) : _Str(FloatToString(value, decimalPlaces)) {}
+
+String String::substring(unsigned int beginIndex) const
+{
+	return this->substring(beginIndex, this->length());
+}
+
+String String::substring(unsigned int beginIndex, unsigned int endIndex) const
+{
+	if( beginIndex > endIndex )
+	{
+		unsigned int tmp = beginIndex;
+		beginIndex = endIndex;
+		endIndex = tmp;
+	}
+	if( beginIndex > this->length() )
+	{
+		return String();
+	}
+	if( endIndex > this->length() )
+	{
+		endIndex = this->length();
+	}
+	return String(this->_Str.substr(beginIndex, endIndex - beginIndex));
+}
+
+/*
+ * Print
+ */
+
+size_t Print::write(const uint8_t *buffer, size_t size)
+{
+	size_t n = 0;
+	while( size-- )
+	{
+		if( this->write(*buffer++) )
+			n++;
+		else
+			break;
+	}
+	return n;
+}
+
+size_t Print::_PrintNumber(unsigned long value, int base, bool negative)
+{
+	std::string str = NumberToString(value, (unsigned char)base, negative);
+	return this->write((const uint8_t *)str.c_str(), str.length());
+}
+
+size_t Print::print(const String &str) { return this->write((const uint8_t *)str.c_str(), str.length()); }
+size_t Print::print(const char str[]) { return this->write(str); }
+size_t Print::print(char c) { return this->write((uint8_t)c); }
+size_t Print::print(unsigned char value, int base) { return this->_PrintNumber(value, base, false); }
+size_t Print::print(int value, int base) { return this->print((long)value, base); }
+size_t Print::print(unsigned int value, int base) { return this->_PrintNumber(value, base, false); }
+size_t Print::print(long value, int base)
+{
+	if( (base == 10) && (value < 0) )
+		return this->_PrintNumber((unsigned long)(-value), base, true);
+	return this->_PrintNumber((unsigned long)value, base, false);
+}
+size_t Print::print(unsigned long value, int base) { return this->_PrintNumber(value, base, false); }
+size_t Print::print(double value, int digits)
+{
+	std::string str = FloatToString(value, (unsigned char)digits);
+	return this->write((const uint8_t *)str.c_str(), str.length());
+}
+
+size_t Print::println() { return this->write("\r\n"); }
+size_t Print::println(const String &str) { size_t n = this->print(str); return n + this->println(); }
+size_t Print::println(const char str[]) { size_t n = this->print(str); return n + this->println(); }
+size_t Print::println(char c) { size_t n = this->print(c); return n + this->println(); }
+size_t Print::println(unsigned char value, int base) { size_t n = this->print(value, base); return n + this->println(); }
+size_t Print::println(int value, int base) { size_t n = this->print(value, base); return n + this->println(); }
+size_t Print::println(unsigned int value, int base) { size_t n = this->print(value, base); return n + this->println(); }
+size_t Print::println(long value, int base) { size_t n = this->print(value, base); return n + this->println(); }
+size_t Print::println(unsigned long value, int base) { size_t n = this->print(value, base); return n + this->println(); }
+size_t Print::println(double value, int digits) { size_t n = this->print(value, digits); return n + this->println(); }
+
+/*
+ * HardwareSerial
+ */
+
+HardwareSerial Serial;
+HardwareSerial Serial1;
+
+HardwareSerial::HardwareSerial()
+{
+	this->ResetHostStats();
+}
+
+void HardwareSerial::begin(unsigned long baud)
+{
+	this->_Baud = baud;
+	this->_LastDrainNs = HostSim::NowNs();
+	this->_DrainCarry = 0;
+}
+
+void HardwareSerial::end()
+{
+	this->flush();
+	this->_Baud = 0;
+}
+
+void HardwareSerial::SetDrainRate(uint32_t bytesPerSecond)
+{
+	this->_Drain();
+	this->_DrainRate = bytesPerSecond;
+}
+
+uint32_t HardwareSerial::GetDrainRate() const
+{
+	return (this->_DrainRate != 0) ? this->_DrainRate : (uint32_t)(this->_Baud / 10u);
+}
+
+void HardwareSerial::SetCapture(bool enable)
+{
+	this->_Capture = enable;
+}
+
+void HardwareSerial::ResetHostStats()
+{
+	memset(&this->_Stats, 0, sizeof(this->_Stats));
+}
+
+uint16_t HardwareSerial::TxQueued()
+{
+	this->_Drain();
+	return this->_TxCount;
+}
+
+void HardwareSerial::_Drain()
+{
+	uint64_t now = HostSim::NowNs();
+	uint32_t rate = this->GetDrainRate();
+
+	if( rate == 0u )
+	{
+		/* Port not started, nothing leaves the FIFO */
+		this->_LastDrainNs = now;
+		return;
+	}
+
+	/* Bytes that left since the last call, keeping the remainder so slow polling doesn't lose time */
+	this->_DrainCarry += (now - this->_LastDrainNs) * rate;
+	this->_LastDrainNs = now;
+
+	uint64_t bytes = this->_DrainCarry / 1000000000u;
+	if( bytes >= this->_TxCount )
+	{
+		bytes = this->_TxCount;
+		if( this->_TxCount == 0u )
+		{
+			/* Line idle, don't bank time for later bytes */
+			this->_DrainCarry = 0;
+		}
+	}
+	this->_DrainCarry -= bytes * 1000000000u;
+
+	if( this->_Capture )
+	{
+		for( uint64_t i = 0; i < bytes; i++ )
+		{
+			uint16_t tail = (uint16_t)((this->_TxHead + SERIAL_TX_BUFFER_SIZE - this->_TxCount + i) % SERIAL_TX_BUFFER_SIZE);
+			this->_Captured += (char)this->_Tx[tail];
+		}
+	}
+	this->_TxCount = (uint16_t)(this->_TxCount - bytes);
+	this->_Stats.BytesOnWire += (uint32_t)bytes;
+	if( this->_TxCount == 0u )
+	{
+		this->_DrainCarry = 0;
+	}
+}
+
+int HardwareSerial::availableForWrite()
+{
+	this->_Drain();
+	return SERIAL_TX_BUFFER_SIZE - 1 - this->_TxCount;
+}
+
+void HardwareSerial::flush()
+{
+	uint32_t rate = this->GetDrainRate();
+	this->_Drain();
+	if( (rate == 0u) || (this->_TxCount == 0u) )
+	{
+		return;
+	}
+
+	HostSim::Advance(((uint64_t)this->_TxCount * 1000000000u + rate - 1u) / rate);
+	this->_Drain();
+}
+
+size_t HardwareSerial::write(uint8_t byte)
+{
+	this->_Stats.WriteCalls++;
+
+	/* Like the AVR core: busy wait for FIFO space, in virtual time */
+	while( this->availableForWrite() <= 0 )
+	{
+		uint32_t rate = this->GetDrainRate();
+		uint64_t wait = (rate == 0u) ? 0u : ((1000000000u + rate - 1u) / rate);
+		if( wait == 0u )
+		{
+			return 0;
+		}
+		HostSim::Advance(wait);
+		this->_Stats.BlockedNs += wait;
+	}
+
+	this->_Tx[this->_TxHead] = byte;
+	this->_TxHead = (uint16_t)((this->_TxHead + 1u) % SERIAL_TX_BUFFER_SIZE);
+	this->_TxCount++;
+	this->_Stats.BytesWritten++;
+	return 1;
+}
+
+size_t HardwareSerial::write(const uint8_t *buffer, size_t size)
+{
+	size_t n = 0;
+	uint32_t calls = this->_Stats.WriteCalls;
+
+	/* What fits now is copied in one go, the rest waits for FIFO space byte by byte like the core does */
+	size_t space = (size_t)this->availableForWrite();
+	size_t now = (size < space) ? size : space;
+	size_t first = SERIAL_TX_BUFFER_SIZE - this->_TxHead;
+	if( first > now )
+	{
+		first = now;
+	}
+	memcpy(&this->_Tx[this->_TxHead], buffer, first);
+	memcpy(&this->_Tx[0], &buffer[first], now - first);
+	this->_TxHead = (uint16_t)((this->_TxHead + now) % SERIAL_TX_BUFFER_SIZE);
+	this->_TxCount = (uint16_t)(this->_TxCount + now);
+	this->_Stats.BytesWritten += (uint32_t)now;
+	n = now;
+
+	while( n < size )
+	{
+		if( this->write(buffer[n]) == 0 )
+		{
+			break;
+		}
+		n++;
+	}
+
+	/* Count the bulk write as a single call */
+	this->_Stats.WriteCalls = calls + 1u;
+	return n;
+}
+
+int HardwareSerial::available()
+{
+	return this->_RxCount;
+}
+
+int HardwareSerial::peek()
+{
+	if( this->_RxCount == 0u )
+	{
+		return -1;
+	}
+	uint16_t tail = (uint16_t)((this->_RxHead + SERIAL_RX_BUFFER_SIZE - this->_RxCount) % SERIAL_RX_BUFFER_SIZE);
+	return this->_Rx[tail];
+}
+
+int HardwareSerial::read()
+{
+	int c = this->peek();
+	if( c >= 0 )
+	{
+		this->_RxCount--;
+	}
+	return c;
+}
+
+size_t HardwareSerial::InjectRx(const uint8_t *data, size_t len)
+{
+	size_t n = 0;
+	for( ; n < len; n++ )
+	{
+		if( this->_RxCount >= (SERIAL_RX_BUFFER_SIZE - 1) )
+		{
+			this->_Stats.RxOverruns += (uint32_t)(len - n);
+			break;
+		}
+		this->_Rx[this->_RxHead] = data[n];
+		this->_RxHead = (uint16_t)((this->_RxHead + 1u) % SERIAL_RX_BUFFER_SIZE);
+		this->_RxCount++;
+	}
+	return n;
+}
+
+/*
+ * SPI
+ */
+
+SPIClass SPI;
+
+void SPIClass::begin()
+{
+	pinMode(SS, OUTPUT);
+	pinMode(MOSI, OUTPUT);
+	pinMode(SCK, OUTPUT);
+	WriteLevel(SCK, LOW);
+	this->_Transfers = 0;
+}
+
+void SPIClass::end()
+{
+}
+
+void SPIClass::beginTransaction(SPISettings settings)
+{
+	uint32_t clock = settings._Clock;
+
+	if( clock > HOST_SIM_SPI_MAX_CLOCK )
+	{
+		clock = HOST_SIM_SPI_MAX_CLOCK;
+	}
+	if( clock == 0u )
+	{
+		clock = 1u;
+	}
+	this->_Settings = settings;
+	this->_BitNs = (uint32_t)((1000000000u + clock - 1u) / clock);
+}
+
+void SPIClass::endTransaction()
+{
+}
+
+uint8_t SPIClass::transfer(uint8_t data)
+{
+	uint8_t received = 0;
+
+	Charge(Costs.SpiByteNs);
+	for( uint8_t bit = 0; bit < 8u; bit++ )
+	{
+		uint8_t shift = (this->_Settings._BitOrder == MSBFIRST) ? (uint8_t)(7u - bit) : bit;
+
+		/* Mode 0: data valid before the rising edge, both sides sample on it */
+		WriteLevel(MOSI, (data >> shift) & 1u);
+		Charge(this->_BitNs / 2u);
+		WriteLevel(SCK, HIGH);
+		received |= (uint8_t)(((FastGpioHost::Ports[MISO / 8u] >> (MISO % 8u)) & 1u) << shift);
+		Charge(this->_BitNs - this->_BitNs / 2u);
+		WriteLevel(SCK, LOW);
+	}
+	this->_Transfers++;
+	return received;
+}
+
+void SPIClass::transfer(void *buf, size_t count)
+{
+	uint8_t *data = (uint8_t *)buf;
+
+	for( size_t n = 0; n < count; n++ )
+	{
+		data[n] = this->transfer(data[n]);
+	}
+}
+
+#endif /* DRIVERS_HOST */
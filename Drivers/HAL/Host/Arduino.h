@@ -0,0 +1,294 @@
+/*
+ * Arduino.h (host)
+ *
+ *  Linux stand-in for the parts of the Arduino core used by the drivers, so they can be
+ *  built and measured without a board. Put Drivers/HAL/Host first on the include path and
+ *  build with -DDRIVERS_HOST (see Benchmark/Readme.md).
+ *
+ *  - time is virtual: millis()/micros() only move when HostSim::Advance() or delay() is
+ *    called, or when a pin/serial operation charges its simulated cost
+ *  - pins live in the FastGpioHost register array, every level change is recorded in an
+ *    edge log and inputs are driven with HostSim::SetInput()
+ *  - HardwareSerial drains its TX FIFO at a configurable rate (default baud / 10)
+ *  - SPI (SPI.h) shifts out on the MOSI/SCK pins and charges the time on the wire
+ */
+
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+#ifndef DRIVERS_HOST
+	#define DRIVERS_HOST	1
+#endif
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+#include <string>
+
+typedef uint8_t byte;
+typedef bool boolean;
+typedef uint16_t word;
+
+#define HIGH				0x1
+#define LOW					0x0
+
+#define INPUT				0x0
+#define OUTPUT				0x1
+#define INPUT_PULLUP		0x2
+
+#define LSBFIRST			0
+#define MSBFIRST			1
+
+#define CHANGE				1
+#define FALLING				2
+#define RISING				3
+
+#define DEC					10
+#define HEX					16
+#define OCT					8
+#define BIN					2
+
+#define PI					3.1415926535897932384626433832795
+
+#define NOT_AN_INTERRUPT	-1
+#define NOT_A_PORT			0
+
+#ifndef HOST_SIM_PINS
+	#define HOST_SIM_PINS	80u
+#endif
+
+#ifndef HOST_SIM_EDGE_LOG_SIZE
+	#define HOST_SIM_EDGE_LOG_SIZE	16384u
+#endif
+
+#ifndef SERIAL_TX_BUFFER_SIZE
+	#define SERIAL_TX_BUFFER_SIZE	64
+#endif
+
+#ifndef SERIAL_RX_BUFFER_SIZE
+	#define SERIAL_RX_BUFFER_SIZE	64
+#endif
+
+#define NUM_DIGITAL_PINS			HOST_SIM_PINS
+#define digitalPinToInterrupt(p)	((p) < HOST_SIM_PINS ? (int)(p) : NOT_AN_INTERRUPT)
+#define _BV(bit)					(1u << (bit))
+/* Port N is FastGpioHost::Ports[N - 1] (Arduino numbers ports from 1, 0 is NOT_A_PORT) */
+#define digitalPinToPort(p)			((p) < HOST_SIM_PINS ? (uint8_t)((p) / 8u + 1u) : NOT_A_PORT)
+#define digitalPinToBitMask(p)		((uint8_t)(1u << ((p) % 8u)))
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int digitalRead(uint8_t pin);
+int analogRead(uint8_t pin);
+void analogWrite(uint8_t pin, int val);
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+void attachInterrupt(uint8_t interruptNum, void (*userFunc)(void), int mode);
+void detachInterrupt(uint8_t interruptNum);
+
+/* Single threaded host: "interrupts" run synchronously, nothing to mask */
+inline void noInterrupts() {}
+inline void interrupts() {}
+
+void tone(uint8_t pin, unsigned int frequency, unsigned long duration = 0);
+void noTone(uint8_t pin);
+
+class String
+{
+public:
+	String(const char *cstr = "");
+	String(const std::string &str);
+	explicit String(char c);
+	explicit String(unsigned char value, unsigned char base = 10);
+	explicit String(int value, unsigned char base = 10);
+	explicit String(unsigned int value, unsigned char base = 10);
+	explicit String(long value, unsigned char base = 10);
+	explicit String(unsigned long value, unsigned char base = 10);
+	explicit String(float value, unsigned char decimalPlaces = 2);
+	explicit String(double value, unsigned char decimalPlaces = 2);
+
+	unsigned int length() const { return (unsigned int)this->_Str.length(); }
+	const char *c_str() const { return this->_Str.c_str(); }
+	char operator[](unsigned int index) const { return index < this->_Str.length() ? this->_Str[index] : 0; }
+
+	String substring(unsigned int beginIndex) const;
+	String substring(unsigned int beginIndex, unsigned int endIndex) const;
+
+	String &operator+=(const String &rhs) { this->_Str += rhs._Str; return *this; }
+	String &operator+=(const char *rhs) { this->_Str += rhs; return *this; }
+	String &operator+=(char rhs) { this->_Str += rhs; return *this; }
+
+	bool operator==(const String &rhs) const { return this->_Str == rhs._Str; }
+	bool operator!=(const String &rhs) const { return this->_Str != rhs._Str; }
+
+	friend String operator+(const String &lhs, const String &rhs) { return String(lhs._Str + rhs._Str); }
+	friend String operator+(const String &lhs, const char *rhs) { return String(lhs._Str + rhs); }
+	friend String operator+(const char *lhs, const String &rhs) { return String(lhs + rhs._Str); }
+
+private:
+	std::string _Str;
+};
+
+class Print
+{
+public:
+	virtual ~Print() {}
+
+	virtual size_t write(uint8_t) = 0;
+	virtual size_t write(const uint8_t *buffer, size_t size);
+	size_t write(const char *str) { return (str == NULL) ? 0 : this->write((const uint8_t *)str, strlen(str)); }
+	size_t write(const char *buffer, size_t size) { return this->write((const uint8_t *)buffer, size); }
+	virtual int availableForWrite() { return 0; }
+	virtual void flush() {}
+
+	size_t print(const String &str);
+	size_t print(const char str[]);
+	size_t print(char c);
+	size_t print(unsigned char value, int base = DEC);
+	size_t print(int value, int base = DEC);
+	size_t print(unsigned int value, int base = DEC);
+	size_t print(long value, int base = DEC);
+	size_t print(unsigned long value, int base = DEC);
+	size_t print(double value, int digits = 2);
+
+	size_t println();
+	size_t println(const String &str);
+	size_t println(const char str[]);
+	size_t println(char c);
+	size_t println(unsigned char value, int base = DEC);
+	size_t println(int value, int base = DEC);
+	size_t println(unsigned int value, int base = DEC);
+	size_t println(long value, int base = DEC);
+	size_t println(unsigned long value, int base = DEC);
+	size_t println(double value, int digits = 2);
+
+private:
+	size_t _PrintNumber(unsigned long value, int base, bool negative);
+};
+
+class Stream : public Print
+{
+public:
+	virtual int available() = 0;
+	virtual int read() = 0;
+	virtual int peek() = 0;
+};
+
+class HardwareSerial : public Stream
+{
+public:
+	typedef struct
+	{
+		uint32_t WriteCalls;		/* calls of write(uint8_t) and write(buf, len) */
+		uint32_t BytesWritten;		/* bytes accepted into the TX FIFO */
+		uint32_t BytesOnWire;		/* bytes that left the TX FIFO */
+		uint64_t BlockedNs;			/* virtual time spent waiting for FIFO space */
+		uint32_t RxOverruns;		/* injected bytes lost because the RX FIFO was full */
+	} HostStats;
+
+	HardwareSerial();
+
+	void begin(unsigned long baud);
+	void end();
+	int available();
+	int peek();
+	int read();
+	int availableForWrite();
+	void flush();
+	size_t write(uint8_t byte);
+	size_t write(const uint8_t *buffer, size_t size);
+	using Print::write;
+	operator bool() { return true; }
+
+	/* Host simulation controls */
+	void SetDrainRate(uint32_t bytesPerSecond);		/* 0 = derive from baud rate, 10 bits per byte */
+	uint32_t GetDrainRate() const;
+	uint16_t TxQueued();							/* bytes still waiting in the TX FIFO */
+	void SetCapture(bool enable);					/* keep a copy of every byte that left the FIFO */
+	const std::string &Captured() const { return this->_Captured; }
+	void ClearCapture() { this->_Captured.clear(); }
+	size_t InjectRx(const uint8_t *data, size_t len);
+	const HostStats &GetHostStats() const { return this->_Stats; }
+	void ResetHostStats();
+
+private:
+	unsigned long _Baud = 0;
+	uint32_t _DrainRate = 0;
+	uint64_t _LastDrainNs = 0;
+	uint64_t _DrainCarry = 0;
+	bool _Capture = false;
+	std::string _Captured;
+	uint8_t _Tx[SERIAL_TX_BUFFER_SIZE];
+	uint16_t _TxHead = 0, _TxCount = 0;
+	uint8_t _Rx[SERIAL_RX_BUFFER_SIZE];
+	uint16_t _RxHead = 0, _RxCount = 0;
+	HostStats _Stats;
+
+	void _Drain();
+};
+
+extern HardwareSerial Serial;
+extern HardwareSerial Serial1;
+
+namespace HostSim
+{
+	typedef struct
+	{
+		uint8_t Pin;
+		uint8_t Level;
+		uint64_t TimeNs;
+	} Edge;
+
+	/* Virtual time charged by each simulated operation, defaults model an AVR at 16MHz */
+	typedef struct
+	{
+		uint32_t DigitalWriteNs;
+		uint32_t DigitalReadNs;
+		uint32_t PinModeNs;
+		uint32_t AnalogWriteNs;
+		uint32_t AnalogReadNs;
+		uint32_t FastGpioStoreNs;
+		uint32_t SpiByteNs;			/* per SPI byte on top of its 8 clock periods */
+	} CostModel;
+
+	/* Back to time zero, all pins low, logs and counters cleared, default costs */
+	void Reset();
+
+	uint64_t NowNs();
+	void Advance(uint64_t ns);
+	inline void AdvanceUs(uint32_t us) { Advance((uint64_t)us * 1000u); }
+
+	CostModel &Costs();
+
+	/* Hardware timer stand-in: Isr runs from Advance() every periodNs of virtual time (0 stops it) */
+	void SetTimerInterrupt(uint32_t periodNs, void (*isr)(void));
+
+	/* Virtual time spent in pin operations since the last ResetBusTime() */
+	uint64_t BusTimeNs();
+	void ResetBusTime();
+
+	/* Drive an input pin from the outside world, fires attached interrupts */
+	void SetInput(uint8_t pin, uint8_t level);
+	uint8_t GetLevel(uint8_t pin);
+	uint8_t GetMode(uint8_t pin);
+	uint8_t GetAnalog(uint8_t pin);
+	void SetAnalogInput(uint8_t pin, uint16_t value);
+
+	/* Level changes of all pins, oldest first. Only the last HOST_SIM_EDGE_LOG_SIZE are kept */
+	void SetEdgeLogging(bool enable);
+	uint32_t EdgeCount();
+	const Edge &GetEdge(uint32_t index);
+	void ClearEdges();
+
+	/* Bytes currently allocated from the heap */
+	size_t HeapInUse();
+}
+
+#endif /* HOST_ARDUINO_H */
@@ -0,0 +1,536 @@
+/*
+ * BenchHC595.cpp
+ */
+
+#include "Benchmark.h"
+#include "HC595.h"
+#include "HC595Pwm.h"
+
+#include <string>
+#include <vector>
+
+using namespace Drivers;
+
+namespace Bench
+{
+	static void Refresh(HC595Base *reg, const char *scenario, size_t heapBefore, uint32_t refreshes)
+	{
+		HostTimer timer;
+		long heapBytes = (long)(HostSim::HeapInUse() - heapBefore);
+
+		HostSim::ResetBusTime();
+		FastGpioHost::ResetCounters();
+		for( uint32_t i = 0; i < refreshes; i++ )
+		{
+			reg->ToggleAll();
+			timer.Start();
+			reg->MainFunction();
+			timer.Stop();
+		}
+
+		Result result;
+		result.Driver = "HC595";
+		result.Scenario = scenario;
+		result.Calls = refreshes;
+		result.HostNs = timer.ElapsedNs();
+		result.BusNs = HostSim::BusTimeNs();
+		result.HeapBytes = heapBytes;
+		Report(result);
+	}
+
+	/* Level of the data pin at every rising clock edge in the edge log, 'L' for every latch pulse */
+	static std::string DecodeEdges(uint8_t clockPin, uint8_t dataPin, uint8_t latchPin, uint8_t data)
+	{
+		std::string bits;
+
+		for( uint32_t i = 0; i < HostSim::EdgeCount(); i++ )
+		{
+			const HostSim::Edge &edge = HostSim::GetEdge(i);
+			if( edge.Pin == dataPin )
+				data = edge.Level;
+			else if( (edge.Pin == clockPin) && (edge.Level == HIGH) )
+				bits += data ? '1' : '0';
+			else if( (edge.Pin == latchPin) && (edge.Level == HIGH) )
+				bits += 'L';
+		}
+		return bits;
+	}
+
+	/* Bits of one refresh followed by 'L' for the latch pulse */
+	static std::string WireBits(HC595Base *reg, uint8_t clockPin, uint8_t dataPin, uint8_t latchPin)
+	{
+		uint8_t data = HostSim::GetLevel(dataPin);
+
+		HostSim::ClearEdges();
+		reg->MainFunction();
+		return DecodeEdges(clockPin, dataPin, latchPin, data);
+	}
+
+	/* Polled refresh of a frame that doesn't change */
+	static void Unchanged(uint32_t calls)
+	{
+		HostSim::Reset();
+		size_t heap = HostSim::HeapInUse();
+		HC595T<FastGpio<2>, FastGpio<3>, FastGpio<4> > reg(4);
+		long heapBytes = (long)(HostSim::HeapInUse() - heap);
+		HostTimer timer;
+
+		reg.SetAll();
+		reg.MainFunction();
+		HostSim::ResetBusTime();
+		FastGpioHost::ResetCounters();
+		timer.Start();
+		for( uint32_t i = 0; i < calls; i++ )
+		{
+			reg.SetBit(0, 1);
+			reg.MainFunction();
+		}
+		timer.Stop();
+
+		Result result;
+		result.Driver = "HC595";
+		result.Scenario = "4 regs, FastGpio, unchanged frame";
+		result.Calls = calls;
+		result.HostNs = timer.ElapsedNs();
+		result.BusNs = HostSim::BusTimeNs();
+		result.HeapBytes = heapBytes;
+		Report(result);
+		Note("port stores %u", FastGpioHost::Stores);
+	}
+
+	/*
+	 * Refresh interrupt every 1ms for 1s of virtual time. Every 50ms the application writes a new
+	 * frame, one register every 400us so the interrupt fires in the middle of it. Every register of
+	 * a frame gets the same value, a latched frame with different bytes is torn.
+	 */
+	static void Interrupt(bool grouped)
+	{
+		HostSim::Reset();
+		size_t heap = HostSim::HeapInUse();
+		HC595T<FastGpio<2>, FastGpio<3>, FastGpio<4> > reg(4);
+		long heapBytes = (long)(HostSim::HeapInUse() - heap);
+		HostTimer timer;
+		uint32_t frames = 0;
+
+		HostSim::ResetBusTime();
+		HostSim::ClearEdges();
+		if( !reg.EnableRefreshInterrupt(true, 1000u) )
+		{
+			Note("no timer backend");
+			return;
+		}
+
+		timer.Start();
+		for( uint32_t ms = 0; ms < 1000u; ms += 50u )
+		{
+			uint8_t value = (uint8_t)(frames * 29u + 3u);
+			if( grouped )
+				reg.BeginUpdate();
+			for( uint8_t i = 0; i < 4u; i++ )
+			{
+				reg.WriteByte(value, i);
+				HostSim::AdvanceUs(400u);
+			}
+			if( grouped )
+				reg.EndUpdate();
+			frames++;
+			HostSim::AdvanceUs(50000u - 4u * 400u);
+		}
+		timer.Stop();
+		reg.EnableRefreshInterrupt(false);
+
+		std::string bits = DecodeEdges(2, 3, 4, LOW);
+		uint32_t latched = 0, torn = 0;
+		for( size_t start = 0; start < bits.size(); )
+		{
+			size_t end = bits.find('L', start);
+			if( end == std::string::npos )
+				break;
+			latched++;
+			for( size_t bit = start + 8u; bit < end; bit++ )
+			{
+				if( bits[bit] != bits[bit - 8u] )
+				{
+					torn++;
+					break;
+				}
+			}
+			start = end + 1u;
+		}
+
+		uint32_t ticks = (uint32_t)(HostSim::NowNs() / 1000000u);
+		Result result;
+		result.Driver = "HC595";
+		result.Scenario = grouped ? "4 regs, 1ms interrupt, BeginUpdate" : "4 regs, 1ms interrupt, ungrouped";
+		result.Calls = ticks;
+		result.HostNs = timer.ElapsedNs();
+		result.BusNs = HostSim::BusTimeNs();
+		result.HeapBytes = heapBytes;
+		Report(result);
+		Note("frames written %u, latched %u in %u ticks, torn %u", frames, latched, ticks, torn);
+	}
+
+	static void Pattern(HC595Base *reg, uint8_t regsNo)
+	{
+		uint8_t data[32];
+		for( uint8_t i = 0; i < regsNo; i++ )
+		{
+			data[i] = (uint8_t)(i * 37u + 1u);
+		}
+		reg->WriteRaw(data, regsNo);
+	}
+
+	std::vector<uint8_t> WireMap(HC595Base *reg)
+	{
+		std::vector<uint8_t> map;
+
+		for( uint16_t output = 0; output < reg->GetRegsNo() * 8u; output++ )
+		{
+			reg->ClearAll();
+			reg->SetBit((uint8_t)(output % 8u), (uint8_t)(output / 8u));
+			map.push_back((uint8_t)WireBits(reg, 2, 3, 4).find('1'));
+		}
+		reg->ClearAll();
+		reg->MainFunction();
+		return map;
+	}
+
+	/* Level of every output in the PWM scenarios, covers off and fully on */
+	static uint8_t PwmLevel(uint16_t output, uint8_t depth)
+	{
+		return (uint8_t)((output * 37u) & ((1u << depth) - 1u));
+	}
+
+	/* Ad-hoc software PWM for comparison: every tick compares a counter with each level and shifts */
+	static struct
+	{
+		HC595Base *Reg;
+		uint8_t Depth;
+		uint8_t Counter;
+	} CounterPwm;
+
+	static void CounterPwmTick(void *Arg)
+	{
+		(void)Arg;
+		HC595Base *reg = CounterPwm.Reg;
+		uint8_t period = (uint8_t)((1u << CounterPwm.Depth) - 1u);
+
+		CounterPwm.Counter = (uint8_t)((CounterPwm.Counter + 1u) % period);
+		for( uint16_t output = 0; output < reg->GetRegsNo() * 8u; output++ )
+		{
+			reg->WriteBit((uint8_t)(output % 8u), (CounterPwm.Counter < PwmLevel(output, CounterPwm.Depth)) ? 1u : 0u, (uint8_t)(output / 8u));
+		}
+		reg->MainFunction();
+	}
+
+	/*
+	 * 4 registers on FastGpio pins dimmed from the 100us PeriodicTimer tick for 3 frames. The
+	 * on time of every output over one frame is rebuilt from the latch pulses in the edge log.
+	 */
+	static void Pwm(uint8_t depth, bool bcm)
+	{
+		HostSim::Reset();
+		size_t heap = HostSim::HeapInUse();
+		HC595T<FastGpio<2>, FastGpio<3>, FastGpio<4> > reg(4);
+		std::vector<uint8_t> map = WireMap(&reg);
+		HC595Pwm *pwm = nullptr;
+		int8_t timer = PeriodicTimer::INVALID_HANDLE;
+		uint64_t lsbNs = PERIODIC_TIMER_TICK_US * 1000u;
+		uint64_t frameNs = ((1u << depth) - 1u) * lsbNs;
+		HostTimer hostTimer;
+		char scenario[40];
+
+		if( bcm )
+		{
+			pwm = new HC595Pwm(reg, depth);
+			for( uint16_t output = 0; output < 32u; output++ )
+			{
+				pwm->SetLevel(output, PwmLevel(output, depth));
+			}
+			pwm->Commit();
+		}
+		long heapBytes = (long)(HostSim::HeapInUse() - heap);
+
+		uint8_t dataLevel = HostSim::GetLevel(3);
+		HostSim::ClearEdges();
+		HostSim::ResetBusTime();
+		uint64_t start = HostSim::NowNs();
+		if( bcm )
+		{
+			pwm->EnableInterrupt(true, PERIODIC_TIMER_TICK_US);
+		}
+		else
+		{
+			CounterPwm.Reg = &reg;
+			CounterPwm.Depth = depth;
+			CounterPwm.Counter = 0;
+			timer = PeriodicTimer::Attach(CounterPwmTick, nullptr, 1u);
+		}
+		hostTimer.Start();
+		HostSim::Advance(3u * frameNs);
+		hostTimer.Stop();
+		uint32_t ticks = (uint32_t)((HostSim::NowNs() - start) / lsbNs);
+		if( bcm )
+			pwm->EnableInterrupt(false);
+		else
+			PeriodicTimer::Detach(timer);
+
+		if( HostSim::EdgeCount() >= HOST_SIM_EDGE_LOG_SIZE )
+			Note("edge log full, on times not reliable");
+
+		/* Latched frames with their time, the chain holds the last 32 bits shifted in */
+		std::vector<uint64_t> times;
+		std::vector<std::string> frames;
+		std::string chain(32u, '0');
+		uint8_t data = dataLevel;
+		for( uint32_t i = 0; i < HostSim::EdgeCount(); i++ )
+		{
+			const HostSim::Edge &edge = HostSim::GetEdge(i);
+			if( edge.Pin == 3u )
+				data = edge.Level;
+			else if( (edge.Pin == 2u) && (edge.Level == HIGH) )
+				chain = chain.substr(1) + (data ? '1' : '0');
+			else if( (edge.Pin == 4u) && (edge.Level == HIGH) )
+			{
+				times.push_back(edge.TimeNs);
+				frames.push_back(chain);
+			}
+		}
+
+		/* On time over the frame starting at the first latch of the second frame */
+		uint64_t from = 0;
+		size_t first = 0;
+		while( (first < times.size()) && (times[first] < start + frameNs) )
+			first++;
+		uint32_t worst = 0, latches = 0;
+		if( first < times.size() )
+		{
+			from = times[first];
+			std::vector<uint64_t> onNs(32u, 0u);
+			for( size_t n = first; (n < times.size()) && (times[n] < from + frameNs); n++ )
+			{
+				uint64_t until = ((n + 1u < times.size()) && (times[n + 1u] < from + frameNs)) ? times[n + 1u] : from + frameNs;
+				for( uint8_t bit = 0; bit < 32u; bit++ )
+				{
+					if( frames[n][bit] == '1' )
+						onNs[bit] += until - times[n];
+				}
+				latches++;
+			}
+			for( uint16_t output = 0; output < 32u; output++ )
+			{
+				long onTicks = (long)((onNs[map[output]] + lsbNs / 2u) / lsbNs);
+				uint32_t error = (uint32_t)labs(onTicks - (long)PwmLevel(output, depth));
+				worst = (error > worst) ? error : worst;
+			}
+		}
+
+		snprintf(scenario, sizeof(scenario), "4 regs, %u bit %s, 100us", depth, bcm ? "BCM" : "counter PWM");
+		Result result;
+		result.Driver = "HC595";
+		result.Scenario = scenario;
+		result.Calls = ticks;
+		result.HostNs = hostTimer.ElapsedNs();
+		result.BusNs = HostSim::BusTimeNs();
+		result.HeapBytes = heapBytes;
+		Report(result);
+		Note("%.0f Hz frames, %u latches per frame, worst on time error %u of %u ticks", 1e9 / (double)frameNs, latches, worst, (1u << depth) - 1u);
+
+		delete pwm;
+	}
+
+	/* Long chain without heap */
+	static uint32_t WideStorage[HC595_STORAGE_WORDS(256)];
+
+	static std::vector<uint8_t> Snapshot(HC595Base &reg)
+	{
+		std::vector<uint8_t> bits;
+		for( uint32_t bit = 0; bit < reg.GetRegsNo() * 8u; bit++ )
+		{
+			bits.push_back((uint8_t)reg.ReadField(bit, 1u));
+		}
+		return bits;
+	}
+
+	static void ReportOps(const char *scenario, uint32_t calls, const HostTimer &timer, long heapBytes)
+	{
+		Result result;
+		result.Driver = "HC595";
+		result.Scenario = scenario;
+		result.Calls = calls;
+		result.HostNs = timer.ElapsedNs();
+		result.BusNs = HostSim::BusTimeNs();
+		result.HeapBytes = heapBytes;
+		Report(result);
+	}
+
+	/*
+	 * Per-bit calls against word operations on 256 registers (2048 outputs). Calls are whole
+	 * passes: all outputs, 150 12 bit fields, or one 2045 bit bitset copy at an odd offset.
+	 */
+	static void WideOps(uint32_t passes)
+	{
+		HostSim::Reset();
+		size_t heap = HostSim::HeapInUse();
+		HC595T<FastGpio<2>, FastGpio<3>, FastGpio<4> > reg(256u, WideStorage);
+		long heapBytes = (long)(HostSim::HeapInUse() - heap);
+		uint32_t bitset[64];
+		std::vector<uint8_t> expected;
+
+		for( uint8_t i = 0; i < 64u; i++ )
+		{
+			bitset[i] = 0x9E3779B9u * (i + 1u);
+		}
+		HostSim::ResetBusTime();
+
+		HostTimer perBit;
+		for( uint32_t pass = 0; pass < passes; pass++ )
+		{
+			reg.ClearAll();
+			perBit.Start();
+			for( int bit = 0; bit < 2048; bit++ )
+			{
+				reg.SetBitNo(bit);
+			}
+			perBit.Stop();
+		}
+		expected = Snapshot(reg);
+		ReportOps("256 regs, 2048 outputs, SetBitNo", passes, perBit, heapBytes);
+
+		HostTimer range;
+		for( uint32_t pass = 0; pass < passes; pass++ )
+		{
+			reg.ClearAll();
+			range.Start();
+			reg.SetRange(0, 2048u);
+			range.Stop();
+		}
+		ReportOps("256 regs, 2048 outputs, SetRange", passes, range, heapBytes);
+		Note("same outputs as SetBitNo: %s", (Snapshot(reg) == expected) ? "yes" : "NO");
+
+		HostTimer fieldBits;
+		for( uint32_t pass = 0; pass < passes; pass++ )
+		{
+			reg.ClearAll();
+			fieldBits.Start();
+			for( uint32_t field = 0; field < 150u; field++ )
+			{
+				uint32_t offset = 5u + 13u * field, value = field * 27u;
+				for( uint8_t bit = 0; bit < 12u; bit++ )
+				{
+					reg.WriteBit((uint8_t)((offset + bit) % 8u), (uint8_t)((value >> bit) & 1u), (uint16_t)((offset + bit) / 8u));
+				}
+			}
+			fieldBits.Stop();
+		}
+		expected = Snapshot(reg);
+		ReportOps("256 regs, 150 fields, WriteBit", passes, fieldBits, heapBytes);
+
+		HostTimer fields;
+		for( uint32_t pass = 0; pass < passes; pass++ )
+		{
+			reg.ClearAll();
+			fields.Start();
+			for( uint32_t field = 0; field < 150u; field++ )
+			{
+				reg.WriteField(5u + 13u * field, 12u, field * 27u);
+			}
+			fields.Stop();
+		}
+		ReportOps("256 regs, 150 fields, WriteField", passes, fields, heapBytes);
+		Note("same outputs as WriteBit: %s", (Snapshot(reg) == expected) ? "yes" : "NO");
+
+		HostTimer copyBits;
+		for( uint32_t pass = 0; pass < passes; pass++ )
+		{
+			reg.ClearAll();
+			copyBits.Start();
+			for( uint32_t bit = 0; bit < 2045u; bit++ )
+			{
+				uint32_t to = bit + 3u;
+				reg.WriteBit((uint8_t)(to % 8u), (uint8_t)((bitset[bit / 32u] >> (bit % 32u)) & 1u), (uint16_t)(to / 8u));
+			}
+			copyBits.Stop();
+		}
+		expected = Snapshot(reg);
+		ReportOps("256 regs, 2045 bit copy, WriteBit", passes, copyBits, heapBytes);
+
+		HostTimer copy;
+		for( uint32_t pass = 0; pass < passes; pass++ )
+		{
+			reg.ClearAll();
+			copy.Start();
+			reg.WriteBitset(bitset, 3u, 2045u);
+			copy.Stop();
+		}
+		ReportOps("256 regs, 2045 bit copy, WriteBitset", passes, copy, heapBytes);
+		Note("same outputs as WriteBit: %s", (Snapshot(reg) == expected) ? "yes" : "NO");
+		std::vector<uint8_t>().swap(expected);
+
+		Refresh(&reg, "256 regs, FastGpio, static storage", heap, 200u);
+		Note("%u B of static storage", (unsigned)sizeof(WideStorage));
+	}
+
+	void HC595Scenarios()
+	{
+		static const uint8_t chains[] = { 1, 2, 4, 8, 16, 32 };
+		char scenario[40];
+
+		for( uint8_t n = 0; n < sizeof(chains); n++ )
+		{
+			uint8_t regsNo = chains[n];
+			uint32_t refreshes = 20000u / regsNo;
+
+			HostSim::Reset();
+			size_t heap = HostSim::HeapInUse();
+			HC595 *slow = new HC595(2, 3, 4, regsNo);
+			snprintf(scenario, sizeof(scenario), "%u regs, Gpio pins", regsNo);
+			Refresh(slow, scenario, heap, refreshes);
+			delete slow;
+
+			HostSim::Reset();
+			heap = HostSim::HeapInUse();
+			HC595T<FastGpio<2>, FastGpio<3>, FastGpio<4> > *fast = new HC595T<FastGpio<2>, FastGpio<3>, FastGpio<4> >(regsNo);
+			snprintf(scenario, sizeof(scenario), "%u regs, FastGpio pins", regsNo);
+			Refresh(fast, scenario, heap, refreshes);
+			Note("port stores per refresh %u", FastGpioHost::Stores / refreshes);
+			Pattern(fast, regsNo);
+			std::string bitBang = WireBits(fast, 2, 3, 4);
+			(void)bitBang;
+			delete fast;
+
+#if HC595_SPI_ENABLED == 1
+			HostSim::Reset();
+			heap = HostSim::HeapInUse();
+			HC595Spi *spi = new HC595Spi(10, regsNo);
+			snprintf(scenario, sizeof(scenario), "%u regs, SPI, Gpio latch", regsNo);
+			Refresh(spi, scenario, heap, refreshes);
+			Pattern(spi, regsNo);
+			std::string wire = WireBits(spi, SCK, MOSI, 10);
+			Note("%u bits + latch at %lu Hz, same as bit-bang: %s", (unsigned)(wire.size() - 1u), (unsigned long)HC595_SPI_CLOCK, (wire == bitBang) ? "yes" : "NO");
+			delete spi;
+
+			HostSim::Reset();
+			heap = HostSim::HeapInUse();
+			HC595SpiT<FastGpio<10> > *spiFast = new HC595SpiT<FastGpio<10> >(regsNo);
+			snprintf(scenario, sizeof(scenario), "%u regs, SPI, FastGpio latch", regsNo);
+			Refresh(spiFast, scenario, heap, refreshes);
+			Pattern(spiFast, regsNo);
+			wire = WireBits(spiFast, SCK, MOSI, 10);
+			Note("same as bit-bang: %s", (wire == bitBang) ? "yes" : "NO");
+			delete spiFast;
+#endif
+		}
+
+		Unchanged(100000u);
+		Interrupt(true);
+		Interrupt(false);
+
+		Pwm(4, true);
+		Pwm(4, false);
+		Pwm(8, true);
+		Pwm(8, false);
+
+		WideOps(200u);
+	}
+}
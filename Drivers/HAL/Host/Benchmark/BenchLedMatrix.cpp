@@ -0,0 +1,297 @@
+/*
+ * BenchLedMatrix.cpp
+ */
+
+#include "Benchmark.h"
+#include "LedMatrixDriver.h"
+
+#include <math.h>
+#include <string>
+#include <vector>
+
+using namespace Drivers;
+
+namespace Bench
+{
+	/* Checkerboard with a diagonal, every row different */
+	template<class MatrixT>
+	static void Pattern(MatrixT &matrix)
+	{
+		for( uint8_t y = 0; y < MatrixT::ROWS; y++ )
+		{
+			for( uint8_t x = 0; x < MatrixT::COLS; x++ )
+			{
+				matrix.WritePixel(x, y, (((x + y) & 1u) == 0u) || (x == y));
+			}
+		}
+	}
+
+	/* Chain contents expected while row y of the original board is lit */
+	static bool BoardRowOk(HC595Base &regs, LedMatrixDriver &matrix, uint8_t y)
+	{
+		uint8_t expected[3] = { 0x00, 0x00, (uint8_t)~(1u << y) };
+		for( uint8_t x = 0; x < 12u; x++ )
+		{
+			if( !matrix.GetPixel(x, y) )
+				continue;
+			if( x <= 3u )
+				expected[1] |= (uint8_t)(1u << (3u - x));
+			else
+				expected[0] |= (uint8_t)(1u << (x - 4u));
+		}
+		for( uint8_t reg = 0; reg < 3u; reg++ )
+		{
+			if( regs.ReadField(reg * 8u, 8u) != expected[reg] )
+				return false;
+		}
+		return true;
+	}
+
+	template<class MatrixT>
+	static bool LinearRowOk(HC595Base &regs, MatrixT &matrix, uint8_t y)
+	{
+		typedef LedMatrixLinearLayout<MatrixT::COLS, MatrixT::ROWS> Layout;
+		for( uint8_t x = 0; x < MatrixT::COLS; x++ )
+		{
+			if( regs.ReadField(x, 1u) != (uint32_t)matrix.GetPixel(x, y) )
+				return false;
+		}
+		for( uint8_t row = 0; row < MatrixT::ROWS; row++ )
+		{
+			if( regs.ReadField(Layout::ROW_BASE + row, 1u) != (uint32_t)(row != y) )
+				return false;
+		}
+		return true;
+	}
+
+	static void ReportScan(const char *scenario, uint32_t calls, uint8_t callsPerFrame, const HostTimer &timer, long heapBytes, uint32_t wrong, size_t frameBytes)
+	{
+		Result result;
+		result.Driver = "LedMatrix";
+		result.Scenario = scenario;
+		result.Calls = calls;
+		result.HostNs = timer.ElapsedNs();
+		result.BusNs = HostSim::BusTimeNs();
+		result.HeapBytes = heapBytes;
+		Report(result);
+
+		double frameNs = (double)HostSim::BusTimeNs() / (double)calls * callsPerFrame;
+		Note("%u calls per frame, %.0f frames/s with the CPU only refreshing, %u B frame, rows wrong %u/%u", callsPerFrame, 1e9 / frameNs, (unsigned)frameBytes, wrong, calls);
+	}
+
+	template<class ChainT>
+	static void Board(const char *scenario, ChainT *chain, uint32_t calls)
+	{
+		size_t heap = HostSim::HeapInUse();
+		LedMatrixDriver matrix(12, 8, chain);
+		long heapBytes = (long)(HostSim::HeapInUse() - heap);
+		HostTimer timer;
+		uint32_t wrong = 0;
+
+		Pattern(matrix);
+		matrix.Commit();
+		/* One row per call */
+		matrix.SetRefreshRate(0);
+		HostSim::ResetBusTime();
+		for( uint32_t i = 0; i < calls; i++ )
+		{
+			timer.Start();
+			matrix.MainFunction();
+			timer.Stop();
+			wrong += BoardRowOk(*chain, matrix, (uint8_t)(i % 8u)) ? 0u : 1u;
+		}
+		ReportScan(scenario, calls, 8u * LedMatrixDriver::DEPTH, timer, heapBytes, wrong, sizeof(uint8_t[LedMatrixDriver::DEPTH][8][LedMatrixDriver::ROW_BYTES]));
+	}
+
+#if HC595_SPI_ENABLED == 1
+	template<uint8_t ColsT, uint8_t RowsT>
+	static void Linear(const char *scenario, uint32_t calls)
+	{
+		typedef LedMatrixT<ColsT, RowsT> MatrixT;
+		const uint16_t regsNo = LedMatrixLinearLayout<ColsT, RowsT>::REGS_NO;
+
+		HostSim::Reset();
+		size_t heap = HostSim::HeapInUse();
+		HC595SpiT<FastGpio<10> > chain(regsNo);
+		MatrixT matrix(&chain);
+		long heapBytes = (long)(HostSim::HeapInUse() - heap);
+		HostTimer timer;
+		uint32_t wrong = 0;
+
+		Pattern(matrix);
+		/* One row per call */
+		matrix.SetRefreshRate(0);
+		HostSim::ResetBusTime();
+		for( uint32_t i = 0; i < calls; i++ )
+		{
+			timer.Start();
+			matrix.MainFunction();
+			timer.Stop();
+			wrong += LinearRowOk(chain, matrix, (uint8_t)(i % RowsT)) ? 0u : 1u;
+		}
+		ReportScan(scenario, calls, RowsT, timer, heapBytes, wrong, (size_t)RowsT * MatrixT::ROW_BYTES);
+	}
+#endif
+
+	typedef LedMatrixT<12, 8, LedMatrixBoardLayout, 4> GrayBoard;
+
+	static uint8_t GrayLevel(uint8_t x, uint8_t y)
+	{
+		return (uint8_t)((x + 3u * y) & GrayBoard::MAX_LEVEL);
+	}
+
+	/* Board output of a pixel: anodes X0-X3 on register 1 bits 3-0, X4-X11 on register 0 */
+	static bool BoardLit(const std::string &chain, const std::vector<uint8_t> &map, uint8_t x, uint8_t y)
+	{
+		uint8_t column = (x <= 3u) ? (uint8_t)(8u + 3u - x) : (uint8_t)(x - 4u);
+		return (chain[map[column]] == '1') && (chain[map[16u + y]] == '0');
+	}
+
+	/*
+	 * The 12x8 board at 4 bit on FastGpio pins for 6 nominal frames, loop() calls MainFunction()
+	 * every 10us and, with taskUs, runs a task of taskUs every 20ms. The latch pulses in the edge
+	 * log are the slot timestamps, the pixels lit in every slot are rebuilt from the bits shifted
+	 * in before it.
+	 */
+	static void Scan(const char *scenario, bool interrupt, uint32_t taskUs, uint8_t brightness)
+	{
+		HostSim::Reset();
+		HC595T<FastGpio<2>, FastGpio<3>, FastGpio<4> > chain(3);
+		std::vector<uint8_t> map = WireMap(&chain);
+		size_t heap = HostSim::HeapInUse();
+		GrayBoard *matrix = new GrayBoard(&chain);
+		long heapBytes = (long)(HostSim::HeapInUse() - heap);
+		HostTimer hostTimer;
+
+		for( uint8_t y = 0; y < GrayBoard::ROWS; y++ )
+		{
+			for( uint8_t x = 0; x < GrayBoard::COLS; x++ )
+			{
+				matrix->SetLevel(x, y, GrayLevel(x, y));
+			}
+		}
+		matrix->SetBrightness(brightness);
+		matrix->Commit();
+
+		uint8_t dataLevel = HostSim::GetLevel(3);
+		HostSim::ClearEdges();
+		HostSim::ResetBusTime();
+		uint64_t start = HostSim::NowNs();
+		if( interrupt )
+			matrix->EnableInterrupt(true);
+		uint64_t slotNs = (uint64_t)matrix->GetSlotUs() * 1000u;
+		uint64_t runNs = 6u * GrayBoard::SLOTS * slotNs;
+		uint64_t nextTask = start + 20000000u;
+
+		hostTimer.Start();
+		while( HostSim::NowNs() - start < runNs )
+		{
+			matrix->MainFunction();
+			HostSim::AdvanceUs(10);
+			if( (taskUs != 0u) && (HostSim::NowNs() >= nextTask) )
+			{
+				HostSim::AdvanceUs(taskUs);
+				nextTask += 20000000u;
+			}
+		}
+		hostTimer.Stop();
+		uint16_t refreshHz = matrix->GetRefreshRate();
+		matrix->EnableInterrupt(false);
+		LedMatrixStats stats = matrix->GetStats();
+
+		if( HostSim::EdgeCount() >= HOST_SIM_EDGE_LOG_SIZE )
+			Note("edge log full, timestamps not reliable");
+
+		/* Latch timestamps and the 24 chain bits latched with each */
+		std::vector<uint64_t> times;
+		std::vector<std::string> latched;
+		std::string bits(24u, '0');
+		uint8_t data = dataLevel;
+		for( uint32_t i = 0; i < HostSim::EdgeCount(); i++ )
+		{
+			const HostSim::Edge &edge = HostSim::GetEdge(i);
+			if( edge.Pin == 3u )
+				data = edge.Level;
+			else if( (edge.Pin == 2u) && (edge.Level == HIGH) )
+				bits = bits.substr(1) + (data ? '1' : '0');
+			else if( (edge.Pin == 4u) && (edge.Level == HIGH) )
+			{
+				times.push_back(edge.TimeNs);
+				latched.push_back(bits);
+			}
+		}
+
+		/* Latch n shows plane (n / 8) % 4, held for 2^plane slots */
+		const uint32_t latchesPerFrame = GrayBoard::ROWS * GrayBoard::DEPTH;
+		double jitterUs = 0.0;
+		for( size_t n = 0; n + 1u < times.size(); n++ )
+		{
+			uint64_t expected = slotNs << ((n / GrayBoard::ROWS) % GrayBoard::DEPTH);
+			double error = fabs((double)(times[n + 1u] - times[n]) - (double)expected) / 1000.0;
+			jitterUs = (error > jitterUs) ? error : jitterUs;
+		}
+
+		/* On time of every pixel over each complete frame, in slots of that frame */
+		double worst = 0.0, slowestNs = 0.0;
+		uint32_t frames = 0;
+		for( size_t first = 0; first + latchesPerFrame < times.size(); first += latchesPerFrame )
+		{
+			double frameNs = (double)(times[first + latchesPerFrame] - times[first]);
+			slowestNs = (frameNs > slowestNs) ? frameNs : slowestNs;
+			for( uint8_t y = 0; y < GrayBoard::ROWS; y++ )
+			{
+				for( uint8_t x = 0; x < GrayBoard::COLS; x++ )
+				{
+					uint64_t onNs = 0;
+					for( size_t n = first; n < first + latchesPerFrame; n++ )
+					{
+						if( BoardLit(latched[n], map, x, y) )
+							onNs += times[n + 1u] - times[n];
+					}
+					double onSlots = (double)onNs * GrayBoard::SLOTS / frameNs;
+					double level = (double)((GrayLevel(x, y) * brightness + 127u) / 255u);
+					double error = fabs(onSlots - level);
+					worst = (error > worst) ? error : worst;
+				}
+			}
+			frames++;
+		}
+
+		Result result;
+		result.Driver = "LedMatrix";
+		result.Scenario = scenario;
+		result.Calls = (uint32_t)times.size();
+		result.HostNs = hostTimer.ElapsedNs();
+		result.BusNs = HostSim::BusTimeNs();
+		result.HeapBytes = heapBytes;
+		Report(result);
+		Note("%u Hz refresh, %u us slots, latch jitter %.1f us, slowest frame %.1f ms of %.1f", refreshHz, (unsigned)(slotNs / 1000u), jitterUs, slowestNs / 1e6, (double)(GrayBoard::SLOTS * slotNs) / 1e6);
+		Note("missed deadlines %u, worst %u us late, worst on time error %.2f slots (levels 0-%u) over %u frames", stats.MissedDeadlines, stats.MaxLateUs, worst, GrayBoard::MAX_LEVEL, frames);
+
+		delete matrix;
+	}
+
+	void LedMatrixScenarios()
+	{
+		HostSim::Reset();
+		HC595 *slow = new HC595(2, 3, 4, 3);
+		Board("12x8 board, Gpio pins", slow, 8000);
+		delete slow;
+
+		HostSim::Reset();
+		HC595T<FastGpio<2>, FastGpio<3>, FastGpio<4> > *fast = new HC595T<FastGpio<2>, FastGpio<3>, FastGpio<4> >(3);
+		Board("12x8 board, FastGpio pins", fast, 8000);
+		delete fast;
+
+#if HC595_SPI_ENABLED == 1
+		Linear<16, 16>("16x16, SPI, FastGpio latch", 16000);
+		Linear<32, 32>("32x32, SPI, FastGpio latch", 16000);
+		Linear<64, 32>("64x32, SPI, FastGpio latch", 16000);
+#endif
+
+		Scan("12x8 4 bit, polled, idle loop", false, 0, 255);
+		Scan("12x8 4 bit, polled, 5ms task/20ms", false, 5000, 255);
+		Scan("12x8 4 bit, interrupt, 5ms task/20ms", true, 5000, 255);
+		Scan("12x8 4 bit, interrupt, brightness 50%", true, 5000, 128);
+	}
+}
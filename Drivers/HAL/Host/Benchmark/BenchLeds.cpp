@@ -0,0 +1,126 @@
+/*
+ * BenchLeds.cpp
+ */
+
+#include "Benchmark.h"
+#include "LED.h"
+#include "FastGpio.h"
+#include "RGB_LED.h"
+
+using namespace Drivers;
+
+namespace Bench
+{
+	/* LED through the HAL or LEDT through its pin type, the calls are resolved on LedT */
+	template<class LedT>
+	static void Blink(const char *scenario, LedT *(*make)())
+	{
+		HostTimer timer;
+
+		HostSim::Reset();
+		size_t heap = HostSim::HeapInUse();
+		LedT *led = make();
+		long heapBytes = (long)(HostSim::HeapInUse() - heap);
+
+		led->StartBlink(10);
+		HostSim::ResetBusTime();
+		HostSim::ClearEdges();
+
+		const uint32_t calls = 100000;
+		for( uint32_t i = 0; i < calls; i++ )
+		{
+			HostSim::AdvanceUs(100);
+			timer.Start();
+			led->Update();
+			timer.Stop();
+		}
+
+		Result result;
+		result.Driver = "LED";
+		result.Scenario = scenario;
+		result.Calls = calls;
+		result.HostNs = timer.ElapsedNs();
+		result.BusNs = HostSim::BusTimeNs();
+		result.HeapBytes = heapBytes;
+		Report(result);
+		Note("edges on pin 13: %u (expected ~%u)", HostSim::EdgeCount(), calls / 100u);
+
+		delete led;
+	}
+
+	template<class LedT>
+	static void Toggle(const char *scenario, LedT *(*make)())
+	{
+		HostTimer timer;
+
+		HostSim::Reset();
+		LedT *led = make();
+		HostSim::ResetBusTime();
+		HostSim::ClearEdges();
+
+		const uint32_t calls = 10000;
+		timer.Start();
+		for( uint32_t i = 0; i < calls; i++ )
+		{
+			led->Toggle();
+		}
+		timer.Stop();
+
+		Result result;
+		result.Driver = "LED";
+		result.Scenario = scenario;
+		result.Calls = calls;
+		result.HostNs = timer.ElapsedNs();
+		result.BusNs = HostSim::BusTimeNs();
+		result.HeapBytes = 0;
+		Report(result);
+		Note("edges on pin 13: %u (expected %u)", HostSim::EdgeCount(), calls);
+
+		delete led;
+	}
+
+	static LED *MakeLed() { return new LED(13); }
+	static LEDT<FastGpio<13> > *MakeFastLed() { return new LEDT<FastGpio<13> >(); }
+
+	static void Breathing()
+	{
+		HostTimer timer;
+
+		HostSim::Reset();
+		size_t heap = HostSim::HeapInUse();
+		RGB_LED *led = new RGB_LED(9, 10, 11);
+		long heapBytes = (long)(HostSim::HeapInUse() - heap);
+
+		led->StartBreathing(255, 128, 0, 2000);
+		HostSim::ResetBusTime();
+
+		const uint32_t calls = 20000;
+		for( uint32_t i = 0; i < calls; i++ )
+		{
+			HostSim::AdvanceUs(1000);
+			timer.Start();
+			led->Update();
+			timer.Stop();
+		}
+
+		Result result;
+		result.Driver = "RGB_LED";
+		result.Scenario = "breathing 2s, Update() every 1ms";
+		result.Calls = calls;
+		result.HostNs = timer.ElapsedNs();
+		result.BusNs = HostSim::BusTimeNs();
+		result.HeapBytes = heapBytes;
+		Report(result);
+
+		delete led;
+	}
+
+	void LedScenarios()
+	{
+		Blink("blink 10ms, Update() every 100us", MakeLed);
+		Blink("LEDT<FastGpio>, blink 10ms, 100us", MakeFastLed);
+		Toggle("Toggle()", MakeLed);
+		Toggle("LEDT<FastGpio>, Toggle()", MakeFastLed);
+		Breathing();
+	}
+}
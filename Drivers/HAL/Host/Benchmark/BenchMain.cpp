@@ -0,0 +1,50 @@
+/*
+ * BenchMain.cpp
+ *
+ *  Host benchmark of the drivers, see Readme.md for the build command.
+ */
+
+#include "Benchmark.h"
+
+#include <stdarg.h>
+
+namespace Bench
+{
+	void PrintHeader()
+	{
+		printf("%-12s %-36s %10s %14s %16s %10s\n", "driver", "scenario", "calls", "calls/s", "bus ns/call", "heap B");
+	}
+
+	void Report(const Result &result)
+	{
+		double callsPerSecond = (result.HostNs != 0u) ? ((double)result.Calls * 1e9 / (double)result.HostNs) : 0.0;
+		double busPerCall = (result.Calls != 0u) ? ((double)result.BusNs / (double)result.Calls) : 0.0;
+
+		printf("%-12s %-36s %10u %14.0f %16.1f %10ld\n", result.Driver, result.Scenario, result.Calls, callsPerSecond, busPerCall, result.HeapBytes);
+	}
+
+	void Note(const char *format, ...)
+	{
+		va_list va;
+		va_start(va, format);
+		printf("%-12s ", "");
+		vprintf(format, va);
+		printf("\n");
+		va_end(va);
+	}
+}
+
+int main()
+{
+	Bench::PrintHeader();
+
+	Bench::SerialAsyncScenarios();
+	Bench::HC595Scenarios();
+	Bench::LedMatrixScenarios();
+	Bench::LedScenarios();
+	Bench::SensorScenarios();
+	Bench::StepperScenarios();
+	Bench::PrintfScenarios();
+
+	return 0;
+}
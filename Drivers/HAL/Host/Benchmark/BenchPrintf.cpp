@@ -0,0 +1,452 @@
+/*
+ * BenchPrintf.cpp
+ *
+ *  Built with DEFERRED_PRINTF=1 (see Readme.md), printf_() formats on the device and
+ *  printf_deferred() sends records for Drivers/HAL/Host/Tools/DeferredLog.cpp.
+ *  snprintf_ct() is measured against the runtime parser of snprintf_() on the same lines.
+ *  Float conversions are checked against glibc, Printf promises its output up to 17 significant digits.
+ */
+
+#include "Benchmark.h"
+#include "Printf.h"
+#include "PrintfCompiled.h"
+#include "Cobs.h"
+#include <math.h>
+#include <stdlib.h>
+
+/* Printf.h maps snprintf to snprintf_, the float checks need glibc's */
+#undef snprintf
+
+/* Division per digit build of Printf, see PrintfReference.cpp */
+namespace PrintfReference
+{
+	int snprintf_(char *buffer, size_t count, const char *format, ...);
+}
+
+namespace Bench
+{
+	/* Typical debug lines, one every 10ms at 115200 baud, text formatted on the device (printf_() or printf_ct())
+	 * against deferred records */
+	static void LogLines(bool deferred, bool compiled, uint32_t lines)
+	{
+		static const char *states[] = { "idle", "run", "fault" };
+		HostTimer timer;
+
+		HostSim::Reset();
+		printf_init(&Serial, 115200);
+		HostSim::AdvanceUs(100000);
+		Serial.TxQueued();
+		Serial.SetCapture(true);
+		Serial.ClearCapture();
+		Serial.ResetHostStats();
+
+		uint32_t calls = 0;
+		for( uint32_t i = 0; i < lines; i++ )
+		{
+			unsigned long now = 1000UL + i * 10UL;
+			int ax = (int)(i * 37U % 2000U) - 1000, ay = (int)(i * 11U % 2000U) - 1000, az = 980;
+			unsigned int temp = 2300U + (i % 200U);
+
+			timer.Start();
+			if( deferred )
+			{
+				printf_deferred("t=%lu ax=%d ay=%d az=%d temp=%u.%02u state=%s\n", now, ax, ay, az, temp / 100U, temp % 100U, states[i % 3U]);
+				printf_deferred("loop %lu us, queue %u\n", (unsigned long)(i % 700U), (unsigned int)(i % 64U));
+			}
+			else if( compiled )
+			{
+				printf_ct("t=%lu ax=%d ay=%d az=%d temp=%u.%02u state=%s\n", now, ax, ay, az, temp / 100U, temp % 100U, states[i % 3U]);
+				printf_ct("loop %lu us, queue %u\n", (unsigned long)(i % 700U), (unsigned int)(i % 64U));
+			}
+			else
+			{
+				printf_("t=%lu ax=%d ay=%d az=%d temp=%u.%02u state=%s\n", now, ax, ay, az, temp / 100U, temp % 100U, states[i % 3U]);
+				printf_("loop %lu us, queue %u\n", (unsigned long)(i % 700U), (unsigned int)(i % 64U));
+			}
+			timer.Stop();
+			calls += 2U;
+
+			HostSim::AdvanceUs(10000);
+		}
+		HostSim::AdvanceUs(100000);
+		Serial.TxQueued();
+
+		// Deferred: every frame must be a record of one of the two formats
+		const std::string &wire = Serial.Captured();
+		uint32_t records = 0;
+		if( deferred )
+		{
+			Drivers::CobsDecoder decoder;
+			uint8_t head[5] = { 0 };
+			size_t length = 0;
+			for( size_t i = 0; i < wire.size(); i++ )
+			{
+				uint8_t decoded;
+				switch( decoder.Push((uint8_t)wire[i], decoded) )
+				{
+				case Drivers::CobsDecoder::DATA:
+					if( length < sizeof(head) )
+						head[length] = decoded;
+					length++;
+					break;
+				case Drivers::CobsDecoder::FRAME:
+				{
+					uint32_t id = (uint32_t)head[1] | ((uint32_t)head[2] << 8) | ((uint32_t)head[3] << 16) | ((uint32_t)head[4] << 24);
+					if( (head[0] == 'P') && ((id == PrintfDeferred::FormatId("t=%lu ax=%d ay=%d az=%d temp=%u.%02u state=%s\n")) || (id == PrintfDeferred::FormatId("loop %lu us, queue %u\n"))) )
+						records++;
+					length = 0;
+					break;
+				}
+				case Drivers::CobsDecoder::CORRUPT:
+					length = 0;
+					break;
+				default:
+					break;
+				}
+			}
+		}
+		else
+		{
+			for( size_t i = 0; i < wire.size(); i++ )
+			{
+				records += (wire[i] == '\n') ? 1U : 0U;
+			}
+		}
+
+		Result result;
+		result.Driver = "Printf";
+		result.Scenario = deferred ? "debug lines, printf_deferred" : (compiled ? "debug lines, printf_ct" : "debug lines, printf_");
+		result.Calls = calls;
+		result.HostNs = timer.ElapsedNs();
+		result.BusNs = (uint64_t)wire.size() * 1000000000U / Serial.GetDrainRate();
+		result.HeapBytes = 0;
+		Report(result);
+		Note("%.1f B/line on the wire, lines %u/%u, serial write calls %.1f/line", (double)wire.size() / calls, records, calls, (double)Serial.GetHostStats().WriteCalls / calls);
+
+		Serial.SetCapture(false);
+	}
+
+	/* Integer conversion, fast kernels against the division per digit of the original library */
+	static void IntegerFormat(const char *format, int size, uint32_t values)
+	{
+		static char scenario[48];
+		char fast[64], reference[64];
+		HostTimer fastTimer, referenceTimer;
+		uint32_t mismatches = 0;
+		uint64_t seed = 0x9E3779B97F4A7C15ULL;
+
+		for( uint32_t i = 0; i < values; i++ )
+		{
+			// xorshift, then keep a random number of bits so short and long numbers both show up
+			seed ^= seed << 13;
+			seed ^= seed >> 7;
+			seed ^= seed << 17;
+			uint64_t value = seed >> (seed % 64U);
+
+			fastTimer.Start();
+			if( size == 8 )
+				snprintf_(fast, sizeof(fast), format, (unsigned long long)value);
+			else if( size == 4 )
+				snprintf_(fast, sizeof(fast), format, (unsigned long)(uint32_t)value);
+			else
+				snprintf_(fast, sizeof(fast), format, (int)(int16_t)value);
+			fastTimer.Stop();
+
+			referenceTimer.Start();
+			if( size == 8 )
+				PrintfReference::snprintf_(reference, sizeof(reference), format, (unsigned long long)value);
+			else if( size == 4 )
+				PrintfReference::snprintf_(reference, sizeof(reference), format, (unsigned long)(uint32_t)value);
+			else
+				PrintfReference::snprintf_(reference, sizeof(reference), format, (int)(int16_t)value);
+			referenceTimer.Stop();
+
+			mismatches += (strcmp(fast, reference) != 0) ? 1U : 0U;
+		}
+
+		Result result;
+		snprintf_(scenario, sizeof(scenario), "integer \"%s\"", format);
+		result.Driver = "Printf";
+		result.Scenario = scenario;
+		result.Calls = values;
+		result.HostNs = fastTimer.ElapsedNs();
+		result.BusNs = 0;
+		result.HeapBytes = 0;
+		Report(result);
+		Note("%.1f ns/call, division per digit %.1f ns/call, output mismatches %u", (double)fastTimer.ElapsedNs() / values, (double)referenceTimer.ElapsedNs() / values, mismatches);
+	}
+
+	static uint64_t FloatSeed = 0x2545F4914F6CDD1DULL;
+
+	/* Random bit pattern of a finite double, or a typical reading like 1234.567 or -0.0042 */
+	static double FloatValue(bool randomBits)
+	{
+		double value;
+		do
+		{
+			FloatSeed ^= FloatSeed << 13;
+			FloatSeed ^= FloatSeed >> 7;
+			FloatSeed ^= FloatSeed << 17;
+			if( randomBits )
+			{
+				memcpy(&value, &FloatSeed, sizeof(value));
+			}
+			else
+			{
+				const int64_t mantissa = (int64_t)(FloatSeed >> 2) >> (34 + FloatSeed % 28U);
+				value = (double)mantissa / pow(10.0, (double)((FloatSeed >> 8) % 10U));
+			}
+		} while( !isfinite(value) );
+		return value;
+	}
+
+	/* Float conversion against glibc and the multiply loop of the original library */
+	static void FloatFormat(const char *format, bool randomBits, uint32_t values)
+	{
+		static char scenario[48];
+		char fast[512], reference[512], glibc[512];
+		HostTimer fastTimer, referenceTimer, glibcTimer;
+		uint32_t mismatches = 0, referenceMismatches = 0;
+
+		for( uint32_t i = 0; i < values; i++ )
+		{
+			const double value = FloatValue(randomBits);
+
+			fastTimer.Start();
+			snprintf_(fast, sizeof(fast), format, value);
+			fastTimer.Stop();
+
+			referenceTimer.Start();
+			PrintfReference::snprintf_(reference, sizeof(reference), format, value);
+			referenceTimer.Stop();
+
+			glibcTimer.Start();
+			snprintf(glibc, sizeof(glibc), format, value);
+			glibcTimer.Stop();
+
+			mismatches += (strcmp(fast, glibc) != 0) ? 1U : 0U;
+			referenceMismatches += (strcmp(reference, glibc) != 0) ? 1U : 0U;
+		}
+
+		Result result;
+		snprintf_(scenario, sizeof(scenario), "float \"%s\", %s", format, randomBits ? "random bits" : "readings");
+		result.Driver = "Printf";
+		result.Scenario = scenario;
+		result.Calls = values;
+		result.HostNs = fastTimer.ElapsedNs();
+		result.BusNs = 0;
+		result.HeapBytes = 0;
+		Report(result);
+		Note("%.1f ns/call, multiply loop %.1f ns/call, glibc %.1f ns/call", (double)fastTimer.ElapsedNs() / values, (double)referenceTimer.ElapsedNs() / values, (double)glibcTimer.ElapsedNs() / values);
+		Note("differs from glibc: %u, multiply loop %u of %u", mismatches, referenceMismatches, values);
+	}
+
+	/* ftoa_shortest() must read back to the same double with the fewest digits glibc's %.*g needs for that */
+	static void FloatShortest(uint32_t values)
+	{
+		char fast[64], glibc[64];
+		HostTimer fastTimer, glibcTimer;
+		uint32_t failures = 0;
+
+		for( uint32_t i = 0; i < values; i++ )
+		{
+			const double value = FloatValue(true);
+
+			fastTimer.Start();
+			ftoa_shortest(fast, sizeof(fast), value);
+			fastTimer.Stop();
+
+			glibcTimer.Start();
+			snprintf(glibc, sizeof(glibc), "%.17g", value);
+			glibcTimer.Stop();
+
+			int fewest = 1;
+			for( ; fewest < 17; fewest++ )
+			{
+				snprintf(glibc, sizeof(glibc), "%.*g", fewest, value);
+				if( strtod(glibc, nullptr) == value )
+					break;
+			}
+			int digits = 0, zeros = 0;
+			for( const char *c = fast; (*c != 0) && (*c != 'e'); c++ )
+			{
+				if( (*c < '0') || (*c > '9') )
+					continue;
+				if( (digits == 0) && (*c == '0') )
+					continue;
+				digits++;
+				zeros = (*c == '0') ? zeros + 1 : 0;
+			}
+			// zeros in front of the point of a large integer are not digits of the shortest form
+			if( strchr(fast, '.') == nullptr )
+				digits -= zeros;
+			failures += ((strtod(fast, nullptr) != value) || ((value != 0.0) && (digits > fewest))) ? 1U : 0U;
+		}
+
+		Result result;
+		result.Driver = "Printf";
+		result.Scenario = "ftoa_shortest, random bits";
+		result.Calls = values;
+		result.HostNs = fastTimer.ElapsedNs();
+		result.BusNs = 0;
+		result.HeapBytes = 0;
+		Report(result);
+		Note("%.1f ns/call, glibc %%.17g %.1f ns/call, not shortest or not round trip: %u of %u", (double)fastTimer.ElapsedNs() / values, (double)glibcTimer.ElapsedNs() / values, failures, values);
+	}
+
+	/* Sink of the chunked output scenario: collects the text and counts the calls it got */
+	typedef struct
+	{
+		char Text[128];
+		size_t Length;
+		uint32_t Calls;
+	} ChunkSink;
+
+	static void ChunkSinkChar(char character, void *arg)
+	{
+		ChunkSink *sink = (ChunkSink *)arg;
+		if( sink->Length < sizeof(sink->Text) - 1U )
+			sink->Text[sink->Length++] = character;
+		sink->Calls++;
+	}
+
+	static void ChunkSinkBlock(const char *data, size_t length, void *arg)
+	{
+		ChunkSink *sink = (ChunkSink *)arg;
+		for( size_t i = 0; (i < length) && (sink->Length < sizeof(sink->Text) - 1U); i++ )
+			sink->Text[sink->Length++] = data[i];
+		sink->Calls++;
+	}
+
+	/* fctprintf() calls its output per character, fctprintf_block() per PRINTF_CHUNK_BUFFER_SIZE chunk */
+	static void ChunkedOutput(bool block, uint32_t lines)
+	{
+		static const char *states[] = { "idle", "run", "fault" };
+		HostTimer timer;
+		ChunkSink sink;
+		uint64_t calls = 0;
+		uint32_t mismatches = 0;
+
+		for( uint32_t i = 0; i < lines; i++ )
+		{
+			char reference[128];
+			sink.Length = 0;
+			sink.Calls = 0;
+
+			timer.Start();
+			if( block )
+				fctprintf_block(ChunkSinkBlock, &sink, "t=%lu ax=%d ay=%d az=%d temp=%u.%02u state=%s\n", 1000UL + i * 10UL, (int)(i * 37U % 2000U) - 1000, (int)(i * 11U % 2000U) - 1000, 980, (2300U + i % 200U) / 100U, (2300U + i % 200U) % 100U, states[i % 3U]);
+			else
+				fctprintf(ChunkSinkChar, &sink, "t=%lu ax=%d ay=%d az=%d temp=%u.%02u state=%s\n", 1000UL + i * 10UL, (int)(i * 37U % 2000U) - 1000, (int)(i * 11U % 2000U) - 1000, 980, (2300U + i % 200U) / 100U, (2300U + i % 200U) % 100U, states[i % 3U]);
+			timer.Stop();
+
+			sink.Text[sink.Length] = 0;
+			snprintf_(reference, sizeof(reference), "t=%lu ax=%d ay=%d az=%d temp=%u.%02u state=%s\n", 1000UL + i * 10UL, (int)(i * 37U % 2000U) - 1000, (int)(i * 11U % 2000U) - 1000, 980, (2300U + i % 200U) / 100U, (2300U + i % 200U) % 100U, states[i % 3U]);
+			mismatches += (strcmp(sink.Text, reference) != 0) ? 1U : 0U;
+			calls += sink.Calls;
+		}
+
+		Result result;
+		result.Driver = "Printf";
+		result.Scenario = block ? "telemetry line, fctprintf_block" : "telemetry line, fctprintf";
+		result.Calls = lines;
+		result.HostNs = timer.ElapsedNs();
+		result.BusNs = 0;
+		result.HeapBytes = 0;
+		Report(result);
+		Note("%.1f ns/line, %.1f output calls/line, output mismatches %u", (double)timer.ElapsedNs() / lines, (double)calls / lines, mismatches);
+	}
+
+	/* Compile time parsed format against the runtime parser, Compiled and Runtime format line i into the buffer */
+	template<typename Compiled, typename Runtime>
+	static void CompiledFormat(const char *scenario, Compiled compiled, Runtime runtime, uint32_t lines)
+	{
+		char fast[96], reference[96];
+		HostTimer compiledTimer, runtimeTimer;
+		uint32_t mismatches = 0;
+
+		for( uint32_t i = 0; i < lines; i++ )
+		{
+			compiledTimer.Start();
+			const int compiledLength = compiled(fast, sizeof(fast), i);
+			compiledTimer.Stop();
+
+			runtimeTimer.Start();
+			const int runtimeLength = runtime(reference, sizeof(reference), i);
+			runtimeTimer.Stop();
+
+			mismatches += ((compiledLength != runtimeLength) || (strcmp(fast, reference) != 0)) ? 1U : 0U;
+		}
+
+		Result result;
+		result.Driver = "Printf";
+		result.Scenario = scenario;
+		result.Calls = lines;
+		result.HostNs = compiledTimer.ElapsedNs();
+		result.BusNs = 0;
+		result.HeapBytes = 0;
+		Report(result);
+		Note("%.1f ns/line, runtime parser %.1f ns/line, output mismatches %u", (double)compiledTimer.ElapsedNs() / lines, (double)runtimeTimer.ElapsedNs() / lines, mismatches);
+	}
+
+	static const char *states[] = { "idle", "run", "fault" };
+
+	static int TelemetryCompiled(char *buffer, size_t size, uint32_t i)
+	{
+		return snprintf_ct(buffer, size, "t=%lu ax=%d ay=%d az=%d temp=%u.%02u state=%s\n", 1000UL + i * 10UL, (int)(i * 37U % 2000U) - 1000, (int)(i * 11U % 2000U) - 1000, 980, (2300U + i % 200U) / 100U, (2300U + i % 200U) % 100U, states[i % 3U]);
+	}
+
+	static int TelemetryRuntime(char *buffer, size_t size, uint32_t i)
+	{
+		return snprintf_(buffer, size, "t=%lu ax=%d ay=%d az=%d temp=%u.%02u state=%s\n", 1000UL + i * 10UL, (int)(i * 37U % 2000U) - 1000, (int)(i * 11U % 2000U) - 1000, 980, (2300U + i % 200U) / 100U, (2300U + i % 200U) % 100U, states[i % 3U]);
+	}
+
+	static int HexDumpCompiled(char *buffer, size_t size, uint32_t i)
+	{
+		return snprintf_ct(buffer, size, "%08lX: %02x %02x %02x %02x %-8s|%c\n", (unsigned long)i * 16UL, i & 0xFFU, (i >> 3) & 0xFFU, (i >> 6) & 0xFFU, (i >> 9) & 0xFFU, states[i % 3U], (char)('A' + i % 26U));
+	}
+
+	static int HexDumpRuntime(char *buffer, size_t size, uint32_t i)
+	{
+		return snprintf_(buffer, size, "%08lX: %02x %02x %02x %02x %-8s|%c\n", (unsigned long)i * 16UL, i & 0xFFU, (i >> 3) & 0xFFU, (i >> 6) & 0xFFU, (i >> 9) & 0xFFU, states[i % 3U], (char)('A' + i % 26U));
+	}
+
+	static int MeasurementCompiled(char *buffer, size_t size, uint32_t i)
+	{
+		return snprintf_ct(buffer, size, "ch%u %8.3f V %+.2e A %*s\n", i % 8U, (double)i * 0.0125, (double)i * -1e-4, (int)(i % 6U), "ok");
+	}
+
+	static int MeasurementRuntime(char *buffer, size_t size, uint32_t i)
+	{
+		return snprintf_(buffer, size, "ch%u %8.3f V %+.2e A %*s\n", i % 8U, (double)i * 0.0125, (double)i * -1e-4, (int)(i % 6U), "ok");
+	}
+
+	void PrintfScenarios()
+	{
+		IntegerFormat("%d", 2, 200000);
+		IntegerFormat("%lu", 4, 200000);
+		IntegerFormat("%llu", 8, 200000);
+		IntegerFormat("%llx", 8, 200000);
+		IntegerFormat("%08lX", 4, 200000);
+		IntegerFormat("%-12lu|", 4, 200000);
+		IntegerFormat("%+.7d", 2, 200000);
+		IntegerFormat("%#llo", 8, 200000);
+		IntegerFormat("%#llb", 8, 200000);
+		IntegerFormat("%20.15llu", 8, 200000);
+		FloatFormat("%f", false, 500000);
+		FloatFormat("%.3f", false, 500000);
+		FloatFormat("%10.4g", false, 500000);
+		FloatFormat("%e", true, 500000);
+		FloatFormat("%.16e", true, 500000);
+		FloatFormat("%g", true, 500000);
+		FloatShortest(500000);
+		CompiledFormat("telemetry line, snprintf_ct", TelemetryCompiled, TelemetryRuntime, 200000);
+		CompiledFormat("hex dump line, snprintf_ct", HexDumpCompiled, HexDumpRuntime, 200000);
+		CompiledFormat("measurement line, snprintf_ct", MeasurementCompiled, MeasurementRuntime, 200000);
+		ChunkedOutput(false, 200000);
+		ChunkedOutput(true, 200000);
+		LogLines(false, false, 5000);
+		LogLines(false, true, 5000);
+		LogLines(true, false, 5000);
+	}
+}
@@ -0,0 +1,182 @@
+/*
+ * BenchSensors.cpp
+ */
+
+#include "Benchmark.h"
+#include "HC_SR04.h"
+#include "IR_Receiver.h"
+
+using namespace Drivers;
+
+namespace Bench
+{
+	/* Echo scripted from the outside: rises 200us after the trigger, lasts for the round trip of distanceCm */
+	static void Sonar(float distanceCm, uint32_t pollUs)
+	{
+		static char scenario[48];
+		HostTimer timer;
+		const uint8_t TRIG = 7, ECHO = 8;
+
+		HostSim::Reset();
+		size_t heap = HostSim::HeapInUse();
+		HC_SR04 *sonar = new HC_SR04(TRIG, ECHO);
+		long heapBytes = (long)(HostSim::HeapInUse() - heap);
+		HostSim::ResetBusTime();
+
+		const uint32_t echoUs = (uint32_t)(distanceCm / 0.01715f);
+		const uint32_t measurements = 200;
+		uint32_t calls = 0, valid = 0;
+		float worstError = 0.0f;
+
+		for( uint32_t m = 0; m < measurements; m++ )
+		{
+			sonar->StartMeasurement();
+			uint64_t start = HostSim::NowNs();
+			bool echoHigh = false, echoDone = false;
+
+			while( !sonar->IsComplete() )
+			{
+				/* Edges are driven at their exact time, Update() only runs every pollUs */
+				uint64_t pollEnd = HostSim::NowNs() + (uint64_t)pollUs * 1000u;
+				if( !echoHigh && (start + 200000u <= pollEnd) )
+				{
+					HostSim::Advance(start + 200000u - HostSim::NowNs());
+					HostSim::SetInput(ECHO, HIGH);
+					echoHigh = true;
+				}
+				if( echoHigh && !echoDone && (start + (200u + echoUs) * 1000ull <= pollEnd) )
+				{
+					HostSim::Advance(start + (200u + echoUs) * 1000ull - HostSim::NowNs());
+					HostSim::SetInput(ECHO, LOW);
+					echoDone = true;
+				}
+				HostSim::Advance(pollEnd - HostSim::NowNs());
+
+				timer.Start();
+				sonar->Update();
+				timer.Stop();
+				calls++;
+			}
+
+			float distance = sonar->GetDistanceCM();
+			if( distance >= 0.0f )
+			{
+				valid++;
+				float error = fabsf(distance - distanceCm);
+				if( error > worstError )
+					worstError = error;
+			}
+
+			/* Sensor needs ~60ms between measurements */
+			HostSim::AdvanceUs(60000);
+		}
+
+		Result result;
+		snprintf(scenario, sizeof(scenario), "%.0f cm echo, Update() every %uus", (double)distanceCm, pollUs);
+		result.Driver = "HC_SR04";
+		result.Scenario = scenario;
+		result.Calls = calls;
+		result.HostNs = timer.ElapsedNs();
+		result.BusNs = HostSim::BusTimeNs();
+		result.HeapBytes = heapBytes;
+		Report(result);
+		Note("valid %u/%u, worst error %.2f cm", valid, measurements, (double)worstError);
+
+		delete sonar;
+	}
+
+	/* NEC frame on an active low receiver output: 9ms mark, 4.5ms space, 32 bits MSB first, stop mark */
+	static uint8_t NecEdges(uint32_t code, uint32_t startUs, uint32_t *timesUs)
+	{
+		uint8_t n = 0;
+		uint32_t t = startUs;
+
+		timesUs[n++] = t; t += 9000u;
+		timesUs[n++] = t; t += 4500u;
+		for( int8_t bit = 31; bit >= 0; bit-- )
+		{
+			timesUs[n++] = t; t += 562u;
+			timesUs[n++] = t; t += (code & (1UL << bit)) ? 1687u : 562u;
+		}
+		timesUs[n++] = t; t += 562u;
+		timesUs[n++] = t;
+		return n;
+	}
+
+	/* The frame is played on the pin while Update() runs every pollUs, as it would in a busy loop() */
+	static void Infrared(uint32_t pollUs)
+	{
+		static char scenario[48];
+		HostTimer timer;
+		const uint8_t RX = 2;
+		const uint32_t CODE = 0x20DF10EFUL;
+		uint32_t edges[80];
+
+		HostSim::Reset();
+		HostSim::SetInput(RX, HIGH);
+		size_t heap = HostSim::HeapInUse();
+		IR_Receiver *ir = new IR_Receiver(RX);
+		long heapBytes = (long)(HostSim::HeapInUse() - heap);
+
+		const uint32_t frames = 100;
+		uint32_t calls = 0, decoded = 0;
+		HostSim::ResetBusTime();
+
+		for( uint32_t f = 0; f < frames; f++ )
+		{
+			ir->StartReceiving();
+			uint32_t startUs = (uint32_t)(HostSim::NowNs() / 1000u) + 1000u;
+			uint8_t count = NecEdges(CODE, startUs, edges);
+			uint8_t next = 0;
+
+			/* Low level on even edges, the receiver output idles high */
+			for( uint8_t i = 0; i < 200u && !ir->IsSignalDetected(); i++ )
+			{
+				uint32_t pollEnd = (uint32_t)(HostSim::NowNs() / 1000u) + pollUs;
+				while( next < count && edges[next] <= pollEnd )
+				{
+					HostSim::AdvanceUs(edges[next] - (uint32_t)(HostSim::NowNs() / 1000u));
+					HostSim::SetInput(RX, (next & 1u) ? HIGH : LOW);
+					next++;
+				}
+				HostSim::AdvanceUs(pollEnd - (uint32_t)(HostSim::NowNs() / 1000u));
+
+				timer.Start();
+				ir->Update();
+				timer.Stop();
+				calls++;
+			}
+
+			if( ir->IsSignalDetected() && (ir->GetReceivedCode() == CODE) )
+			{
+				decoded++;
+			}
+			ir->StopReceiving();
+			HostSim::AdvanceUs(100000);
+		}
+
+		Result result;
+		snprintf(scenario, sizeof(scenario), "NEC frames, Update() every %uus", pollUs);
+		result.Driver = "IR_Receiver";
+		result.Scenario = scenario;
+		result.Calls = calls;
+		result.HostNs = timer.ElapsedNs();
+		result.BusNs = HostSim::BusTimeNs();
+		result.HeapBytes = heapBytes;
+		Report(result);
+		Note("decoded %u/%u frames", decoded, frames);
+
+		delete ir;
+	}
+
+	void SensorScenarios()
+	{
+		Sonar(50.0f, 10);
+		Sonar(50.0f, 100);
+		Sonar(200.0f, 100);
+		Sonar(50.0f, 1000);
+		Infrared(1000);
+		Infrared(20000);
+		Infrared(100000);
+	}
+}
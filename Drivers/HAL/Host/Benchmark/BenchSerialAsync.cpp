@@ -0,0 +1,700 @@
+/*
+ * BenchSerialAsync.cpp
+ */
+
+#include "Benchmark.h"
+#include "SerialAsync.h"
+
+using namespace Drivers;
+
+namespace Bench
+{
+	/* Upper bound in ms of the log2 latency bucket holding the given fraction of the frames */
+	static double LatencyPercentileMs(const SerialAsyncStats &stats, double fraction)
+	{
+		uint32_t total = 0, seen = 0;
+		for( uint8_t i = 0; i < SERIAL_ASYNC_LATENCY_BUCKETS; i++ )
+		{
+			total += stats.LatencyLog2Us[i];
+		}
+		for( uint8_t i = 0; i < SERIAL_ASYNC_LATENCY_BUCKETS; i++ )
+		{
+			seen += stats.LatencyLog2Us[i];
+			if( (total != 0u) && (seen >= fraction * total) )
+			{
+				return (double)(2u << i) / 1000.0;
+			}
+		}
+		return 0.0;
+	}
+
+	static void LogLines(uint16_t lineLength, uint32_t lines)
+	{
+		static char scenario[48];
+		uint8_t line[512];
+		HostTimer timer;
+
+		for( uint16_t i = 0; i < lineLength; i++ )
+		{
+			line[i] = (uint8_t)('a' + (i % 26));
+		}
+		line[lineLength - 1] = '\n';
+
+		HostSim::Reset();
+		size_t heap = HostSim::HeapInUse();
+		SerialAsync *serial = new SerialAsync(&Serial, (uint32_t)SerialSpeed::BAUD_115200);
+		long heapBytes = (long)(HostSim::HeapInUse() - heap);
+		Serial.ResetHostStats();
+
+		uint32_t accepted = 0, calls = 0;
+		for( uint32_t i = 0; i < lines; i++ )
+		{
+			timer.Start();
+			if( serial->WriteBytes(line, lineLength) == lineLength )
+			{
+				accepted++;
+			}
+			serial->MainFunction();
+			timer.Stop();
+			calls += 2u;
+
+			/* One line every 5ms of application time, drained in between */
+			for( uint8_t tick = 0; tick < 50u; tick++ )
+			{
+				HostSim::AdvanceUs(100);
+				timer.Start();
+				serial->MainFunction();
+				timer.Stop();
+				calls++;
+			}
+		}
+
+		uint32_t rate = Serial.GetDrainRate();
+		Result result;
+		snprintf(scenario, sizeof(scenario), "%u B lines @115200, 5ms period", lineLength);
+		result.Driver = "SerialAsync";
+		result.Scenario = scenario;
+		result.Calls = calls;
+		result.HostNs = timer.ElapsedNs();
+		result.BusNs = (uint64_t)Serial.GetHostStats().BytesOnWire * 1000000000u / rate;
+		result.HeapBytes = heapBytes;
+		Report(result);
+		Note("lines accepted %u/%u, serial write calls %u, bytes on wire %u", accepted, lines, Serial.GetHostStats().WriteCalls, Serial.GetHostStats().BytesOnWire);
+		SerialAsyncStats stats = serial->GetStats();
+		Note("stats: accepted %u B, rejected %u B in %u writes, high-water %u/%u B, latency p50 <%.2f ms p99 <%.2f ms", stats.BytesAccepted, stats.BytesRejected, stats.WritesRejected,
+			stats.HighWater[SerialAsync::LANE_BULK], SERIAL_ASYNC_STATIC_BUFFER_SIZE, LatencyPercentileMs(stats, 0.5), LatencyPercentileMs(stats, 0.99));
+
+		delete serial;
+	}
+
+	/* Sink faster than the driver: only the CPU cost of queueing and draining is left */
+	template<class SerialAsyncType>
+	static void FastSink(uint16_t lineLength, uint32_t lines, const char *instance)
+	{
+		static char scenario[48];
+		uint8_t line[512];
+		HostTimer timer;
+
+		memset(line, 'x', sizeof(line));
+
+		HostSim::Reset();
+		size_t heap = HostSim::HeapInUse();
+		SerialAsyncType *serial = new SerialAsyncType(&Serial, (uint32_t)SerialSpeed::BAUD_115200);
+		long heapBytes = (long)(HostSim::HeapInUse() - heap);
+		Serial.SetDrainRate(1000000000u);
+		Serial.ResetHostStats();
+		uint16_t idle = serial->AvailableForWrite();
+
+		uint32_t calls = 0;
+		for( uint32_t i = 0; i < lines; i++ )
+		{
+			timer.Start();
+			serial->WriteBytes(line, lineLength);
+			timer.Stop();
+			calls++;
+
+			while( serial->AvailableForWrite() < idle )
+			{
+				HostSim::AdvanceUs(1);
+				timer.Start();
+				serial->MainFunction();
+				timer.Stop();
+				calls++;
+			}
+		}
+
+		Result result;
+		snprintf(scenario, sizeof(scenario), "%u B lines, fast sink, %s", lineLength, instance);
+		result.Driver = "SerialAsync";
+		result.Scenario = scenario;
+		result.Calls = calls;
+		result.HostNs = timer.ElapsedNs();
+		result.BusNs = 0;
+		result.HeapBytes = heapBytes;
+		Report(result);
+		Note("host CPU %.2f ns/byte, serial write calls per line %.1f", (double)timer.ElapsedNs() / ((double)lines * lineLength), (double)Serial.GetHostStats().WriteCalls / lines);
+
+		Serial.SetDrainRate(0);
+		delete serial;
+	}
+
+	/* Main loop blocked 20ms per iteration (e.g. a slow sensor read): polling only tops up the core FIFO once per loop */
+	static void BusyLoop(bool txInterrupt, uint32_t loops)
+	{
+		static char scenario[48];
+		uint8_t line[200];
+		HostTimer timer;
+
+		memset(line, 'y', sizeof(line));
+
+		HostSim::Reset();
+		SerialAsync *serial = new SerialAsync(&Serial, (uint32_t)SerialSpeed::BAUD_115200);
+		bool interruptOn = txInterrupt && serial->EnableTxInterrupt(true);
+		Serial.ResetHostStats();
+		serial->ResetThroughput();
+
+		uint32_t accepted = 0, calls = 0;
+		for( uint32_t i = 0; i < loops; i++ )
+		{
+			timer.Start();
+			if( serial->WriteBytes(line, sizeof(line)) == sizeof(line) )
+			{
+				accepted++;
+			}
+			serial->MainFunction();
+			timer.Stop();
+			calls += 2u;
+
+			delay(20);
+		}
+
+		SerialAsyncThroughput throughput = serial->GetThroughput();
+		Result result;
+		snprintf(scenario, sizeof(scenario), "200 B per 20ms busy loop, %s", interruptOn ? "TX interrupt" : "polled");
+		result.Driver = "SerialAsync";
+		result.Scenario = scenario;
+		result.Calls = calls;
+		result.HostNs = timer.ElapsedNs();
+		result.BusNs = (uint64_t)Serial.GetHostStats().BytesOnWire * 1000000000u / Serial.GetDrainRate();
+		result.HeapBytes = 0;
+		Report(result);
+		Note("line use %u.%u%% of baud, offered %.1f%%, lines accepted %u/%u", throughput.LineUsePermille / 10u, throughput.LineUsePermille % 10u,
+			100.0 * sizeof(line) * 10u * 50u / 115200.0, accepted, loops);
+
+		delete serial;
+	}
+
+	/* Logs flood the bulk lane while a 16 B reply goes out every 10ms: time from WriteBytes() to the reply's last byte on the wire */
+	static void ReplyLatency(uint8_t replyLane, uint32_t replies)
+	{
+		static char scenario[48];
+		uint8_t log[96], reply[16];
+		HostTimer timer;
+
+		memset(log, 'l', sizeof(log));
+		log[sizeof(log) - 1] = '\n';
+		memset(reply, '#', sizeof(reply));
+		reply[sizeof(reply) - 1] = '\n';
+
+		// Priority lanes are opt-in, the control lane gets a 128 B queue of its own
+		typedef SerialAsyncT<SERIAL_ASYNC_STATIC_BUFFER_SIZE, 0, 128> LaneSerial;
+		HostSim::Reset();
+		LaneSerial *serial = new LaneSerial(&Serial, (uint32_t)SerialSpeed::BAUD_115200);
+		Serial.SetCapture(true);
+		Serial.ClearCapture();
+		Serial.ResetHostStats();
+
+		uint32_t calls = 0, lost = 0;
+		uint64_t totalNs = 0, worstNs = 0;
+		size_t searched = 0;
+		for( uint32_t i = 0; i < replies; i++ )
+		{
+			// 10ms of logging, a line every 500us, far more than 115200 baud carries
+			for( uint8_t tick = 0; tick < 100u; tick++ )
+			{
+				timer.Start();
+				if( (tick % 5u) == 0u )
+				{
+					serial->WriteBytes(log, sizeof(log));
+					calls++;
+				}
+				serial->MainFunction();
+				timer.Stop();
+				calls++;
+				HostSim::AdvanceUs(100);
+			}
+
+			timer.Start();
+			uint16_t accepted = serial->WriteBytes(reply, sizeof(reply), replyLane);
+			timer.Stop();
+			calls++;
+			if( accepted == 0u )
+			{
+				lost++;
+				continue;
+			}
+
+			uint64_t sentNs = HostSim::NowNs();
+			for( ;; )
+			{
+				// TxQueued() lets the simulated FIFO catch up with virtual time
+				Serial.TxQueued();
+				size_t start = Serial.Captured().find('#', searched);
+				size_t found = (start == std::string::npos) ? start : Serial.Captured().find('\n', start);
+				if( found != std::string::npos )
+				{
+					searched = found + 1u;
+					break;
+				}
+				HostSim::AdvanceUs(100);
+				timer.Start();
+				serial->MainFunction();
+				timer.Stop();
+				calls++;
+			}
+
+			uint64_t latencyNs = HostSim::NowNs() - sentNs;
+			totalNs += latencyNs;
+			worstNs = (latencyNs > worstNs) ? latencyNs : worstNs;
+		}
+
+		Result result;
+		snprintf(scenario, sizeof(scenario), "16 B reply under log flood, %s lane", (replyLane == SerialAsync::LANE_BULK) ? "bulk" : "control");
+		result.Driver = "SerialAsync";
+		result.Scenario = scenario;
+		result.Calls = calls;
+		result.HostNs = timer.ElapsedNs();
+		result.BusNs = (uint64_t)Serial.GetHostStats().BytesOnWire * 1000000000u / Serial.GetDrainRate();
+		result.HeapBytes = 0;
+		Report(result);
+		Note("reply latency mean %.2f ms, worst %.2f ms, replies rejected %u/%u", (double)totalNs / 1e6 / (replies - lost), (double)worstNs / 1e6, lost, replies);
+		SerialAsyncStats stats = serial->GetStats();
+		Note("stats: high-water control %u B, bulk %u B, latency of all frames p50 <%.2f ms p99 <%.2f ms", stats.HighWater[SerialAsync::LANE_CONTROL], stats.HighWater[SerialAsync::LANE_BULK],
+			LatencyPercentileMs(stats, 0.5), LatencyPercentileMs(stats, 0.99));
+
+		Serial.SetCapture(false);
+		delete serial;
+	}
+
+	/* Bursts of 48 B telemetry records into a UART throttled to 2000 B/s, what survives on the wire per overflow policy */
+	static void OverflowPolicy(SerialOverflow policy, uint16_t timeoutMs, uint16_t bursts)
+	{
+		static char scenario[48];
+		static const char *names[] = { "reject", "partial", "drop oldest", "block" };
+		char record[49];
+		HostTimer timer;
+
+		HostSim::Reset();
+		SerialAsyncT<256, 16, 16> *serial = new SerialAsyncT<256, 16, 16>(&Serial, (uint32_t)SerialSpeed::BAUD_115200);
+		serial->SetOverflowPolicy(policy, timeoutMs);
+		// Flush what the previous scenario left in the hardware FIFO
+		HostSim::AdvanceUs(100000);
+		Serial.TxQueued();
+		Serial.SetDrainRate(2000);
+		Serial.SetCapture(true);
+		Serial.ClearCapture();
+		Serial.ResetHostStats();
+
+		uint32_t calls = 0, written = 0, id = 0;
+		uint64_t worstBlockNs = 0;
+		for( uint16_t burst = 0; burst < bursts; burst++ )
+		{
+			// 20 records at once, then 100ms of polling
+			for( uint8_t i = 0; i < 20u; i++, id++ )
+			{
+				snprintf(record, sizeof(record), "<%05u:%039u>\n", id % 100000u, 0u);
+				uint64_t startNs = HostSim::NowNs();
+				timer.Start();
+				written += serial->WriteBytes((const uint8_t *)record, 48);
+				timer.Stop();
+				calls++;
+				worstBlockNs = ((HostSim::NowNs() - startNs) > worstBlockNs) ? (HostSim::NowNs() - startNs) : worstBlockNs;
+			}
+
+			for( uint16_t tick = 0; tick < 100u; tick++ )
+			{
+				HostSim::AdvanceUs(1000);
+				timer.Start();
+				serial->MainFunction();
+				timer.Stop();
+				calls++;
+			}
+		}
+
+		// Let the queue run dry, then check every line that made it out
+		for( uint16_t tick = 0; tick < 2000u; tick++ )
+		{
+			HostSim::AdvanceUs(1000);
+			serial->MainFunction();
+		}
+		Serial.TxQueued();
+
+		uint32_t intact = 0, broken = 0;
+		const std::string &wire = Serial.Captured();
+		for( size_t start = 0; start < wire.size(); )
+		{
+			size_t end = wire.find('\n', start);
+			if( end == std::string::npos )
+			{
+				broken++;
+				break;
+			}
+			if( ((end - start) == 47u) && (wire[start] == '<') && (wire[end - 1u] == '>') )
+				intact++;
+			else
+				broken++;
+			start = end + 1u;
+		}
+
+		SerialAsyncStats stats = serial->GetStats();
+		Result result;
+		snprintf(scenario, sizeof(scenario), "48 B record bursts @2000 B/s, %s", names[(uint8_t)policy]);
+		result.Driver = "SerialAsync";
+		result.Scenario = scenario;
+		result.Calls = calls;
+		result.HostNs = timer.ElapsedNs();
+		result.BusNs = (uint64_t)Serial.GetHostStats().BytesOnWire * 1000000000u / Serial.GetDrainRate();
+		result.HeapBytes = 0;
+		Report(result);
+		Note("records intact %u/%u, broken %u, rejected %u B, dropped %u frames, worst write %.1f ms", intact, id, broken, stats.BytesRejected, stats.FramesDropped, (double)worstBlockNs / 1e6);
+
+		Serial.SetCapture(false);
+		Serial.SetDrainRate(0);
+		delete serial;
+	}
+
+	/* Sensor samples at 115200 baud, printf style ASCII lines against COBS frames of the raw struct */
+	static void Telemetry(bool binary, uint32_t samples)
+	{
+		typedef struct
+		{
+			uint32_t TimeMs;
+			int16_t Accel[3];
+			int16_t Gyro[3];
+			uint16_t TempCenti;
+		} Sample;
+
+		char line[96];
+		HostTimer timer;
+
+		HostSim::Reset();
+		SerialAsync *serial = new SerialAsync(&Serial, (uint32_t)SerialSpeed::BAUD_115200);
+		HostSim::AdvanceUs(100000);
+		Serial.TxQueued();
+		Serial.SetCapture(true);
+		Serial.ClearCapture();
+		Serial.ResetHostStats();
+
+		uint32_t calls = 0, accepted = 0;
+		for( uint32_t i = 0; i < samples; i++ )
+		{
+			Sample sample;
+			memset(&sample, 0, sizeof(sample));
+			sample.TimeMs = 1000u + i * 10u;
+			for( uint8_t j = 0; j < 3u; j++ )
+			{
+				sample.Accel[j] = (int16_t)(((int32_t)(i * 37u + j * 1000u) % 32768) - 16384);
+				sample.Gyro[j] = (int16_t)(((int32_t)(i * 11u + j * 300u) % 4000) - 2000);
+			}
+			sample.TempCenti = (uint16_t)(2300u + (i % 200u));
+
+			timer.Start();
+			if( binary )
+			{
+				accepted += (serial->WriteCobsFrame((const uint8_t *)&sample, sizeof(sample)) != 0u) ? 1u : 0u;
+			}
+			else
+			{
+				int length = snprintf(line, sizeof(line), "%lu,%d,%d,%d,%d,%d,%d,%u\n", (unsigned long)sample.TimeMs,
+					sample.Accel[0], sample.Accel[1], sample.Accel[2], sample.Gyro[0], sample.Gyro[1], sample.Gyro[2], sample.TempCenti);
+				accepted += (serial->WriteBytes((const uint8_t *)line, (uint16_t)length) != 0u) ? 1u : 0u;
+			}
+			timer.Stop();
+			calls++;
+
+			// One sample every 10ms
+			for( uint8_t tick = 0; tick < 10u; tick++ )
+			{
+				HostSim::AdvanceUs(1000);
+				serial->MainFunction();
+			}
+		}
+		HostSim::AdvanceUs(100000);
+		serial->MainFunction();
+		Serial.TxQueued();
+
+		// Decode what went out on the wire
+		uint32_t valid = 0;
+		const std::string &wire = Serial.Captured();
+		if( binary )
+		{
+			CobsDecoder decoder;
+			for( size_t i = 0; i < wire.size(); i++ )
+			{
+				uint8_t decoded;
+				if( (decoder.Push((uint8_t)wire[i], decoded) == CobsDecoder::FRAME) && (decoder.Length() == (sizeof(Sample) + 2u)) )
+					valid++;
+			}
+		}
+		else
+		{
+			for( size_t i = 0; i < wire.size(); i++ )
+			{
+				valid += (wire[i] == '\n') ? 1u : 0u;
+			}
+		}
+
+		Result result;
+		result.Driver = "SerialAsync";
+		result.Scenario = binary ? "telemetry 20 B samples, COBS + CRC16" : "telemetry 20 B samples, ASCII";
+		result.Calls = calls;
+		result.HostNs = timer.ElapsedNs();
+		result.BusNs = (uint64_t)Serial.GetHostStats().BytesOnWire * 1000000000u / Serial.GetDrainRate();
+		result.HeapBytes = 0;
+		Report(result);
+		Note("%.1f B/sample on the wire, samples accepted %u, decoded %u/%u", (double)wire.size() / samples, accepted, valid, samples);
+
+		Serial.SetCapture(false);
+		delete serial;
+	}
+
+	static uint32_t FramesSeen = 0;
+
+	static void CountFrame(const ByteSpan &Frame, void *Arg)
+	{
+		(void)Arg;
+		FramesSeen += (Frame.FirstLength + Frame.SecondLength) ? 1u : 0u;
+	}
+
+	/* 32 B command frames arriving in core FIFO sized bursts, cost of cutting them out of the stream */
+	static void RxFrames(SerialFraming mode, bool callback, uint32_t frames)
+	{
+		static char scenario[48];
+		static const char *names[] = { "disabled", "raw", "delimiter", "fixed length", "length prefix", "cobs" };
+		uint8_t stream[36 * 64];
+		uint16_t streamLength = 0;
+		HostTimer timer;
+
+		for( uint8_t i = 0; i < 64u; i++ )
+		{
+			if( mode == SerialFraming::COBS )
+			{
+				// 30 B payload, 32 B with the CRC like the other modes
+				uint8_t payload[30];
+				CobsEncoder encoder;
+				for( uint8_t j = 0; j < 30u; j++ )
+					payload[j] = (uint8_t)(i + j);
+				encoder.Begin(&stream[streamLength], COBS_ENCODED_SIZE(30u), nullptr);
+				encoder.Put(payload, 30u);
+				streamLength += encoder.End();
+				continue;
+			}
+			if( mode == SerialFraming::LENGTH_PREFIX )
+				stream[streamLength++] = 32u;
+			for( uint8_t j = 0; j < 31u; j++ )
+				stream[streamLength++] = (uint8_t)('a' + ((i + j) % 26));
+			stream[streamLength++] = (mode == SerialFraming::DELIMITER) ? '\n' : '.';
+		}
+
+		// The default instance is transmit only, RX needs a queue
+		typedef SerialAsyncT<SERIAL_ASYNC_STATIC_BUFFER_SIZE, 256> RxSerial;
+		HostSim::Reset();
+		RxSerial *serial = new RxSerial(&Serial, (uint32_t)SerialSpeed::BAUD_115200);
+		serial->SetFraming(mode, (mode == SerialFraming::FIXED_LENGTH) ? 32u : ((mode == SerialFraming::DELIMITER) ? '\n' : 1u));
+		if( callback )
+			serial->SetFrameCallback(CountFrame);
+		FramesSeen = 0;
+
+		uint32_t calls = 0, offset = 0, bytes = 0;
+		while( bytes < frames * 32u )
+		{
+			uint16_t burst = SERIAL_RX_BUFFER_SIZE - 1;
+			if( burst > (streamLength - offset) )
+				burst = (uint16_t)(streamLength - offset);
+			burst = (uint16_t)Serial.InjectRx(&stream[offset], burst);
+			offset = (offset + burst) % streamLength;
+			bytes += burst;
+
+			timer.Start();
+			serial->MainFunction();
+			ByteSpan frame;
+			while( serial->PeekFrame(frame) )
+			{
+				FramesSeen++;
+				serial->ReleaseFrame();
+			}
+			timer.Stop();
+			calls++;
+		}
+
+		Result result;
+		snprintf(scenario, sizeof(scenario), "RX 32 B frames, %s%s", names[(uint8_t)mode], callback ? ", callback" : "");
+		result.Driver = "SerialAsync";
+		result.Scenario = scenario;
+		result.Calls = calls;
+		result.HostNs = timer.ElapsedNs();
+		result.BusNs = 0;
+		result.HeapBytes = 0;
+		Report(result);
+		Note("host CPU %.2f ns/byte, frames %u, dropped %u, corrupt %u", (double)timer.ElapsedNs() / bytes, FramesSeen, serial->GetRxDropped(), serial->GetRxCorrupt());
+
+		delete serial;
+	}
+
+	// The default instance is transmit only, RX needs a queue
+	typedef SerialAsyncT<SERIAL_ASYNC_STATIC_BUFFER_SIZE, 256> EchoSerial;
+
+	typedef struct
+	{
+		EchoSerial *Serial;
+		uint32_t Frames;
+	} EchoState;
+
+	/* Echoes the command as a COBS frame and runs MainFunction() like an application handler would */
+	static void EchoFrame(const ByteSpan &Frame, void *Arg)
+	{
+		EchoState *state = (EchoState *)Arg;
+		uint8_t payload[16];
+		uint16_t length = (uint16_t)(Frame.FirstLength + Frame.SecondLength);
+		if( length > sizeof(payload) )
+			return;
+
+		memcpy(payload, Frame.First, Frame.FirstLength);
+		memcpy(&payload[Frame.FirstLength], Frame.Second, Frame.SecondLength);
+		state->Serial->WriteCobsFrame(payload, length);
+		state->Serial->MainFunction();
+		state->Frames++;
+	}
+
+	/* 8 B COBS commands arriving several per burst, each answered from the frame callback */
+	static void CallbackReply(uint32_t commands)
+	{
+		uint8_t stream[COBS_ENCODED_SIZE(8u) * 64u];
+		uint16_t streamLength = 0;
+		HostTimer timer;
+
+		for( uint8_t i = 0; i < 64u; i++ )
+		{
+			uint8_t payload[8] = { i, 0u, 1u, 2u, (uint8_t)(i * 3u), 0u, 0xFFu, (uint8_t)~i };
+			CobsEncoder encoder;
+			encoder.Begin(&stream[streamLength], COBS_ENCODED_SIZE(8u), nullptr);
+			encoder.Put(payload, 8u);
+			streamLength += encoder.End();
+		}
+
+		HostSim::Reset();
+		EchoSerial *serial = new EchoSerial(&Serial, (uint32_t)SerialSpeed::BAUD_115200);
+		EchoState state = { serial, 0u };
+		serial->SetFraming(SerialFraming::COBS);
+		serial->SetFrameCallback(EchoFrame, &state);
+		HostSim::AdvanceUs(100000);
+		Serial.TxQueued();
+		Serial.SetCapture(true);
+		Serial.ClearCapture();
+
+		uint32_t calls = 0, offset = 0, sent = 0;
+		while( sent < commands )
+		{
+			uint16_t burst = SERIAL_RX_BUFFER_SIZE - 1;
+			if( burst > (streamLength - offset) )
+				burst = (uint16_t)(streamLength - offset);
+			burst = (uint16_t)Serial.InjectRx(&stream[offset], burst);
+			for( uint16_t i = 0; i < burst; i++ )
+				sent += (stream[offset + i] == 0u) ? 1u : 0u;
+			offset = (offset + burst) % streamLength;
+
+			timer.Start();
+			serial->MainFunction();
+			timer.Stop();
+			calls++;
+			HostSim::AdvanceUs(5000);
+		}
+		for( uint8_t i = 0; i < 100u; i++ )
+		{
+			HostSim::AdvanceUs(1000);
+			serial->MainFunction();
+		}
+		Serial.TxQueued();
+
+		// Every reply has to come back intact and in order
+		uint32_t echoed = 0, wrong = 0;
+		uint8_t reply[16];
+		uint8_t replyLength = 0;
+		CobsDecoder decoder;
+		const std::string &wire = Serial.Captured();
+		for( size_t i = 0; i < wire.size(); i++ )
+		{
+			uint8_t decoded;
+			switch( decoder.Push((uint8_t)wire[i], decoded) )
+			{
+			case CobsDecoder::DATA:
+				if( replyLength < sizeof(reply) )
+					reply[replyLength] = decoded;
+				replyLength++;
+				break;
+
+			case CobsDecoder::FRAME:
+			{
+				// The CRC is decoded like the payload
+				uint8_t expected = (uint8_t)(echoed % 64u);
+				bool match = (replyLength == 10u) && (reply[0] == expected) && (reply[7] == (uint8_t)~expected);
+				wrong += match ? 0u : 1u;
+				echoed++;
+				replyLength = 0;
+				break;
+			}
+
+			case CobsDecoder::CORRUPT:
+				wrong++;
+				replyLength = 0;
+				break;
+
+			default:
+				break;
+			}
+		}
+		Serial.SetCapture(false);
+
+		Result result;
+		result.Driver = "SerialAsync";
+		result.Scenario = "RX 8 B COBS commands, reply from callback";
+		result.Calls = calls;
+		result.HostNs = timer.ElapsedNs();
+		result.BusNs = 0;
+		result.HeapBytes = 0;
+		Report(result);
+		Note("commands %u, callbacks %u, replies %u, wrong %u, dropped %u, corrupt %u", sent, state.Frames, echoed, wrong, serial->GetRxDropped(), serial->GetRxCorrupt());
+
+		delete serial;
+	}
+
+	void SerialAsyncScenarios()
+	{
+		FastSink<SerialAsync>(64, 20000, "1024 B");
+		FastSink<SerialAsync>(256, 20000, "1024 B");
+		FastSink<SerialAsync>(512, 20000, "1024 B");
+		FastSink<SerialAsyncT<128, 16, 16> >(64, 20000, "<128,16,16>");
+		FastSink<SerialAsyncT<256, 16, 16> >(64, 20000, "<256,16,16>");
+		FastSink<SerialAsyncT<64> >(64, 20000, "<64>");
+		FastSink<SerialAsyncT<64, 0, 0, 4, 8, false> >(64, 20000, "<64>, 4 frames, no stats");
+		LogLines(64, 2000);
+		LogLines(256, 2000);
+		LogLines(512, 2000);
+		BusyLoop(false, 500);
+		BusyLoop(true, 500);
+		ReplyLatency(SerialAsync::LANE_BULK, 200);
+		ReplyLatency(SerialAsync::LANE_CONTROL, 200);
+		OverflowPolicy(SerialOverflow::REJECT, 0, 20);
+		OverflowPolicy(SerialOverflow::PARTIAL, 0, 20);
+		OverflowPolicy(SerialOverflow::DROP_OLDEST, 0, 20);
+		OverflowPolicy(SerialOverflow::BLOCK, 20, 20);
+		RxFrames(SerialFraming::DELIMITER, false, 20000);
+		RxFrames(SerialFraming::DELIMITER, true, 20000);
+		RxFrames(SerialFraming::FIXED_LENGTH, false, 20000);
+		RxFrames(SerialFraming::LENGTH_PREFIX, false, 20000);
+		RxFrames(SerialFraming::COBS, false, 20000);
+		CallbackReply(2000);
+		Telemetry(false, 2000);
+		Telemetry(true, 2000);
+	}
+}
@@ -0,0 +1,64 @@
+/*
+ * BenchStepper.cpp
+ */
+
+#include "Benchmark.h"
+#include "X113647Stepper.h"
+
+using namespace Drivers;
+
+namespace Bench
+{
+	template<class StepperT>
+	static void Steps(StepperT *motor, const char *scenario, size_t heapBefore)
+	{
+		HostTimer timer;
+		long heapBytes = (long)(HostSim::HeapInUse() - heapBefore);
+		const uint32_t steps = 20000;
+		uint32_t glitches = 0;
+
+		HostSim::ResetBusTime();
+		for( uint32_t i = 0; i < steps; i++ )
+		{
+			HostSim::ClearEdges();
+			timer.Start();
+			motor->StepNext();
+			timer.Stop();
+
+			/* Coil edges of one step at different instants are intermediate coil states */
+			for( uint32_t e = 1; e < HostSim::EdgeCount(); e++ )
+			{
+				if( HostSim::GetEdge(e).TimeNs != HostSim::GetEdge(e - 1u).TimeNs )
+					glitches++;
+			}
+			HostSim::AdvanceUs(2000);
+		}
+
+		Result result;
+		result.Driver = "X11Stepper";
+		result.Scenario = scenario;
+		result.Calls = steps;
+		result.HostNs = timer.ElapsedNs();
+		result.BusNs = HostSim::BusTimeNs();
+		result.HeapBytes = heapBytes;
+		Report(result);
+		Note("intermediate coil states: %u", glitches);
+	}
+
+	void StepperScenarios()
+	{
+		typedef X11StepperT< X11Coils<Gpio, Gpio, Gpio, Gpio> > PerPinStepper;
+
+		HostSim::Reset();
+		size_t heap = HostSim::HeapInUse();
+		PerPinStepper *perPin = new PerPinStepper(X11Coils<Gpio, Gpio, Gpio, Gpio>(Gpio(40, OUTPUT), Gpio(41, OUTPUT), Gpio(42, OUTPUT), Gpio(43, OUTPUT)));
+		Steps(perPin, "4 coils, one Gpio per coil", heap);
+		delete perPin;
+
+		HostSim::Reset();
+		heap = HostSim::HeapInUse();
+		X11Stepper *grouped = new X11Stepper(40, 41, 42, 43);
+		Steps(grouped, "4 coils, GpioGroup", heap);
+		delete grouped;
+	}
+}
@@ -0,0 +1,66 @@
+/*
+ * Benchmark.h
+ *
+ *  Helpers shared by the host benchmark scenarios. Every scenario reports, per driver:
+ *   - calls per second of host CPU time (relative cost of the driver code itself)
+ *   - simulated bus time per call (virtual time charged by pin and serial operations)
+ *   - heap bytes taken by the driver instance
+ */
+
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include "Arduino.h"
+
+#include <chrono>
+#include <vector>
+
+namespace Drivers
+{
+	class HC595Base;
+}
+
+namespace Bench
+{
+	typedef struct
+	{
+		const char *Driver;
+		const char *Scenario;
+		uint32_t Calls;
+		uint64_t HostNs;		/* host CPU time spent in the measured calls */
+		uint64_t BusNs;			/* simulated bus time over all measured calls */
+		long HeapBytes;			/* heap taken by the driver instance */
+	} Result;
+
+	class HostTimer
+	{
+	public:
+		void Start() { this->_Start = std::chrono::steady_clock::now(); }
+		void Stop() { this->_Elapsed += (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - this->_Start).count(); }
+		uint64_t ElapsedNs() const { return this->_Elapsed; }
+
+	private:
+		std::chrono::steady_clock::time_point _Start;
+		uint64_t _Elapsed = 0;
+	};
+
+	void PrintHeader();
+	void Report(const Result &result);
+	/* Free form line below the last result, e.g. a correctness check of the scenario */
+	void Note(const char *format, ...);
+
+	/* Position on the wire of every output of a chain on pins 2 (clock), 3 (data) and 4 (latch),
+	 * found by shifting one set output at a time */
+	std::vector<uint8_t> WireMap(Drivers::HC595Base *reg);
+
+	/* Scenario groups, one per file */
+	void SerialAsyncScenarios();
+	void HC595Scenarios();
+	void LedMatrixScenarios();
+	void LedScenarios();
+	void SensorScenarios();
+	void StepperScenarios();
+	void PrintfScenarios();
+}
+
+#endif /* BENCHMARK_H */
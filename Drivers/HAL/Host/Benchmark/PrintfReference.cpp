@@ -0,0 +1,23 @@
+/*
+ * PrintfReference.cpp
+ *
+ *  Printf built a second time with PRINTF_DISABLE_FAST_NTOA and PRINTF_DISABLE_FLOAT_ENGINE,
+ *  i.e. the division per digit integer conversion and the multiply loop float conversion,
+ *  inside namespace PrintfReference so BenchPrintf can compare both.
+ *  Everything Printf.cpp includes is included here first, outside the namespace.
+ */
+
+#include <float.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "Printf.h"
+#include "Cobs.h"
+
+#define PRINTF_DISABLE_FAST_NTOA
+#define PRINTF_DISABLE_FLOAT_ENGINE
+
+namespace PrintfReference
+{
+#include "Printf.cpp"
+}
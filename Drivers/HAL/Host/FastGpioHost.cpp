@@ -0,0 +1,30 @@
+/*
+ * FastGpioHost.cpp
+ *
+ *  Register array backing FastGpio when the drivers are built for the host (DRIVERS_HOST).
+ */
+
+#if defined(DRIVERS_HOST)
+
+#include "FastGpio.h"
+
+namespace Drivers
+{
+	namespace FastGpioHost
+	{
+		volatile uint8_t Ports[FAST_GPIO_HOST_PORTS] = {0};
+		volatile uint8_t Ddrs[FAST_GPIO_HOST_PORTS] = {0};
+		volatile uint32_t Stores = 0;
+		volatile uint32_t Loads = 0;
+		void (*StoreHook)(uint8_t Port, uint8_t OldValue, uint8_t NewValue) = nullptr;
+
+		void ResetCounters()
+		{
+			Stores = 0;
+			Loads = 0;
+		}
+	}
+
+} /* namespace Drivers */
+
+#endif /* DRIVERS_HOST */
@@ -0,0 +1,71 @@
+/*
+ * SPI.h (host)
+ *
+ *  Stand-in for the Arduino SPI library on top of the host simulation. Transfers are
+ *  shifted out on the MOSI/SCK pins (they show up in the edge log) and
+ *  charged as time on the wire: 8 clock periods per byte plus HostSim::Costs().SpiByteNs
+ *  for the load/poll loop around every byte. The clock is capped at HOST_SIM_SPI_MAX_CLOCK,
+ *  F_CPU / 2 of an AVR at 16MHz. Only mode 0 is simulated.
+ */
+
+#ifndef HOST_SPI_H
+#define HOST_SPI_H
+
+#include "Arduino.h"
+
+#define SPI_MODE0			0x00
+#define SPI_MODE1			0x04
+#define SPI_MODE2			0x08
+#define SPI_MODE3			0x0C
+
+#ifndef HOST_SIM_SPI_MAX_CLOCK
+	#define HOST_SIM_SPI_MAX_CLOCK	8000000u
+#endif
+
+/* Hardware SPI pins of an Uno */
+static const uint8_t SS = 10;
+static const uint8_t MOSI = 11;
+static const uint8_t MISO = 12;
+static const uint8_t SCK = 13;
+
+class SPISettings
+{
+public:
+	SPISettings(uint32_t clock, uint8_t bitOrder, uint8_t dataMode) : _Clock(clock), _BitOrder(bitOrder), _DataMode(dataMode)
+	{
+	}
+
+	SPISettings() : SPISettings(4000000u, MSBFIRST, SPI_MODE0)
+	{
+	}
+
+private:
+	uint32_t _Clock;
+	uint8_t _BitOrder;
+	uint8_t _DataMode;
+
+	friend class SPIClass;
+};
+
+class SPIClass
+{
+public:
+	void begin();
+	void end();
+	void beginTransaction(SPISettings settings);
+	void endTransaction();
+	uint8_t transfer(uint8_t data);
+	void transfer(void *buf, size_t count);
+
+	/* Host simulation controls */
+	uint32_t GetTransfers() const { return this->_Transfers; }	/* bytes since begin() */
+
+private:
+	SPISettings _Settings;
+	uint32_t _BitNs = 250u;
+	uint32_t _Transfers = 0;
+};
+
+extern SPIClass SPI;
+
+#endif /* HOST_SPI_H */
@@ -0,0 +1,124 @@
+/*
+ * CobsDecode.cpp
+ *
+ *  Decodes a capture of SerialAsync COBS frames (SerialFraming::COBS, WriteCobsFrame()) on the
+ *  host, e.g. from `cat /dev/ttyUSB0 > log.bin`. Every frame is checked against its CRC16 and
+ *  printed as hex, bytes before the first delimiter are skipped as a partial frame.
+ *
+ *  cobs_decode [-q] [-o payloads.bin] [capture.bin]
+ *   -q   summary only
+ *   -o   also writes every valid payload, prefixed with its length (u16 little endian)
+ *  Reads stdin without a file. Exit code 1 when a corrupt frame was seen.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include "Cobs.h"
+
+using namespace Drivers;
+
+int main(int argc, char **argv)
+{
+	bool quiet = false;
+	const char *outName = nullptr;
+	const char *inName = nullptr;
+
+	for( int i = 1; i < argc; i++ )
+	{
+		if( strcmp(argv[i], "-q") == 0 )
+			quiet = true;
+		else if( (strcmp(argv[i], "-o") == 0) && ((i + 1) < argc) )
+			outName = argv[++i];
+		else if( argv[i][0] != '-' )
+			inName = argv[i];
+		else
+		{
+			fprintf(stderr, "usage: %s [-q] [-o payloads.bin] [capture.bin]\n", argv[0]);
+			return 2;
+		}
+	}
+
+	FILE *in = (inName != nullptr) ? fopen(inName, "rb") : stdin;
+	if( in == nullptr )
+	{
+		perror(inName);
+		return 2;
+	}
+	FILE *out = nullptr;
+	if( outName != nullptr )
+	{
+		out = fopen(outName, "wb");
+		if( out == nullptr )
+		{
+			perror(outName);
+			return 2;
+		}
+	}
+
+	CobsDecoder decoder;
+	std::vector<uint8_t> frame;
+	unsigned long frames = 0, corrupt = 0, bytes = 0;
+	bool synced = false;
+	int c;
+
+	while( (c = fgetc(in)) != EOF )
+	{
+		uint8_t decoded = 0;
+		bytes++;
+
+		// Whatever came before the first delimiter is the tail of a frame we missed the start of
+		if( !synced )
+		{
+			synced = (c == 0x00);
+			continue;
+		}
+
+		switch( decoder.Push((uint8_t)c, decoded) )
+		{
+		case CobsDecoder::DATA:
+			frame.push_back(decoded);
+			break;
+
+		case CobsDecoder::FRAME:
+			frame.resize(frame.size() - 2u);
+			if( !quiet )
+			{
+				printf("%6lu %5u:", frames, (unsigned)frame.size());
+				for( size_t i = 0; i < frame.size(); i++ )
+				{
+					printf(" %02x", frame[i]);
+				}
+				printf("\n");
+			}
+			if( out != nullptr )
+			{
+				uint8_t length[2] = { (uint8_t)frame.size(), (uint8_t)(frame.size() >> 8) };
+				fwrite(length, 1, 2, out);
+				fwrite(frame.data(), 1, frame.size(), out);
+			}
+			frames++;
+			frame.clear();
+			break;
+
+		case CobsDecoder::CORRUPT:
+			if( !quiet )
+				printf("%6lu  corrupt frame, %u bytes decoded\n", frames, (unsigned)decoder.Length());
+			corrupt++;
+			frame.clear();
+			break;
+
+		default:
+			break;
+		}
+	}
+
+	fprintf(stderr, "%lu bytes, %lu frames, %lu corrupt%s\n", bytes, frames, corrupt, frame.empty() ? "" : ", last frame incomplete");
+
+	if( in != stdin )
+		fclose(in);
+	if( out != nullptr )
+		fclose(out);
+
+	return (corrupt == 0u) ? 0 : 1;
+}
@@ -0,0 +1,518 @@
+/*
+ * DeferredLog.cpp
+ *
+ *  Host side of printf_deferred() (Drivers/Printf, DEFERRED_PRINTF=1): the device only sends
+ *  format ids and raw arguments, this tool formats the text again.
+ *
+ *  deferred_log table <sources...> > strings.tab
+ *   Finds every printf_deferred("...", ...) in the sources and writes the string table, one
+ *   "<id hex>\t<format, C escaped>" line per format. Run it as part of the build so the table
+ *   matches the firmware; two formats with the same id are an error.
+ *
+ *  deferred_log decode strings.tab [capture.bin]
+ *   Decodes the COBS frames of a capture (stdin without a file) and prints the log lines.
+ *   Frames that are not log records are reported with their length only.
+ */
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <map>
+#include <string>
+#include <vector>
+#include "Cobs.h"
+
+using namespace Drivers;
+
+/* Same hash as PrintfDeferred::FormatId() */
+static uint32_t FormatId(const std::string &format)
+{
+	uint32_t hash = 2166136261u;
+	for( size_t i = 0; i < format.size(); i++ )
+	{
+		hash = (hash ^ (uint8_t)format[i]) * 16777619u;
+	}
+	return hash;
+}
+
+static bool ReadFile(const char *name, std::string &content)
+{
+	FILE *file = fopen(name, "rb");
+	if( file == nullptr )
+	{
+		perror(name);
+		return false;
+	}
+	char chunk[4096];
+	size_t n;
+	while( (n = fread(chunk, 1, sizeof(chunk), file)) > 0 )
+	{
+		content.append(chunk, n);
+	}
+	fclose(file);
+	return true;
+}
+
+static int HexDigit(char c)
+{
+	if( (c >= '0') && (c <= '9') )
+		return c - '0';
+	if( (c >= 'a') && (c <= 'f') )
+		return c - 'a' + 10;
+	if( (c >= 'A') && (c <= 'F') )
+		return c - 'A' + 10;
+	return -1;
+}
+
+/* Parses a C string literal starting at the opening quote, returns the position after it */
+static size_t ParseLiteral(const std::string &text, size_t pos, std::string &value)
+{
+	for( pos++; (pos < text.size()) && (text[pos] != '"'); pos++ )
+	{
+		char c = text[pos];
+		if( (c != '\\') || ((pos + 1u) >= text.size()) )
+		{
+			value += c;
+			continue;
+		}
+
+		c = text[++pos];
+		switch( c )
+		{
+		case 'n': value += '\n'; break;
+		case 't': value += '\t'; break;
+		case 'r': value += '\r'; break;
+		case 'a': value += '\a'; break;
+		case 'b': value += '\b'; break;
+		case 'f': value += '\f'; break;
+		case 'v': value += '\v'; break;
+		case 'x':
+		{
+			int byte = 0;
+			while( ((pos + 1u) < text.size()) && (HexDigit(text[pos + 1u]) >= 0) )
+			{
+				byte = (byte << 4) | HexDigit(text[++pos]);
+			}
+			value += (char)byte;
+			break;
+		}
+		default:
+			if( (c >= '0') && (c <= '7') )
+			{
+				int byte = c - '0';
+				for( int i = 0; (i < 2) && ((pos + 1u) < text.size()) && (text[pos + 1u] >= '0') && (text[pos + 1u] <= '7'); i++ )
+				{
+					byte = (byte << 3) | (text[++pos] - '0');
+				}
+				value += (char)byte;
+			}
+			else
+			{
+				value += c;
+			}
+			break;
+		}
+	}
+	return pos + 1u;
+}
+
+static std::string Escape(const std::string &value)
+{
+	std::string out;
+	char hex[8];
+	for( size_t i = 0; i < value.size(); i++ )
+	{
+		uint8_t c = (uint8_t)value[i];
+		switch( c )
+		{
+		case '\n': out += "\\n"; break;
+		case '\t': out += "\\t"; break;
+		case '\r': out += "\\r"; break;
+		case '\\': out += "\\\\"; break;
+		case '"': out += "\\\""; break;
+		default:
+			if( (c < 0x20u) || (c >= 0x7Fu) )
+			{
+				// Octal, a hex escape would swallow following hex digits
+				snprintf(hex, sizeof(hex), "\\%03o", c);
+				out += hex;
+			}
+			else
+			{
+				out += (char)c;
+			}
+			break;
+		}
+	}
+	return out;
+}
+
+static int Table(int count, char **files)
+{
+	static const char *call = "printf_deferred";
+	std::map<uint32_t, std::string> table;
+	bool collision = false;
+
+	for( int f = 0; f < count; f++ )
+	{
+		std::string text;
+		if( !ReadFile(files[f], text) )
+			return 2;
+
+		// Calls outside comments and literals, followed by '(' and a literal (skips the macro definition)
+		for( size_t pos = 0; pos < text.size(); )
+		{
+			if( text.compare(pos, 2, "//") == 0 )
+			{
+				pos = text.find('\n', pos);
+				continue;
+			}
+			if( text.compare(pos, 2, "/*") == 0 )
+			{
+				pos = text.find("*/", pos + 2u);
+				pos = (pos == std::string::npos) ? pos : (pos + 2u);
+				continue;
+			}
+			if( text[pos] == '"' )
+			{
+				std::string skipped;
+				pos = ParseLiteral(text, pos, skipped);
+				continue;
+			}
+			if( text[pos] == '\'' )
+			{
+				for( pos++; (pos < text.size()) && (text[pos] != '\''); pos++ )
+				{
+					if( text[pos] == '\\' )
+						pos++;
+				}
+				pos++;
+				continue;
+			}
+			if( !isalpha((unsigned char)text[pos]) && (text[pos] != '_') )
+			{
+				pos++;
+				continue;
+			}
+
+			size_t at = pos;
+			while( (at < text.size()) && (isalnum((unsigned char)text[at]) || (text[at] == '_')) )
+				at++;
+			bool isCall = (text.compare(pos, at - pos, call) == 0) && ((at - pos) == strlen(call));
+			pos = at;
+			if( !isCall )
+				continue;
+
+			while( (at < text.size()) && isspace((unsigned char)text[at]) )
+				at++;
+			if( (at >= text.size()) || (text[at] != '(') )
+				continue;
+
+			// Adjacent literals are one string
+			std::string format;
+			bool literal = false;
+			for( at++; at < text.size(); )
+			{
+				while( (at < text.size()) && isspace((unsigned char)text[at]) )
+					at++;
+				if( (at >= text.size()) || (text[at] != '"') )
+					break;
+				at = ParseLiteral(text, at, format);
+				literal = true;
+			}
+			if( !literal )
+				continue;
+			pos = at;
+
+			uint32_t id = FormatId(format);
+			std::map<uint32_t, std::string>::iterator known = table.find(id);
+			if( (known != table.end()) && (known->second != format) )
+			{
+				fprintf(stderr, "%s: id %08x of \"%s\" is also \"%s\", change one of them\n", files[f], id, Escape(format).c_str(), Escape(known->second).c_str());
+				collision = true;
+			}
+			table[id] = format;
+		}
+	}
+
+	for( std::map<uint32_t, std::string>::iterator it = table.begin(); it != table.end(); ++it )
+	{
+		printf("%08x\t%s\n", it->first, Escape(it->second).c_str());
+	}
+	return collision ? 1 : 0;
+}
+
+typedef struct
+{
+	uint8_t Tag;
+	uint64_t Bits;			/* integer and pointer values, zero extended */
+	double Float;
+	std::string Text;
+} Argument;
+
+static bool ReadArguments(const std::vector<uint8_t> &record, std::vector<Argument> &args)
+{
+	for( size_t pos = 5u; pos < record.size(); )
+	{
+		Argument arg;
+		arg.Tag = record[pos++];
+		arg.Bits = 0;
+		arg.Float = 0.0;
+
+		uint8_t size = arg.Tag & 0x0Fu;
+		if( (arg.Tag & 0xF0u) == 0x40u )
+		{
+			if( pos >= record.size() )
+				return false;
+			size = record[pos++];
+			if( (pos + size) > record.size() )
+				return false;
+			arg.Text.assign((const char *)&record[pos], size);
+		}
+		else
+		{
+			if( (size == 0u) || (size > 8u) || ((pos + size) > record.size()) )
+				return false;
+			for( uint8_t i = 0; i < size; i++ )
+			{
+				arg.Bits |= (uint64_t)record[pos + i] << (8u * i);
+			}
+			if( (arg.Tag & 0xF0u) == 0x30u )
+			{
+				if( size == 4u )
+				{
+					float value;
+					uint32_t bits = (uint32_t)arg.Bits;
+					memcpy(&value, &bits, sizeof(value));
+					arg.Float = value;
+				}
+				else
+				{
+					memcpy(&arg.Float, &arg.Bits, sizeof(arg.Float));
+				}
+			}
+		}
+		pos += size;
+		args.push_back(arg);
+	}
+	return true;
+}
+
+static long long Signed(const Argument &arg)
+{
+	uint8_t bits = (uint8_t)((arg.Tag & 0x0Fu) * 8u);
+	if( ((arg.Tag & 0xF0u) == 0x10u) && (bits < 64u) && (arg.Bits & (1ull << (bits - 1u))) )
+		return (long long)(arg.Bits | (~0ull << bits));
+	if( (arg.Tag & 0xF0u) == 0x30u )
+		return (long long)arg.Float;
+	return (long long)arg.Bits;
+}
+
+/* Formats like the device printf would have, one conversion at a time with the host snprintf */
+static std::string Format(const std::string &format, const std::vector<Argument> &args)
+{
+	std::string out;
+	size_t next = 0;
+	char buffer[512];
+
+	for( size_t i = 0; i < format.size(); i++ )
+	{
+		if( format[i] != '%' )
+		{
+			out += format[i];
+			continue;
+		}
+		if( ((i + 1u) < format.size()) && (format[i + 1u] == '%') )
+		{
+			out += '%';
+			i++;
+			continue;
+		}
+
+		// Flags, width and precision are kept, '*' takes its value from the arguments
+		std::string spec = "%";
+		for( i++; (i < format.size()) && strchr("-+ #0", format[i]); i++ )
+			spec += format[i];
+		for( ; (i < format.size()) && (isdigit((unsigned char)format[i]) || (format[i] == '.') || (format[i] == '*')); i++ )
+		{
+			if( format[i] == '*' )
+				spec += std::to_string((next < args.size()) ? Signed(args[next++]) : 0);
+			else
+				spec += format[i];
+		}
+		// Length modifiers are replaced by the size the value actually has
+		while( (i < format.size()) && strchr("hljztL", format[i]) )
+			i++;
+		if( i >= format.size() )
+			break;
+
+		char conversion = format[i];
+		if( next >= args.size() )
+		{
+			out += '?';
+			continue;
+		}
+		const Argument &arg = args[next++];
+
+		switch( conversion )
+		{
+		case 'd':
+		case 'i':
+			snprintf(buffer, sizeof(buffer), (spec + "lld").c_str(), Signed(arg));
+			break;
+		case 'u':
+		case 'x':
+		case 'X':
+		case 'o':
+			snprintf(buffer, sizeof(buffer), (spec + "ll" + conversion).c_str(), (unsigned long long)(((arg.Tag & 0xF0u) == 0x10u) ? (uint64_t)Signed(arg) & (~0ull >> (64u - (arg.Tag & 0x0Fu) * 8u)) : arg.Bits));
+			break;
+		case 'b':
+		{
+			std::string bits;
+			for( uint64_t value = arg.Bits; value != 0u; value >>= 1 )
+				bits.insert(bits.begin(), (char)('0' + (value & 1u)));
+			snprintf(buffer, sizeof(buffer), (spec + "s").c_str(), bits.empty() ? "0" : bits.c_str());
+			break;
+		}
+		case 'c':
+			snprintf(buffer, sizeof(buffer), (spec + "c").c_str(), (int)Signed(arg));
+			break;
+		case 'f':
+		case 'F':
+		case 'e':
+		case 'E':
+		case 'g':
+		case 'G':
+			snprintf(buffer, sizeof(buffer), (spec + conversion).c_str(), ((arg.Tag & 0xF0u) == 0x30u) ? arg.Float : (double)Signed(arg));
+			break;
+		case 's':
+			snprintf(buffer, sizeof(buffer), (spec + "s").c_str(), arg.Text.c_str());
+			break;
+		case 'p':
+			snprintf(buffer, sizeof(buffer), "%0*llX", (int)((arg.Tag & 0x0Fu) * 2u), (unsigned long long)arg.Bits);
+			break;
+		default:
+			snprintf(buffer, sizeof(buffer), "%%%c", conversion);
+			break;
+		}
+		out += buffer;
+	}
+	return out;
+}
+
+static bool LoadTable(const char *name, std::map<uint32_t, std::string> &table)
+{
+	std::string text;
+	if( !ReadFile(name, text) )
+		return false;
+
+	for( size_t pos = 0; pos < text.size(); )
+	{
+		size_t end = text.find('\n', pos);
+		if( end == std::string::npos )
+			end = text.size();
+		std::string line = text.substr(pos, end - pos);
+		pos = end + 1u;
+
+		size_t tab = line.find('\t');
+		if( tab == std::string::npos )
+			continue;
+		// The escaped format is a literal without its quotes
+		std::string quoted = "\"" + line.substr(tab + 1u) + "\"";
+		std::string format;
+		ParseLiteral(quoted, 0, format);
+		table[(uint32_t)strtoul(line.substr(0, tab).c_str(), nullptr, 16)] = format;
+	}
+	return true;
+}
+
+static int Decode(const char *tableName, const char *inName)
+{
+	std::map<uint32_t, std::string> table;
+	if( !LoadTable(tableName, table) )
+		return 2;
+
+	FILE *in = (inName != nullptr) ? fopen(inName, "rb") : stdin;
+	if( in == nullptr )
+	{
+		perror(inName);
+		return 2;
+	}
+
+	CobsDecoder decoder;
+	std::vector<uint8_t> record;
+	unsigned long lines = 0, unknown = 0, corrupt = 0;
+	bool synced = false;
+	int c;
+
+	while( (c = fgetc(in)) != EOF )
+	{
+		uint8_t decoded = 0;
+
+		if( !synced )
+		{
+			synced = (c == 0x00);
+			continue;
+		}
+
+		switch( decoder.Push((uint8_t)c, decoded) )
+		{
+		case CobsDecoder::DATA:
+			record.push_back(decoded);
+			break;
+
+		case CobsDecoder::FRAME:
+		{
+			record.resize(record.size() - 2u);
+			std::vector<Argument> args;
+			uint32_t id = 0;
+			if( (record.size() >= 5u) && (record[0] == 'P') )
+				id = (uint32_t)record[1] | ((uint32_t)record[2] << 8) | ((uint32_t)record[3] << 16) | ((uint32_t)record[4] << 24);
+
+			std::map<uint32_t, std::string>::iterator format = table.find(id);
+			if( (record.size() < 5u) || (record[0] != 'P') )
+			{
+				printf("<frame, %u bytes>\n", (unsigned)record.size());
+			}
+			else if( (format == table.end()) || !ReadArguments(record, args) )
+			{
+				printf("<unknown format %08x, %u bytes>\n", id, (unsigned)record.size());
+				unknown++;
+			}
+			else
+			{
+				fputs(Format(format->second, args).c_str(), stdout);
+				lines++;
+			}
+			record.clear();
+			break;
+		}
+
+		case CobsDecoder::CORRUPT:
+			printf("<corrupt frame>\n");
+			corrupt++;
+			record.clear();
+			break;
+
+		default:
+			break;
+		}
+	}
+
+	fprintf(stderr, "%lu log records, %lu unknown, %lu corrupt\n", lines, unknown, corrupt);
+	if( in != stdin )
+		fclose(in);
+	return ((unknown == 0u) && (corrupt == 0u)) ? 0 : 1;
+}
+
+int main(int argc, char **argv)
+{
+	if( (argc >= 3) && (strcmp(argv[1], "table") == 0) )
+		return Table(argc - 2, &argv[2]);
+	if( ((argc == 3) || (argc == 4)) && (strcmp(argv[1], "decode") == 0) )
+		return Decode(argv[2], (argc == 4) ? argv[3] : nullptr);
+
+	fprintf(stderr, "usage: %s table <sources...> > strings.tab\n       %s decode strings.tab [capture.bin]\n", argv[0], argv[0]);
+	return 2;
+}
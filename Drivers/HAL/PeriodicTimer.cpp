@@ -0,0 +1,151 @@
+/*
+ * PeriodicTimer.cpp
+ */
+
+#include "PeriodicTimer.h"
+
+#if defined(DRIVERS_HOST)
+	#define PERIODIC_TIMER_BACKEND_HOST
+#elif defined(__AVR__) && (PERIODIC_TIMER_USE_TIMER2 == 1) && defined(TIMER2_COMPA_vect)
+	#define PERIODIC_TIMER_BACKEND_AVR_TIMER2
+
+	/* CPU clocks per tick and the smallest Timer2 prescaler that counts them in 8 bits */
+	#define PERIODIC_TIMER_CLOCKS		((uint64_t)F_CPU * PERIODIC_TIMER_TICK_US / 1000000u)
+	#define PERIODIC_TIMER_PRESCALER	((PERIODIC_TIMER_CLOCKS <= 256u) ? 1u : (PERIODIC_TIMER_CLOCKS <= 2048u) ? 8u : \
+										 (PERIODIC_TIMER_CLOCKS <= 8192u) ? 32u : (PERIODIC_TIMER_CLOCKS <= 16384u) ? 64u : \
+										 (PERIODIC_TIMER_CLOCKS <= 32768u) ? 128u : (PERIODIC_TIMER_CLOCKS <= 65536u) ? 256u : 1024u)
+	#define PERIODIC_TIMER_COUNTS		(PERIODIC_TIMER_CLOCKS / PERIODIC_TIMER_PRESCALER)
+	#define PERIODIC_TIMER_CS_BITS		((PERIODIC_TIMER_PRESCALER == 1u) ? _BV(CS20) : (PERIODIC_TIMER_PRESCALER == 8u) ? _BV(CS21) : \
+										 (PERIODIC_TIMER_PRESCALER == 32u) ? (_BV(CS21) | _BV(CS20)) : (PERIODIC_TIMER_PRESCALER == 64u) ? _BV(CS22) : \
+										 (PERIODIC_TIMER_PRESCALER == 128u) ? (_BV(CS22) | _BV(CS20)) : (PERIODIC_TIMER_PRESCALER == 256u) ? (_BV(CS22) | _BV(CS21)) : \
+										 (_BV(CS22) | _BV(CS21) | _BV(CS20)))
+	static_assert((PERIODIC_TIMER_COUNTS >= 1u) && (PERIODIC_TIMER_COUNTS <= 256u), "PeriodicTimer: tick out of the Timer2 range at this F_CPU");
+	static_assert((((uint64_t)F_CPU * PERIODIC_TIMER_TICK_US) % ((uint64_t)PERIODIC_TIMER_PRESCALER * 1000000u)) == 0u, "PeriodicTimer: tick is not a whole number of Timer2 counts at this F_CPU");
+#endif
+
+namespace Drivers
+{
+	namespace PeriodicTimer
+	{
+		typedef struct
+		{
+			Callback Function;
+			void *Arg;
+			uint16_t Period;
+			uint16_t Countdown;
+		} Client;
+
+		static Client _Clients[PERIODIC_TIMER_MAX_CALLBACKS];
+		static uint8_t _Attached = 0;
+
+		static void _Tick()
+		{
+			for( uint8_t i = 0; i < PERIODIC_TIMER_MAX_CALLBACKS; i++ )
+			{
+				Client &client = _Clients[i];
+				if( (client.Function != nullptr) && (--client.Countdown == 0u) )
+				{
+					client.Countdown = client.Period;
+					client.Function(client.Arg);
+				}
+			}
+		}
+
+		static void _Start()
+		{
+#if defined(PERIODIC_TIMER_BACKEND_HOST)
+			HostSim::SetTimerInterrupt(PERIODIC_TIMER_TICK_US * 1000u, _Tick);
+#elif defined(PERIODIC_TIMER_BACKEND_AVR_TIMER2)
+			{
+				Vfb_CriticalSection cs;
+				TCCR2A = _BV(WGM21);						// CTC
+				TCCR2B = PERIODIC_TIMER_CS_BITS;
+				OCR2A = (uint8_t)(PERIODIC_TIMER_COUNTS - 1u);
+				TCNT2 = 0;
+				TIFR2 = _BV(OCF2A);
+				TIMSK2 = _BV(OCIE2A);
+			}
+#endif
+		}
+
+		static void _Stop()
+		{
+#if defined(PERIODIC_TIMER_BACKEND_HOST)
+			HostSim::SetTimerInterrupt(0, nullptr);
+#elif defined(PERIODIC_TIMER_BACKEND_AVR_TIMER2)
+			TIMSK2 &= (uint8_t)~_BV(OCIE2A);
+#endif
+		}
+
+		bool IsAvailable()
+		{
+#if defined(PERIODIC_TIMER_BACKEND_HOST) || defined(PERIODIC_TIMER_BACKEND_AVR_TIMER2)
+			return true;
+#else
+			return false;
+#endif
+		}
+
+		int8_t Attach(Callback Function, void *Arg, uint16_t PeriodTicks)
+		{
+			if( !IsAvailable() || (Function == nullptr) || (PeriodTicks == 0u) )
+			{
+				return INVALID_HANDLE;
+			}
+
+			for( uint8_t i = 0; i < PERIODIC_TIMER_MAX_CALLBACKS; i++ )
+			{
+				if( _Clients[i].Function == nullptr )
+				{
+					{
+						Vfb_CriticalSection cs;
+						_Clients[i].Arg = Arg;
+						_Clients[i].Period = PeriodTicks;
+						_Clients[i].Countdown = PeriodTicks;
+						_Clients[i].Function = Function;
+					}
+
+#if defined(PERIODIC_TIMER_BACKEND_HOST)
+					/* HostSim::Reset() drops the timer interrupt, arm it again on every attach */
+					_Attached++;
+					_Start();
+#else
+					if( _Attached++ == 0u )
+					{
+						_Start();
+					}
+#endif
+					return (int8_t)i;
+				}
+			}
+
+			return INVALID_HANDLE;
+		}
+
+		void Detach(int8_t Handle)
+		{
+			if( (Handle < 0) || ((uint8_t)Handle >= PERIODIC_TIMER_MAX_CALLBACKS) || (_Clients[Handle].Function == nullptr) )
+			{
+				return;
+			}
+
+			{
+				Vfb_CriticalSection cs;
+				_Clients[Handle].Function = nullptr;
+			}
+
+			if( --_Attached == 0u )
+			{
+				_Stop();
+			}
+		}
+	}
+
+} /* namespace Drivers */
+
+#if defined(PERIODIC_TIMER_BACKEND_AVR_TIMER2)
+ISR(TIMER2_COMPA_vect)
+{
+	Drivers::PeriodicTimer::_Tick();
+}
+#endif
@@ -0,0 +1,60 @@
+/*
+ * PeriodicTimer.h
+ *
+ *  One hardware timer tick shared by the drivers that need work done from interrupt context
+ *  at a fixed rate (SerialAsync TX refill, display refresh, ...). Each client attaches a
+ *  callback with its own period in ticks; callbacks run inside the timer ISR, so they must be
+ *  short and only touch interrupt-safe state.
+ *
+ *  Backends:
+ *   - DRIVERS_HOST: HostSim timer interrupt, fires in virtual time
+ *   - AVR with PERIODIC_TIMER_USE_TIMER2 == 1: Timer2 in CTC mode. Opt-in because Timer2 is
+ *     also used by tone() and by analogWrite() on pins 3 and 11 of the UNO
+ *   - anything else: no timer, Attach() fails and drivers stay in polling mode
+ */
+
+#ifndef PERIODIC_TIMER_H
+#define PERIODIC_TIMER_H
+
+#include "HAL.h"
+
+/* Timer tick. On AVR Timer2 it must be a whole number of prescaled clocks, at most 256 of them with
+ * the 1024 prescaler (e.g. multiples of 0.5us up to 16.3ms at 16MHz) */
+#ifndef PERIODIC_TIMER_TICK_US
+	#define PERIODIC_TIMER_TICK_US			100u
+#endif
+
+#ifndef PERIODIC_TIMER_MAX_CALLBACKS
+	#define PERIODIC_TIMER_MAX_CALLBACKS	4u
+#endif
+
+#ifndef PERIODIC_TIMER_USE_TIMER2
+	#define PERIODIC_TIMER_USE_TIMER2		0
+#endif
+
+namespace Drivers
+{
+	namespace PeriodicTimer
+	{
+		typedef void (*Callback)(void *Arg);
+
+		static const int8_t INVALID_HANDLE = -1;
+
+		/* Calls Function(Arg) every PeriodTicks ticks from the timer ISR, starts the timer with the first client */
+		int8_t Attach(Callback Function, void *Arg, uint16_t PeriodTicks);
+		/* Stops the timer with the last client */
+		void Detach(int8_t Handle);
+
+		/* False when the build has no timer backend */
+		bool IsAvailable();
+
+		inline uint16_t UsToTicks(uint32_t Us)
+		{
+			uint32_t ticks = Us / PERIODIC_TIMER_TICK_US;
+			return (ticks == 0u) ? 1u : ((ticks > 0xFFFFu) ? 0xFFFFu : (uint16_t)ticks);
+		}
+	}
+
+} /* namespace Drivers */
+
+#endif /* PERIODIC_TIMER_H */
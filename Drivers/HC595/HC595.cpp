@@ -9,41 +9,188 @@
 
 namespace Drivers
 {
-	HC595::HC595(uint8_t ClockPin, uint8_t DataPin, uint8_t LatchPin, uint8_t RegNo) : _ClockPin(ClockPin, OUTPUT), _DataPin(DataPin, OUTPUT), _LatchPin(LatchPin, OUTPUT), _RegsNo(RegNo)
+	HC595Base::HC595Base(uint16_t RegNo, uint32_t *Storage) : _RegsNo(RegNo)
 	{
-		this->_Buffer = (uint8_t *)malloc(this->_RegsNo*sizeof(uint8_t));
+		/* Buffer, shadow and dirty bits in one block */
+		this->_WordsNo = (uint16_t)((this->_RegsNo + 3u) / 4u);
+		if( Storage == nullptr )
+		{
+			Storage = (uint32_t *)malloc(HC595_STORAGE_WORDS(this->_RegsNo) * sizeof(uint32_t));
+			this->_OwnsStorage = true;
+		}
+		memset(Storage, 0, HC595_STORAGE_WORDS(this->_RegsNo) * sizeof(uint32_t));
+		this->_Buffer = Storage;
+		this->_Shadow = this->_Buffer + this->_WordsNo;
+		this->_Dirty = this->_Shadow + this->_WordsNo;
+	}
+
+	HC595Base::~HC595Base()
+	{
+		this->EnableRefreshInterrupt(false);
+		if( this->_OwnsStorage )
+		{
+			free(this->_Buffer);
+		}
+	}
+
+	void HC595Base::MainFunction()
+	{
+		if( this->IsRefreshInterruptEnabled() )
+			return;
+
+		if( this->_Swap() )
+			this->ShiftOut();
+	}
+
+	void HC595Base::BeginUpdate()
+	{
+		Vfb_CriticalSection cs;
+		this->_Updating++;
+	}
+
+	void HC595Base::EndUpdate()
+	{
+		Vfb_CriticalSection cs;
+		if( this->_Updating > 0u )
+			this->_Updating--;
+	}
+
+	void HC595Base::Invalidate()
+	{
+		this->_Stale = true;
+	}
+
+	bool HC595Base::EnableRefreshInterrupt(bool Enable, uint32_t PeriodUs)
+	{
+		if( !Enable )
+		{
+			PeriodicTimer::Detach(this->_RefreshTimer);
+			this->_RefreshTimer = PeriodicTimer::INVALID_HANDLE;
+			return true;
+		}
+
+		if( this->IsRefreshInterruptEnabled() )
+			return true;
+
+		this->_RefreshTimer = PeriodicTimer::Attach(RefreshInterruptHandler, this, PeriodicTimer::UsToTicks(PeriodUs));
+
+		return this->IsRefreshInterruptEnabled();
+	}
+
+	void HC595Base::RefreshInterruptHandler(void *Arg)
+	{
+		HC595Base *self = (HC595Base *)Arg;
+
+		if( self->_Swap() )
+			self->ShiftOut();
 	}
 
-	HC595::~HC595()
+	void HC595Base::_MarkDirty(uint16_t Word)
 	{
-		free(this->_Buffer);
+		/* Also orders the buffer write before the flag, the refresh may run from an ISR */
+		Vfb_CriticalSection cs;
+		this->_Dirty[Word >> 5] |= (uint32_t)1u << (Word & 31u);
 	}
 
-	void HC595::SetAll()
+	void HC595Base::_MarkDirty(uint16_t FirstWord, uint16_t LastWord)
 	{
-		for(uint8_t i = 0; i < this->_RegsNo; i++)
+		Vfb_CriticalSection cs;
+		for(uint16_t word = FirstWord; word <= LastWord; word++)
 		{
-			this->_Buffer[i] = 0xFF;
+			this->_Dirty[word >> 5] |= (uint32_t)1u << (word & 31u);
 		}
 	}
 
-	void HC595::ClearAll()
+	bool HC595Base::_CheckRange(uint32_t First, uint32_t Count)
 	{
-		for(uint8_t i = 0; i < this->_RegsNo; i++)
+		if( (First > (uint32_t)this->_RegsNo * 8u) || (Count > (uint32_t)this->_RegsNo * 8u - First) )
 		{
-			this->_Buffer[i] = 0x00;
+			#if HC595_DEBUG_ENABLED ==1
+				ERR_PRINT("[ERR][HC595] Invalid bit range: ");
+				ERR_PRINT(First);
+				ERR_PRINT(" + ");
+				ERR_PRINTLN(Count);
+			#endif
+			return false;
 		}
+		return true;
 	}
 
-	void HC595::ToggleAll()
+	/* Op: 0 clear, 1 set, 2 toggle. One masked operation per word */
+	void HC595Base::_ApplyRange(uint32_t First, uint32_t Count, uint8_t Op)
 	{
-		for(uint8_t i = 0; i < this->_RegsNo; i++)
+		if( (Count == 0u) || !this->_CheckRange(First, Count) )
+			return;
+
+		uint32_t last = First + Count - 1u;
+		uint16_t firstWord = (uint16_t)(First >> 5), lastWord = (uint16_t)(last >> 5);
+		for(uint16_t word = firstWord; word <= lastWord; word++)
 		{
-			this->_Buffer[i] = ~this->_Buffer[i];
+			uint32_t mask = 0xFFFFFFFFu;
+			if( word == firstWord )
+				mask &= 0xFFFFFFFFu << (First & 31u);
+			if( word == lastWord )
+				mask &= 0xFFFFFFFFu >> (31u - (last & 31u));
+
+			if( Op == 0u )
+				this->_Buffer[word] &= ~mask;
+			else if( Op == 1u )
+				this->_Buffer[word] |= mask;
+			else
+				this->_Buffer[word] ^= mask;
 		}
+		this->_MarkDirty(firstWord, lastWord);
+	}
+
+	/* Double buffering: copy the words written since the last call into the shadow frame, in
+	 * one critical section so the refresh never sees half of an update. Returns false when the
+	 * latched frame would not change. */
+	bool HC595Base::_Swap()
+	{
+		bool changed;
+
+		Vfb_CriticalSection cs;
+		if( this->_Updating > 0u )
+			return false;
+
+		changed = this->_Stale;
+		this->_Stale = false;
+		for(uint16_t first = 0; first < this->_WordsNo; first += 32u)
+		{
+			uint32_t dirty = this->_Dirty[first >> 5];
+			if( dirty == 0u )
+				continue;
+
+			this->_Dirty[first >> 5] = 0;
+			for(uint16_t word = first; (dirty != 0u) && (word < this->_WordsNo); word++, dirty >>= 1)
+			{
+				if( (dirty & 1u) && (this->_Shadow[word] != this->_Buffer[word]) )
+				{
+					this->_Shadow[word] = this->_Buffer[word];
+					changed = true;
+				}
+			}
+		}
+
+		return changed;
 	}
 
-	void HC595::WriteRaw(uint8_t *Data, uint8_t len)
+	void HC595Base::SetAll()
+	{
+		this->_ApplyRange(0, (uint32_t)this->_RegsNo * 8u, 1u);
+	}
+
+	void HC595Base::ClearAll()
+	{
+		this->_ApplyRange(0, (uint32_t)this->_RegsNo * 8u, 0u);
+	}
+
+	void HC595Base::ToggleAll()
+	{
+		this->_ApplyRange(0, (uint32_t)this->_RegsNo * 8u, 2u);
+	}
+
+	void HC595Base::WriteRaw(const uint8_t *Data, uint16_t len)
 	{
 		if(len > this->_RegsNo)
 		{
@@ -53,14 +200,19 @@ namespace Drivers
 			#endif
 			return;
 		}
+		if(len == 0)
+		{
+			return;
+		}
 
-		for(uint8_t i = 0; i < this->_RegsNo; i++)
+		for(uint16_t i = 0; i < len; i++)
 		{
-			this->_Buffer[i] = Data[i];
+			_Reg(this->_Buffer, i) = Data[i];
 		}
+		this->_MarkDirty(0, (uint16_t)((len - 1u) / 4u));
 	}
 
-	void HC595::SetBit(uint8_t bit, uint8_t RegIndex)
+	void HC595Base::SetBit(uint8_t bit, uint16_t RegIndex)
 	{
 		if(RegIndex >= this->_RegsNo || (uint8_t)bit >= 8)
 		{
@@ -73,10 +225,11 @@ namespace Drivers
 
 
 		//DBG_PRINTLN("reg[" + String(RegIndex) + "][" + String(bit) + "] = 1");
-		this->_Buffer[RegIndex] |= (1 << (uint8_t)bit);
+		_Reg(this->_Buffer, RegIndex) |= (1 << (uint8_t)bit);
+		this->_MarkDirty((uint16_t)(RegIndex >> 2));
 	}
 
-	void HC595::ClearBit(uint8_t bit, uint8_t RegIndex)
+	void HC595Base::ClearBit(uint8_t bit, uint16_t RegIndex)
 	{
 		if(RegIndex >= this->_RegsNo || (uint8_t)bit >= 8)
 		{
@@ -88,10 +241,11 @@ namespace Drivers
 		}
 
 		//DBG_PRINTLN("reg[" + String(RegIndex) + "][" + String(bit) + "] = 0");
-		this->_Buffer[RegIndex] &= (~(1 << (uint8_t)bit));
+		_Reg(this->_Buffer, RegIndex) &= (~(1 << (uint8_t)bit));
+		this->_MarkDirty((uint16_t)(RegIndex >> 2));
 	}
 
-	void HC595::ToggleBit(uint8_t bit, uint8_t RegIndex)
+	void HC595Base::ToggleBit(uint8_t bit, uint16_t RegIndex)
 	{
 		if(RegIndex >= this->_RegsNo || (uint8_t)bit >= 8)
 		{
@@ -101,10 +255,11 @@ namespace Drivers
 			#endif
 			return;
 		}
-		this->_Buffer[RegIndex] ^= (1 << (uint8_t)bit);
+		_Reg(this->_Buffer, RegIndex) ^= (1 << (uint8_t)bit);
+		this->_MarkDirty((uint16_t)(RegIndex >> 2));
 	}
 
-	void HC595::WriteBit(uint8_t bit, uint8_t value, uint8_t RegIdx)
+	void HC595Base::WriteBit(uint8_t bit, uint8_t value, uint16_t RegIdx)
 	{
 		if(RegIdx >= this->_RegsNo || (uint8_t)bit >= 8)
 		{
@@ -124,7 +279,7 @@ namespace Drivers
 		}
 	}
 
-	void HC595::WriteByte(uint8_t Byte, uint8_t RegIndex)
+	void HC595Base::WriteByte(uint8_t Byte, uint16_t RegIndex)
 	{
 		if(RegIndex >= this->_RegsNo)
 		{
@@ -134,10 +289,11 @@ namespace Drivers
 			#endif
 			return;
 		}
-		this->_Buffer[RegIndex] = Byte;
+		_Reg(this->_Buffer, RegIndex) = Byte;
+		this->_MarkDirty((uint16_t)(RegIndex >> 2));
 	}
 
-	void HC595::ToggleByte(uint8_t RegIdx)
+	void HC595Base::ToggleByte(uint16_t RegIdx)
 	{
 		if(RegIdx >= this->_RegsNo)
 		{
@@ -148,10 +304,11 @@ namespace Drivers
 			return;
 		}
 
-		this->_Buffer[RegIdx] = ~this->_Buffer[RegIdx];
+		_Reg(this->_Buffer, RegIdx) = ~_Reg(this->_Buffer, RegIdx);
+		this->_MarkDirty((uint16_t)(RegIdx >> 2));
 	}
 
-	void HC595::ClearByte(uint8_t RegIdx)
+	void HC595Base::ClearByte(uint16_t RegIdx)
 	{
 		if(RegIdx >= this->_RegsNo)
 		{
@@ -162,10 +319,11 @@ namespace Drivers
 			return;
 		}
 
-		this->_Buffer[RegIdx] = 0x00;
+		_Reg(this->_Buffer, RegIdx) = 0x00;
+		this->_MarkDirty((uint16_t)(RegIdx >> 2));
 	}
 
-	void HC595::SetByte(uint8_t RegIdx)
+	void HC595Base::SetByte(uint16_t RegIdx)
 	{
 		if(RegIdx >= this->_RegsNo)
 		{
@@ -176,14 +334,100 @@ namespace Drivers
 			return;
 		}
 
-		this->_Buffer[RegIdx] = 0xFF;
+		_Reg(this->_Buffer, RegIdx) = 0xFF;
+		this->_MarkDirty((uint16_t)(RegIdx >> 2));
+	}
+
+	void HC595Base::SetRange(uint32_t First, uint32_t Count)
+	{
+		this->_ApplyRange(First, Count, 1u);
+	}
+
+	void HC595Base::ClearRange(uint32_t First, uint32_t Count)
+	{
+		this->_ApplyRange(First, Count, 0u);
+	}
+
+	void HC595Base::ToggleRange(uint32_t First, uint32_t Count)
+	{
+		this->_ApplyRange(First, Count, 2u);
+	}
+
+	void HC595Base::WriteField(uint32_t BitOffset, uint8_t Width, uint32_t Value)
+	{
+		if( (Width == 0u) || (Width > 32u) || !this->_CheckRange(BitOffset, Width) )
+			return;
+
+		uint16_t word = (uint16_t)(BitOffset >> 5);
+		uint8_t shift = (uint8_t)(BitOffset & 31u);
+		uint32_t mask = (Width == 32u) ? 0xFFFFFFFFu : (((uint32_t)1u << Width) - 1u);
+
+		Value &= mask;
+		this->_Buffer[word] = (this->_Buffer[word] & ~(mask << shift)) | (Value << shift);
+		/* Field crosses into the next word */
+		if( shift + Width > 32u )
+		{
+			this->_Buffer[word + 1u] = (this->_Buffer[word + 1u] & ~(mask >> (32u - shift))) | (Value >> (32u - shift));
+			this->_MarkDirty(word, (uint16_t)(word + 1u));
+		}
+		else
+		{
+			this->_MarkDirty(word);
+		}
+	}
+
+	uint32_t HC595Base::ReadField(uint32_t BitOffset, uint8_t Width) const
+	{
+		if( (Width == 0u) || (Width > 32u) || (BitOffset > (uint32_t)this->_RegsNo * 8u) || (Width > (uint32_t)this->_RegsNo * 8u - BitOffset) )
+			return 0;
+
+		uint16_t word = (uint16_t)(BitOffset >> 5);
+		uint8_t shift = (uint8_t)(BitOffset & 31u);
+		uint32_t mask = (Width == 32u) ? 0xFFFFFFFFu : (((uint32_t)1u << Width) - 1u);
+		uint32_t value = this->_Buffer[word] >> shift;
+
+		if( shift + Width > 32u )
+		{
+			value |= this->_Buffer[word + 1u] << (32u - shift);
+		}
+		return value & mask;
+	}
+
+	void HC595Base::WriteBitset(const uint32_t *Bits, uint32_t First, uint32_t Count)
+	{
+		if( (Count == 0u) || !this->_CheckRange(First, Count) )
+			return;
+
+		/* Aligned: whole words, only the last one masked */
+		if( (First & 31u) == 0u )
+		{
+			uint16_t word = (uint16_t)(First >> 5);
+			uint32_t whole = Count >> 5;
+			for(uint32_t i = 0; i < whole; i++)
+			{
+				this->_Buffer[word + i] = Bits[i];
+			}
+			if( (Count & 31u) != 0u )
+			{
+				uint32_t mask = ((uint32_t)1u << (Count & 31u)) - 1u;
+				this->_Buffer[word + whole] = (this->_Buffer[word + whole] & ~mask) | (Bits[whole] & mask);
+			}
+			this->_MarkDirty(word, (uint16_t)((First + Count - 1u) >> 5));
+			return;
+		}
+
+		for(uint32_t i = 0; i < Count; i += 32u)
+		{
+			uint8_t width = (Count - i >= 32u) ? 32u : (uint8_t)(Count - i);
+			this->WriteField(First + i, width, Bits[i >> 5]);
+		}
 	}
 
 #ifdef HC595_EXTENDED_FUNCTIONS
-	void HC595::SetBitNo(int bit_number)
+	void HC595Base::SetBitNo(int bit_number)
 	{
 		// Calculate on which register index this one belongs
-		uint8_t RegIndex = 0;
+		uint16_t RegIndex = 0;
 		if( bit_number > 7 )
 		{
 			RegIndex = (bit_number/8);
@@ -234,10 +478,10 @@ namespace Drivers
 			this->SetBit((uint8_t)(8 - abs(bit_number))%8, RegIndex);
 		}
 	}
-	void HC595::ClearBitNo(int bit_number)
+	void HC595Base::ClearBitNo(int bit_number)
 	{
 		// Calculate on which register index this one belongs
-		uint8_t RegIndex = 0;
+		uint16_t RegIndex = 0;
 		if( bit_number > 7 )
 		{
 			RegIndex = (bit_number/8);
@@ -289,82 +533,45 @@ namespace Drivers
 		}
 	}
 
-	void HC595::SetFirstNBits(uint8_t bits_number)
+	void HC595Base::SetFirstNBits(uint32_t bits_number)
 	{
-		// Validate bits range
-		if(bits_number > (this->_RegsNo * 8))
-		{
-			#if HC595_DEBUG_ENABLED ==1
-				ERR_PRINT("[ERR][HC595] SetFirstNBits(): Invalid bits number ");
-				ERR_PRINT(bits_number);
-				ERR_PRINT(", max  ");
-				ERR_PRINTLN(this->_RegsNo * 8);
-			#endif
-			return;
-		}
-
-
-		for( uint8_t i = 0; i < bits_number; i++ )
-		{
-			this->SetBitNo(i);
-		}
+		this->SetRange(0, bits_number);
 	}
-	void HC595::ClearFirstNBits(uint8_t bits_number)
+	void HC595Base::ClearFirstNBits(uint32_t bits_number)
 	{
-		// Validate bit range
-		if(bits_number > (this->_RegsNo * 8))
-		{
-			#if HC595_DEBUG_ENABLED ==1
-				ERR_PRINT("[ERR][HC595] ClearFirstNBits(): Invalid bits number ");
-				ERR_PRINT(bits_number);
-				ERR_PRINT(", max  ");
-				ERR_PRINTLN(this->_RegsNo * 8 - 1);
-			#endif
-			return;
-		}
-
-		for( uint8_t i = 0; i < bits_number; i++ )
-		{
-			this->ClearBitNo(i);
-		}
+		this->ClearRange(0, bits_number);
 	}
-	void HC595::SetLastNBits(uint8_t bits_number)
+	void HC595Base::SetLastNBits(uint32_t bits_number)
 	{
 		// Validate bit range
-		if(bits_number > (this->_RegsNo * 8))
+		if(bits_number > (uint32_t)this->_RegsNo * 8u)
 		{
 			#if HC595_DEBUG_ENABLED ==1
 				ERR_PRINT("[ERR][HC595] SetLastNBits(): Invalid bits number ");
 				ERR_PRINT(bits_number);
 				ERR_PRINT(", max  ");
-				ERR_PRINTLN(this->_RegsNo * 8);
+				ERR_PRINTLN((uint32_t)this->_RegsNo * 8u);
 			#endif
 			return;
 		}
 
-		for( int i = (this->_RegsNo * 8) - 1; i >= ((this->_RegsNo * 8) - bits_number); i-- )
-		{
-			this->SetBitNo(i);
-		}
+		this->SetRange((uint32_t)this->_RegsNo * 8u - bits_number, bits_number);
 	}
-	void HC595::ClearLastNBits(uint8_t bits_number)
+	void HC595Base::ClearLastNBits(uint32_t bits_number)
 	{
 		// Validate bit range
-		if(bits_number > (this->_RegsNo * 8))
+		if(bits_number > (uint32_t)this->_RegsNo * 8u)
 		{
 			#if HC595_DEBUG_ENABLED ==1
 				ERR_PRINT("[ERR][HC595] ClearLastNBits(): Invalid bits number ");
 				ERR_PRINT(bits_number);
 				ERR_PRINT(", max  ");
-				ERR_PRINTLN(this->_RegsNo * 8);
+				ERR_PRINTLN((uint32_t)this->_RegsNo * 8u);
 			#endif
 			return;
 		}
 
-		for( int i = (this->_RegsNo * 8) - 1; i >= ((this->_RegsNo * 8) - bits_number); i-- )
-		{
-			this->ClearBitNo(i);
-		}
+		this->ClearRange((uint32_t)this->_RegsNo * 8u - bits_number, bits_number);
 	}
 #endif
 
@@ -9,7 +9,9 @@
 #define HC595_H_
 
 #include "HAL.h"
-#include "GpioBase.h"
+#include "Gpio.h"
+#include "FastGpio.h"
+#include "PeriodicTimer.h"
 
 #ifndef HC595_DEBUG_MESSAGES
 	#define HC595_DEBUG_MESSAGES	1
@@ -31,6 +33,27 @@
 	#define HC595_ENDIANESS			HC595_SMALL_ENDIAN
 #endif
 
+/* Hardware SPI transport (HC595Spi). Set to 0 on boards without the SPI library,
+ * the bit-banged HC595 is always available */
+#ifndef HC595_SPI_ENABLED
+	#define HC595_SPI_ENABLED		1
+#endif
+#ifndef HC595_SPI_CLOCK
+	#define HC595_SPI_CLOCK			8000000UL
+#endif
+
+#if HC595_SPI_ENABLED == 1
+	#include <SPI.h>
+#endif
+
+/* uint32_t words of static storage for a chain of RegsNo registers, see HC595Base() */
+#define HC595_STORAGE_WORDS(RegsNo)	(2u * (((RegsNo) + 3u) / 4u) + (((RegsNo) + 3u) / 4u + 31u) / 32u)
+
+/* How often the refresh interrupt looks for a changed frame */
+#ifndef HC595_REFRESH_PERIOD_US
+	#define HC595_REFRESH_PERIOD_US	1000u
+#endif
+
 namespace Drivers
 {
 	enum class HC595Pin
@@ -45,54 +68,158 @@ namespace Drivers
 		Q_H = 7,
 	};
 
-	class HC595
+	/*
+	 * Outputs are packed in uint32_t words: bit n of the chain (output Q_(n % 8) of register n / 8)
+	 * is bit n % 32 of word n / 32. Range, field and bitset writes work on whole words, with a
+	 * single bounds check per call.
+	 */
+	class HC595Base
 	{
 	public:
-		HC595(uint8_t ClockPin, uint8_t DataPin, uint8_t LatchPin, uint8_t RegsNo = 1);
-		virtual ~HC595();
+		/* Storage: HC595_STORAGE_WORDS(RegsNo) words kept for the lifetime of the chain, e.g. a static
+		 * array for long chains without heap. Allocated when nullptr */
+		HC595Base(uint16_t RegsNo = 1, uint32_t *Storage = nullptr);
+		virtual ~HC595Base();
 
 		void SetAll();
 		void ClearAll();
 		void ToggleAll();
-		void WriteRaw(uint8_t *Data, uint8_t len);
+		void WriteRaw(const uint8_t *Data, uint16_t len);
+
+		void SetBit(uint8_t bit, uint16_t RegIdx = 0);
+		void ClearBit(uint8_t bit, uint16_t RegIdx = 0);
+		void ToggleBit(uint8_t bit, uint16_t RegIdx = 0);
+		void WriteBit(uint8_t bit, uint8_t value, uint16_t RegIdx = 0);
 
-		void SetBit(uint8_t bit, uint8_t RegIdx = 0);
-		void ClearBit(uint8_t bit, uint8_t RegIdx = 0);
-		void ToggleBit(uint8_t bit, uint8_t RegIdx = 0);
-		void WriteBit(uint8_t bit, uint8_t value, uint8_t RegIdx = 0);
+		void WriteByte(uint8_t Byte, uint16_t RegIdx = 0);
+		void ToggleByte(uint16_t RegIdx = 0);
+		void ClearByte(uint16_t RegIdx = 0);
+		void SetByte(uint16_t RegIdx = 0);
 
-		void WriteByte(uint8_t Byte, uint8_t RegIdx = 0);
-		void ToggleByte(uint8_t RegIdx = 0);
-		void ClearByte(uint8_t RegIdx = 0);
-		void SetByte(uint8_t RegIdx = 0);
+		/* Count outputs starting at chain bit First */
+		void SetRange(uint32_t First, uint32_t Count);
+		void ClearRange(uint32_t First, uint32_t Count);
+		void ToggleRange(uint32_t First, uint32_t Count);
+		/* Width (1 to 32) bits at chain bit BitOffset, least significant bit first */
+		void WriteField(uint32_t BitOffset, uint8_t Width, uint32_t Value);
+		uint32_t ReadField(uint32_t BitOffset, uint8_t Width) const;
+		/* Count bits of a packed bitset (bit i is bit i % 32 of Bits[i / 32]) to the chain from bit First */
+		void WriteBitset(const uint32_t *Bits, uint32_t First, uint32_t Count);
 
 #ifdef HC595_EXTENDED_FUNCTIONS
 		void SetBitNo(int bit_number);
 		void ClearBitNo(int bit_number);
 
-		void SetFirstNBits(uint8_t bits_number);
-		void ClearFirstNBits(uint8_t bits_number);
-		void SetLastNBits(uint8_t bits_number);
-		void ClearLastNBits(uint8_t bits_number);
+		void SetFirstNBits(uint32_t bits_number);
+		void ClearFirstNBits(uint32_t bits_number);
+		void SetLastNBits(uint32_t bits_number);
+		void ClearLastNBits(uint32_t bits_number);
 #endif
 
-		void MainFunction()
+		/* Shift out and latch the buffer if it changed since the last latch. Does nothing while
+		 * the refresh interrupt is enabled or an update is open */
+		void MainFunction();
+
+		/* Changes between BeginUpdate() and the last EndUpdate() are latched together, the frame
+		 * isn't picked up halfway (calls nest) */
+		void BeginUpdate();
+		void EndUpdate();
+		/* Latch on the next refresh even if nothing changed, e.g. after the chain lost power */
+		void Invalidate();
+
+		/*
+		 * Interrupt driven refresh: a PeriodicTimer callback looks for a changed frame every
+		 * PeriodUs and latches it, so outputs follow at a fixed rate without the main loop and
+		 * MainFunction() does nothing. Returns false when the build has no timer backend or no
+		 * free timer slot. With HC595Spi the SPI bus is then driven from the ISR, don't share it
+		 * with main loop users.
+		 */
+		bool EnableRefreshInterrupt(bool Enable, uint32_t PeriodUs = HC595_REFRESH_PERIOD_US);
+		inline bool IsRefreshInterruptEnabled() const
+		{
+			return this->_RefreshTimer != PeriodicTimer::INVALID_HANDLE;
+		}
+		static void RefreshInterruptHandler(void *Arg);
+
+		inline uint16_t GetRegsNo() const
+		{
+			return this->_RegsNo;
+		}
+
+	protected:
+		/* Shift out _Shadow and latch it */
+		virtual void ShiftOut() = 0;
+
+		/* Register RegIdx of a word buffer: byte RegIdx % 4 of word RegIdx / 4, least significant first */
+		static inline uint8_t &_Reg(uint32_t *Words, uint16_t RegIdx)
+		{
+			#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+				return ((uint8_t *)Words)[(RegIdx & ~3u) | (3u - (RegIdx & 3u))];
+			#else
+				return ((uint8_t *)Words)[RegIdx];
+			#endif
+		}
+
+		uint16_t _RegsNo = 1;
+		uint16_t _WordsNo = 1;
+		/* Buffer to store current values */
+		uint32_t *_Buffer;
+		/* Frame last latched into the chain, only touched by the refresh */
+		uint32_t *_Shadow;
+		/* One bit per word written since the last swap */
+		volatile uint32_t *_Dirty;
+		volatile uint8_t _Updating = 0;
+		volatile bool _Stale = true;
+		bool _OwnsStorage = false;
+		int8_t _RefreshTimer = PeriodicTimer::INVALID_HANDLE;
+
+	private:
+		void _MarkDirty(uint16_t Word);
+		void _MarkDirty(uint16_t FirstWord, uint16_t LastWord);
+		bool _CheckRange(uint32_t First, uint32_t Count);
+		void _ApplyRange(uint32_t First, uint32_t Count, uint8_t Op);
+		bool _Swap();
+	};
+
+	/* Bit-banged shift register chain. Pin types can be Gpio (runtime pin numbers) or
+	 * FastGpio<PinNo> (pin resolved at compile time, one store per clock edge). */
+	template<class ClockPinT, class DataPinT, class LatchPinT>
+	class HC595T : public HC595Base
+	{
+	public:
+		HC595T(const ClockPinT &ClockPin, const DataPinT &DataPin, const LatchPinT &LatchPin, uint16_t RegsNo = 1, uint32_t *Storage = nullptr) : HC595Base(RegsNo, Storage), _ClockPin(ClockPin), _DataPin(DataPin), _LatchPin(LatchPin)
+		{
+		}
+
+		/* Only usable with default constructible pins, e.g. FastGpio */
+		HC595T(uint16_t RegsNo = 1, uint32_t *Storage = nullptr) : HC595Base(RegsNo, Storage)
+		{
+		}
+
+		~HC595T()
+		{
+			this->EnableRefreshInterrupt(false);
+		}
+
+	protected:
+		void ShiftOut()
 		{
 			/* Loop through all shift registers */
 			#if (HC595_ENDIANESS == HC595_BIG_ENDIAN)
-				for(uint8_t reg = 0; reg < this->_RegsNo; reg++){
+				for(uint16_t reg = 0; reg < this->_RegsNo; reg++){
 			#else
-				static uint8_t reg;
-				for(uint8_t tmpReg = (this->_RegsNo); tmpReg > 0; tmpReg--) {
+				uint16_t reg;
+				for(uint16_t tmpReg = (this->_RegsNo); tmpReg > 0; tmpReg--) {
 				reg = tmpReg-1;
 			#endif
+				uint8_t value = _Reg(this->_Shadow, reg);
 				/* Loop through all bits from current shift register */
 				for (int bit = 0; bit < 8; bit++)
 				{
 					#if HC595_BIT_SHIFT_ORDER == MSBFIRST
-						this->_DataPin.Write(!!(this->_Buffer[reg] & (1 << (7 - bit))));
+						this->_DataPin.Write(!!(value & (1 << (7 - bit))));
 					#else
-						this->_DataPin.Write(!!(this->_Buffer[reg] & (1 << bit)));
+						this->_DataPin.Write(!!(value & (1 << bit)));
 					#endif
 
 					this->_ClockPin.Set();
@@ -107,12 +234,79 @@ namespace Drivers
 		}
 
 	private:
-		GpioBase _ClockPin, _DataPin, _LatchPin;
-		uint8_t _RegsNo = 1;
-		/* Buffer to store current values */
-		uint8_t *_Buffer;
+		ClockPinT _ClockPin;
+		DataPinT _DataPin;
+		LatchPinT _LatchPin;
+	};
 
+	class HC595 : public HC595T<Gpio, Gpio, Gpio>
+	{
+	public:
+		HC595(uint8_t ClockPin, uint8_t DataPin, uint8_t LatchPin, uint16_t RegsNo = 1, uint32_t *Storage = nullptr) : HC595T<Gpio, Gpio, Gpio>(Gpio(ClockPin, OUTPUT), Gpio(DataPin, OUTPUT), Gpio(LatchPin, OUTPUT), RegsNo, Storage)
+		{
+		}
+	};
+
+#if HC595_SPI_ENABLED == 1
+	/* Shift register chain on the hardware SPI: MOSI to SER, SCK to SRCLK and a latch pin to RCLK.
+	 * The buffer goes out in one transaction with the same register order (HC595_ENDIANESS) and
+	 * bit order (HC595_BIT_SHIFT_ORDER) as HC595T, followed by one latch pulse. */
+	template<class LatchPinT>
+	class HC595SpiT : public HC595Base
+	{
+	public:
+		HC595SpiT(const LatchPinT &LatchPin, uint16_t RegsNo = 1, uint32_t ClockHz = HC595_SPI_CLOCK, uint32_t *Storage = nullptr) : HC595Base(RegsNo, Storage), _LatchPin(LatchPin), _Settings(ClockHz, HC595_BIT_SHIFT_ORDER, SPI_MODE0)
+		{
+			SPI.begin();
+		}
+
+		/* Only usable with a default constructible latch pin, e.g. FastGpio */
+		HC595SpiT(uint16_t RegsNo = 1, uint32_t ClockHz = HC595_SPI_CLOCK, uint32_t *Storage = nullptr) : HC595Base(RegsNo, Storage), _Settings(ClockHz, HC595_BIT_SHIFT_ORDER, SPI_MODE0)
+		{
+			SPI.begin();
+		}
+
+		~HC595SpiT()
+		{
+			this->EnableRefreshInterrupt(false);
+		}
+
+	protected:
+		void ShiftOut()
+		{
+			SPI.beginTransaction(this->_Settings);
+			#if (HC595_ENDIANESS == HC595_BIG_ENDIAN)
+				for(uint16_t reg = 0; reg < this->_RegsNo; reg++)
+				{
+					SPI.transfer(_Reg(this->_Shadow, reg));
+				}
+			#else
+				for(uint16_t reg = this->_RegsNo; reg > 0; reg--)
+				{
+					SPI.transfer(_Reg(this->_Shadow, reg - 1));
+				}
+			#endif
+			SPI.endTransaction();
+
+			/* Start writing session */
+			this->_LatchPin.Clear();
+			/* End writing session and output data */
+			this->_LatchPin.Set();
+		}
+
+	private:
+		LatchPinT _LatchPin;
+		SPISettings _Settings;
+	};
+
+	class HC595Spi : public HC595SpiT<Gpio>
+	{
+	public:
+		HC595Spi(uint8_t LatchPin, uint16_t RegsNo = 1, uint32_t ClockHz = HC595_SPI_CLOCK, uint32_t *Storage = nullptr) : HC595SpiT<Gpio>(Gpio(LatchPin, OUTPUT), RegsNo, ClockHz, Storage)
+		{
+		}
 	};
+#endif
 
 } /* namespace Drivers */
 
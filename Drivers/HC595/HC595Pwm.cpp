@@ -0,0 +1,149 @@
+/*
+ * HC595Pwm.cpp
+ */
+
+#include "HC595Pwm.h"
+
+namespace Drivers
+{
+	HC595Pwm::HC595Pwm(HC595Base &Regs, uint8_t Depth) : _Regs(Regs), _RegsNo(Regs.GetRegsNo()), _Depth(Depth)
+	{
+		if( (Depth == 0u) || (Depth > 8u) )
+		{
+			#if HC595_DEBUG_ENABLED ==1
+				ERR_PRINT("[ERR][HC595Pwm] Invalid depth: ");
+				ERR_PRINTLN(Depth);
+			#endif
+			this->_Depth = 8u;
+		}
+
+		this->_Levels = (uint8_t *)calloc(this->_RegsNo * 8u, sizeof(uint8_t));
+		this->_Planes = (uint8_t *)calloc(2u * this->_Depth * this->_RegsNo, sizeof(uint8_t));
+	}
+
+	HC595Pwm::~HC595Pwm()
+	{
+		this->EnableInterrupt(false);
+		free(this->_Planes);
+		free(this->_Levels);
+	}
+
+	void HC595Pwm::SetLevel(uint16_t Output, uint8_t Level)
+	{
+		if( Output >= this->_RegsNo * 8u )
+		{
+			#if HC595_DEBUG_ENABLED ==1
+				ERR_PRINT("[ERR][HC595Pwm] SetLevel(): Invalid output: ");
+				ERR_PRINTLN(Output);
+			#endif
+			return;
+		}
+
+		uint8_t max = (uint8_t)((1u << this->_Depth) - 1u);
+		this->_Levels[Output] = (Level > max) ? max : Level;
+	}
+
+	uint8_t HC595Pwm::GetLevel(uint16_t Output) const
+	{
+		return (Output < this->_RegsNo * 8u) ? this->_Levels[Output] : 0u;
+	}
+
+	void HC595Pwm::SetAllLevels(uint8_t Level)
+	{
+		for( uint16_t i = 0; i < this->_RegsNo * 8u; i++ )
+		{
+			this->SetLevel(i, Level);
+		}
+	}
+
+	void HC595Pwm::Commit()
+	{
+		uint8_t back;
+
+		/* Keep the interrupt from switching sets while the back one is written */
+		{
+			Vfb_CriticalSection cs;
+			this->_Pending = false;
+			back = (uint8_t)(this->_Front ^ 1u);
+		}
+
+		uint8_t *planes = this->_Planes + (uint32_t)back * this->_Depth * this->_RegsNo;
+		for( uint16_t reg = 0; reg < this->_RegsNo; reg++ )
+		{
+			const uint8_t *levels = this->_Levels + reg * 8u;
+			for( uint8_t plane = 0; plane < this->_Depth; plane++ )
+			{
+				uint8_t bits = 0;
+				for( uint8_t output = 0; output < 8u; output++ )
+				{
+					bits |= (uint8_t)(((levels[output] >> plane) & 1u) << output);
+				}
+				planes[(uint32_t)plane * this->_RegsNo + reg] = bits;
+			}
+		}
+
+		{
+			Vfb_CriticalSection cs;
+			this->_Pending = true;
+		}
+	}
+
+	bool HC595Pwm::EnableInterrupt(bool Enable, uint32_t LsbUs)
+	{
+		if( !Enable )
+		{
+			PeriodicTimer::Detach(this->_Timer);
+			this->_Timer = PeriodicTimer::INVALID_HANDLE;
+			return true;
+		}
+
+		if( this->IsInterruptEnabled() )
+			return true;
+
+		this->_LsbUs = LsbUs;
+		this->_Timer = PeriodicTimer::Attach(InterruptHandler, this, PeriodicTimer::UsToTicks(LsbUs));
+
+		return this->IsInterruptEnabled();
+	}
+
+	void HC595Pwm::InterruptHandler(void *Arg)
+	{
+		HC595Pwm *self = (HC595Pwm *)Arg;
+
+		if( --self->_Countdown == 0u )
+		{
+			self->_NextPlane();
+		}
+	}
+
+	void HC595Pwm::MainFunction()
+	{
+		if( this->IsInterruptEnabled() )
+			return;
+
+		uint32_t now = micros();
+		if( (uint32_t)(now - this->_PlaneStartUs) < (uint32_t)this->_Countdown * this->_LsbUs )
+			return;
+
+		this->_PlaneStartUs = now;
+		this->_NextPlane();
+	}
+
+	void HC595Pwm::_NextPlane()
+	{
+		/* New levels only at a frame boundary, a frame never mixes two sets */
+		if( (this->_Plane == 0u) && this->_Pending )
+		{
+			this->_Front ^= 1u;
+			this->_Pending = false;
+		}
+
+		uint8_t *plane = this->_Planes + ((uint32_t)this->_Front * this->_Depth + this->_Plane) * this->_RegsNo;
+		this->_Regs.WriteRaw(plane, this->_RegsNo);
+		this->_Regs.MainFunction();
+
+		this->_Countdown = (uint16_t)(1u << this->_Plane);
+		this->_Plane = (uint8_t)((this->_Plane + 1u == this->_Depth) ? 0u : this->_Plane + 1u);
+	}
+
+} /* namespace Drivers */
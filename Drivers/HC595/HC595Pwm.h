@@ -0,0 +1,86 @@
+/*
+ * HC595Pwm.h
+ *
+ *  Brightness per output of an HC595 chain with binary code modulation (bit angle modulation).
+ *  Every output gets a Depth bit level. Commit() precomputes one bitplane per bit of the
+ *  levels, plane k is latched and held for 2^k ticks: a frame takes 2^Depth - 1 ticks and an
+ *  output is on for Level of them. The chain is shifted Depth times per frame, the ticks in
+ *  between only count down, so the cost follows the bit depth and not the duty resolution.
+ *
+ *  Frame rate is 1 / (LsbUs * (2^Depth - 1)): with 100us ticks 667Hz at 4 bit but 39Hz at 8 bit,
+ *  which flickers (lower PERIODIC_TIMER_TICK_US for 7-8 bit). A plane must be shifted out well
+ *  within one tick, use HC595Spi or FastGpio pins rather than Gpio. The chain's own refresh
+ *  interrupt must stay off, the planes are latched through its MainFunction().
+ */
+
+#ifndef HC595_PWM_H_
+#define HC595_PWM_H_
+
+#include "HC595.h"
+
+#ifndef HC595_PWM_DEPTH
+	#define HC595_PWM_DEPTH		4u
+#endif
+
+namespace Drivers
+{
+	class HC595Pwm
+	{
+	public:
+		/* Depth: 1 to 8 bits per level */
+		HC595Pwm(HC595Base &Regs, uint8_t Depth = HC595_PWM_DEPTH);
+		~HC595Pwm();
+
+		/* Level 0 (off) to 2^Depth - 1 (always on) of output Q_(Output % 8) of register Output / 8,
+		 * shown after the next Commit() */
+		void SetLevel(uint16_t Output, uint8_t Level);
+		uint8_t GetLevel(uint16_t Output) const;
+		void SetAllLevels(uint8_t Level);
+
+		/* Builds the bitplanes from the levels, the new planes are used from the next frame on */
+		void Commit();
+
+		/*
+		 * Plane switching from a PeriodicTimer callback every LsbUs (rounded to timer ticks).
+		 * Returns false when the build has no timer backend or no free timer slot, then call
+		 * MainFunction() from the main loop instead.
+		 */
+		bool EnableInterrupt(bool Enable, uint32_t LsbUs = PERIODIC_TIMER_TICK_US);
+		inline bool IsInterruptEnabled() const
+		{
+			return this->_Timer != PeriodicTimer::INVALID_HANDLE;
+		}
+		static void InterruptHandler(void *Arg);
+
+		/* Polled plane switching on micros(), does nothing while the interrupt is enabled */
+		void MainFunction();
+
+		inline uint8_t GetDepth() const
+		{
+			return this->_Depth;
+		}
+
+	private:
+		HC595Base &_Regs;
+		uint16_t _RegsNo;
+		uint8_t _Depth;
+		/* One level per output */
+		uint8_t *_Levels;
+		/* Two sets of Depth planes of _RegsNo bytes, plane k of set s at _Planes + (s * Depth + k) * _RegsNo */
+		uint8_t *_Planes;
+		/* Set being shown, the other one is written by Commit() */
+		volatile uint8_t _Front = 0;
+		volatile bool _Pending = false;
+		/* Next plane to latch and ticks until then */
+		uint8_t _Plane = 0;
+		uint16_t _Countdown = 1;
+		uint32_t _LsbUs = PERIODIC_TIMER_TICK_US;
+		uint32_t _PlaneStartUs = 0;
+		int8_t _Timer = PeriodicTimer::INVALID_HANDLE;
+
+		void _NextPlane();
+	};
+
+} /* namespace Drivers */
+
+#endif /* HC595_PWM_H_ */
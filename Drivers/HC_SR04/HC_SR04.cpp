@@ -12,6 +12,9 @@ namespace Drivers
 		// Ensure trigger starts low
 		Vfb_DigitalWrite(_triggerPin, LOW);
 
+		// Echo timing from the pin interrupt when the pin has one, polling otherwise
+		_echoEdges = EdgeCapture::Subscribe(_echoPin);
+
 		// Initialize state
 		_setState(STATE::IDLE);
 		_distance = 0.0;
@@ -22,6 +25,7 @@ namespace Drivers
 	{
 		// Stop any periodic measurements
 		StopPeriodicMeasurements();
+		EdgeCapture::Unsubscribe(_echoEdges);
 
 		// Set trigger pin to safe state
 		Vfb_DigitalWrite(_triggerPin, LOW);
@@ -34,6 +38,9 @@ namespace Drivers
 			return false; // Measurement already in progress
 		}
 
+		// Edges from a previous (timed out) echo must not be taken for this one
+		EdgeCapture::Flush(_echoEdges);
+
 		_setState(STATE::TRIGGERING);
 		_startTime = millis();
 		_triggerPulse();
@@ -181,6 +188,11 @@ namespace Drivers
 	{
 		unsigned long currentTime = millis();
 
+		if (_echoEdges != EdgeCapture::INVALID_HANDLE)
+		{
+			_processEchoEdges();
+		}
+
 		switch (_state)
 		{
 			case STATE::TRIGGERING:
@@ -194,7 +206,7 @@ namespace Drivers
 
 			case STATE::WAITING_FOR_ECHO:
 				// Wait for echo pin to go HIGH
-				if (Vfb_DigitalRead(_echoPin) == HIGH)
+				if ((_echoEdges == EdgeCapture::INVALID_HANDLE) && (Vfb_DigitalRead(_echoPin) == HIGH))
 				{
 					_echoStart = micros();
 					_setState(STATE::MEASURING);
@@ -211,7 +223,7 @@ namespace Drivers
 
 			case STATE::MEASURING:
 				// Wait for echo pin to go LOW
-				if (Vfb_DigitalRead(_echoPin) == LOW)
+				if ((_echoEdges == EdgeCapture::INVALID_HANDLE) && (Vfb_DigitalRead(_echoPin) == LOW))
 				{
 					_duration = micros() - _echoStart;
 					_distance = _calculateDistance(_duration);
@@ -244,6 +256,28 @@ namespace Drivers
 		_state = newState;
 	}
 
+	void HC_SR04::_processEchoEdges()
+	{
+		EdgeEvent edge;
+
+		// Both echo edges may already be queued, the timestamps come from the ISR
+		while ((_state == STATE::WAITING_FOR_ECHO || _state == STATE::MEASURING) && EdgeCapture::Pop(_echoEdges, edge))
+		{
+			if (_state == STATE::WAITING_FOR_ECHO && edge.Level == HIGH)
+			{
+				_echoStart = edge.TimeUs;
+				_setState(STATE::MEASURING);
+			}
+			else if (_state == STATE::MEASURING && edge.Level == LOW)
+			{
+				_duration = edge.TimeUs - _echoStart;
+				_distance = _calculateDistance(_duration);
+				_setState(STATE::COMPLETE);
+				_handleMeasurementComplete();
+			}
+		}
+	}
+
 	float HC_SR04::_calculateDistance(unsigned long duration)
 	{
 		// Speed of sound = 343 m/s = 34300 cm/s
@@ -2,6 +2,7 @@
 #define HC_SR04_H
 
 #include "HAL.h"
+#include "EdgeCapture.h"
 
 namespace Drivers
 {
@@ -70,6 +71,8 @@ namespace Drivers
         // Hardware pins
         uint8_t _triggerPin;
         uint8_t _echoPin;
+        // Echo edges timestamped by EdgeCapture, INVALID_HANDLE when the echo pin is polled
+        int8_t _echoEdges;
 
         // State management
         STATE _state;
@@ -93,6 +96,7 @@ namespace Drivers
 
         // Helper methods
         void _setState(STATE newState);
+        void _processEchoEdges();
         float _calculateDistance(unsigned long duration);
         void _triggerPulse();
         void _handleMeasurementComplete();
@@ -2,19 +2,13 @@
 
 namespace Drivers
 {
-    // Static instance pointer for interrupt handling
-    IR_Receiver* IR_Receiver::_instance = nullptr;
-
     IR_Receiver::IR_Receiver(uint8_t rxPin) :
         _rxPin(rxPin), _state(STATE::IDLE), _stateStartTime(0), _timeoutMs(1000),
-        _lastEdgeTime(0), _pulseIndex(0), _receiving(false), _dataReady(false),
+        _rxEdges(EdgeCapture::INVALID_HANDLE), _lastEdgeTime(0), _pulseIndex(0), _receiving(false), _dataReady(false),
         _receivedCode(0), _receivedProtocol(PROTOCOL::UNKNOWN), _decodingLength(0),
         _minPulseWidth(50), _maxPulseWidth(10000), _rxCallback(nullptr),
         _rxCallbackEnabled(false), _periodicRxMode(false), _debugEnabled(false)
     {
-        // Set static instance for interrupt handling
-        _instance = this;
-
         // Initialize RX pin
         Vfb_SetPinMode(_rxPin, INPUT);
         
@@ -26,12 +20,6 @@ namespace Drivers
     {
         StopReceiving();
         StopPeriodicReceiving();
-        
-        // Clear static instance
-        if (_instance == this)
-        {
-            _instance = nullptr;
-        }
     }
 
     bool IR_Receiver::StartReceiving()
@@ -45,10 +33,28 @@ namespace Drivers
         _pulseIndex = 0;
         _receiving = true;
         _dataReady = false;
-        
-        // Attach interrupt for RX pin (both edges to capture mark and space)
-        attachInterrupt(digitalPinToInterrupt(_rxPin), _rxInterrupt, CHANGE);
-        
+        _lastEdgeTime = 0;
+
+        // Capture both edges of the RX pin (mark and space), any number of receivers can run at once
+        if (_rxEdges == EdgeCapture::INVALID_HANDLE)
+        {
+            _rxEdges = EdgeCapture::Subscribe(_rxPin);
+        }
+        else
+        {
+            EdgeCapture::Flush(_rxEdges);
+        }
+
+        if (_rxEdges == EdgeCapture::INVALID_HANDLE)
+        {
+            _setState(STATE::IDLE);
+            _receiving = false;
+#if DRIVERS_DEBUG == 1
+            ERR_PRINTLN("[ERR][IR_Receiver] RX pin has no interrupt or EdgeCapture is full");
+#endif
+            return false;
+        }
+
         return true;
     }
 
@@ -56,7 +62,8 @@ namespace Drivers
     {
         _receiving = false;
         _dataReady = false;
-        detachInterrupt(digitalPinToInterrupt(_rxPin));
+        EdgeCapture::Unsubscribe(_rxEdges);
+        _rxEdges = EdgeCapture::INVALID_HANDLE;
         
         if (_state == STATE::RECEIVING)
         {
@@ -167,8 +174,10 @@ namespace Drivers
         switch (_state)
         {
             case STATE::RECEIVING:
+                _processEdges();
+
                 // Check for receive timeout
-                if (currentTime - _stateStartTime > _timeoutMs)
+                if (!_dataReady && (currentTime - _stateStartTime > _timeoutMs))
                 {
                     _setState(STATE::TIMEOUT);
                     // Timeout is normal when no IR signals are present - no error needed
@@ -240,14 +249,12 @@ namespace Drivers
 
     void IR_Receiver::_copyPulseData()
     {
-        // Copy volatile buffer to stable buffer for processing
-        noInterrupts();
+        // Copy pulse buffer to stable buffer for processing
         for (uint16_t i = 0; i < _pulseIndex && i < 128; i++)
         {
             _decodingBuffer[i] = _pulseBuffer[i];
         }
         _decodingLength = _pulseIndex;
-        interrupts();
     }
 
     void IR_Receiver::_processReceivedSignal()
@@ -427,45 +434,49 @@ namespace Drivers
         }
     }
 
-    void IR_Receiver::_handleInterrupt()
+    void IR_Receiver::_processEdges()
     {
-        if (!_receiving || _pulseIndex >= 127)
-        {
-            return;
-        }
+        EdgeEvent edge;
 
-        unsigned long currentTime = micros();
-        
-        if (_lastEdgeTime != 0)
+        while (_receiving && EdgeCapture::Peek(_rxEdges, edge))
         {
-            unsigned long duration = currentTime - _lastEdgeTime;
-            
-            // Filter out noise (too short or too long pulses)
-            if (duration >= _minPulseWidth && duration <= _maxPulseWidth)
+            if (_lastEdgeTime != 0)
             {
-                _pulseBuffer[_pulseIndex++] = duration;
+                unsigned long duration = edge.TimeUs - _lastEdgeTime;
+
+                // A gap longer than any pulse ends the frame. The edge stays queued: the periodic restart
+                // goes on from it, StartReceiving() flushes it with the rest
+                if (duration > _maxPulseWidth && _pulseIndex > 0)
+                {
+                    _receiving = false;
+                    _dataReady = true;
+                    break;
+                }
+
+                // Filter out noise (too short or too long pulses)
+                if (duration >= _minPulseWidth && duration <= _maxPulseWidth)
+                {
+                    _pulseBuffer[_pulseIndex++] = duration;
+                }
+            }
+
+            EdgeCapture::Pop(_rxEdges, edge);
+            _lastEdgeTime = edge.TimeUs;
+
+            // Check if we should stop receiving
+            if (_pulseIndex >= 127)
+            {
+                _receiving = false;
+                _dataReady = true;
             }
         }
-        
-        _lastEdgeTime = currentTime;
-        
-        // Check if we should stop receiving
-        if (_pulseIndex >= 127)
+
+        // The frame also ends when the line stays idle longer than any pulse
+        if (_receiving && _pulseIndex > 0 && (micros() - _lastEdgeTime) > _maxPulseWidth)
         {
             _receiving = false;
             _dataReady = true;
         }
-        
-        // Also stop if no edge for a while (end of transmission)
-        // This would need a timer check in main Update() function
-    }
-
-    void IR_Receiver::_rxInterrupt()
-    {
-        if (_instance != nullptr)
-        {
-            _instance->_handleInterrupt();
-        }
     }
 
     // Helper Methods
@@ -2,6 +2,7 @@
 #define IR_RXLED_H
 
 #include "HAL.h"
+#include "EdgeCapture.h"
 
 namespace Drivers
 {
@@ -72,12 +73,13 @@ namespace Drivers
         unsigned long _stateStartTime;
         unsigned long _timeoutMs;
 
-        // Reception variables
-        volatile unsigned long _lastEdgeTime;
-        volatile uint16_t _pulseBuffer[128];  // Buffer for pulse timings
-        volatile uint16_t _pulseIndex;
-        volatile bool _receiving;
-        volatile bool _dataReady;
+        // Reception variables, edges are timestamped by EdgeCapture and turned into pulses in Update()
+        int8_t _rxEdges;
+        unsigned long _lastEdgeTime;
+        uint16_t _pulseBuffer[128];  // Buffer for pulse timings
+        uint16_t _pulseIndex;
+        bool _receiving;
+        bool _dataReady;
         
         // Decoding variables
         uint32_t _receivedCode;
@@ -104,10 +106,8 @@ namespace Drivers
         void _handleSignalReceived();
         void _copyPulseData();
 
-        // Interrupt handling
-        void _handleInterrupt();
-        static void _rxInterrupt();
-        static IR_Receiver* _instance;
+        // Edge handling
+        void _processEdges();
 
         // Helper methods - General
         void _setState(STATE newState);
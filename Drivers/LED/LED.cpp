@@ -17,71 +17,17 @@ LED::~LED()
 
 void LED::On()
 {
-	if (this->_PinNo <= 0)
-	{
-		#if DRIVERS_DEBUG == 1
-            ERR_PRINT("[ERR][LED] On(): Invalid pin or not initialized: ");
-            ERR_PRINTLN(this->_PinNo);
-        #endif
-		return;
-	}
-
-	this->StopBlink();
-	this->_currentState = STATE::ON;
-
-	if (_isPWMPin)
-	{
-		this->_writePWM(_brightness);
-	}
-	else
-	{
-		this->_writePin(true);
-	}
+	this->_On(_HalWriter{this->_PinNo});
 }
 
 void LED::Off()
 {
-	if (this->_PinNo <= 0)
-	{
-		#if DRIVERS_DEBUG == 1
-            ERR_PRINT("[ERR][LED] Off(): Invalid pin or not initialized: ");
-            ERR_PRINTLN(this->_PinNo);
-        #endif
-		return;
-	}
-
-	this->StopBlink();
-	this->_currentState = STATE::OFF;
-
-	if (_isPWMPin)
-	{
-		this->_writePWM(0);
-	}
-	else
-	{
-		this->_writePin(false);
-	}
+	this->_Off(_HalWriter{this->_PinNo});
 }
 
 void LED::Toggle()
 {
-	if (this->_PinNo <= 0)
-	{
-		#if DRIVERS_DEBUG == 1
-            ERR_PRINT("[ERR][LED] Toggle(): Invalid pin or not initialized: ");
-            ERR_PRINTLN(this->_PinNo);
-        #endif
-		return;
-	}
-
-	if (_currentState == STATE::ON)
-	{
-		this->Off();
-	}
-	else
-	{
-		this->On();
-	}
+	this->_Toggle(_HalWriter{this->_PinNo});
 }
 
 LED::STATE LED::GetState()
@@ -208,34 +154,26 @@ bool LED::IsBlinking() const
 
 void LED::Update()
 {
-	if (_isFading)
-	{
-		_updateFade();
-	}
-	else if (_pattern != nullptr)
-	{
-		_updatePattern();
-	}
-	else if (_blinkMode != BLINK_MODE::NONE)
-	{
-		_updateBlink();
-	}
+	this->_Update(_HalWriter{this->_PinNo});
 }
 
 // Private helper methods
 
-void LED::_writePin(bool state)
+bool LED::_isValidPin(const char *caller) const
 {
-	if (state)
-	{
-		Vfb_DigitalWrite(_PinNo, HIGH);
-		_currentState = STATE::ON;
-	}
-	else
+	if (this->_PinNo <= 0)
 	{
-		Vfb_DigitalWrite(_PinNo, LOW);
-		_currentState = STATE::OFF;
+		#if DRIVERS_DEBUG == 1
+            ERR_PRINT("[ERR][LED] ");
+            ERR_PRINT(caller);
+            ERR_PRINT("(): Invalid pin or not initialized: ");
+            ERR_PRINTLN(this->_PinNo);
+        #else
+            (void)caller;
+        #endif
+		return false;
 	}
+	return true;
 }
 
 void LED::_writePWM(uint8_t value)
@@ -254,115 +192,6 @@ void LED::_writePWM(uint8_t value)
 	}
 }
 
-void LED::_updateBlink()
-{
-	unsigned long currentTime = millis();
-	unsigned long targetTime;
-
-	if (_blinkState)
-	{
-		targetTime = _lastBlinkTime + _blinkOnTime;
-	}
-	else
-	{
-		targetTime = _lastBlinkTime + _blinkOffTime;
-	}
-
-	if (currentTime >= targetTime)
-	{
-		_blinkState = !_blinkState;
-		_lastBlinkTime = currentTime;
-
-		if (_blinkState)
-		{
-			// Turn on
-			if (_isPWMPin)
-			{
-				_writePWM (_brightness);
-			}
-			else
-			{
-				_writePin(true);
-			}
-		}
-		else
-		{
-			// Turn off
-			if (_isPWMPin)
-			{
-				_writePWM(0);
-			}
-			else
-			{
-				_writePin(false);
-			}
-		}
-
-		// Handle count-limited blinking
-		if (_blinkMode == BLINK_MODE::COUNT_LIMITED)
-		{
-			_remainingBlinks--;
-			if (_remainingBlinks <= 0)
-			{
-				StopBlink();
-				Off(); // Ensure LED ends in off state
-			}
-		}
-	}
-}
-
-void LED::_updatePattern()
-{
-	unsigned long currentTime = millis();
-	unsigned long targetTime = _lastBlinkTime + _pattern[_patternIndex];
-
-	if (currentTime >= targetTime)
-	{
-		_lastBlinkTime = currentTime;
-		_patternIndex++;
-
-		// Toggle state on each pattern step
-		_blinkState = !_blinkState;
-
-		if (_blinkState)
-		{
-			if (_isPWMPin)
-			{
-				_writePWM (_brightness);
-			}
-			else
-			{
-				_writePin(true);
-			}
-		}
-		else
-		{
-			if (_isPWMPin)
-			{
-				_writePWM(0);
-			}
-			else
-			{
-				_writePin(false);
-			}
-		}
-
-		// Check if pattern is complete
-		if (_patternIndex >= _patternLength)
-		{
-			if (_patternRepeat)
-			{
-				_patternIndex = 0; // Restart pattern
-			}
-			else
-			{
-				StopBlink();
-				Off(); // End in off state
-			}
-		}
-	}
-}
-
 void LED::_updateFade()
 {
 	unsigned long currentTime = millis();
@@ -22,7 +22,7 @@ namespace Drivers
         };
 
         LED(uint8_t pin, bool isPWMCapable = false);
-        ~LED();
+        virtual ~LED();
 
         // Basic LED control
         void On();
@@ -49,6 +49,20 @@ namespace Drivers
         // Call this regularly in your main loop for non-blocking operation
         void Update();
 
+    protected:
+        // Digital pin writes are a template parameter of the state logic below, so LEDT gets its
+        // pin type's store inlined instead of a call through the HAL
+        struct _HalWriter
+        {
+            uint8_t PinNo;
+            inline void operator()(uint8_t level) const { Vfb_DigitalWrite(PinNo, level); }
+        };
+
+        template<class WriterT> void _On(const WriterT &write);
+        template<class WriterT> void _Off(const WriterT &write);
+        template<class WriterT> void _Toggle(const WriterT &write);
+        template<class WriterT> void _Update(const WriterT &write);
+
     private:
         // Hardware
         uint8_t _PinNo = 0;
@@ -81,14 +95,222 @@ namespace Drivers
         uint8_t _fadeTargetBrightness = 0;
 
         // Helper methods
-        void _writePin(bool state);
+        bool _isValidPin(const char *caller) const;
+        template<class WriterT> void _writePin(const WriterT &write, bool state);
         void _writePWM(uint8_t value);
-        void _updateBlink();
-        void _updatePattern();
+        template<class WriterT> void _updateBlink(const WriterT &write);
+        template<class WriterT> void _updatePattern(const WriterT &write);
         void _updateFade();
         bool _isPWMValue(uint8_t value) const;
     };
 
+    template<class WriterT>
+    void LED::_On(const WriterT &write)
+    {
+        if (!this->_isValidPin("On"))
+        {
+            return;
+        }
+
+        this->StopBlink();
+        this->_currentState = STATE::ON;
+
+        if (_isPWMPin)
+        {
+            this->_writePWM(_brightness);
+        }
+        else
+        {
+            this->_writePin(write, true);
+        }
+    }
+
+    template<class WriterT>
+    void LED::_Off(const WriterT &write)
+    {
+        if (!this->_isValidPin("Off"))
+        {
+            return;
+        }
+
+        this->StopBlink();
+        this->_currentState = STATE::OFF;
+
+        if (_isPWMPin)
+        {
+            this->_writePWM(0);
+        }
+        else
+        {
+            this->_writePin(write, false);
+        }
+    }
+
+    template<class WriterT>
+    void LED::_Toggle(const WriterT &write)
+    {
+        if (!this->_isValidPin("Toggle"))
+        {
+            return;
+        }
+
+        if (_currentState == STATE::ON)
+        {
+            this->_Off(write);
+        }
+        else
+        {
+            this->_On(write);
+        }
+    }
+
+    template<class WriterT>
+    void LED::_Update(const WriterT &write)
+    {
+        if (_isFading)
+        {
+            _updateFade();
+        }
+        else if (_pattern != nullptr)
+        {
+            _updatePattern(write);
+        }
+        else if (_blinkMode != BLINK_MODE::NONE)
+        {
+            _updateBlink(write);
+        }
+    }
+
+    template<class WriterT>
+    void LED::_writePin(const WriterT &write, bool state)
+    {
+        if (state)
+        {
+            write(HIGH);
+            _currentState = STATE::ON;
+        }
+        else
+        {
+            write(LOW);
+            _currentState = STATE::OFF;
+        }
+    }
+
+    template<class WriterT>
+    void LED::_updateBlink(const WriterT &write)
+    {
+        unsigned long currentTime = millis();
+        unsigned long targetTime;
+
+        if (_blinkState)
+        {
+            targetTime = _lastBlinkTime + _blinkOnTime;
+        }
+        else
+        {
+            targetTime = _lastBlinkTime + _blinkOffTime;
+        }
+
+        if (currentTime >= targetTime)
+        {
+            _blinkState = !_blinkState;
+            _lastBlinkTime = currentTime;
+
+            if (_isPWMPin)
+            {
+                _writePWM(_blinkState ? _brightness : 0);
+            }
+            else
+            {
+                _writePin(write, _blinkState);
+            }
+
+            // Handle count-limited blinking
+            if (_blinkMode == BLINK_MODE::COUNT_LIMITED)
+            {
+                _remainingBlinks--;
+                if (_remainingBlinks <= 0)
+                {
+                    StopBlink();
+                    _Off(write); // Ensure LED ends in off state
+                }
+            }
+        }
+    }
+
+    template<class WriterT>
+    void LED::_updatePattern(const WriterT &write)
+    {
+        unsigned long currentTime = millis();
+        unsigned long targetTime = _lastBlinkTime + _pattern[_patternIndex];
+
+        if (currentTime >= targetTime)
+        {
+            _lastBlinkTime = currentTime;
+            _patternIndex++;
+
+            // Toggle state on each pattern step
+            _blinkState = !_blinkState;
+
+            if (_isPWMPin)
+            {
+                _writePWM(_blinkState ? _brightness : 0);
+            }
+            else
+            {
+                _writePin(write, _blinkState);
+            }
+
+            // Check if pattern is complete
+            if (_patternIndex >= _patternLength)
+            {
+                if (_patternRepeat)
+                {
+                    _patternIndex = 0; // Restart pattern
+                }
+                else
+                {
+                    StopBlink();
+                    _Off(write); // End in off state
+                }
+            }
+        }
+    }
+
+    /*
+     * Digital (non PWM) LED driven through a templated pin type, e.g. LEDT<FastGpio<13>>. On, Off,
+     * Toggle and Update are resolved at compile time and write through PinT directly; called
+     * through an LED reference they fall back to the HAL write on the same pin.
+     */
+    template<class PinT>
+    class LEDT : public LED
+    {
+    public:
+        LEDT(const PinT &pin) : LED(pin.GetPinNo(), false), _Pin(pin)
+        {
+        }
+
+        /* Only usable with default constructible pins, e.g. FastGpio */
+        LEDT() : LED(PinT::GetPinNo(), false)
+        {
+        }
+
+        inline void On() { this->_On(_PinWriter(this->_Pin)); }
+        inline void Off() { this->_Off(_PinWriter(this->_Pin)); }
+        inline void Toggle() { this->_Toggle(_PinWriter(this->_Pin)); }
+        inline void Update() { this->_Update(_PinWriter(this->_Pin)); }
+
+    private:
+        struct _PinWriter
+        {
+            PinT &Pin;
+            inline _PinWriter(PinT &pin) : Pin(pin) {}
+            inline void operator()(uint8_t level) const { Pin.Write(level); }
+        };
+
+        PinT _Pin;
+    };
+
 } /* namespace Drivers */
 
 #endif /* LED_H */
@@ -9,12 +9,486 @@
 #define LedMatrixDriver_H_
 
 #include "HAL.h"
-#include "GpioBase.h"
+#include "Gpio.h"
 #include "HC595.h"
+#include "PeriodicTimer.h"
+
+/* Frames per second of LedMatrixT, see SetRefreshRate() */
+#ifndef LEDMATRIX_REFRESH_HZ
+	#define LEDMATRIX_REFRESH_HZ		100u
+#endif
+
+/* Bits per pixel of LedMatrixDriver: 1 (on/off) or more for grayscale, see LedMatrixT */
+#ifndef LEDMATRIX_DRIVER_DEPTH
+	#define LEDMATRIX_DRIVER_DEPTH		1u
+#endif
 
 namespace Drivers
 {
-	class LedMatrixDriver
+	/*
+	 * Chain layout of LedMatrixT: anodes (columns, active high) on chain bits 0..ColsT-1, cathodes
+	 * (rows, active low) from the next register on. A row goes out as its column bytes plus two
+	 * range operations on the cathodes.
+	 */
+	template<uint8_t ColsT, uint8_t RowsT>
+	class LedMatrixLinearLayout
+	{
+	public:
+		static const uint16_t ROW_BASE = ((ColsT + 7u) / 8u) * 8u;
+		static const uint16_t REGS_NO = (ROW_BASE + RowsT + 7u) / 8u;
+
+		static void WriteRow(HC595Base &Regs, const uint8_t *RowBits, uint8_t Row)
+		{
+			Regs.WriteRaw(RowBits, (ColsT + 7u) / 8u);
+			Regs.SetRange(ROW_BASE, RowsT);
+			Regs.ClearRange(ROW_BASE + Row, 1u);
+		}
+	};
+
+	/* Wiring of the original 3 register board: anodes X0-X3 on register 1 bits 3-0, X4-X11 on
+	 * register 0, cathodes Y0-Y7 on register 2 */
+	class LedMatrixBoardLayout
+	{
+	public:
+		static const uint16_t REGS_NO = 3;
+
+		static void WriteRow(HC595Base &Regs, const uint8_t *RowBits, uint8_t Row)
+		{
+			uint8_t low = RowBits[0] & 0x0F;
+			uint8_t regs[3];
+
+			regs[0] = (uint8_t)((RowBits[0] >> 4) | (RowBits[1] << 4));
+			regs[1] = (uint8_t)(((low & 0x1) << 3) | ((low & 0x2) << 1) | ((low & 0x4) >> 1) | ((low & 0x8) >> 3));
+			regs[2] = (uint8_t)~(1u << Row);
+			Regs.WriteRaw(regs, sizeof(regs));
+		}
+	};
+
+	typedef struct
+	{
+		uint32_t Frames;			/* complete frames shown */
+		uint32_t MissedDeadlines;	/* slots latched one slot or more after they were due */
+		uint32_t MaxLateUs;			/* worst lateness of a slot */
+	} LedMatrixStats;
+
+	/*
+	 * Row multiplexed LED matrix of ColsT x RowsT on an HC595 chain of at least LayoutT::REGS_NO
+	 * registers, DepthT bits per pixel (1: on/off, up to 8: grayscale).
+	 *
+	 * The frame is DepthT bitplanes, plane k holds bit k of every pixel level (row y, column x is
+	 * bit x % 8 of byte x / 8 of the row). The scan lights one whole row per slot with a single
+	 * chain write and latch. Grayscale uses binary code modulation across row scans: a frame is
+	 * DepthT scans of all rows, scan k shows plane k and holds each row for 2^k slots. A frame is
+	 * RowsT * (2^DepthT - 1) slots and a pixel of level L is lit for L of its row's slots.
+	 *
+	 * Slot timing:
+	 *  - EnableInterrupt(true): slots run from a PeriodicTimer callback, the refresh rate no
+	 *    longer depends on the main loop. The slot is rounded to timer ticks: the 12x8 board
+	 *    refreshes at up to 83Hz with 4 bit and 100us ticks (lower PERIODIC_TIMER_TICK_US for
+	 *    more). A row must go out well within one tick, use FastGpio pins or HC595Spi
+	 *  - MainFunction(): polled on micros(), a slow main loop stretches the slots
+	 * Slots that start one slot or more late are counted in the stats, see GetStats().
+	 *
+	 * With DepthT 1 pixel changes show at the next slot. With DepthT > 1 they are shown after
+	 * Commit(), which builds the displayed planes with the brightness applied and swaps them in at
+	 * the next frame boundary. The chain's own refresh interrupt must stay off.
+	 *
+	 * A cathode output sinks the current of the whole row: size the column resistors (or add
+	 * row drivers) for ColsT LEDs at once.
+	 */
+	template<uint8_t ColsT, uint8_t RowsT, class LayoutT = LedMatrixLinearLayout<ColsT, RowsT>, uint8_t DepthT = 1>
+	class LedMatrixT
+	{
+	public:
+		static const uint8_t COLS = ColsT;
+		static const uint8_t ROWS = RowsT;
+		static const uint8_t ROW_BYTES = (ColsT + 7u) / 8u;
+		static const uint8_t DEPTH = DepthT;
+		static const uint8_t MAX_LEVEL = (uint8_t)((1u << DepthT) - 1u);
+		/* Slots per frame */
+		static const uint32_t SLOTS = (uint32_t)RowsT * MAX_LEVEL;
+
+		/* ShiftRegs is not owned */
+		LedMatrixT(HC595Base *ShiftRegs) : _HC595(ShiftRegs)
+		{
+			static_assert((ColsT > 0u) && (RowsT > 0u), "LedMatrixT: empty matrix");
+			static_assert((DepthT > 0u) && (DepthT <= 8u), "LedMatrixT: 1 to 8 bits per pixel");
+			memset(this->_Frame, 0, sizeof(this->_Frame));
+			memset(this->_Sets, 0, sizeof(this->_Sets));
+			memset(&this->_Stats, 0, sizeof(this->_Stats));
+			this->SetRefreshRate(LEDMATRIX_REFRESH_HZ);
+		}
+
+		~LedMatrixT()
+		{
+			this->EnableInterrupt(false);
+		}
+
+		/* Full level */
+		void SetPixel(uint8_t x, uint8_t y)
+		{
+			if( (x < ColsT) && (y < RowsT) )
+			{
+				for( uint8_t plane = 0; plane < DepthT; plane++ )
+					this->_Frame[plane][y][x >> 3] |= (uint8_t)(1u << (x & 7u));
+			}
+		}
+
+		void ClearPixel(uint8_t x, uint8_t y)
+		{
+			if( (x < ColsT) && (y < RowsT) )
+			{
+				for( uint8_t plane = 0; plane < DepthT; plane++ )
+					this->_Frame[plane][y][x >> 3] &= (uint8_t)~(1u << (x & 7u));
+			}
+		}
+
+		void WritePixel(uint8_t x, uint8_t y, bool On)
+		{
+			if( On )
+				this->SetPixel(x, y);
+			else
+				this->ClearPixel(x, y);
+		}
+
+		/* True for any level but 0 */
+		bool GetPixel(uint8_t x, uint8_t y) const
+		{
+			return this->GetLevel(x, y) != 0u;
+		}
+
+		/* Level 0 (off) to MAX_LEVEL, clamped */
+		void SetLevel(uint8_t x, uint8_t y, uint8_t Level)
+		{
+			if( (x >= ColsT) || (y >= RowsT) )
+				return;
+			if( Level > MAX_LEVEL )
+				Level = MAX_LEVEL;
+
+			uint8_t mask = (uint8_t)(1u << (x & 7u));
+			for( uint8_t plane = 0; plane < DepthT; plane++ )
+			{
+				if( (Level >> plane) & 1u )
+					this->_Frame[plane][y][x >> 3] |= mask;
+				else
+					this->_Frame[plane][y][x >> 3] &= (uint8_t)~mask;
+			}
+		}
+
+		uint8_t GetLevel(uint8_t x, uint8_t y) const
+		{
+			uint8_t level = 0;
+
+			if( (x < ColsT) && (y < RowsT) )
+			{
+				for( uint8_t plane = 0; plane < DepthT; plane++ )
+					level |= (uint8_t)(((this->_Frame[plane][y][x >> 3] >> (x & 7u)) & 1u) << plane);
+			}
+			return level;
+		}
+
+		void SetRow(uint8_t y)
+		{
+			if( y >= RowsT )
+				return;
+			for( uint8_t plane = 0; plane < DepthT; plane++ )
+			{
+				memset(this->_Frame[plane][y], 0xFF, ROW_BYTES);
+				/* Keep the bits past the last column clear, they are shifted out with the row */
+				this->_Frame[plane][y][ROW_BYTES - 1u] &= _LastByteMask();
+			}
+		}
+
+		void ClearRow(uint8_t y)
+		{
+			if( y >= RowsT )
+				return;
+			for( uint8_t plane = 0; plane < DepthT; plane++ )
+				memset(this->_Frame[plane][y], 0, ROW_BYTES);
+		}
+
+		void SetColumn(uint8_t x)
+		{
+			for( uint8_t y = 0; y < RowsT; y++ )
+				this->SetPixel(x, y);
+		}
+
+		void ClearColumn(uint8_t x)
+		{
+			for( uint8_t y = 0; y < RowsT; y++ )
+				this->ClearPixel(x, y);
+		}
+
+		void SetAll()
+		{
+			for( uint8_t y = 0; y < RowsT; y++ )
+				this->SetRow(y);
+		}
+
+		void ClearAll()
+		{
+			memset(this->_Frame, 0, sizeof(this->_Frame));
+		}
+
+		/* ROW_BYTES bytes, same bit order as the frame, set pixels get the full level */
+		void WriteRow(uint8_t y, const uint8_t *Bits)
+		{
+			if( y >= RowsT )
+				return;
+			for( uint8_t plane = 0; plane < DepthT; plane++ )
+			{
+				memcpy(this->_Frame[plane][y], Bits, ROW_BYTES);
+				this->_Frame[plane][y][ROW_BYTES - 1u] &= _LastByteMask();
+			}
+		}
+
+		/* Row y of bitplane Plane */
+		const uint8_t *GetRow(uint8_t y, uint8_t Plane = DepthT - 1u) const
+		{
+			return this->_Frame[(Plane < DepthT) ? Plane : 0u][(y < RowsT) ? y : 0u];
+		}
+
+		/* 0 (dark) to 255 (full), grayscale only: levels are scaled by Commit() */
+		void SetBrightness(uint8_t Brightness)
+		{
+			this->_Brightness = Brightness;
+		}
+
+		uint8_t GetBrightness() const
+		{
+			return this->_Brightness;
+		}
+
+		/* Grayscale: builds the displayed planes from the frame, shown from the next frame on */
+		void Commit()
+		{
+			if( DepthT == 1u )
+				return;
+
+			uint8_t back;
+
+			/* Keep the scan from switching sets while the back one is written */
+			{
+				Vfb_CriticalSection cs;
+				this->_Pending = false;
+				back = (uint8_t)(this->_Front ^ 1u);
+			}
+
+			uint8_t (*set)[RowsT][ROW_BYTES] = this->_Sets[back];
+			if( this->_Brightness == 0xFFu )
+			{
+				memcpy(set, this->_Frame, sizeof(this->_Frame));
+			}
+			else
+			{
+				for( uint8_t y = 0; y < RowsT; y++ )
+				{
+					for( uint8_t i = 0; i < ROW_BYTES; i++ )
+					{
+						uint8_t out[DepthT];
+						memset(out, 0, sizeof(out));
+						for( uint8_t bit = 0; bit < 8u; bit++ )
+						{
+							uint16_t level = 0;
+							for( uint8_t plane = 0; plane < DepthT; plane++ )
+								level |= (uint16_t)(((this->_Frame[plane][y][i] >> bit) & 1u) << plane);
+							level = (uint16_t)((level * this->_Brightness + 127u) / 255u);
+							for( uint8_t plane = 0; plane < DepthT; plane++ )
+								out[plane] |= (uint8_t)(((level >> plane) & 1u) << bit);
+						}
+						for( uint8_t plane = 0; plane < DepthT; plane++ )
+							set[plane][y][i] = out[plane];
+					}
+				}
+			}
+
+			{
+				Vfb_CriticalSection cs;
+				this->_Pending = true;
+			}
+		}
+
+		/*
+		 * Whole frames per second, 0 runs one slot per MainFunction() call. Takes effect at once,
+		 * also on a running interrupt.
+		 */
+		void SetRefreshRate(uint16_t Hz)
+		{
+			this->_RefreshHz = Hz;
+			this->_SlotUs = _SlotUsFor(Hz);
+
+			if( this->IsInterruptEnabled() )
+			{
+				this->EnableInterrupt(false);
+				this->EnableInterrupt(true);
+			}
+		}
+
+		/* Achieved rate, the slot is rounded down to whole us or timer ticks */
+		uint16_t GetRefreshRate() const
+		{
+			return (this->_SlotUs == 0u) ? 0u : (uint16_t)(1000000UL / (this->_SlotUs * SLOTS));
+		}
+
+		/* Slot length in use, 0 when free running */
+		uint32_t GetSlotUs() const
+		{
+			return this->_SlotUs;
+		}
+
+		/*
+		 * Slots from a PeriodicTimer callback. Returns false when the build has no timer backend
+		 * or no free timer slot, then call MainFunction() from the main loop instead.
+		 */
+		bool EnableInterrupt(bool Enable)
+		{
+			if( !Enable )
+			{
+				PeriodicTimer::Detach(this->_Timer);
+				this->_Timer = PeriodicTimer::INVALID_HANDLE;
+				/* Back to the requested rate for polling */
+				this->_SlotUs = _SlotUsFor(this->_RefreshHz);
+				return true;
+			}
+
+			if( this->IsInterruptEnabled() )
+				return true;
+
+			uint16_t ticks = PeriodicTimer::UsToTicks(this->_SlotUs);
+			this->_SlotUs = (uint32_t)ticks * PERIODIC_TIMER_TICK_US;
+			this->_Hold = 0;
+			this->_Countdown = 1;
+			this->_Timer = PeriodicTimer::Attach(InterruptHandler, this, ticks);
+
+			return this->IsInterruptEnabled();
+		}
+
+		inline bool IsInterruptEnabled() const
+		{
+			return this->_Timer != PeriodicTimer::INVALID_HANDLE;
+		}
+
+		static void InterruptHandler(void *Arg)
+		{
+			LedMatrixT *self = (LedMatrixT *)Arg;
+
+			if( --self->_Countdown == 0u )
+			{
+				self->_NextSlot();
+			}
+		}
+
+		/* Polled scan, lights the next row when the current slot is over. Does nothing while the interrupt is enabled */
+		void MainFunction()
+		{
+			if( this->IsInterruptEnabled() )
+				return;
+
+			if( (uint32_t)(micros() - this->_SlotStartUs) < (uint32_t)this->_Hold * this->_SlotUs )
+				return;
+
+			this->_NextSlot();
+		}
+
+		LedMatrixStats GetStats() const
+		{
+			LedMatrixStats stats;
+
+			{
+				Vfb_CriticalSection cs;
+				stats = this->_Stats;
+			}
+			return stats;
+		}
+
+		void ResetStats()
+		{
+			Vfb_CriticalSection cs;
+			memset(&this->_Stats, 0, sizeof(this->_Stats));
+		}
+
+	protected:
+		/* Shift registers used to output the data */
+		HC595Base *_HC595;
+		/* The image, DepthT bitplanes */
+		uint8_t _Frame[DepthT][RowsT][ROW_BYTES];
+		/* Grayscale: two sets of displayed planes, written by Commit() */
+		uint8_t _Sets[(DepthT > 1u) ? 2u : 1u][DepthT][RowsT][ROW_BYTES];
+		volatile uint8_t _Front = 0;
+		volatile bool _Pending = false;
+		/* Next row and plane to light */
+		uint8_t _Row = 0;
+		uint8_t _Plane = 0;
+		/* Slots the lit row is held for (0 before the first one) and timer callbacks until the next one */
+		uint8_t _Hold = 0;
+		uint8_t _Countdown = 1;
+		uint16_t _RefreshHz = 0;
+		uint32_t _SlotUs = 0;
+		uint32_t _SlotStartUs = 0;
+		int8_t _Timer = PeriodicTimer::INVALID_HANDLE;
+		LedMatrixStats _Stats;
+		uint8_t _Brightness = 0xFF;
+
+		static uint8_t _LastByteMask()
+		{
+			return ((ColsT & 7u) == 0u) ? 0xFFu : (uint8_t)((1u << (ColsT & 7u)) - 1u);
+		}
+
+		static uint32_t _SlotUsFor(uint16_t Hz)
+		{
+			if( Hz == 0u )
+				return 0u;
+			uint32_t us = 1000000UL / ((uint32_t)Hz * SLOTS);
+			return (us == 0u) ? 1u : us;
+		}
+
+		void _NextSlot()
+		{
+			uint32_t now = micros();
+
+			if( (this->_Hold != 0u) && (this->_SlotUs != 0u) )
+			{
+				uint32_t elapsed = now - this->_SlotStartUs;
+				uint32_t due = (uint32_t)this->_Hold * this->_SlotUs;
+				if( elapsed > due )
+				{
+					uint32_t late = elapsed - due;
+					if( late > this->_Stats.MaxLateUs )
+						this->_Stats.MaxLateUs = late;
+					if( late >= this->_SlotUs )
+						this->_Stats.MissedDeadlines++;
+				}
+			}
+			this->_SlotStartUs = now;
+
+			/* New planes only at a frame boundary, a frame never mixes two sets */
+			if( (DepthT > 1u) && (this->_Row == 0u) && (this->_Plane == 0u) && this->_Pending )
+			{
+				this->_Front ^= 1u;
+				this->_Pending = false;
+			}
+
+			const uint8_t *row = (DepthT > 1u) ? this->_Sets[this->_Front][this->_Plane][this->_Row] : this->_Frame[0][this->_Row];
+			LayoutT::WriteRow(*this->_HC595, row, this->_Row);
+			this->_HC595->MainFunction();
+
+			this->_Hold = (uint8_t)(1u << this->_Plane);
+			this->_Countdown = this->_Hold;
+			if( ++this->_Row == RowsT )
+			{
+				this->_Row = 0;
+				if( ++this->_Plane == DepthT )
+				{
+					this->_Plane = 0;
+					this->_Stats.Frames++;
+				}
+			}
+		}
+	};
+
+	/* The original board: 12 anodes (X) and 8 cathodes (Y) on 3 registers, see LedMatrixBoardLayout.
+	 * With LEDMATRIX_DRIVER_DEPTH > 1 the pixel calls below set full levels, call Commit() to show them */
+	class LedMatrixDriver : public LedMatrixT<12, 8, LedMatrixBoardLayout, LEDMATRIX_DRIVER_DEPTH>
 	{
 	public:
 		// Maximum matrix sizes
@@ -22,6 +496,8 @@ namespace Drivers
 		static const uint8_t MATRIX_MAX_Y_ELEMENTS = 12;
 
 		LedMatrixDriver(uint8_t nCathods, uint8_t nAnods, uint8_t ClockPin, uint8_t DataPin, uint8_t LatchPin);
+		/* Use an externally created chain of 3 registers, e.g. HC595T<FastGpio<2>, FastGpio<3>, FastGpio<4>> */
+		LedMatrixDriver(uint8_t nCathods, uint8_t nAnods, HC595Base *ShiftRegs);
 		virtual ~LedMatrixDriver();
 
 		void SetAll();
@@ -40,7 +516,7 @@ namespace Drivers
 			{
 				for( int j = 0; j < this->_nElementsY; j++ )
 				{
-					this->_Matrix[i][j] = matrix[j][i];
+					this->WritePixel(i, j, matrix[j][i] != 0);
 				}
 			}
 
@@ -50,27 +526,9 @@ namespace Drivers
 		void TextMatrixPositions();
 		void PrintMatrix();
 
-		void MainFunction();
-
 	private:
 		uint8_t _nElementsY, _nElementsX;
-		/* Buffer to store current values */
-		int _Matrix[MATRIX_MAX_X_ELEMENTS][MATRIX_MAX_Y_ELEMENTS];
-		/* Shift registers used to output the data */
-		HC595 *_HC595;
-		uint8_t _RegsBuffer[3] = {0};
-		/* Matrix writing cursor */
-		uint8_t _CursorX = 0, _CursorY = 0;
-
-		void CalcNextPosition();
-
-		void SetAllAnodsStates(uint8_t state);
-		void SetAllCathodsState(uint8_t state);
-		void SetSingleAnodState(uint8_t anod_no, uint8_t state);
-		void SetSingleCathodState(uint8_t cathod_no, uint8_t state);
-
-		void Hc595AllOff();
-		void Hc595AllOn();
+		bool _OwnsHC595 = false;
 	};
 
 } /* namespace Drivers */
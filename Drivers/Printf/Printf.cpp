@@ -30,6 +30,7 @@
 //
 ///////////////////////////////////////////////////////////////////////////////
 
+#include <limits.h>
 #include <stdbool.h>
 #include <stdint.h>
 
@@ -56,6 +57,13 @@
 #define PRINTF_FTOA_BUFFER_SIZE    32U
 #endif
 
+// 'chunk' buffer size of fctprintf_block(), printf_to() and printf_(), the output function
+// gets the text in pieces of this size (dynamically created on stack)
+// default: 32 byte
+#ifndef PRINTF_CHUNK_BUFFER_SIZE
+#define PRINTF_CHUNK_BUFFER_SIZE   32U
+#endif
+
 // support for the floating point type (%f)
 // default: activated
 #ifndef PRINTF_DISABLE_SUPPORT_FLOAT
@@ -80,6 +88,25 @@
 #define PRINTF_MAX_FLOAT  1e9
 #endif
 
+// shortest round trip float engine (Ryu) behind %f, %e and %g: exact up to 17 significant
+// digits like glibc (9 for the 32 bit double of AVR), no PRINTF_MAX_FLOAT limit.
+// Disabled it is the multiply loop of _ftoa
+// default: activated, except on AVR: its double is 32 bit but the engine still works on 64 bit
+// integers there, PRINTF_ENABLE_FLOAT_ENGINE builds it anyway
+#if defined(__AVR__) && !defined(PRINTF_ENABLE_FLOAT_ENGINE) && !defined(PRINTF_DISABLE_FLOAT_ENGINE)
+#define PRINTF_DISABLE_FLOAT_ENGINE
+#endif
+#ifndef PRINTF_DISABLE_FLOAT_ENGINE
+#define PRINTF_FLOAT_ENGINE
+#endif
+
+// define this to build the float engine with ~1 KB of power of 5 tables instead of ~10 KB,
+// the powers in between are computed on the fly
+// default: activated on AVR
+#if defined(__AVR__) && !defined(PRINTF_FLOAT_REDUCED_TABLE)
+#define PRINTF_FLOAT_REDUCED_TABLE
+#endif
+
 // support for the long long types (%llu or %p)
 // default: activated
 #ifndef PRINTF_DISABLE_SUPPORT_LONG_LONG
@@ -93,6 +120,13 @@
 #define PRINTF_SUPPORT_PTRDIFF_T
 #endif
 
+// table driven integer conversion: digit pairs and reciprocal division for decimal,
+// shifts and a nibble table for hex/octal/binary instead of a division per digit
+// default: activated
+#ifndef PRINTF_DISABLE_FAST_NTOA
+#define PRINTF_FAST_NTOA
+#endif
+
 ///////////////////////////////////////////////////////////////////////////////
 
 // internal flag definitions
@@ -124,6 +158,15 @@ typedef struct
 	void *arg;
 } out_fct_wrap_type;
 
+// wrapper (used as buffer) for chunked output function type
+typedef struct
+{
+	void (*fct)(const char *data, size_t length, void *arg);
+	void *arg;
+	size_t length;
+	char chunk[PRINTF_CHUNK_BUFFER_SIZE];
+} out_block_wrap_type;
+
 #if defined(ASYNC_PRINTF) && (ASYNC_PRINTF == 1)
 	#include <SerialAsync.h>
 
@@ -132,6 +175,14 @@ typedef struct
 	static HardwareSerial *serial;
 #endif
 
+#if (DEFERRED_PRINTF == 1)
+	#include <Cobs.h>
+#endif
+
+#if !defined(PRINTF_DISABLE_COMPILED_FORMAT)
+	#include "PrintfCompiled.h"
+#endif
+
 void printf_init(HardwareSerial *SerialPort, uint32_t BaudRate)
 {
 	#if defined(ASYNC_PRINTF) && (ASYNC_PRINTF == 1)
@@ -156,6 +207,18 @@ void _putchar(char character)
 	}
 }
 
+#if !defined(ASYNC_PRINTF) || (ASYNC_PRINTF != 1)
+// chunk output of printf_() to the serial port
+static void _serial_block(const char *data, size_t length, void *arg)
+{
+	(void) arg;
+	if (serial)
+	{
+		serial->write((const uint8_t*) data, length);
+	}
+}
+#endif
+
 #if defined(ASYNC_PRINTF) && (ASYNC_PRINTF == 1)
 void printf_MainFunction()
 {
@@ -193,6 +256,25 @@ static inline void _out_char(char character, void *buffer, size_t idx, size_t ma
 	}
 }
 
+#if defined(ASYNC_PRINTF) && (ASYNC_PRINTF == 1)
+// internal output straight into a span reserved in the SerialAsync queue
+static inline void _out_span(char character, void *buffer, size_t idx, size_t maxlen)
+{
+	Drivers::ByteSpan *span = (Drivers::ByteSpan*) buffer;
+	if (character && (idx < maxlen))
+	{
+		if (idx < span->FirstLength)
+		{
+			span->First[idx] = (uint8_t) character;
+		}
+		else
+		{
+			span->Second[idx - span->FirstLength] = (uint8_t) character;
+		}
+	}
+}
+#endif
+
 // internal output function wrapper
 static inline void _out_fct(char character, void *buffer, size_t idx, size_t maxlen)
 {
@@ -205,6 +287,32 @@ static inline void _out_fct(char character, void *buffer, size_t idx, size_t max
 	}
 }
 
+// internal chunked output function wrapper, full chunks are handed on here, the rest by _out_block_flush()
+static inline void _out_block(char character, void *buffer, size_t idx, size_t maxlen)
+{
+	(void) idx;
+	(void) maxlen;
+	out_block_wrap_type *wrap = (out_block_wrap_type*) buffer;
+	if (character)
+	{
+		wrap->chunk[wrap->length++] = character;
+		if (wrap->length == sizeof(wrap->chunk))
+		{
+			wrap->fct(wrap->chunk, wrap->length, wrap->arg);
+			wrap->length = 0U;
+		}
+	}
+}
+
+static inline void _out_block_flush(out_block_wrap_type *wrap)
+{
+	if (wrap->length)
+	{
+		wrap->fct(wrap->chunk, wrap->length, wrap->arg);
+		wrap->length = 0U;
+	}
+}
+
 // internal secure strlen
 // \return The length of the string (excluding the terminating 0) limited by 'maxsize'
 static inline unsigned int _strnlen_s(const char *str, size_t maxsize)
@@ -333,6 +441,137 @@ static size_t _ntoa_format(out_fct_type out, char *buffer, size_t idx, size_t ma
 	return _out_rev(out, buffer, idx, maxlen, buf, len, width, flags);
 }
 
+// conversion tables live in flash on AVR
+#if defined(__AVR__)
+#include <avr/pgmspace.h>
+#define _PRINTF_TABLE_ATTR PROGMEM
+#define _printf_table_read(table, i) ((char) pgm_read_byte(&(table)[i]))
+#define _printf_table_read32(table, i) ((uint32_t) pgm_read_dword(&(table)[i]))
+#else
+#define _PRINTF_TABLE_ATTR
+#define _printf_table_read(table, i) ((table)[i])
+#define _printf_table_read32(table, i) ((table)[i])
+#endif
+
+#if defined(PRINTF_FAST_NTOA)
+
+static const char _digit_pairs[200] _PRINTF_TABLE_ATTR =
+{
+	'0','0','0','1','0','2','0','3','0','4','0','5','0','6','0','7','0','8','0','9',
+	'1','0','1','1','1','2','1','3','1','4','1','5','1','6','1','7','1','8','1','9',
+	'2','0','2','1','2','2','2','3','2','4','2','5','2','6','2','7','2','8','2','9',
+	'3','0','3','1','3','2','3','3','3','4','3','5','3','6','3','7','3','8','3','9',
+	'4','0','4','1','4','2','4','3','4','4','4','5','4','6','4','7','4','8','4','9',
+	'5','0','5','1','5','2','5','3','5','4','5','5','5','6','5','7','5','8','5','9',
+	'6','0','6','1','6','2','6','3','6','4','6','5','6','6','6','7','6','8','6','9',
+	'7','0','7','1','7','2','7','3','7','4','7','5','7','6','7','7','7','8','7','9',
+	'8','0','8','1','8','2','8','3','8','4','8','5','8','6','8','7','8','8','8','9',
+	'9','0','9','1','9','2','9','3','9','4','9','5','9','6','9','7','9','8','9','9'
+};
+
+static const char _nibble_lower[16] _PRINTF_TABLE_ATTR =
+{ '0','1','2','3','4','5','6','7','8','9','a','b','c','d','e','f' };
+static const char _nibble_upper[16] _PRINTF_TABLE_ATTR =
+{ '0','1','2','3','4','5','6','7','8','9','A','B','C','D','E','F' };
+
+// appends the decimal digits of value to buf in reverse, two digits per step
+// 10 digits at most, always fits PRINTF_NTOA_BUFFER_SIZE
+static size_t _ntoa_dec32(char *buf, size_t len, uint32_t value)
+{
+	// value / 100 as multiply and shift, exact for every 32 bit value (32x32->64 multiply, no division)
+	while (value >= 10000U)
+	{
+		const uint32_t q = (uint32_t) (((uint64_t) value * 0x51EB851FU) >> 37U);
+		const uint8_t r = (uint8_t) (value - q * 100U);
+		buf[len++] = _printf_table_read(_digit_pairs, 2U * r + 1U);
+		buf[len++] = _printf_table_read(_digit_pairs, 2U * r);
+		value = q;
+	}
+
+	// same in 16x16->32 bit, exact below 43699
+	uint16_t small = (uint16_t) value;
+	if (small >= 100U)
+	{
+		const uint16_t q = (uint16_t) (((uint32_t) small * 41944U) >> 22U);
+		const uint8_t r = (uint8_t) (small - q * 100U);
+		buf[len++] = _printf_table_read(_digit_pairs, 2U * r + 1U);
+		buf[len++] = _printf_table_read(_digit_pairs, 2U * r);
+		small = q;
+	}
+
+	if (small >= 10U)
+	{
+		buf[len++] = _printf_table_read(_digit_pairs, 2U * small + 1U);
+		buf[len++] = _printf_table_read(_digit_pairs, 2U * small);
+	}
+	else
+	{
+		buf[len++] = (char) ('0' + small);
+	}
+	return len;
+}
+
+// appends the digits of value in base 2, 8 or 16 (shift 1, 3 or 4) to buf in reverse
+static size_t _ntoa_pow2_32(char *buf, size_t len, uint32_t value, unsigned int shift, const char *digits)
+{
+	const uint8_t mask = (uint8_t) ((1U << shift) - 1U);
+	do
+	{
+		buf[len++] = _printf_table_read(digits, (uint8_t) value & mask);
+		value >>= shift;
+	} while (value && (len < PRINTF_NTOA_BUFFER_SIZE));
+	return len;
+}
+
+#if defined(PRINTF_SUPPORT_LONG_LONG) || (ULONG_MAX > 0xFFFFFFFFUL)
+// 64 bit: 9 digit chunks split off with at most two 64 bit divisions, the chunks use the 32 bit path
+static size_t _ntoa_dec64(char *buf, size_t len, unsigned long long value)
+{
+	while (value > 0xFFFFFFFFULL)
+	{
+		const unsigned long long q = value / 1000000000ULL;
+		const size_t end = len + 9U;
+		len = _ntoa_dec32(buf, len, (uint32_t) (value - q * 1000000000ULL));
+		while (len < end)
+		{
+			buf[len++] = '0';
+		}
+		value = q;
+	}
+	return _ntoa_dec32(buf, len, (uint32_t) value);
+}
+
+static size_t _ntoa_pow2_64(char *buf, size_t len, unsigned long long value, unsigned int shift, const char *digits)
+{
+	// 32 bit halves when the digits split evenly, 64 bit shifts are a library call on small cores
+	if ((shift != 3U) && (value > 0xFFFFFFFFULL))
+	{
+		const size_t end = len + 32U / shift;
+		len = _ntoa_pow2_32(buf, len, (uint32_t) value, shift, digits);
+		while ((len < end) && (len < PRINTF_NTOA_BUFFER_SIZE))
+		{
+			buf[len++] = '0';
+		}
+		return (len < PRINTF_NTOA_BUFFER_SIZE) ? _ntoa_pow2_32(buf, len, (uint32_t) (value >> 32U), shift, digits) : len;
+	}
+
+	const uint8_t mask = (uint8_t) ((1U << shift) - 1U);
+	do
+	{
+		buf[len++] = _printf_table_read(digits, (uint8_t) value & mask);
+		value >>= shift;
+	} while (value && (len < PRINTF_NTOA_BUFFER_SIZE));
+	return len;
+}
+#endif
+
+// shift for the power of two bases, 0 for the others
+static inline unsigned int _ntoa_shift(unsigned long base)
+{
+	return (base == 16U) ? 4U : ((base == 8U) ? 3U : ((base == 2U) ? 1U : 0U));
+}
+#endif  // PRINTF_FAST_NTOA
+
 // internal itoa for 'long' type
 static size_t _ntoa_long(out_fct_type out, char *buffer, size_t idx, size_t maxlen, unsigned long value, bool negative, unsigned long base, unsigned int prec, unsigned int width, unsigned int flags)
 {
@@ -348,6 +587,30 @@ static size_t _ntoa_long(out_fct_type out, char *buffer, size_t idx, size_t maxl
 	// write if precision != 0 and value is != 0
 	if (!(flags & FLAGS_PRECISION) || value)
 	{
+#if defined(PRINTF_FAST_NTOA)
+		const unsigned int shift = _ntoa_shift(base);
+		const char *digits = (flags & FLAGS_UPPERCASE) ? _nibble_upper : _nibble_lower;
+#if (ULONG_MAX > 0xFFFFFFFFUL)
+		if (base == 10U)
+		{
+			len = _ntoa_dec64(buf, len, value);
+		}
+		else if (shift)
+		{
+			len = _ntoa_pow2_64(buf, len, value, shift, digits);
+		}
+#else
+		if (base == 10U)
+		{
+			len = _ntoa_dec32(buf, len, value);
+		}
+		else if (shift)
+		{
+			len = _ntoa_pow2_32(buf, len, value, shift, digits);
+		}
+#endif
+		else
+#endif
 		do
 		{
 			const char digit = (char) (value % base);
@@ -372,22 +635,905 @@ static size_t _ntoa_long_long(out_fct_type out, char *buffer, size_t idx, size_t
 		flags &= ~FLAGS_HASH;
 	}
 
-	// write if precision != 0 and value is != 0
-	if (!(flags & FLAGS_PRECISION) || value)
+	// write if precision != 0 and value is != 0
+	if (!(flags & FLAGS_PRECISION) || value)
+	{
+#if defined(PRINTF_FAST_NTOA)
+		const unsigned int shift = _ntoa_shift((unsigned long) base);
+		if (base == 10U)
+		{
+			len = _ntoa_dec64(buf, len, value);
+		}
+		else if (shift)
+		{
+			len = _ntoa_pow2_64(buf, len, value, shift, (flags & FLAGS_UPPERCASE) ? _nibble_upper : _nibble_lower);
+		}
+		else
+#endif
+		do
+		{
+			const char digit = (char) (value % base);
+			buf[len++] = digit < 10 ? '0' + digit : (flags & FLAGS_UPPERCASE ? 'A' : 'a') + digit - 10;
+			value /= base;
+		} while (value && (len < PRINTF_NTOA_BUFFER_SIZE));
+	}
+
+	return _ntoa_format(out, buffer, idx, maxlen, buf, len, negative, (unsigned int) base, prec, width, flags);
+}
+#endif  // PRINTF_SUPPORT_LONG_LONG
+
+#if defined(PRINTF_SUPPORT_FLOAT)
+
+#if defined(PRINTF_FLOAT_ENGINE)
+// IEEE layout of double, 32 bit on AVR. _PRINTF_FLOAT_DIGITS significant digits tell every
+// value apart, the ones after it print as 0. Up to DBL_DIG digits the padded shortest form
+// is already the rounded value
+#if (DBL_MANT_DIG == 53)
+#define _PRINTF_FLOAT_MANTISSA_BITS  52
+#define _PRINTF_FLOAT_EXPONENT_BITS  11
+#define _PRINTF_FLOAT_DIGITS         17
+typedef uint64_t _float_bits_t;
+#else
+#define _PRINTF_FLOAT_MANTISSA_BITS  23
+#define _PRINTF_FLOAT_EXPONENT_BITS  8
+#define _PRINTF_FLOAT_DIGITS         9
+typedef uint32_t _float_bits_t;
+#endif
+#define _PRINTF_FLOAT_BIAS  ((1 << (_PRINTF_FLOAT_EXPONENT_BITS - 1)) - 1)
+
+// words of the big number for exact comparisons: m2 * 5^340 for double, m2 * 5^53 for float
+#define _PRINTF_FLOAT_BIG_WORDS  ((DBL_MANT_DIG == 53) ? 28U : 8U)
+
+#include "PrintfFloatTables.h"
+
+// finite double split into its exact value and its shortest decimal digits
+// value = m2 * 2^e2, shortest = digits * 10^exp10 with 'length' digits and no trailing zeros
+typedef struct
+{
+	uint64_t m2;
+	int e2;
+	uint64_t digits;
+	int exp10;
+	unsigned int length;
+} _float_decimal;
+
+// big number for the exact comparisons, 32 bit words, lowest first
+typedef struct
+{
+	uint32_t w[_PRINTF_FLOAT_BIG_WORDS];
+	unsigned int n;
+} _float_big;
+
+static const uint64_t _float_pow10[20] _PRINTF_TABLE_ATTR =
+{
+	1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL, 100000000ULL, 1000000000ULL,
+	10000000000ULL, 100000000000ULL, 1000000000000ULL, 10000000000000ULL, 100000000000000ULL, 1000000000000000ULL,
+	10000000000000000ULL, 100000000000000000ULL, 1000000000000000000ULL, 10000000000000000000ULL
+};
+
+// bit length of 5^e, 1 for e = 0
+static inline int _float_pow5bits(int e)
+{
+	return (int) (((uint32_t) e * 1217359U) >> 19U) + 1;
+}
+
+// floor(log10(2^e))
+static inline int _float_log10_pow2(int e)
+{
+	return (int) (((uint32_t) e * 78913U) >> 18U);
+}
+
+// floor(log10(5^e))
+static inline int _float_log10_pow5(int e)
+{
+	return (int) (((uint32_t) e * 732923U) >> 20U);
+}
+
+static inline uint64_t _float_table_read(const uint64_t *entry)
+{
+#if defined(__AVR__)
+	uint64_t value;
+	memcpy_P(&value, entry, sizeof(value));
+	return value;
+#else
+	return *entry;
+#endif
+}
+
+#if defined(__SIZEOF_INT128__)
+// 64x64->128 bit multiply
+static inline uint64_t _float_umul128(uint64_t a, uint64_t b, uint64_t *hi)
+{
+	const unsigned __int128 p = (unsigned __int128) a * b;
+	*hi = (uint64_t) (p >> 64U);
+	return (uint64_t) p;
+}
+
+// (m * mul) >> j of a 125 bit table entry, 64 < j < 128
+static inline uint64_t _float_mul_shift(uint64_t m, const uint64_t *mul, int j)
+{
+	const unsigned __int128 b0 = (unsigned __int128) m * mul[0];
+	const unsigned __int128 b2 = (unsigned __int128) m * mul[1];
+	return (uint64_t) (((b0 >> 64U) + b2) >> (j - 64));
+}
+#else
+// 64x64->128 bit multiply from 32 bit halves
+static inline uint64_t _float_umul128(uint64_t a, uint64_t b, uint64_t *hi)
+{
+	const uint64_t a_lo = (uint32_t) a, a_hi = a >> 32U;
+	const uint64_t b_lo = (uint32_t) b, b_hi = b >> 32U;
+	const uint64_t b00 = a_lo * b_lo, b01 = a_lo * b_hi, b10 = a_hi * b_lo, b11 = a_hi * b_hi;
+	const uint64_t mid1 = b10 + (b00 >> 32U);
+	const uint64_t mid2 = b01 + (uint32_t) mid1;
+	*hi = b11 + (mid1 >> 32U) + (mid2 >> 32U);
+	return (mid2 << 32U) | (uint32_t) b00;
+}
+
+// (m * mul) >> j of a 125 bit table entry, 64 < j < 128
+static inline uint64_t _float_mul_shift(uint64_t m, const uint64_t *mul, int j)
+{
+	uint64_t high0, high1;
+	_float_umul128(m, mul[0], &high0);
+	const uint64_t low1 = _float_umul128(m, mul[1], &high1);
+	const uint64_t sum = high0 + low1;
+	if (sum < high0)
+	{
+		high1++;
+	}
+	const int shift = j - 64;
+	return (shift < 64) ? ((high1 << (63 - shift) << 1U) | (sum >> shift)) : (high1 >> (shift - 64));
+}
+#endif
+
+#if defined(PRINTF_FLOAT_REDUCED_TABLE)
+// result = ((mul * m) >> delta) + add, 128 bit, 0 < delta < 64
+static void _float_mul_shift_add(const uint64_t *mul, uint64_t m, int delta, uint64_t add, uint64_t *result)
+{
+#if defined(__SIZEOF_INT128__)
+	const unsigned __int128 b0 = (unsigned __int128) m * mul[0];
+	const unsigned __int128 b2 = (unsigned __int128) m * mul[1];
+	const unsigned __int128 sum = (b0 >> delta) + (b2 << (64 - delta)) + add;
+	result[0] = (uint64_t) sum;
+	result[1] = (uint64_t) (sum >> 64U);
+#else
+	uint64_t b0_hi, b2_hi;
+	const uint64_t b0_lo = _float_umul128(m, mul[0], &b0_hi);
+	const uint64_t b2_lo = _float_umul128(m, mul[1], &b2_hi);
+	// b0 >> delta plus b2 << (64 - delta)
+	uint64_t lo = (b0_hi << (64 - delta)) | (b0_lo >> delta);
+	uint64_t hi = (b0_hi >> delta) + ((b2_hi << (64 - delta)) | (b2_lo >> delta));
+	const uint64_t mid = b2_lo << (64 - delta);
+	lo += mid;
+	hi += (lo < mid) ? 1U : 0U;
+	lo += add;
+	hi += (lo < add) ? 1U : 0U;
+	result[0] = lo;
+	result[1] = hi;
+#endif
+}
+#endif
+
+// 5^i scaled to 125 bits
+static void _float_pow5_entry(unsigned int i, uint64_t *result)
+{
+#if !defined(PRINTF_FLOAT_REDUCED_TABLE)
+	result[0] = _float_table_read(&_float_pow5[i][0]);
+	result[1] = _float_table_read(&_float_pow5[i][1]);
+#else
+	const unsigned int base = i / 26U;
+	const unsigned int offset = i - base * 26U;
+	const uint64_t mul[2] = { _float_table_read(&_float_pow5_base[base][0]), _float_table_read(&_float_pow5_base[base][1]) };
+	if (offset == 0U)
+	{
+		result[0] = mul[0];
+		result[1] = mul[1];
+		return;
+	}
+	const int delta = _float_pow5bits((int) i) - _float_pow5bits((int) (base * 26U));
+	const uint32_t corr = (_printf_table_read32(_float_pow5_corr, i / 16U) >> ((i % 16U) * 2U)) & 3U;
+	_float_mul_shift_add(mul, _float_table_read(&_float_pow5_small[offset]), delta, corr, result);
+#endif
+}
+
+// 2^k / 5^i scaled to 125 bits, rounded up
+static void _float_pow5_inv_entry(unsigned int i, uint64_t *result)
+{
+#if !defined(PRINTF_FLOAT_REDUCED_TABLE)
+	result[0] = _float_table_read(&_float_pow5_inv[i][0]);
+	result[1] = _float_table_read(&_float_pow5_inv[i][1]);
+#else
+	const unsigned int base = (i + 25U) / 26U;
+	const unsigned int offset = base * 26U - i;
+	uint64_t mul[2] = { _float_table_read(&_float_pow5_inv_base[base][0]), _float_table_read(&_float_pow5_inv_base[base][1]) };
+	if (offset == 0U)
+	{
+		result[0] = mul[0];
+		result[1] = mul[1];
+		return;
+	}
+	// the table rounds up, the product starts from the rounded down value
+	if (mul[0]-- == 0U)
+	{
+		mul[1]--;
+	}
+	const int delta = _float_pow5bits((int) (base * 26U)) - _float_pow5bits((int) i);
+	const uint32_t corr = (_printf_table_read32(_float_pow5_inv_corr, i / 16U) >> ((i % 16U) * 2U)) & 3U;
+	_float_mul_shift_add(mul, _float_table_read(&_float_pow5_small[offset]), delta, 1U + corr, result);
+#endif
+}
+
+static inline unsigned int _float_pow5_factor(uint64_t value)
+{
+	unsigned int count = 0U;
+	while ((value % 5U) == 0U)
+	{
+		value /= 5U;
+		count++;
+	}
+	return count;
+}
+
+// shortest digits that read back to the same value, Ryu (Ulf Adams, PLDI 2018)
+static void _float_shortest(uint64_t ieee_mantissa, unsigned int ieee_exponent, _float_decimal *d)
+{
+	int e2;
+	uint64_t m2;
+	if (ieee_exponent == 0U)
+	{
+		e2 = 1 - _PRINTF_FLOAT_BIAS - _PRINTF_FLOAT_MANTISSA_BITS - 2;
+		m2 = ieee_mantissa;
+	}
+	else
+	{
+		e2 = (int) ieee_exponent - _PRINTF_FLOAT_BIAS - _PRINTF_FLOAT_MANTISSA_BITS - 2;
+		m2 = (1ULL << _PRINTF_FLOAT_MANTISSA_BITS) | ieee_mantissa;
+	}
+	d->m2 = m2;
+	d->e2 = e2 + 2;
+
+	const bool accept_bounds = (m2 & 1U) == 0U;
+	// the interval of values that read back to this one, scaled by 4: mv - 1 - mm_shift .. mv + 2
+	const uint64_t mv = 4U * m2;
+	const unsigned int mm_shift = ((ieee_mantissa != 0U) || (ieee_exponent <= 1U)) ? 1U : 0U;
+
+	uint64_t vr, vp, vm;
+	uint64_t mul[2];
+	int e10;
+	bool vm_trailing_zeros = false, vr_trailing_zeros = false;
+	if (e2 >= 0)
+	{
+		const int q = _float_log10_pow2(e2) - ((e2 > 3) ? 1 : 0);
+		e10 = q;
+		const int k = 125 + _float_pow5bits(q) - 1;
+		const int i = -e2 + q + k;
+		_float_pow5_inv_entry((unsigned int) q, mul);
+		vr = _float_mul_shift(mv, mul, i);
+		vp = _float_mul_shift(mv + 2U, mul, i);
+		vm = _float_mul_shift(mv - 1U - mm_shift, mul, i);
+		if (q <= 21)
+		{
+			// only one of mp, mv and mm can be a multiple of 5, if any
+			if ((mv % 5U) == 0U)
+			{
+				vr_trailing_zeros = _float_pow5_factor(mv) >= (unsigned int) q;
+			}
+			else if (accept_bounds)
+			{
+				vm_trailing_zeros = _float_pow5_factor(mv - 1U - mm_shift) >= (unsigned int) q;
+			}
+			else
+			{
+				vp -= (_float_pow5_factor(mv + 2U) >= (unsigned int) q) ? 1U : 0U;
+			}
+		}
+	}
+	else
+	{
+		const int q = _float_log10_pow5(-e2) - ((-e2 > 1) ? 1 : 0);
+		e10 = q + e2;
+		const int i = -e2 - q;
+		const int k = _float_pow5bits(i) - 125;
+		const int j = q - k;
+		_float_pow5_entry((unsigned int) i, mul);
+		vr = _float_mul_shift(mv, mul, j);
+		vp = _float_mul_shift(mv + 2U, mul, j);
+		vm = _float_mul_shift(mv - 1U - mm_shift, mul, j);
+		if (q <= 1)
+		{
+			// mv = 4 * m2 always has two trailing zero bits, mp one, mm one if mm_shift
+			vr_trailing_zeros = true;
+			if (accept_bounds)
+			{
+				vm_trailing_zeros = mm_shift == 1U;
+			}
+			else
+			{
+				vp--;
+			}
+		}
+		else if (q < 63)
+		{
+			vr_trailing_zeros = (mv & ((1ULL << q) - 1U)) == 0U;
+		}
+	}
+
+	// remove digits while vp and vm still differ, vr follows with the last removed digit for rounding
+	int removed = 0;
+	unsigned int last_removed = 0U;
+	uint64_t output;
+	if (vm_trailing_zeros || vr_trailing_zeros)
+	{
+		// rare: the bounds or the value are exact decimals, ties need care
+		while ((vp / 10U) > (vm / 10U))
+		{
+			vm_trailing_zeros = vm_trailing_zeros && ((vm % 10U) == 0U);
+			vr_trailing_zeros = vr_trailing_zeros && (last_removed == 0U);
+			last_removed = (unsigned int) (vr % 10U);
+			vr /= 10U;
+			vp /= 10U;
+			vm /= 10U;
+			removed++;
+		}
+		if (vm_trailing_zeros)
+		{
+			while ((vm % 10U) == 0U)
+			{
+				vr_trailing_zeros = vr_trailing_zeros && (last_removed == 0U);
+				last_removed = (unsigned int) (vr % 10U);
+				vr /= 10U;
+				vp /= 10U;
+				vm /= 10U;
+				removed++;
+			}
+		}
+		if (vr_trailing_zeros && (last_removed == 5U) && ((vr % 2U) == 0U))
+		{
+			// exactly halfway, round to even
+			last_removed = 4U;
+		}
+		output = vr + ((((vr == vm) && (!accept_bounds || !vm_trailing_zeros)) || (last_removed >= 5U)) ? 1U : 0U);
+	}
+	else
+	{
+		bool round_up = false;
+		if ((vp / 100U) > (vm / 100U))
+		{
+			round_up = (vr % 100U) >= 50U;
+			vr /= 100U;
+			vp /= 100U;
+			vm /= 100U;
+			removed += 2;
+		}
+		while ((vp / 10U) > (vm / 10U))
+		{
+			round_up = (vr % 10U) >= 5U;
+			vr /= 10U;
+			vp /= 10U;
+			vm /= 10U;
+			removed++;
+		}
+		output = vr + (((vr == vm) || round_up) ? 1U : 0U);
+	}
+	e10 += removed;
+
+	// no trailing zeros, the rounding below relies on it
+	while ((output % 10U) == 0U)
+	{
+		output /= 10U;
+		e10++;
+	}
+	unsigned int length = 1U;
+	while ((length < 20U) && (output >= _float_table_read(&_float_pow10[length])))
+	{
+		length++;
+	}
+	d->digits = output;
+	d->exp10 = e10;
+	d->length = length;
+}
+
+static void _float_big_mul(_float_big *big, uint32_t m)
+{
+	uint64_t carry = 0U;
+	for (unsigned int i = 0U; i < big->n; i++)
+	{
+		carry += (uint64_t) big->w[i] * m;
+		big->w[i] = (uint32_t) carry;
+		carry >>= 32U;
+	}
+	if (carry && (big->n < _PRINTF_FLOAT_BIG_WORDS))
+	{
+		big->w[big->n++] = (uint32_t) carry;
+	}
+}
+
+// big = value * 5^e
+static void _float_big_pow5(_float_big *big, uint64_t value, unsigned int e)
+{
+	big->w[0] = (uint32_t) value;
+	big->w[1] = (uint32_t) (value >> 32U);
+	big->n = big->w[1] ? 2U : 1U;
+	for (; e >= 13U; e -= 13U)
+	{
+		_float_big_mul(big, 1220703125U);
+	}
+	if (e)
+	{
+		_float_big_mul(big, (uint32_t) (_float_table_read(&_float_pow10[e]) >> e));
+	}
+}
+
+static unsigned int _float_big_bits(const _float_big *big)
+{
+	unsigned int n = big->n;
+	while (n && (big->w[n - 1U] == 0U))
+	{
+		n--;
+	}
+	if (!n)
+	{
+		return 0U;
+	}
+	unsigned int bits = (n - 1U) * 32U;
+	for (uint32_t top = big->w[n - 1U]; top; top >>= 1U)
+	{
+		bits++;
+	}
+	return bits;
+}
+
+// 64 bits of big starting at bit 'shift'
+static uint64_t _float_big_bits_at(const _float_big *big, unsigned int shift)
+{
+	uint64_t result = 0U;
+	const unsigned int word = shift / 32U, bit = shift % 32U;
+	for (unsigned int i = 0U; i < 3U; i++)
+	{
+		const uint64_t w = (word + i < big->n) ? big->w[word + i] : 0U;
+		const int at = (int) (i * 32U) - (int) bit;
+		result |= (at >= 0) ? (w << at) : (w >> -at);
+	}
+	return result;
+}
+
+// sign of big - value * 2^t
+static int _float_big_compare(const _float_big *big, uint64_t value, int t)
+{
+	const int bits = (int) _float_big_bits(big);
+	int value_bits = 0;
+	for (uint64_t v = value; v; v >>= 1U)
+	{
+		value_bits++;
+	}
+	if (!value_bits)
+	{
+		return bits ? 1 : 0;
+	}
+	if (bits != value_bits + t)
+	{
+		return (bits > value_bits + t) ? 1 : -1;
+	}
+	if (t < 0)
+	{
+		// big has fewer than 64 bits here
+		const uint64_t left = _float_big_bits_at(big, 0U) << -t;
+		return (left > value) ? 1 : ((left < value) ? -1 : 0);
+	}
+	const uint64_t top = _float_big_bits_at(big, (unsigned int) t);
+	if (top != value)
+	{
+		return (top > value) ? 1 : -1;
+	}
+	// equal on top, anything left below makes big larger
+	for (unsigned int i = 0U; i < (unsigned int) t / 32U; i++)
+	{
+		if (big->w[i])
+		{
+			return 1;
+		}
+	}
+	return (t % 32) && (big->w[t / 32] << (32 - t % 32)) ? 1 : 0;
+}
+
+// exact sign of value - c * 10^u * 2^p2
+static int _float_compare(const _float_decimal *d, uint64_t c, int u, int p2)
+{
+	_float_big big;
+	const int t = d->e2 - u - p2;
+	if (u >= 0)
+	{
+		// m2 * 2^t against c * 5^u
+		_float_big_pow5(&big, c, (unsigned int) u);
+		return -_float_big_compare(&big, d->m2, t);
+	}
+	// m2 * 5^-u * 2^t against c
+	_float_big_pow5(&big, d->m2, (unsigned int) -u);
+	return _float_big_compare(&big, c, -t);
+}
+
+// true when value rounds (half even) above n * 10^u
+static inline bool _float_above(const _float_decimal *d, uint64_t n, int u)
+{
+	const int c = _float_compare(d, 2U * n + 1U, u, -1);
+	return (c > 0) || ((c == 0) && (n & 1U));
+}
+
+// decimal exponent of the first digit of the exact value, callers that round to DBL_DIG digits or less
+// can take the shortest form's exponent of a normal value: it is only off when they round up anyway
+static int _float_exponent(const _float_decimal *d)
+{
+	const int e = d->exp10 + (int) d->length - 1;
+	// only a shortest 10^e can stand for a value just below it, e.g. 1e23 or 1e-323
+	return ((d->digits == 1U) && (_float_compare(d, 1U, e, 0) < 0)) ? e - 1 : e;
+}
+
+// value / 10^u rounded half even, the caller keeps it to _PRINTF_FLOAT_DIGITS significant digits (+ carry)
+static uint64_t _float_round(const _float_decimal *d, int u)
+{
+	if (u >= d->exp10)
+	{
+		// dropping digits of the shortest form rounds the same as the exact value, except on a tie
+		const unsigned int k = (unsigned int) (u - d->exp10);
+		if (k > d->length)
+		{
+			return 0U;
+		}
+		const uint64_t scale = _float_table_read(&_float_pow10[k]);
+		uint64_t n = d->digits / scale;
+		const uint64_t rem = d->digits - n * scale;
+		if ((rem > scale / 2U) || ((rem == scale / 2U) && rem && _float_above(d, n, u)))
+		{
+			n++;
+		}
+		return n;
+	}
+
+	// up to DBL_DIG significant digits the zeros padding the shortest form of a normal value are exact
+	uint64_t n = d->digits * _float_table_read(&_float_pow10[d->exp10 - u]);
+	if ((d->exp10 + (int) d->length - u <= DBL_DIG) && (d->m2 >> _PRINTF_FLOAT_MANTISSA_BITS))
+	{
+		return n;
+	}
+	if (u < 0)
+	{
+		// digits below what the shortest form pins down: floor(m2 * 5^-u * 2^(e2 - u)), then round
+		_float_big big;
+		_float_big_pow5(&big, d->m2, (unsigned int) -u);
+		const int shift = u - d->e2;
+		if (shift <= 0)
+		{
+			return _float_big_bits_at(&big, 0U) << -shift;
+		}
+		n = _float_big_bits_at(&big, (unsigned int) shift);
+		// half even on the bits shifted out
+		const unsigned int half = (unsigned int) shift - 1U;
+		if (_float_big_bits_at(&big, half) & 1U)
+		{
+			bool above = (n & 1U) != 0U;
+			for (unsigned int i = 0U; !above && (i <= half / 32U) && (i < big.n); i++)
+			{
+				above = ((i < half / 32U) ? big.w[i] : (big.w[i] & ((1U << (half % 32U)) - 1U))) != 0U;
+			}
+			n += above ? 1U : 0U;
+		}
+		return n;
+	}
+	// more digits of a value >= 1, the shortest form is within a few units of the result
+	while (_float_above(d, n, u))
+	{
+		n++;
+	}
+	while (n && !_float_above(d, n - 1U, u))
+	{
+		n--;
+	}
+	return n;
+}
+
+// %f of m2 * 2^e2 without the shortest digits: m2 * 10^prec fits 128 bits, shifted right by -e2 and
+// rounded half even. False when the value needs the general path (integer part >= 2^52, tiny values,
+// more than _PRINTF_FLOAT_DIGITS digits)
+static bool _float_fixed(uint64_t m2, int e2, unsigned int prec, uint64_t *n)
+{
+	if ((prec >= 20U) || (e2 >= 0) || (e2 <= -128))
+	{
+		return false;
+	}
+	uint64_t hi;
+	const uint64_t lo = _float_umul128(m2, _float_table_read(&_float_pow10[prec]), &hi);
+	const unsigned int s = (unsigned int) -e2;
+	uint64_t q;
+	bool round_up;
+	if (s < 64U)
+	{
+		if (hi >> s)
+		{
+			return false;
+		}
+		q = (hi << (64U - s)) | (lo >> s);
+		const uint64_t rest = lo & ((1ULL << s) - 1U);
+		const uint64_t half = 1ULL << (s - 1U);
+		round_up = (rest > half) || ((rest == half) && (q & 1U));
+	}
+	else
+	{
+		q = hi >> (s - 64U);
+		const uint64_t rest_hi = (s > 64U) ? (hi & ((1ULL << (s - 64U)) - 1U)) : 0U;
+		const uint64_t half_hi = (s > 64U) ? (1ULL << (s - 65U)) : 0U;
+		const uint64_t half_lo = (s > 64U) ? 0U : (1ULL << 63U);
+		round_up = (rest_hi > half_hi) || ((rest_hi == half_hi) && ((lo > half_lo) || ((lo == half_lo) && (q & 1U))));
+	}
+	q += round_up ? 1U : 0U;
+	if (q >= _float_table_read(&_float_pow10[_PRINTF_FLOAT_DIGITS]))
+	{
+		return false;
+	}
+	*n = q;
+	return true;
+}
+
+// formats value in style 'f', 'e', 'g' or 's' (shortest, %g like), digits past _PRINTF_FLOAT_DIGITS are 0
+static size_t _float_format(out_fct_type out, char *buffer, size_t idx, size_t maxlen, double value, unsigned int prec, unsigned int width, unsigned int flags, char style)
+{
+	_float_bits_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	const bool negative = (bits >> (_PRINTF_FLOAT_MANTISSA_BITS + _PRINTF_FLOAT_EXPONENT_BITS)) != 0U;
+	const unsigned int ieee_exponent = (unsigned int) (bits >> _PRINTF_FLOAT_MANTISSA_BITS) & ((1U << _PRINTF_FLOAT_EXPONENT_BITS) - 1U);
+	const uint64_t ieee_mantissa = bits & ((((_float_bits_t) 1U) << _PRINTF_FLOAT_MANTISSA_BITS) - 1U);
+
+	if (!(flags & FLAGS_PRECISION))
+	{
+		prec = PRINTF_DEFAULT_FLOAT_PRECISION;
+	}
+
+	const char *special = nullptr;
+	uint64_t n = 0U;
+	int unit = 0;                 // n * 10^unit is the printed value
+	int exp = 0;                  // exponent of the 'e' form
+	unsigned int zeros = 0U;      // 'e' form: zeros after the digits of n
+	unsigned int decimals = 0U;   // fixed form: digits after the point
+	bool fixed = true;
+
+	if (ieee_exponent == ((1U << _PRINTF_FLOAT_EXPONENT_BITS) - 1U))
+	{
+		special = ieee_mantissa ? ((flags & FLAGS_UPPERCASE) ? "NAN" : "nan") : ((flags & FLAGS_UPPERCASE) ? "INF" : "inf");
+	}
+	else
+	{
+		_float_decimal d;
+		const bool zero = (ieee_exponent == 0U) && (ieee_mantissa == 0U);
+		if (!zero && (style != 'f'))
+		{
+			_float_shortest(ieee_mantissa, ieee_exponent, &d);
+		}
+
+		if (style == 'f')
+		{
+			decimals = prec;
+			unit = -(int) prec;
+			const uint64_t m2 = ieee_exponent ? ((1ULL << _PRINTF_FLOAT_MANTISSA_BITS) | ieee_mantissa) : ieee_mantissa;
+			const int e2 = (int) (ieee_exponent ? ieee_exponent : 1U) - _PRINTF_FLOAT_BIAS - _PRINTF_FLOAT_MANTISSA_BITS;
+			if (!zero && !_float_fixed(m2, e2, prec, &n))
+			{
+				_float_shortest(ieee_mantissa, ieee_exponent, &d);
+				int e = d.exp10 + (int) d.length - 1;
+				if ((e + (int) prec + 1 > DBL_DIG) || !(d.m2 >> _PRINTF_FLOAT_MANTISSA_BITS))
+				{
+					e = _float_exponent(&d);
+				}
+				if (e + (int) prec + 1 > _PRINTF_FLOAT_DIGITS)
+				{
+					unit = e - (_PRINTF_FLOAT_DIGITS - 1);
+				}
+				n = _float_round(&d, unit);
+			}
+		}
+		else if (style == 's')
+		{
+			// shortest digits, fixed between 1e-4 and 1e17 like %.17g of a double
+			if (!zero)
+			{
+				n = d.digits;
+				unit = d.exp10;
+				exp = d.exp10 + (int) d.length - 1;
+			}
+			fixed = (exp >= -4) && (exp < 17);
+			decimals = (unit < 0) ? (unsigned int) -unit : 0U;
+		}
+		else
+		{
+			// p significant digits, %g counts the precision that way
+			const unsigned int p = (style == 'g') ? (prec ? prec : 1U) : prec + 1U;
+			const unsigned int pc = (p > _PRINTF_FLOAT_DIGITS) ? _PRINTF_FLOAT_DIGITS : p;
+			zeros = p - pc;
+			if (zero)
+			{
+				zeros = p - 1U;
+			}
+			else
+			{
+				exp = d.exp10 + (int) d.length - 1;
+				if ((p > DBL_DIG) || !(d.m2 >> _PRINTF_FLOAT_MANTISSA_BITS))
+				{
+					exp = _float_exponent(&d);
+				}
+				unit = exp - (int) pc + 1;
+				n = _float_round(&d, unit);
+				if (n >= _float_table_read(&_float_pow10[pc]))
+				{
+					// rounded up to the next power of 10
+					n /= 10U;
+					unit++;
+					exp++;
+				}
+			}
+
+			fixed = false;
+			if (style == 'g')
+			{
+				if (((int) p > exp) && (exp >= -4))
+				{
+					fixed = true;
+					decimals = (unsigned int) ((int) p - 1 - exp);
+				}
+				if (!(flags & FLAGS_HASH))
+				{
+					// %g drops trailing zeros
+					while (n && ((n % 10U) == 0U))
+					{
+						n /= 10U;
+						unit++;
+					}
+					zeros = 0U;
+					if (zero)
+					{
+						unit = 0;
+					}
+					if (fixed && ((unit >= 0) || (decimals > (unsigned int) -unit)))
+					{
+						decimals = (unit >= 0) ? 0U : (unsigned int) -unit;
+					}
+				}
+			}
+		}
+	}
+
+	// significant digits of n in reverse
+	char digits[20];
+#if defined(PRINTF_FAST_NTOA) && (defined(PRINTF_SUPPORT_LONG_LONG) || (ULONG_MAX > 0xFFFFFFFFUL))
+	const unsigned int count = (unsigned int) _ntoa_dec64(digits, 0U, n);
+#else
+	unsigned int count = 0U;
+	do
+	{
+		digits[count++] = (char) ('0' + (n % 10U));
+		n /= 10U;
+	} while (n);
+#endif
+
+	// length of the number without sign
+	size_t length;
+	const int top = (int) count - 1 + unit;   // decimal position of the first digit (fixed form)
+	const unsigned int fraction = count - 1U + zeros;
+	const unsigned int exp_abs = (exp < 0) ? (unsigned int) -exp : (unsigned int) exp;
+	if (special)
+	{
+		length = 3U;
+	}
+	else if (fixed)
+	{
+		length = (size_t) ((top > 0) ? top + 1 : 1) + ((decimals || (flags & FLAGS_HASH)) ? 1U : 0U) + decimals;
+	}
+	else
+	{
+		length = 1U + ((fraction || (flags & FLAGS_HASH)) ? 1U : 0U) + fraction + 2U + ((exp_abs >= 100U) ? 3U : 2U);
+	}
+
+	char sign = 0;
+	if (negative)
+	{
+		sign = '-';
+	}
+	else if (flags & FLAGS_PLUS)
+	{
+		sign = '+';
+	}
+	else if (flags & FLAGS_SPACE)
+	{
+		sign = ' ';
+	}
+	length += sign ? 1U : 0U;
+
+	// pre padding, zeros go after the sign
+	const bool zeropad = !special && (flags & FLAGS_ZEROPAD) && !(flags & FLAGS_LEFT);
+	if (!(flags & FLAGS_LEFT) && !zeropad)
+	{
+		for (size_t i = length; i < width; i++)
+		{
+			out(' ', buffer, idx++, maxlen);
+		}
+	}
+	if (sign)
+	{
+		out(sign, buffer, idx++, maxlen);
+	}
+	if (zeropad)
+	{
+		for (size_t i = length; i < width; i++)
+		{
+			out('0', buffer, idx++, maxlen);
+		}
+	}
+
+	if (special)
+	{
+		for (unsigned int i = 0U; i < 3U; i++)
+		{
+			out(special[i], buffer, idx++, maxlen);
+		}
+	}
+	else if (fixed)
+	{
+		for (int pos = (top > 0) ? top : 0; pos >= -(int) decimals; pos--)
+		{
+			const int i = top - pos;
+			out(((i >= 0) && (i < (int) count)) ? digits[(int) count - 1 - i] : '0', buffer, idx++, maxlen);
+			if ((pos == 0) && (decimals || (flags & FLAGS_HASH)))
+			{
+				out('.', buffer, idx++, maxlen);
+			}
+		}
+	}
+	else
+	{
+		out(digits[count - 1U], buffer, idx++, maxlen);
+		if (fraction || (flags & FLAGS_HASH))
+		{
+			out('.', buffer, idx++, maxlen);
+		}
+		for (unsigned int i = count - 1U; i > 0U; i--)
+		{
+			out(digits[i - 1U], buffer, idx++, maxlen);
+		}
+		for (unsigned int i = 0U; i < zeros; i++)
+		{
+			out('0', buffer, idx++, maxlen);
+		}
+		out((flags & FLAGS_UPPERCASE) ? 'E' : 'e', buffer, idx++, maxlen);
+		out((exp < 0) ? '-' : '+', buffer, idx++, maxlen);
+		if (exp_abs >= 100U)
+		{
+			out((char) ('0' + exp_abs / 100U), buffer, idx++, maxlen);
+		}
+		out((char) ('0' + (exp_abs / 10U) % 10U), buffer, idx++, maxlen);
+		out((char) ('0' + exp_abs % 10U), buffer, idx++, maxlen);
+	}
+
+	// post padding
+	if (flags & FLAGS_LEFT)
 	{
-		do
+		for (size_t i = length; i < width; i++)
 		{
-			const char digit = (char) (value % base);
-			buf[len++] = digit < 10 ? '0' + digit : (flags & FLAGS_UPPERCASE ? 'A' : 'a') + digit - 10;
-			value /= base;
-		} while (value && (len < PRINTF_NTOA_BUFFER_SIZE));
+			out(' ', buffer, idx++, maxlen);
+		}
 	}
+	return idx;
+}
 
-	return _ntoa_format(out, buffer, idx, maxlen, buf, len, negative, (unsigned int) base, prec, width, flags);
+// internal ftoa for fixed decimal floating point
+static size_t _ftoa(out_fct_type out, char *buffer, size_t idx, size_t maxlen, double value, unsigned int prec, unsigned int width, unsigned int flags)
+{
+	return _float_format(out, buffer, idx, maxlen, value, prec, width, flags, 'f');
 }
-#endif  // PRINTF_SUPPORT_LONG_LONG
 
-#if defined(PRINTF_SUPPORT_FLOAT)
+#if defined(PRINTF_SUPPORT_EXPONENTIAL)
+// internal ftoa variant for exponential floating-point type, %g with FLAGS_ADAPT_EXP
+static size_t _etoa(out_fct_type out, char *buffer, size_t idx, size_t maxlen, double value, unsigned int prec, unsigned int width, unsigned int flags)
+{
+	return _float_format(out, buffer, idx, maxlen, value, prec, width, flags, (flags & FLAGS_ADAPT_EXP) ? 'g' : 'e');
+}
+#endif  // PRINTF_SUPPORT_EXPONENTIAL
+#else
 
 #if defined(PRINTF_SUPPORT_EXPONENTIAL)
 // forward declaration so that _ftoa can switch to exp notation for values > PRINTF_MAX_FLOAT
@@ -672,8 +1818,81 @@ static size_t _etoa(out_fct_type out, char *buffer, size_t idx, size_t maxlen, d
 	return idx;
 }
 #endif  // PRINTF_SUPPORT_EXPONENTIAL
+#endif  // PRINTF_FLOAT_ENGINE
 #endif  // PRINTF_SUPPORT_FLOAT
 
+// internal char format with padding
+static size_t _ctoa(out_fct_type out, char *buffer, size_t idx, size_t maxlen, char character, unsigned int width, unsigned int flags)
+{
+	unsigned int l = 1U;
+	// pre padding
+	if (!(flags & FLAGS_LEFT))
+	{
+		while (l++ < width)
+		{
+			out(' ', buffer, idx++, maxlen);
+		}
+	}
+	// char output
+	out(character, buffer, idx++, maxlen);
+	// post padding
+	if (flags & FLAGS_LEFT)
+	{
+		while (l++ < width)
+		{
+			out(' ', buffer, idx++, maxlen);
+		}
+	}
+	return idx;
+}
+
+// internal string format with precision and padding
+static size_t _stoa(out_fct_type out, char *buffer, size_t idx, size_t maxlen, const char *p, unsigned int precision, unsigned int width, unsigned int flags)
+{
+	unsigned int l = _strnlen_s(p, precision ? precision : (size_t) -1);
+	// pre padding
+	if (flags & FLAGS_PRECISION)
+	{
+		l = (l < precision ? l : precision);
+	}
+	if (!(flags & FLAGS_LEFT))
+	{
+		while (l++ < width)
+		{
+			out(' ', buffer, idx++, maxlen);
+		}
+	}
+	// string output
+	while ((*p != 0) && (!(flags & FLAGS_PRECISION) || precision--))
+	{
+		out(*(p++), buffer, idx++, maxlen);
+	}
+	// post padding
+	if (flags & FLAGS_LEFT)
+	{
+		while (l++ < width)
+		{
+			out(' ', buffer, idx++, maxlen);
+		}
+	}
+	return idx;
+}
+
+// internal pointer format, all hex digits of the address
+static size_t _ptoa(out_fct_type out, char *buffer, size_t idx, size_t maxlen, const void *pointer, unsigned int precision, unsigned int flags)
+{
+	const unsigned int width = sizeof(void*) * 2U;
+	flags |= FLAGS_ZEROPAD | FLAGS_UPPERCASE;
+#if defined(PRINTF_SUPPORT_LONG_LONG)
+	const bool is_ll = sizeof(uintptr_t) == sizeof(long long);
+	if (is_ll)
+	{
+		return _ntoa_long_long(out, buffer, idx, maxlen, (uintptr_t) pointer, false, 16U, precision, width, flags);
+	}
+#endif
+	return _ntoa_long(out, buffer, idx, maxlen, (unsigned long) ((uintptr_t) pointer), false, 16U, precision, width, flags);
+}
+
 // internal vsnprintf
 static int _vsnprintf(out_fct_type out, char *buffer, const size_t maxlen, const char *format, va_list va)
 {
@@ -932,83 +2151,19 @@ static int _vsnprintf(out_fct_type out, char *buffer, const size_t maxlen, const
 #endif  // PRINTF_SUPPORT_EXPONENTIAL
 #endif  // PRINTF_SUPPORT_FLOAT
 		case 'c':
-		{
-			unsigned int l = 1U;
-			// pre padding
-			if (!(flags & FLAGS_LEFT))
-			{
-				while (l++ < width)
-				{
-					out(' ', buffer, idx++, maxlen);
-				}
-			}
-			// char output
-			out((char) va_arg(va, int), buffer, idx++, maxlen);
-			// post padding
-			if (flags & FLAGS_LEFT)
-			{
-				while (l++ < width)
-				{
-					out(' ', buffer, idx++, maxlen);
-				}
-			}
+			idx = _ctoa(out, buffer, idx, maxlen, (char) va_arg(va, int), width, flags);
 			format++;
 			break;
-		}
 
 		case 's':
-		{
-			const char *p = va_arg(va, char*);
-			unsigned int l = _strnlen_s(p, precision ? precision : (size_t) -1);
-			// pre padding
-			if (flags & FLAGS_PRECISION)
-			{
-				l = (l < precision ? l : precision);
-			}
-			if (!(flags & FLAGS_LEFT))
-			{
-				while (l++ < width)
-				{
-					out(' ', buffer, idx++, maxlen);
-				}
-			}
-			// string output
-			while ((*p != 0) && (!(flags & FLAGS_PRECISION) || precision--))
-			{
-				out(*(p++), buffer, idx++, maxlen);
-			}
-			// post padding
-			if (flags & FLAGS_LEFT)
-			{
-				while (l++ < width)
-				{
-					out(' ', buffer, idx++, maxlen);
-				}
-			}
+			idx = _stoa(out, buffer, idx, maxlen, va_arg(va, char*), precision, width, flags);
 			format++;
 			break;
-		}
 
 		case 'p':
-		{
-			width = sizeof(void*) * 2U;
-			flags |= FLAGS_ZEROPAD | FLAGS_UPPERCASE;
-#if defined(PRINTF_SUPPORT_LONG_LONG)
-			const bool is_ll = sizeof(uintptr_t) == sizeof(long long);
-			if (is_ll)
-			{
-				idx = _ntoa_long_long(out, buffer, idx, maxlen, (uintptr_t) va_arg(va, void*), false, 16U, precision, width, flags);
-			}
-			else
-			{
-#endif
-				idx = _ntoa_long(out, buffer, idx, maxlen, (unsigned long) ((uintptr_t) va_arg(va, void*)), false, 16U, precision, width, flags);
-#if defined(PRINTF_SUPPORT_LONG_LONG)
-			}
-#endif
+			idx = _ptoa(out, buffer, idx, maxlen, va_arg(va, void*), precision, flags);
 			format++;
 			break;
-		}
 
 		case '%':
 			out('%', buffer, idx++, maxlen);
@@ -1031,12 +2186,65 @@ static int _vsnprintf(out_fct_type out, char *buffer, const size_t maxlen, const
 
 ///////////////////////////////////////////////////////////////////////////////
 
+// formats through a chunk buffer on the stack, out_block gets the text once per chunk
+static int _vfctprintf_block(void (*out_block)(const char *data, size_t length, void *arg), void *arg, const char *format, va_list va)
+{
+	out_block_wrap_type out_block_wrap;
+	out_block_wrap.fct = out_block;
+	out_block_wrap.arg = arg;
+	out_block_wrap.length = 0U;
+	const int ret = _vsnprintf(_out_block, (char*) (uintptr_t) &out_block_wrap, (size_t) -1, format, va);
+	_out_block_flush(&out_block_wrap);
+	return ret;
+}
+
+#if defined(ASYNC_PRINTF) && (ASYNC_PRINTF == 1)
+// formats straight into the free space of the SerialAsync queue, the line is queued whole or, following the
+// overflow policy of the queue, not at all (counted as rejected). Only a line longer than the free space is
+// formatted a second time, into a reservation of its exact length once the policy made room for it
+static int _vprintf_async(const char *format, va_list va)
+{
+	Drivers::ByteSpan span;
+	if (!serial)
+	{
+		return _vsnprintf(_out_null, nullptr, (size_t) -1, format, va);
+	}
+
+	va_list again;
+	va_copy(again, va);
+	const uint16_t room = serial->Reserve(span);
+	int ret = _vsnprintf(_out_span, (char*) &span, (size_t) room, format, va);
+	if ((ret > 0) && ((size_t) ret <= room))
+	{
+		serial->Commit((uint16_t) ret);
+	}
+	else if ((ret > 0) && (serial->Reserve((uint16_t) ((ret > 0xFFFF) ? 0xFFFF : ret), span) != 0U))
+	{
+		_vsnprintf(_out_span, (char*) &span, (size_t) ret, format, again);
+		serial->Commit((uint16_t) ret);
+	}
+	va_end(again);
+	return ret;
+}
+
+void printf_SetOverflowPolicy(Drivers::SerialOverflow Policy, uint16_t TimeoutMs)
+{
+	if (serial)
+	{
+		serial->SetOverflowPolicy(Policy, TimeoutMs);
+	}
+}
+#endif
+
 int printf_(const char *format, ...)
 {
 	va_list va;
 	va_start(va, format);
-	char buffer[1];
-	const int ret = _vsnprintf(_out_char, buffer, (size_t) -1, format, va);
+#if defined(ASYNC_PRINTF) && (ASYNC_PRINTF == 1)
+	const int ret = _vprintf_async(format, va);
+#else
+	const int ret = _vfctprintf_block(_serial_block, nullptr, format, va);
+#endif
 	va_end(va);
 	return ret;
 }
@@ -1061,8 +2269,11 @@ int snprintf_(char *buffer, size_t count, const char *format, ...)
 
 int vprintf_(const char *format, va_list va)
 {
-	char buffer[1];
-	return _vsnprintf(_out_char, buffer, (size_t) -1, format, va);
+#if defined(ASYNC_PRINTF) && (ASYNC_PRINTF == 1)
+	return _vprintf_async(format, va);
+#else
+	return _vfctprintf_block(_serial_block, nullptr, format, va);
+#endif
 }
 
 int vsnprintf_(char *buffer, size_t count, const char *format, va_list va)
@@ -1070,6 +2281,71 @@ int vsnprintf_(char *buffer, size_t count, const char *format, va_list va)
 	return _vsnprintf(_out_buffer, buffer, count, format, va);
 }
 
+#if (DEFERRED_PRINTF == 1)
+int printf_deferred_send(const uint8_t *record, uint16_t length)
+{
+	if (!serial)
+	{
+		return 0;
+	}
+#if defined(ASYNC_PRINTF) && (ASYNC_PRINTF == 1)
+	// encoded straight into the queue, a record that doesn't fit is dropped whole
+	return (int) serial->WriteCobsFrame(record, length);
+#else
+	uint8_t frame[COBS_ENCODED_SIZE(PRINTF_DEFERRED_RECORD_SIZE)];
+	Drivers::CobsEncoder encoder;
+	encoder.Begin(frame, sizeof(frame), nullptr);
+	encoder.Put(record, length);
+	serial->write(frame, encoder.End());
+	return (int) length;
+#endif
+}
+#endif
+
+int fctprintf_block(void (*out_block)(const char *data, size_t length, void *arg), void *arg, const char *format, ...)
+{
+	va_list va;
+	va_start(va, format);
+	const int ret = _vfctprintf_block(out_block, arg, format, va);
+	va_end(va);
+	return ret;
+}
+
+int vfctprintf_block(void (*out_block)(const char *data, size_t length, void *arg), void *arg, const char *format, va_list va)
+{
+	return _vfctprintf_block(out_block, arg, format, va);
+}
+
+// chunk output of printf_to() to an Arduino Print
+static void _print_block(const char *data, size_t length, void *arg)
+{
+	((Print*) arg)->write((const uint8_t*) data, length);
+}
+
+int printf_to(Print &out, const char *format, ...)
+{
+	va_list va;
+	va_start(va, format);
+	const int ret = _vfctprintf_block(_print_block, &out, format, va);
+	va_end(va);
+	return ret;
+}
+
+int ftoa_shortest(char *buffer, size_t count, double value)
+{
+#if defined(PRINTF_SUPPORT_FLOAT) && defined(PRINTF_FLOAT_ENGINE)
+	const out_fct_type out = buffer ? _out_buffer : _out_null;
+	const size_t idx = _float_format(out, buffer, 0U, count, value, 0U, 0U, 0U, 's');
+	if (count)
+	{
+		out((char) 0, buffer, (idx < count) ? idx : count - 1U, count);
+	}
+	return (int) idx;
+#else
+	return snprintf_(buffer, count, "%.17g", value);
+#endif
+}
+
 int fctprintf(void (*out)(char character, void *arg), void *arg, const char *format, ...)
 {
 	va_list va;
@@ -1080,3 +2356,184 @@ int fctprintf(void (*out)(char character, void *arg), void *arg, const char *for
 	va_end(va);
 	return ret;
 }
+
+///////////////////////////////////////////////////////////////////////////////
+// emit kernels of printf_ct() & co, the parsing was done by PrintfCompiled.h
+
+#if !defined(PRINTF_DISABLE_COMPILED_FORMAT)
+static_assert((PrintfCompiled::FLAG_ZEROPAD == FLAGS_ZEROPAD) && (PrintfCompiled::FLAG_LEFT == FLAGS_LEFT) && (PrintfCompiled::FLAG_PLUS == FLAGS_PLUS) &&
+	(PrintfCompiled::FLAG_SPACE == FLAGS_SPACE) && (PrintfCompiled::FLAG_HASH == FLAGS_HASH) && (PrintfCompiled::FLAG_UPPERCASE == FLAGS_UPPERCASE) &&
+	(PrintfCompiled::FLAG_PRECISION == FLAGS_PRECISION) && (PrintfCompiled::FLAG_ADAPT_EXP == FLAGS_ADAPT_EXP), "Printf: PrintfCompiled flags out of sync");
+
+#if defined(ASYNC_PRINTF) && (ASYNC_PRINTF == 1)
+// internal output into the span reserved by PrintfCompiled::BeginPrintf() or RetryPrintf()
+static inline void _out_ct_span(char character, void *buffer, size_t idx, size_t maxlen)
+{
+	PrintfCompiled::Span *span = (PrintfCompiled::Span*) buffer;
+	if (character && (idx < maxlen))
+	{
+		if (idx < span->FirstLength)
+		{
+			span->First[idx] = (uint8_t) character;
+		}
+		else
+		{
+			span->Second[idx - span->FirstLength] = (uint8_t) character;
+		}
+	}
+}
+#endif
+
+#if defined(ASYNC_PRINTF) && (ASYNC_PRINTF == 1)
+static void _ct_reserved(PrintfCompiled::Output &o, const Drivers::ByteSpan &span, size_t length)
+{
+	o.Idx = 0U;
+	o.MaxLen = length;
+	o.Reserved.First = span.First;
+	o.Reserved.FirstLength = span.FirstLength;
+	o.Reserved.Second = span.Second;
+	o.Reserved.SecondLength = span.SecondLength;
+	o.Out = _out_ct_span;
+	o.Buffer = &o.Reserved;
+}
+#endif
+
+void PrintfCompiled::BeginPrintf(Output &o)
+{
+#if defined(ASYNC_PRINTF) && (ASYNC_PRINTF == 1)
+	Drivers::ByteSpan span = { nullptr, 0U, nullptr, 0U };
+	if (!serial)
+	{
+		BeginBuffer(o, nullptr, (size_t) -1);
+		return;
+	}
+	_ct_reserved(o, span, serial->Reserve(span));
+#else
+	static_assert(sizeof(Block) == sizeof(out_block_wrap_type), "Printf: PRINTF_CHUNK_BUFFER_SIZE differs from PrintfCompiled.h, set it globally");
+	o.Idx = 0U;
+	o.MaxLen = (size_t) -1;
+	o.Chunk.fct = _serial_block;
+	o.Chunk.arg = nullptr;
+	o.Chunk.length = 0U;
+	o.Out = _out_block;
+	o.Buffer = &o.Chunk;
+#endif
+}
+
+bool PrintfCompiled::RetryPrintf(Output &o)
+{
+#if defined(ASYNC_PRINTF) && (ASYNC_PRINTF == 1)
+	// only a line longer than the free space runs a second time, o.Idx is its exact length
+	Drivers::ByteSpan span = { nullptr, 0U, nullptr, 0U };
+	if (!serial || (o.Idx <= o.MaxLen) || (o.Idx > 0xFFFFU) || (serial->Reserve((uint16_t) o.Idx, span) == 0U))
+	{
+		return false;
+	}
+	_ct_reserved(o, span, o.Idx);
+	return true;
+#else
+	(void) o;
+	return false;
+#endif
+}
+
+int PrintfCompiled::EndPrintf(Output &o)
+{
+#if defined(ASYNC_PRINTF) && (ASYNC_PRINTF == 1)
+	if (serial && (o.Idx != 0U) && (o.Idx <= o.MaxLen))
+	{
+		serial->Commit((uint16_t) o.Idx);
+	}
+#else
+	_out_block_flush((out_block_wrap_type*) &o.Chunk);
+#endif
+	return (int) o.Idx;
+}
+
+void PrintfCompiled::BeginBuffer(Output &o, char *buffer, size_t count)
+{
+	o.Out = buffer ? _out_buffer : _out_null;
+	o.Buffer = buffer;
+	o.Idx = 0U;
+	o.MaxLen = count;
+}
+
+void PrintfCompiled::BeginFunction(Output &o, const Function *function)
+{
+	static_assert(sizeof(Function) == sizeof(out_fct_wrap_type), "Printf: PrintfCompiled::Function out of sync");
+	o.Out = _out_fct;
+	o.Buffer = (void*) (uintptr_t) function;
+	o.Idx = 0U;
+	o.MaxLen = (size_t) -1;
+}
+
+int PrintfCompiled::End(Output &o)
+{
+	// termination
+	o.Out((char) 0, o.Buffer, o.Idx < o.MaxLen ? o.Idx : o.MaxLen - 1U, o.MaxLen);
+	return (int) o.Idx;
+}
+
+void PrintfCompiled::Text(Output &o, const char *text, size_t length)
+{
+	// literal runs go in one copy when they fit the buffer
+	if ((o.Out == _out_buffer) && (o.Idx + length <= o.MaxLen))
+	{
+		memcpy((char*) o.Buffer + o.Idx, text, length);
+		o.Idx += length;
+		return;
+	}
+	for (size_t i = 0U; i < length; i++)
+	{
+		o.Out(text[i], o.Buffer, o.Idx++, o.MaxLen);
+	}
+}
+
+void PrintfCompiled::Integer(Output &o, unsigned long value, bool negative, unsigned int base, unsigned int precision, unsigned int width, unsigned int flags)
+{
+	o.Idx = _ntoa_long(o.Out, (char*) o.Buffer, o.Idx, o.MaxLen, value, negative, base, precision, width, flags);
+}
+
+void PrintfCompiled::LongLong(Output &o, unsigned long long value, bool negative, unsigned int base, unsigned int precision, unsigned int width, unsigned int flags)
+{
+#if defined(PRINTF_SUPPORT_LONG_LONG)
+	o.Idx = _ntoa_long_long(o.Out, (char*) o.Buffer, o.Idx, o.MaxLen, value, negative, base, precision, width, flags);
+#else
+	// same as _vsnprintf, nothing is printed
+	(void) o; (void) value; (void) negative; (void) base; (void) precision; (void) width; (void) flags;
+#endif
+}
+
+void PrintfCompiled::Float(Output &o, double value, char conversion, unsigned int precision, unsigned int width, unsigned int flags)
+{
+#if defined(PRINTF_SUPPORT_FLOAT)
+	if ((conversion == 'f') || (conversion == 'F'))
+	{
+		o.Idx = _ftoa(o.Out, (char*) o.Buffer, o.Idx, o.MaxLen, value, precision, width, flags);
+		return;
+	}
+#if defined(PRINTF_SUPPORT_EXPONENTIAL)
+	o.Idx = _etoa(o.Out, (char*) o.Buffer, o.Idx, o.MaxLen, value, precision, width, flags);
+	return;
+#endif
+#endif
+	// same as _vsnprintf, the conversion character without float support
+	(void) value; (void) precision; (void) width; (void) flags;
+	o.Out(conversion, o.Buffer, o.Idx++, o.MaxLen);
+}
+
+void PrintfCompiled::Char(Output &o, char character, unsigned int width, unsigned int flags)
+{
+	o.Idx = _ctoa(o.Out, (char*) o.Buffer, o.Idx, o.MaxLen, character, width, flags);
+}
+
+void PrintfCompiled::String(Output &o, const char *text, unsigned int precision, unsigned int width, unsigned int flags)
+{
+	o.Idx = _stoa(o.Out, (char*) o.Buffer, o.Idx, o.MaxLen, text, precision, width, flags);
+}
+
+void PrintfCompiled::Pointer(Output &o, const void *pointer, unsigned int precision, unsigned int flags)
+{
+	o.Idx = _ptoa(o.Out, (char*) o.Buffer, o.Idx, o.MaxLen, pointer, precision, flags);
+}
+#endif  // PRINTF_DISABLE_COMPILED_FORMAT
@@ -34,9 +34,30 @@
 
 #include <stdarg.h>
 #include <stddef.h>
+#include <stdint.h>
+#include <string.h>
 
 #include <Arduino.h>
 
+// deferred formatting, see printf_deferred() below
+// default: off, printf_deferred() formats on the device like printf()
+#ifndef DEFERRED_PRINTF
+#define DEFERRED_PRINTF  0
+#endif
+
+// largest deferred record (format id, argument tags and values) in bytes, built on the stack
+// default: 64 byte
+#ifndef PRINTF_DEFERRED_RECORD_SIZE
+#define PRINTF_DEFERRED_RECORD_SIZE  64U
+#endif
+
+#if defined(ASYNC_PRINTF) && (ASYNC_PRINTF == 1)
+namespace Drivers
+{
+	enum class SerialOverflow : uint8_t;
+}
+#endif
+
 #ifdef __cplusplus
 extern "C"
 {
@@ -44,6 +65,11 @@ extern "C"
 
 #if defined(ASYNC_PRINTF) && (ASYNC_PRINTF == 1)
 	void printf_MainFunction();
+	/**
+	 * What printf_() does with a line that doesn't fit the queue, REJECT by default. A line is queued
+	 * whole or not at all, PARTIAL acts like REJECT. Lost lines show up in the SerialAsync stats.
+	 */
+	void printf_SetOverflowPolicy(Drivers::SerialOverflow Policy, uint16_t TimeoutMs);
 #endif
 
 /**
@@ -113,8 +139,216 @@ int vprintf_(const char *format, va_list va);
  */
 int fctprintf(void (*out)(char character, void *arg), void *arg, const char *format, ...);
 
+/**
+ * printf with chunked output function
+ * Like fctprintf(), but the output is collected in a PRINTF_CHUNK_BUFFER_SIZE buffer on the stack and out_block
+ * gets it once per chunk instead of once per character, for outputs that cost something per call (UART driver,
+ * LCD, socket). The last chunk goes out before the function returns
+ * \param out_block An output function which takes a chunk (not null terminated), its length and an argument pointer
+ * \param arg An argument pointer for user data passed to output function
+ * \param format A string that specifies the format of the output
+ * \return The number of characters that are sent to the output function, not counting the terminating null character
+ */
+int fctprintf_block(void (*out_block)(const char *data, size_t length, void *arg), void *arg, const char *format, ...);
+int vfctprintf_block(void (*out_block)(const char *data, size_t length, void *arg), void *arg, const char *format, va_list va);
+
+/**
+ * Shortest text of a double that reads back (strtod) to the same value, e.g. 0.1 gives "0.1" where %.17g gives
+ * "0.10000000000000001". Fixed notation between 1e-4 and 1e17, exponent notation ("1e+17") outside
+ * \param buffer A pointer to the buffer where to store the text
+ * \param count The maximum number of characters to store in the buffer, including a terminating null character
+ * \param value The value, inf and nan print as "inf" and "nan"
+ * \return The number of characters that COULD have been written into the buffer, like snprintf_()
+ */
+int ftoa_shortest(char *buffer, size_t count, double value);
+
+#if (DEFERRED_PRINTF == 1)
+/**
+ * Sends one deferred record as a COBS frame with CRC16 (see Cobs.h) on the printf channel
+ * Used by printf_deferred(), records are built by PrintfDeferred::Record
+ * \param record Record bytes
+ * \param length Record length
+ * \return The number of record bytes sent, 0 when it was dropped
+ */
+int printf_deferred_send(const uint8_t *record, uint16_t length);
+#endif
+
 #ifdef __cplusplus
 }
 #endif
 
+#ifdef __cplusplus
+/**
+ * printf into any Arduino Print (HardwareSerial, LiquidCrystal, ...), one write(buffer, size) per chunk
+ * \param out The Print to write to
+ * \param format A string that specifies the format of the output
+ * \return The number of characters formatted, not counting the terminating null character
+ */
+int printf_to(Print &out, const char *format, ...);
+
+namespace Drivers
+{
+	template<typename TxIndex, typename RxIndex>
+	class SerialAsyncBase;
+}
+
+/**
+ * printf into a SerialAsync queue that is not the printf_() channel, every chunk is one WriteBytes() on the bulk
+ * lane, so a line can be split into frames and a chunk that doesn't fit follows the overflow policy of the instance
+ */
+template<typename TxIndex, typename RxIndex>
+inline int printf_to(Drivers::SerialAsyncBase<TxIndex, RxIndex> &out, const char *format, ...)
+{
+	struct Sink
+	{
+		static void Write(const char *data, size_t length, void *arg)
+		{
+			((Drivers::SerialAsyncBase<TxIndex, RxIndex>*) arg)->WriteBytes((const uint8_t*) data, (uint16_t) length);
+		}
+	};
+	va_list va;
+	va_start(va, format);
+	const int ret = vfctprintf_block(Sink::Write, &out, format, va);
+	va_end(va);
+	return ret;
+}
+
+/**
+ * Deferred printf: with DEFERRED_PRINTF=1 the device doesn't format at all. It sends the id of
+ * the format string (FNV-1a hash, computed at compile time, the string itself is not stored)
+ * and the raw arguments with their types, the host tool Drivers/HAL/Host/Tools/DeferredLog.cpp
+ * formats them again from a string table it extracts from the sources.
+ * The format must be a string literal written right after "printf_deferred(", so the tool
+ * can find it. Without DEFERRED_PRINTF it is printf().
+ *
+ * Record, sent as one COBS frame, little endian:
+ *   'P' <format id u32> then per argument <tag u8> <value>
+ *   tag high nibble: 1 signed, 2 unsigned, 3 float, 4 string, 5 pointer; low nibble: value size
+ *   integers only carry their significant bytes, e.g. a long holding 100 is sent as 1 byte
+ *   strings: tag 0x40, length u8 then the characters (cut to fit the record)
+ * Arguments that don't fit PRINTF_DEFERRED_RECORD_SIZE are left out, the host prints them as '?'.
+ */
+#if (DEFERRED_PRINTF == 1)
+#define printf_deferred(format, ...) \
+	PrintfDeferred::Log<PrintfDeferred::FormatId(format)>(__VA_ARGS__)
+#else
+#define printf_deferred(format, ...) \
+	printf_(format, ##__VA_ARGS__)
+#endif
+
+#if (DEFERRED_PRINTF == 1)
+namespace PrintfDeferred
+{
+	/* FNV-1a over the format, must match the host tool */
+	constexpr uint32_t FormatId(const char *format, uint32_t hash = 2166136261UL)
+	{
+		return (*format == '\0') ? hash : FormatId(format + 1, (hash ^ (uint8_t) *format) * 16777619UL);
+	}
+
+	enum : uint8_t
+	{
+		TAG_SIGNED = 0x10,
+		TAG_UNSIGNED = 0x20,
+		TAG_FLOAT = 0x30,
+		TAG_STRING = 0x40,
+		TAG_POINTER = 0x50
+	};
+
+	class Record
+	{
+	public:
+		explicit Record(uint32_t Id)
+		{
+			this->buffer[0] = 'P';
+			memcpy(&this->buffer[1], &Id, sizeof(Id));
+			this->length = 5U;
+		}
+
+		void Put(char Value)               { this->Integer(TAG_SIGNED, &Value, sizeof(Value)); }
+		void Put(signed char Value)        { this->Integer(TAG_SIGNED, &Value, sizeof(Value)); }
+		void Put(unsigned char Value)      { this->Integer(TAG_UNSIGNED, &Value, sizeof(Value)); }
+		void Put(short Value)              { this->Integer(TAG_SIGNED, &Value, sizeof(Value)); }
+		void Put(unsigned short Value)     { this->Integer(TAG_UNSIGNED, &Value, sizeof(Value)); }
+		void Put(int Value)                { this->Integer(TAG_SIGNED, &Value, sizeof(Value)); }
+		void Put(unsigned int Value)       { this->Integer(TAG_UNSIGNED, &Value, sizeof(Value)); }
+		void Put(long Value)               { this->Integer(TAG_SIGNED, &Value, sizeof(Value)); }
+		void Put(unsigned long Value)      { this->Integer(TAG_UNSIGNED, &Value, sizeof(Value)); }
+		void Put(long long Value)          { this->Integer(TAG_SIGNED, &Value, sizeof(Value)); }
+		void Put(unsigned long long Value) { this->Integer(TAG_UNSIGNED, &Value, sizeof(Value)); }
+		void Put(bool Value)               { this->Put((unsigned char) Value); }
+		void Put(float Value)              { this->Value(TAG_FLOAT, &Value, sizeof(Value)); }
+		void Put(double Value)             { this->Value(TAG_FLOAT, &Value, sizeof(Value)); }
+		void Put(const void *Value)        { this->Value(TAG_POINTER, &Value, sizeof(Value)); }
+
+		void Put(const char *Value)
+		{
+			size_t length = (Value == nullptr) ? 0U : strlen(Value);
+			if (this->length + 2U > PRINTF_DEFERRED_RECORD_SIZE)
+			{
+				return;
+			}
+			if (length > PRINTF_DEFERRED_RECORD_SIZE - 2U - this->length)
+			{
+				length = PRINTF_DEFERRED_RECORD_SIZE - 2U - this->length;
+			}
+			this->buffer[this->length++] = TAG_STRING;
+			this->buffer[this->length++] = (uint8_t) length;
+			memcpy(&this->buffer[this->length], Value, length);
+			this->length = (uint8_t) (this->length + length);
+		}
+		void Put(char *Value) { this->Put((const char*) Value); }
+
+		int Send() const
+		{
+			return printf_deferred_send(this->buffer, this->length);
+		}
+
+	private:
+		uint8_t buffer[PRINTF_DEFERRED_RECORD_SIZE];
+		uint8_t length;
+
+		// leading bytes that only repeat the sign (zero for unsigned) are left out, the host extends them again
+		void Integer(uint8_t Tag, const void *Value, uint8_t Size)
+		{
+			const uint8_t *bytes = (const uint8_t*) Value;
+			while (Size > 1U)
+			{
+				const uint8_t fill = ((Tag == TAG_SIGNED) && (bytes[Size - 2U] & 0x80U)) ? 0xFFU : 0x00U;
+				if (bytes[Size - 1U] != fill)
+				{
+					break;
+				}
+				Size--;
+			}
+			this->Value(Tag, Value, Size);
+		}
+
+		// targets are little endian, the value is copied as it is in memory
+		void Value(uint8_t Tag, const void *Value, uint8_t Size)
+		{
+			if (this->length + 1U + Size > PRINTF_DEFERRED_RECORD_SIZE)
+			{
+				return;
+			}
+			this->buffer[this->length++] = (uint8_t) (Tag | Size);
+			memcpy(&this->buffer[this->length], Value, Size);
+			this->length = (uint8_t) (this->length + Size);
+		}
+
+		static_assert(PRINTF_DEFERRED_RECORD_SIZE <= 255U, "Printf: PRINTF_DEFERRED_RECORD_SIZE must fit a byte");
+	};
+
+	template<uint32_t Id, typename... Args>
+	inline int Log(Args... args)
+	{
+		Record record(Id);
+		// evaluated left to right, one Put() per argument
+		int expand[] = { 0, (record.Put(args), 0)... };
+		(void) expand;
+		return record.Send();
+	}
+}
+#endif  // DEFERRED_PRINTF
+#endif  // __cplusplus
+
 #endif  // _PRINTF_H_
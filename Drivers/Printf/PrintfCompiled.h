@@ -0,0 +1,518 @@
+///////////////////////////////////////////////////////////////////////////////
+// \brief Compile time parsed formats for the tiny printf in Printf.h
+//
+//        printf_ct(), snprintf_ct() and fctprintf_ct() take a literal format, parse
+//        it while compiling and turn the call into a fixed sequence of emit calls
+//        (text, integer, float, char, string) with constant flags, width and
+//        precision. The arguments are checked against their conversions, e.g. a
+//        long for "%d" or an int for "%s" is a compile error, and no va_list is
+//        involved. Output is the same as printf_() & co.
+//
+//        Formats that are only known at run time keep using printf_(), sprintf_(),
+//        snprintf_() and fctprintf(). Every call site gets its own code, so a format
+//        used in many places costs more flash than with printf_().
+//        Needs the GNU statement expression extension (gcc, clang).
+//        PRINTF_DISABLE_COMPILED_FORMAT maps the macros back to the runtime parser.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef _PRINTF_COMPILED_H_
+#define _PRINTF_COMPILED_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "Printf.h"
+
+#if defined(PRINTF_DISABLE_COMPILED_FORMAT)
+
+#define printf_ct(format, ...)                       printf_(format, ##__VA_ARGS__)
+#define snprintf_ct(buffer, count, format, ...)      snprintf_(buffer, count, format, ##__VA_ARGS__)
+#define fctprintf_ct(out, arg, format, ...)          fctprintf(out, arg, format, ##__VA_ARGS__)
+
+#else
+
+// the literal is handed to the templates as a type with a constexpr accessor
+#define _PRINTF_CT_FORMAT(format) \
+	struct _PrintfFormat { static constexpr const char *Str() { return format; } }
+
+#define printf_ct(format, ...) \
+	({ _PRINTF_CT_FORMAT(format); PrintfCompiled::Printf<_PrintfFormat>(__VA_ARGS__); })
+#define snprintf_ct(buffer, count, format, ...) \
+	({ _PRINTF_CT_FORMAT(format); PrintfCompiled::Snprintf<_PrintfFormat>(buffer, count, ##__VA_ARGS__); })
+#define fctprintf_ct(out, arg, format, ...) \
+	({ _PRINTF_CT_FORMAT(format); PrintfCompiled::Fctprintf<_PrintfFormat>(out, arg, ##__VA_ARGS__); })
+
+namespace PrintfCompiled
+{
+	// same values as the internal FLAGS_ of Printf.cpp
+	enum : unsigned int
+	{
+		FLAG_ZEROPAD   = 1U <<  0U,
+		FLAG_LEFT      = 1U <<  1U,
+		FLAG_PLUS      = 1U <<  2U,
+		FLAG_SPACE     = 1U <<  3U,
+		FLAG_HASH      = 1U <<  4U,
+		FLAG_UPPERCASE = 1U <<  5U,
+		FLAG_PRECISION = 1U << 10U,
+		FLAG_ADAPT_EXP = 1U << 11U
+	};
+
+	// reserved queue space for printf_ct() with ASYNC_PRINTF, like Drivers::ByteSpan
+	typedef struct
+	{
+		uint8_t *First;
+		uint16_t FirstLength;
+		uint8_t *Second;
+		uint16_t SecondLength;
+	} Span;
+
+	// chunk of printf_ct() without ASYNC_PRINTF, like out_block_wrap_type. Set PRINTF_CHUNK_BUFFER_SIZE
+	// globally (-D) when it isn't the default, Printf.cpp checks that both agree
+#if !defined(ASYNC_PRINTF) || (ASYNC_PRINTF != 1)
+#ifndef PRINTF_CHUNK_BUFFER_SIZE
+#define PRINTF_CHUNK_BUFFER_SIZE   32U
+#endif
+	typedef struct
+	{
+		void (*fct)(const char *data, size_t length, void *arg);
+		void *arg;
+		size_t length;
+		char chunk[PRINTF_CHUNK_BUFFER_SIZE];
+	} Block;
+#endif
+
+	// output function and argument of fctprintf_ct(), like out_fct_wrap_type
+	typedef struct
+	{
+		void (*fct)(char character, void *arg);
+		void *arg;
+	} Function;
+
+	// where the output goes, set up by the Begin functions in Printf.cpp
+	typedef struct
+	{
+		void (*Out)(char character, void *buffer, size_t idx, size_t maxlen);
+		void *Buffer;
+		size_t Idx;
+		size_t MaxLen;
+#if defined(ASYNC_PRINTF) && (ASYNC_PRINTF == 1)
+		Span Reserved;
+#else
+		Block Chunk;
+#endif
+	} Output;
+
+	// emit kernels, Printf.cpp
+	// with ASYNC_PRINTF the line goes into the free queue space, RetryPrintf() reserves its exact length when
+	// it didn't fit and the overflow policy makes room, EndPrintf() queues it whole or not at all.
+	// Without it the line goes to the serial port in PRINTF_CHUNK_BUFFER_SIZE chunks
+	void BeginPrintf(Output &o);
+	bool RetryPrintf(Output &o);
+	int EndPrintf(Output &o);
+	void BeginBuffer(Output &o, char *buffer, size_t count);
+	void BeginFunction(Output &o, const Function *function);
+	int End(Output &o);
+	void Text(Output &o, const char *text, size_t length);
+	void Integer(Output &o, unsigned long value, bool negative, unsigned int base, unsigned int precision, unsigned int width, unsigned int flags);
+	void LongLong(Output &o, unsigned long long value, bool negative, unsigned int base, unsigned int precision, unsigned int width, unsigned int flags);
+	void Float(Output &o, double value, char conversion, unsigned int precision, unsigned int width, unsigned int flags);
+	void Char(Output &o, char character, unsigned int width, unsigned int flags);
+	void String(Output &o, const char *text, unsigned int precision, unsigned int width, unsigned int flags);
+	void Pointer(Output &o, const void *pointer, unsigned int precision, unsigned int flags);
+
+	///////////////////////////////////////////////////////////////////////////
+	// argument classes, what a conversion accepts
+
+	enum Class : uint8_t
+	{
+		CLASS_OTHER,
+		CLASS_INT,			// int and everything promoted to it
+		CLASS_LONG,
+		CLASS_LONG_LONG,
+		CLASS_DOUBLE,
+		CLASS_STRING,
+		CLASS_POINTER
+	};
+
+	template<typename T> struct ArgClass { static const Class value = CLASS_OTHER; };
+	template<typename T> struct ArgClass<T*> { static const Class value = CLASS_POINTER; };
+	template<> struct ArgClass<bool> { static const Class value = CLASS_INT; };
+	template<> struct ArgClass<char> { static const Class value = CLASS_INT; };
+	template<> struct ArgClass<signed char> { static const Class value = CLASS_INT; };
+	template<> struct ArgClass<unsigned char> { static const Class value = CLASS_INT; };
+	template<> struct ArgClass<short> { static const Class value = CLASS_INT; };
+	template<> struct ArgClass<unsigned short> { static const Class value = CLASS_INT; };
+	template<> struct ArgClass<int> { static const Class value = CLASS_INT; };
+	template<> struct ArgClass<unsigned int> { static const Class value = CLASS_INT; };
+	template<> struct ArgClass<long> { static const Class value = CLASS_LONG; };
+	template<> struct ArgClass<unsigned long> { static const Class value = CLASS_LONG; };
+	template<> struct ArgClass<long long> { static const Class value = CLASS_LONG_LONG; };
+	template<> struct ArgClass<unsigned long long> { static const Class value = CLASS_LONG_LONG; };
+	template<> struct ArgClass<float> { static const Class value = CLASS_DOUBLE; };
+	template<> struct ArgClass<double> { static const Class value = CLASS_DOUBLE; };
+	template<> struct ArgClass<char*> { static const Class value = CLASS_STRING; };
+	template<> struct ArgClass<const char*> { static const Class value = CLASS_STRING; };
+
+	///////////////////////////////////////////////////////////////////////////
+	// format parsing, C++11 constexpr: one return statement each, loops are recursion
+
+	enum : uint8_t
+	{
+		LENGTH_NONE,
+		LENGTH_CHAR,		// hh
+		LENGTH_SHORT,		// h
+		LENGTH_LONG,		// l
+		LENGTH_LONG_LONG,	// ll
+		LENGTH_SIZE,		// z
+		LENGTH_INTMAX,		// j
+		LENGTH_PTRDIFF		// t
+	};
+
+	enum : uint8_t
+	{
+		OP_SIGNED,
+		OP_UNSIGNED,
+		OP_FLOAT,
+		OP_CHAR,
+		OP_STRING,
+		OP_POINTER,
+		OP_PERCENT,
+		OP_INVALID
+	};
+
+	constexpr bool IsDigit(char c)
+	{
+		return (c >= '0') && (c <= '9');
+	}
+
+	// index of the next '%' or of the terminating zero
+	constexpr unsigned int Next(const char *s, unsigned int i)
+	{
+		return ((s[i] == '\0') || (s[i] == '%')) ? i : Next(s, i + 1U);
+	}
+
+	constexpr unsigned int FlagOf(char c)
+	{
+		return (c == '0') ? FLAG_ZEROPAD : (c == '-') ? FLAG_LEFT : (c == '+') ? FLAG_PLUS : (c == ' ') ? FLAG_SPACE : (c == '#') ? FLAG_HASH : 0U;
+	}
+
+	constexpr unsigned int Flags(const char *s, unsigned int i)
+	{
+		return FlagOf(s[i]) ? (FlagOf(s[i]) | Flags(s, i + 1U)) : 0U;
+	}
+
+	constexpr unsigned int FlagsEnd(const char *s, unsigned int i)
+	{
+		return FlagOf(s[i]) ? FlagsEnd(s, i + 1U) : i;
+	}
+
+	constexpr unsigned int DigitsEnd(const char *s, unsigned int i)
+	{
+		return IsDigit(s[i]) ? DigitsEnd(s, i + 1U) : i;
+	}
+
+	constexpr unsigned int Number(const char *s, unsigned int i, unsigned int value)
+	{
+		return IsDigit(s[i]) ? Number(s, i + 1U, value * 10U + (unsigned int) (s[i] - '0')) : value;
+	}
+
+	constexpr uint8_t Length(const char *s, unsigned int i)
+	{
+		return (s[i] == 'l') ? ((s[i + 1U] == 'l') ? LENGTH_LONG_LONG : LENGTH_LONG) :
+			(s[i] == 'h') ? ((s[i + 1U] == 'h') ? LENGTH_CHAR : LENGTH_SHORT) :
+			(s[i] == 'z') ? LENGTH_SIZE : (s[i] == 'j') ? LENGTH_INTMAX : (s[i] == 't') ? LENGTH_PTRDIFF : LENGTH_NONE;
+	}
+
+	constexpr unsigned int LengthSize(uint8_t length)
+	{
+		return ((length == LENGTH_CHAR) || (length == LENGTH_LONG_LONG)) ? 2U : (length == LENGTH_NONE) ? 0U : 1U;
+	}
+
+	constexpr uint8_t Op(char c)
+	{
+		return ((c == 'd') || (c == 'i')) ? OP_SIGNED :
+			((c == 'u') || (c == 'x') || (c == 'X') || (c == 'o') || (c == 'b')) ? OP_UNSIGNED :
+			((c == 'f') || (c == 'F') || (c == 'e') || (c == 'E') || (c == 'g') || (c == 'G')) ? OP_FLOAT :
+			(c == 'c') ? OP_CHAR : (c == 's') ? OP_STRING : (c == 'p') ? OP_POINTER : (c == '%') ? OP_PERCENT : OP_INVALID;
+	}
+
+	constexpr unsigned int Base(char c)
+	{
+		return ((c == 'x') || (c == 'X')) ? 16U : (c == 'o') ? 8U : (c == 'b') ? 2U : 10U;
+	}
+
+	// flags after the same adjustments _vsnprintf makes for the conversion
+	constexpr unsigned int Adjust(unsigned int flags, char c)
+	{
+		return (Op(c) == OP_SIGNED) ? (((flags & FLAG_PRECISION) ? (flags & ~FLAG_ZEROPAD) : flags) & ~FLAG_HASH) :
+			(Op(c) == OP_UNSIGNED) ? ((((flags & FLAG_PRECISION) ? (flags & ~FLAG_ZEROPAD) : flags) & ~(FLAG_PLUS | FLAG_SPACE) & ((Base(c) == 10U) ? ~FLAG_HASH : ~0U)) | ((c == 'X') ? FLAG_UPPERCASE : 0U)) :
+			(Op(c) == OP_FLOAT) ? (flags | (((c == 'F') || (c == 'E') || (c == 'G')) ? FLAG_UPPERCASE : 0U) | (((c == 'g') || (c == 'G')) ? FLAG_ADAPT_EXP : 0U)) :
+			flags;
+	}
+
+	// class of the argument an integer conversion expects, z/j/t follow the actual typedefs
+	constexpr Class IntegerClass(uint8_t length)
+	{
+		return (length == LENGTH_LONG) ? CLASS_LONG : (length == LENGTH_LONG_LONG) ? CLASS_LONG_LONG :
+			(length == LENGTH_SIZE) ? ArgClass<size_t>::value : (length == LENGTH_INTMAX) ? ArgClass<intmax_t>::value :
+			(length == LENGTH_PTRDIFF) ? ArgClass<ptrdiff_t>::value : CLASS_INT;
+	}
+
+	// one conversion, P is the index after its '%'
+	template<typename F, unsigned int P>
+	struct Spec
+	{
+		static constexpr unsigned int flagsEnd = FlagsEnd(F::Str(), P);
+		static constexpr bool starWidth = F::Str()[flagsEnd] == '*';
+		static constexpr unsigned int widthEnd = starWidth ? (flagsEnd + 1U) : DigitsEnd(F::Str(), flagsEnd);
+		static constexpr unsigned int width = starWidth ? 0U : Number(F::Str(), flagsEnd, 0U);
+		static constexpr bool hasPrecision = F::Str()[widthEnd] == '.';
+		static constexpr unsigned int precisionStart = widthEnd + (hasPrecision ? 1U : 0U);
+		static constexpr bool starPrecision = hasPrecision && (F::Str()[precisionStart] == '*');
+		static constexpr unsigned int precisionEnd = starPrecision ? (precisionStart + 1U) : DigitsEnd(F::Str(), precisionStart);
+		static constexpr unsigned int precision = starPrecision ? 0U : Number(F::Str(), precisionStart, 0U);
+		static constexpr uint8_t length = Length(F::Str(), precisionEnd);
+		static constexpr unsigned int conversionAt = precisionEnd + LengthSize(length);
+		static constexpr char conversion = F::Str()[conversionAt];
+		static constexpr uint8_t op = Op(conversion);
+		static constexpr unsigned int base = Base(conversion);
+		// flags without the '*' adjustments, those are only known at run time
+		static constexpr unsigned int flags = Adjust(Flags(F::Str(), P) | (hasPrecision ? FLAG_PRECISION : 0U), conversion);
+		static constexpr Class argClass = ((op == OP_SIGNED) || (op == OP_UNSIGNED)) ? IntegerClass(length) :
+			(op == OP_FLOAT) ? CLASS_DOUBLE : (op == OP_CHAR) ? CLASS_INT : (op == OP_STRING) ? CLASS_STRING : CLASS_POINTER;
+		static constexpr unsigned int end = conversionAt + 1U;
+
+		static_assert(conversion != '\0', "printf_ct: format ends inside a conversion");
+		static_assert(op != OP_INVALID, "printf_ct: unknown conversion");
+	};
+
+	///////////////////////////////////////////////////////////////////////////
+	// emitting, one step per literal run and conversion
+
+	template<typename F, unsigned int Pos, bool End = (F::Str()[Next(F::Str(), Pos)] == '\0')>
+	struct Format;
+
+	template<typename F, unsigned int Pct, uint8_t Op>
+	struct Value
+	{
+		template<int N = 0>
+		static inline void Run(Output &o, unsigned int width, unsigned int precision, unsigned int flags)
+		{
+			(void) o; (void) width; (void) precision; (void) flags;
+			static_assert(N != 0, "printf_ct: fewer arguments than conversions");
+		}
+
+		template<typename A, typename... Rest>
+		static inline void Run(Output &o, unsigned int width, unsigned int precision, unsigned int flags, A arg, Rest... rest)
+		{
+			typedef Spec<F, Pct + 1U> S;
+			static_assert((ArgClass<A>::value == S::argClass) || ((Op == OP_POINTER) && (ArgClass<A>::value == CLASS_STRING)),
+				"printf_ct: argument type doesn't match the conversion");
+
+			Emit(o, width, precision, flags, arg);
+			Format<F, S::end>::Run(o, rest...);
+		}
+
+	private:
+		typedef Spec<F, Pct + 1U> S;
+
+		// integers, with the hh/h truncation _vsnprintf does
+		template<typename A>
+		static inline void Emit(Output &o, unsigned int width, unsigned int precision, unsigned int flags, A arg)
+		{
+			if (Op == OP_CHAR)
+			{
+				Char(o, (char) arg, width, flags);
+			}
+			else if (ArgClass<A>::value == CLASS_LONG_LONG)
+			{
+				const unsigned long long bits = (unsigned long long) arg;
+				const bool negative = (Op == OP_SIGNED) && ((long long) bits < 0);
+				LongLong(o, negative ? (0ULL - bits) : bits, negative, S::base, precision, width, flags);
+			}
+			else if (ArgClass<A>::value == CLASS_LONG)
+			{
+				const unsigned long bits = (unsigned long) arg;
+				const bool negative = (Op == OP_SIGNED) && ((long) bits < 0);
+				Integer(o, negative ? (0UL - bits) : bits, negative, S::base, precision, width, flags);
+			}
+			else if (Op == OP_SIGNED)
+			{
+				const int value = (S::length == LENGTH_CHAR) ? (int) (char) arg : (S::length == LENGTH_SHORT) ? (int) (short) arg : (int) arg;
+				Integer(o, (unsigned int) (value > 0 ? value : 0 - value), value < 0, S::base, precision, width, flags);
+			}
+			else
+			{
+				const unsigned int value = (S::length == LENGTH_CHAR) ? (unsigned int) (unsigned char) arg : (S::length == LENGTH_SHORT) ? (unsigned int) (unsigned short) arg : (unsigned int) arg;
+				Integer(o, value, false, S::base, precision, width, flags);
+			}
+		}
+
+		static inline void Emit(Output &o, unsigned int width, unsigned int precision, unsigned int flags, double arg)
+		{
+			Float(o, arg, S::conversion, precision, width, flags);
+		}
+
+		static inline void Emit(Output &o, unsigned int width, unsigned int precision, unsigned int flags, float arg)
+		{
+			Float(o, arg, S::conversion, precision, width, flags);
+		}
+
+		template<typename T>
+		static inline void Emit(Output &o, unsigned int width, unsigned int precision, unsigned int flags, T *arg)
+		{
+			if (Op == OP_STRING)
+			{
+				String(o, (const char*) arg, precision, width, flags);
+			}
+			else
+			{
+				Pointer(o, (const void*) arg, precision, flags);
+			}
+		}
+	};
+
+	template<typename F, unsigned int Pct>
+	struct Value<F, Pct, OP_PERCENT>
+	{
+		template<typename... Args>
+		static inline void Run(Output &o, unsigned int width, unsigned int precision, unsigned int flags, Args... args)
+		{
+			(void) width; (void) precision; (void) flags;
+			o.Out('%', o.Buffer, o.Idx++, o.MaxLen);
+			Format<F, Spec<F, Pct + 1U>::end>::Run(o, args...);
+		}
+	};
+
+	// '*' precision, negative means none like _vsnprintf
+	template<typename F, unsigned int Pct, bool Star = Spec<F, Pct + 1U>::starPrecision>
+	struct Precision
+	{
+		template<typename... Args>
+		static inline void Run(Output &o, unsigned int width, unsigned int flags, Args... args)
+		{
+			Value<F, Pct, Spec<F, Pct + 1U>::op>::Run(o, width, Spec<F, Pct + 1U>::precision, flags, args...);
+		}
+	};
+
+	template<typename F, unsigned int Pct>
+	struct Precision<F, Pct, true>
+	{
+		template<int N = 0>
+		static inline void Run(Output &o, unsigned int width, unsigned int flags)
+		{
+			(void) o; (void) width; (void) flags;
+			static_assert(N != 0, "printf_ct: missing the '*' precision argument");
+		}
+
+		template<typename A, typename... Rest>
+		static inline void Run(Output &o, unsigned int width, unsigned int flags, A precision, Rest... rest)
+		{
+			static_assert(ArgClass<A>::value == CLASS_INT, "printf_ct: '*' precision must be an int");
+			const int p = (int) precision;
+			Value<F, Pct, Spec<F, Pct + 1U>::op>::Run(o, width, (p > 0) ? (unsigned int) p : 0U, flags, rest...);
+		}
+	};
+
+	// '*' width, negative means left aligned like _vsnprintf
+	template<typename F, unsigned int Pct, bool Star = Spec<F, Pct + 1U>::starWidth>
+	struct Width
+	{
+		template<typename... Args>
+		static inline void Run(Output &o, Args... args)
+		{
+			Precision<F, Pct>::Run(o, Spec<F, Pct + 1U>::width, Spec<F, Pct + 1U>::flags, args...);
+		}
+	};
+
+	template<typename F, unsigned int Pct>
+	struct Width<F, Pct, true>
+	{
+		template<int N = 0>
+		static inline void Run(Output &o)
+		{
+			(void) o;
+			static_assert(N != 0, "printf_ct: missing the '*' width argument");
+		}
+
+		template<typename A, typename... Rest>
+		static inline void Run(Output &o, A width, Rest... rest)
+		{
+			static_assert(ArgClass<A>::value == CLASS_INT, "printf_ct: '*' width must be an int");
+			const int w = (int) width;
+			Precision<F, Pct>::Run(o, (w < 0) ? (unsigned int) -w : (unsigned int) w, Spec<F, Pct + 1U>::flags | ((w < 0) ? FLAG_LEFT : 0U), rest...);
+		}
+	};
+
+	// literal text up to the next conversion, then the conversion
+	template<typename F, unsigned int Pos, bool End>
+	struct Format
+	{
+		template<typename... Args>
+		static inline void Run(Output &o, Args... args)
+		{
+			if (Next(F::Str(), Pos) > Pos)
+			{
+				Text(o, F::Str() + Pos, Next(F::Str(), Pos) - Pos);
+			}
+			Width<F, Next(F::Str(), Pos)>::Run(o, args...);
+		}
+	};
+
+	template<typename F, unsigned int Pos>
+	struct Format<F, Pos, true>
+	{
+		template<typename... Args>
+		static inline void Run(Output &o, Args... args)
+		{
+			static_assert(sizeof...(Args) == 0U, "printf_ct: more arguments than conversions");
+			if (Next(F::Str(), Pos) > Pos)
+			{
+				Text(o, F::Str() + Pos, Next(F::Str(), Pos) - Pos);
+			}
+		}
+	};
+
+	///////////////////////////////////////////////////////////////////////////
+	// entry points, same return values as printf_(), snprintf_() and fctprintf()
+
+	template<typename F, typename... Args>
+	inline int Printf(Args... args)
+	{
+		Output o;
+		BeginPrintf(o);
+#if defined(ASYNC_PRINTF) && (ASYNC_PRINTF == 1)
+		do
+		{
+			Format<F, 0U>::Run(o, args...);
+		} while (RetryPrintf(o));
+#else
+		Format<F, 0U>::Run(o, args...);
+#endif
+		return EndPrintf(o);
+	}
+
+	template<typename F, typename... Args>
+	inline int Snprintf(char *buffer, size_t count, Args... args)
+	{
+		Output o;
+		BeginBuffer(o, buffer, count);
+		Format<F, 0U>::Run(o, args...);
+		return End(o);
+	}
+
+	template<typename F, typename... Args>
+	inline int Fctprintf(void (*out)(char character, void *arg), void *arg, Args... args)
+	{
+		const Function function = { out, arg };
+		Output o;
+		BeginFunction(o, &function);
+		Format<F, 0U>::Run(o, args...);
+		return End(o);
+	}
+}
+
+#endif  // PRINTF_DISABLE_COMPILED_FORMAT
+
+#endif  // _PRINTF_COMPILED_H_
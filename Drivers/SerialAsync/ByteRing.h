@@ -0,0 +1,253 @@
+/*
+ * ByteRing.h
+ *
+ *  Byte FIFO with a power-of-two capacity. Head and tail are free running counters, the slot
+ *  is counter & (Size - 1), so there is no wrap branch per byte and a full ring can be told
+ *  apart from an empty one without wasting a slot. Data is moved in at most two contiguous
+ *  segments (memcpy), readers and writers can also work in place through the span functions.
+ *
+ *  One writer and one reader may run in different contexts (e.g. main loop and an ISR): each
+ *  side only stores its own counter and counters are loaded/stored atomically.
+ *
+ *  The logic lives in ByteRingBase<Index>, ByteRing<Size> only adds the storage, so rings of
+ *  different sizes can be used through a ByteRingBase pointer. Index is the counter type:
+ *  uint8_t for rings up to 128 bytes (single instruction, interrupt safe loads on AVR), uint16_t
+ *  above.
+ */
+
+#ifndef BYTE_RING_H
+#define BYTE_RING_H
+
+#include <Arduino.h>
+#include <string.h>
+#include "HAL.h"
+
+namespace Drivers
+{
+	/* Writable area inside a ring, split in two when it crosses the end of the buffer */
+	typedef struct
+	{
+		uint8_t *First;
+		uint16_t FirstLength;
+		uint8_t *Second;
+		uint16_t SecondLength;
+	} ByteSpan;
+
+	/* Ring logic independent of the size, so rings of different sizes can be handled through one pointer type */
+	template<typename Index>
+	class ByteRingBase
+	{
+	public:
+		inline uint16_t Capacity() const
+		{
+			return (uint16_t)(this->_Mask + 1u);
+		}
+
+		inline uint16_t Used() const
+		{
+			return (Index)(_Load(this->_Head) - _Load(this->_Tail));
+		}
+
+		inline uint16_t Free() const
+		{
+			return (uint16_t)(this->Capacity() - this->Used());
+		}
+
+		inline bool IsEmpty() const
+		{
+			return this->Used() == 0u;
+		}
+
+		/* Copies all of Bytes or nothing */
+		bool Push(const uint8_t *Bytes, uint16_t Length)
+		{
+			if( Length > this->Free() )
+			{
+				return false;
+			}
+
+			Index head = _Load(this->_Head);
+			uint16_t offset = head & this->_Mask;
+			uint16_t first = this->Capacity() - offset;
+			if( first > Length )
+			{
+				first = Length;
+			}
+			memcpy(&this->_Buffer[offset], Bytes, first);
+			memcpy(&this->_Buffer[0], &Bytes[first], Length - first);
+			_Store(this->_Head, (Index)(head + Length));
+
+			return true;
+		}
+
+		/* Copies up to Length bytes out, returns the number of bytes copied */
+		uint16_t Pop(uint8_t *Bytes, uint16_t Length)
+		{
+			uint16_t used = this->Used();
+			if( Length > used )
+			{
+				Length = used;
+			}
+
+			Index tail = _Load(this->_Tail);
+			uint16_t offset = tail & this->_Mask;
+			uint16_t first = this->Capacity() - offset;
+			if( first > Length )
+			{
+				first = Length;
+			}
+			memcpy(Bytes, &this->_Buffer[offset], first);
+			memcpy(&Bytes[first], &this->_Buffer[0], Length - first);
+			_Store(this->_Tail, (Index)(tail + Length));
+
+			return Length;
+		}
+
+		/* Oldest queued bytes that are contiguous in memory, release them with Consume() */
+		inline uint16_t ReadSpan(const uint8_t *&Data) const
+		{
+			uint16_t offset = _Load(this->_Tail) & this->_Mask;
+			uint16_t contiguous = this->Capacity() - offset;
+			uint16_t used = this->Used();
+
+			Data = &this->_Buffer[offset];
+			return (used < contiguous) ? used : contiguous;
+		}
+
+		/* Oldest Length bytes (Length <= Used()) in place, split in two when they wrap */
+		inline void ReadSpan(ByteSpan &Span, uint16_t Length)
+		{
+			uint16_t offset = _Load(this->_Tail) & this->_Mask;
+			uint16_t contiguous = this->Capacity() - offset;
+
+			Span.First = &this->_Buffer[offset];
+			Span.FirstLength = (Length < contiguous) ? Length : contiguous;
+			Span.Second = &this->_Buffer[0];
+			Span.SecondLength = Length - Span.FirstLength;
+		}
+
+		inline void Consume(uint16_t Length)
+		{
+			_Store(this->_Tail, (Index)(_Load(this->_Tail) + Length));
+		}
+
+		/*
+		 * Reader side: drops Length bytes that follow the oldest Keep bytes (Keep + Length <= Used()),
+		 * the Keep bytes are moved up so they stay the oldest. Costs one byte copy per kept byte.
+		 */
+		void Discard(uint16_t Keep, uint16_t Length)
+		{
+			Index tail = _Load(this->_Tail);
+
+			while( Keep > 0u )
+			{
+				Keep--;
+				this->_Buffer[(Index)(tail + Length + Keep) & this->_Mask] = this->_Buffer[(Index)(tail + Keep) & this->_Mask];
+			}
+			_Store(this->_Tail, (Index)(tail + Length));
+		}
+
+		/* Free area for Length bytes (Length <= Free()) without publishing it, see Commit() */
+		inline void WriteSpan(ByteSpan &Span, uint16_t Length)
+		{
+			uint16_t offset = _Load(this->_Head) & this->_Mask;
+			uint16_t contiguous = this->Capacity() - offset;
+
+			Span.First = &this->_Buffer[offset];
+			Span.FirstLength = (Length < contiguous) ? Length : contiguous;
+			Span.Second = &this->_Buffer[0];
+			Span.SecondLength = Length - Span.FirstLength;
+		}
+
+		/* Stores one byte Offset bytes past the published data (Offset < Free()) without publishing it */
+		inline void Stage(uint16_t Offset, uint8_t Byte)
+		{
+			this->_Buffer[(Index)(_Load(this->_Head) + Offset) & this->_Mask] = Byte;
+		}
+
+		/* Publishes Length bytes written through WriteSpan() or Stage() */
+		inline void Commit(uint16_t Length)
+		{
+			_Store(this->_Head, (Index)(_Load(this->_Head) + Length));
+		}
+
+		/* Reader side: drops everything queued */
+		inline void Clear()
+		{
+			_Store(this->_Tail, _Load(this->_Head));
+		}
+
+	protected:
+		ByteRingBase(uint8_t *Buffer, uint16_t Size) : _Buffer(Buffer), _Mask((Index)(Size - 1u)) {}
+
+	private:
+		uint8_t *const _Buffer;
+		const Index _Mask;
+		volatile Index _Head = 0;		/* written by the writer only */
+		volatile Index _Tail = 0;		/* written by the reader only */
+
+		/* 16 bit accesses take two instructions on AVR, an interrupt in between would see half of the update */
+		static inline Index _Load(const volatile Index &Counter)
+		{
+#if defined(__AVR__)
+			if( sizeof(Index) > 1u )
+			{
+				Vfb_CriticalSection cs;
+				return Counter;
+			}
+#endif
+			return Counter;
+		}
+
+		static inline void _Store(volatile Index &Counter, Index Value)
+		{
+#if defined(__AVR__)
+			if( sizeof(Index) > 1u )
+			{
+				Vfb_CriticalSection cs;
+				Counter = Value;
+				return;
+			}
+#endif
+			Counter = Value;
+		}
+	};
+
+	/* Smallest counter type for a ring of Size bytes, free running counters need twice the range */
+	template<bool Small>
+	struct ByteRingIndexOf
+	{
+		typedef uint16_t Type;
+	};
+
+	template<>
+	struct ByteRingIndexOf<true>
+	{
+		typedef uint8_t Type;
+	};
+
+	template<uint16_t Size>
+	struct ByteRingIndex : ByteRingIndexOf<(Size <= 128u)>
+	{
+	};
+
+	template<uint16_t Size, typename Index = typename ByteRingIndex<Size>::Type>
+	class ByteRing : public ByteRingBase<Index>
+	{
+		static_assert((Size != 0u) && ((Size & (Size - 1u)) == 0u), "ByteRing: Size must be a power of two");
+		static_assert(Size <= ((Index)~(Index)0 / 2u + 1u), "ByteRing: Size must fit the counters");
+
+	public:
+		static const uint16_t CAPACITY = Size;
+
+		ByteRing() : ByteRingBase<Index>(_Storage, Size) {}
+		ByteRing(const ByteRing &) = delete;
+		ByteRing &operator=(const ByteRing &) = delete;
+
+	private:
+		uint8_t _Storage[Size];
+	};
+
+} /* namespace Drivers */
+
+#endif /* BYTE_RING_H */
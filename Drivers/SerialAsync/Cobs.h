@@ -0,0 +1,182 @@
+/*
+ * Cobs.h
+ *
+ *  Binary frames for SerialAsync: COBS (Consistent Overhead Byte Stuffing) with a CRC16 trailer
+ *  and a 0x00 delimiter. COBS removes every 0x00 from the encoded bytes, so a receiver can always
+ *  resync on the next delimiter, at a cost of one byte per 254 payload bytes.
+ *
+ *  On the wire: COBS(payload, CRC16 high byte, CRC16 low byte) 0x00
+ *  CRC16 is CRC-16/CCITT-FALSE (poly 0x1021, init 0xFFFF, not reflected, no final xor), the CRC
+ *  over payload plus big endian CRC is 0, which is what the decoder checks.
+ *
+ *  Both sides work one byte at a time without a frame buffer of their own: the encoder writes
+ *  straight into a reserved area (two parts when it wraps in a ring), the decoder hands out
+ *  every decoded byte as it arrives. No Arduino dependency, the host tools use this header too.
+ */
+
+#ifndef COBS_H
+#define COBS_H
+
+#include <stdint.h>
+
+/* Worst case bytes on the wire for a payload of Length bytes: code bytes, CRC and delimiter */
+#define COBS_ENCODED_SIZE(Length)	((uint16_t)((Length) + 2u + (((Length) + 2u) / 254u) + 2u))
+
+namespace Drivers
+{
+	/* One byte of CRC-16/CCITT-FALSE, shifts instead of a 512 byte table */
+	static inline uint16_t Crc16Update(uint16_t Crc, uint8_t Byte)
+	{
+		uint8_t x = (uint8_t)((Crc >> 8) ^ Byte);
+		x ^= (uint8_t)(x >> 4);
+		return (uint16_t)((Crc << 8) ^ ((uint16_t)x << 12) ^ ((uint16_t)x << 5) ^ x);
+	}
+
+	/*
+	 * Encodes one frame into First then Second (COBS_ENCODED_SIZE() bytes in total must be
+	 * available), each code byte is filled in once its block is complete.
+	 */
+	class CobsEncoder
+	{
+	public:
+		void Begin(uint8_t *First, uint16_t FirstLength, uint8_t *Second)
+		{
+			this->first = First;
+			this->firstLength = FirstLength;
+			this->second = Second;
+			this->codeOffset = 0;
+			this->offset = 1;
+			this->code = 1;
+			this->crc = 0xFFFFu;
+		}
+
+		void Put(uint8_t Byte)
+		{
+			this->crc = Crc16Update(this->crc, Byte);
+			this->Encode(Byte);
+		}
+
+		void Put(const uint8_t *Bytes, uint16_t Length)
+		{
+			for( uint16_t i = 0; i < Length; i++ )
+			{
+				this->Put(Bytes[i]);
+			}
+		}
+
+		/* Appends the CRC and the delimiter, returns the encoded length */
+		uint16_t End()
+		{
+			uint16_t crc = this->crc;
+			this->Encode((uint8_t)(crc >> 8));
+			this->Encode((uint8_t)crc);
+			this->At(this->codeOffset) = this->code;
+			this->At(this->offset++) = 0x00;
+			return this->offset;
+		}
+
+	private:
+		uint8_t *first = nullptr;
+		uint8_t *second = nullptr;
+		uint16_t firstLength = 0;
+		uint16_t codeOffset = 0;		/* where the code byte of the current block goes */
+		uint16_t offset = 0;			/* next encoded byte */
+		uint8_t code = 1;				/* current block length + 1 */
+		uint16_t crc = 0xFFFFu;
+
+		inline uint8_t &At(uint16_t Offset)
+		{
+			return (Offset < this->firstLength) ? this->first[Offset] : this->second[Offset - this->firstLength];
+		}
+
+		inline void Encode(uint8_t Byte)
+		{
+			if( Byte != 0x00 )
+			{
+				this->At(this->offset++) = Byte;
+				if( ++this->code != 0xFFu )
+					return;
+			}
+
+			// A zero, or 254 bytes without one, ends the block
+			this->At(this->codeOffset) = this->code;
+			this->codeOffset = this->offset++;
+			this->code = 1;
+		}
+	};
+
+	/*
+	 * Streaming decoder, feed it every received byte. Decoded bytes include the two CRC bytes at
+	 * the end of the frame, the payload is Length() - 2 bytes once FRAME is returned.
+	 */
+	class CobsDecoder
+	{
+	public:
+		enum Result : uint8_t
+		{
+			NONE,			// byte consumed, nothing to report
+			DATA,			// Out holds the next decoded byte
+			FRAME,			// delimiter after a valid frame
+			CORRUPT			// delimiter after a truncated frame or a CRC mismatch
+		};
+
+		Result Push(uint8_t Byte, uint8_t &Out)
+		{
+			if( Byte == 0x00 )
+			{
+				Result result = (this->length == 0u) ? NONE : (((this->left == 0u) && (this->length >= 2u) && (this->crc == 0u)) ? FRAME : CORRUPT);
+				this->frameLength = this->length;
+				this->Reset();
+				return result;
+			}
+
+			if( this->left == 0u )
+			{
+				// Code byte, the previous block ended with a zero unless it was a full one
+				bool zero = this->started && (this->code != 0xFFu);
+				this->started = true;
+				this->code = Byte;
+				this->left = (uint8_t)(Byte - 1u);
+				if( !zero )
+					return NONE;
+				Byte = 0x00;
+			}
+			else
+			{
+				this->left--;
+			}
+
+			this->crc = Crc16Update(this->crc, Byte);
+			this->length++;
+			Out = Byte;
+			return DATA;
+		}
+
+		/* Decoded bytes of the frame that just ended, CRC included */
+		inline uint16_t Length() const
+		{
+			return this->frameLength;
+		}
+
+		/* Drops a partially received frame */
+		void Reset()
+		{
+			this->crc = 0xFFFFu;
+			this->length = 0;
+			this->left = 0;
+			this->code = 0xFFu;
+			this->started = false;
+		}
+
+	private:
+		uint16_t crc = 0xFFFFu;
+		uint16_t length = 0;
+		uint16_t frameLength = 0;
+		uint8_t left = 0;				/* data bytes left in the current block */
+		uint8_t code = 0xFFu;
+		bool started = false;
+	};
+
+} /* namespace Drivers */
+
+#endif /* COBS_H */
@@ -2,137 +2,854 @@
 
 namespace Drivers
 {
-	SerialAsync::SerialAsync(HardwareSerial *serialChannel, uint32_t BaudRate)
+	template<typename TxIndex, typename RxIndex>
+	SerialAsyncBase<TxIndex, RxIndex>::SerialAsyncBase(HardwareSerial *serialChannel, uint32_t BaudRate, uint8_t LaneFrames, uint8_t RxFrames)
 	{
 		this->serial = serialChannel;
+		this->baudRate = BaudRate;
+		this->byteTime16thUs = (BaudRate == 0u) ? 0u : (160000000u / BaudRate);
+
+		memset(this->laneState, 0, sizeof(this->laneState));
+		memset(this->lanes, 0, sizeof(this->lanes));
+		this->laneFrameMask = (uint8_t)(LaneFrames - 1u);
+		this->rxFrameMask = (uint8_t)(RxFrames - 1u);
+
 		this->serial->begin(BaudRate);
+		this->throughputStartUs = micros();
+	}
+
+	template<typename TxIndex, typename RxIndex>
+	SerialAsyncBase<TxIndex, RxIndex>::~SerialAsyncBase()
+	{
+		this->EnableTxInterrupt(false);
+	}
+
+	template<typename TxIndex, typename RxIndex>
+	void SerialAsyncBase<TxIndex, RxIndex>::AttachLane(uint8_t Lane, TxRing *Ring, uint16_t *Frames, uint32_t *QueuedUs)
+	{
+		this->lanes[Lane] = Ring;
+		this->laneState[Lane].Frames = Frames;
+		this->laneState[Lane].QueuedUs = QueuedUs;
+	}
+
+	template<typename TxIndex, typename RxIndex>
+	void SerialAsyncBase<TxIndex, RxIndex>::AttachStats(SerialAsyncStats *Stats)
+	{
+		this->stats = Stats;
+		this->ResetStats();
+	}
+
+	template<typename TxIndex, typename RxIndex>
+	bool SerialAsyncBase<TxIndex, RxIndex>::EnableTxInterrupt(bool Enable)
+	{
+		if( !Enable )
+		{
+			PeriodicTimer::Detach(this->txTimer);
+			this->txTimer = PeriodicTimer::INVALID_HANDLE;
+			return true;
+		}
+
+		if( this->IsTxInterruptEnabled() )
+			return true;
+
+		// A quarter of the time the core FIFO needs to drain at this baud rate (10 bits per byte)
+		uint32_t periodUs = (uint32_t)(((uint64_t)SERIAL_ASYNC_CORE_FIFO_SIZE * 10u * 1000000u / 4u) / this->baudRate);
+		this->txTimer = PeriodicTimer::Attach(TxInterruptHandler, this, PeriodicTimer::UsToTicks(periodUs));
+
+		return this->IsTxInterruptEnabled();
+	}
+
+	template<typename TxIndex, typename RxIndex>
+	void SerialAsyncBase<TxIndex, RxIndex>::TxInterruptHandler(void *Arg)
+	{
+		SerialAsyncBase *self = (SerialAsyncBase *)Arg;
+
+		if( !self->IsTxIdle() )
+		{
+			self->Drain(self->serial->availableForWrite());
+		}
+	}
+
+	template<typename TxIndex, typename RxIndex>
+	SerialAsyncThroughput SerialAsyncBase<TxIndex, RxIndex>::GetThroughput()
+	{
+		SerialAsyncThroughput stats;
+
+		{
+			Vfb_CriticalSection cs;
+			stats.BytesSent = this->bytesSent;
+		}
+		stats.ElapsedUs = micros() - this->throughputStartUs;
+
+		uint64_t capacityBits = (uint64_t)this->baudRate * stats.ElapsedUs;
+		uint64_t permille = (capacityBits == 0u) ? 0u : ((uint64_t)stats.BytesSent * 10u * 1000u * 1000000u / capacityBits);
+		stats.LineUsePermille = (permille > 1000u) ? 1000u : (uint16_t)permille;
+
+		return stats;
+	}
+
+	template<typename TxIndex, typename RxIndex>
+	void SerialAsyncBase<TxIndex, RxIndex>::ResetThroughput()
+	{
+		{
+			Vfb_CriticalSection cs;
+			this->bytesSent = 0;
+		}
+		this->throughputStartUs = micros();
+	}
+
+	template<typename TxIndex, typename RxIndex>
+	SerialAsyncStats SerialAsyncBase<TxIndex, RxIndex>::GetStats()
+	{
+		SerialAsyncStats copy;
+
+		if( this->stats == nullptr )
+		{
+			memset(&copy, 0, sizeof(copy));
+		}
+		else
+		{
+			// The latency histogram is written by the drain, which may be the TX interrupt
+			Vfb_CriticalSection cs;
+			copy = *this->stats;
+		}
+		copy.RxFramesDropped = this->rxDropped;
+
+		return copy;
+	}
+
+	template<typename TxIndex, typename RxIndex>
+	void SerialAsyncBase<TxIndex, RxIndex>::ResetStats()
+	{
+		if( this->stats != nullptr )
+		{
+			Vfb_CriticalSection cs;
+			memset(this->stats, 0, sizeof(*this->stats));
+		}
+		this->rxCorrupt = 0;
+		this->rxDropped = 0;
+	}
+
+	template<typename TxIndex, typename RxIndex>
+	void SerialAsyncBase<TxIndex, RxIndex>::SetStatsDump(uint16_t PeriodMs, uint8_t Lane)
+	{
+		this->statsDumpPeriodMs = PeriodMs;
+		this->statsDumpLane = (Lane < SERIAL_ASYNC_LANES) ? Lane : LANE_BULK;
+		this->statsDumpLastMs = millis();
+	}
+
+	template<typename TxIndex, typename RxIndex>
+	void SerialAsyncBase<TxIndex, RxIndex>::CountAccepted(uint8_t Lane, uint16_t Length)
+	{
+		if( this->stats == nullptr )
+			return;
+
+		this->stats->BytesAccepted += Length;
+
+		uint16_t used = this->lanes[Lane]->Used();
+		if( used > this->stats->HighWater[Lane] )
+			this->stats->HighWater[Lane] = used;
+	}
+
+	template<typename TxIndex, typename RxIndex>
+	void SerialAsyncBase<TxIndex, RxIndex>::CountRejected(uint16_t Length)
+	{
+		if( this->stats == nullptr )
+			return;
+
+		this->stats->BytesRejected += Length;
+		if( this->stats->WritesRejected != 0xFFFFu )
+			this->stats->WritesRejected++;
+	}
+
+	template<typename TxIndex, typename RxIndex>
+	void SerialAsyncBase<TxIndex, RxIndex>::CountLatency(uint16_t FifoFree)
+	{
+		if( this->stats == nullptr )
+			return;
+
+		uint16_t fifoQueued = (FifoFree < (SERIAL_ASYNC_CORE_FIFO_SIZE - 1u)) ? (uint16_t)(SERIAL_ASYNC_CORE_FIFO_SIZE - 1u - FifoFree) : 0u;
+		uint32_t latencyUs = (micros() - this->txFrameQueuedUs) + ((fifoQueued * this->byteTime16thUs) >> 4);
+
+		uint8_t bucket = 0;
+		while( (latencyUs > 1u) && (bucket < (SERIAL_ASYNC_LATENCY_BUCKETS - 1u)) )
+		{
+			latencyUs >>= 1;
+			bucket++;
+		}
+
+		if( this->stats->LatencyLog2Us[bucket] != 0xFFFFu )
+			this->stats->LatencyLog2Us[bucket]++;
+	}
+
+	static uint8_t *PutLe(uint8_t *Out, uint32_t Value, uint8_t Bytes)
+	{
+		for( uint8_t i = 0; i < Bytes; i++ )
+		{
+			*Out++ = (uint8_t)(Value >> (8u * i));
+		}
+		return Out;
+	}
+
+	template<typename TxIndex, typename RxIndex>
+	void SerialAsyncBase<TxIndex, RxIndex>::DumpStats()
+	{
+		uint8_t record[3u + 20u + 1u + 2u * SERIAL_ASYNC_LANES + 1u + 2u * SERIAL_ASYNC_LATENCY_BUCKETS];
+		static_assert(sizeof(record) - 3u <= 0xFFu, "SerialAsync: stats record too long");
+
+		SerialAsyncStats copy = this->GetStats();
+		uint8_t *out = record;
+
+		*out++ = 'S';
+		*out++ = 'A';
+		*out++ = (uint8_t)(sizeof(record) - 3u);
+		out = PutLe(out, copy.BytesAccepted, 4);
+		out = PutLe(out, copy.BytesRejected, 4);
+		out = PutLe(out, copy.WritesRejected, 2);
+		out = PutLe(out, copy.BytesDropped, 4);
+		out = PutLe(out, copy.FramesDropped, 2);
+		out = PutLe(out, copy.RxFramesDropped, 4);
+		*out++ = SERIAL_ASYNC_LANES;
+		for( uint8_t i = 0; i < SERIAL_ASYNC_LANES; i++ )
+		{
+			out = PutLe(out, copy.HighWater[i], 2);
+		}
+		*out++ = SERIAL_ASYNC_LATENCY_BUCKETS;
+		for( uint8_t i = 0; i < SERIAL_ASYNC_LATENCY_BUCKETS; i++ )
+		{
+			out = PutLe(out, copy.LatencyLog2Us[i], 2);
+		}
+
+		// Never blocks or drops application frames for the sake of a stats record
+		this->WriteBytes(record, sizeof(record), this->statsDumpLane, SerialOverflow::REJECT);
+	}
+
+	template<typename TxIndex, typename RxIndex>
+	uint16_t SerialAsyncBase<TxIndex, RxIndex>::WriteString(const String &str, uint8_t Lane)
+	{
+		return this->WriteBytes((const uint8_t *)str.c_str(), (uint16_t)str.length(), Lane);
+	}
+
+	template<typename TxIndex, typename RxIndex>
+	void SerialAsyncBase<TxIndex, RxIndex>::SetLaneBudget(uint8_t Lane, uint16_t Bytes)
+	{
+		if( Lane < SERIAL_ASYNC_LANES )
+			this->laneState[Lane].Budget = Bytes;
+	}
+
+	template<typename TxIndex, typename RxIndex>
+	uint16_t SerialAsyncBase<TxIndex, RxIndex>::WriteBytes(const uint8_t *bytes, uint16_t bytes_length, uint8_t Lane)
+	{
+		return this->WriteBytes(bytes, bytes_length, Lane, this->overflowPolicy, this->overflowTimeoutMs);
 	}
 
-	uint16_t SerialAsync::WriteString(const String &str)
+	template<typename TxIndex, typename RxIndex>
+	void SerialAsyncBase<TxIndex, RxIndex>::SetOverflowPolicy(SerialOverflow Policy, uint16_t TimeoutMs)
 	{
-		return this->WriteBytes((uint8_t *)str.c_str(), (uint16_t)str.length());
+		this->overflowPolicy = Policy;
+		this->overflowTimeoutMs = TimeoutMs;
 	}
 
-	uint16_t SerialAsync::WriteBytes(uint8_t *bytes, uint16_t bytes_length)
+	template<typename TxIndex, typename RxIndex>
+	uint16_t SerialAsyncBase<TxIndex, RxIndex>::WriteBytes(const uint8_t *bytes, uint16_t bytes_length, uint8_t Lane, SerialOverflow Policy, uint16_t TimeoutMs)
 	{
-		// If size if too big then return 0 as not of the bytes will be written
-		uint16_t InternalBufferAvailability, SerialBufferAvailability;
+		uint16_t InternalBufferAvailability, SerialBufferAvailability = 0;
 
-        InternalBufferAvailability = this->BufferAvailability();
-        SerialBufferAvailability = this->serial->availableForWrite();
+		if( bytes_length == 0u )
+			return 0;
 
-		if( bytes_length > (InternalBufferAvailability + SerialBufferAvailability) )
+		if( Lane >= SERIAL_ASYNC_LANES )
+		{
+			this->CountRejected(bytes_length);
 			return 0;
+		}
+		if( this->lanes[Lane] == nullptr )
+			Lane = LANE_BULK;
+
+		TxRing *queue = this->lanes[Lane];
+		uint32_t startMs = (Policy == SerialOverflow::BLOCK) ? millis() : 0u;
+		uint16_t w_len;
+
+		for( ;; )
+		{
+			w_len = 0;
+
+			// Interrupt mode: the ISR owns the serial driver, just queue
+			if( !this->IsTxInterruptEnabled() )
+			{
+				// Queued frames go first to keep the order, then as much of the request as the serial buffer takes
+				SerialBufferAvailability = this->serial->availableForWrite();
+				SerialBufferAvailability -= this->Drain(SerialBufferAvailability);
+
+				if( this->IsTxIdle() && (SerialBufferAvailability > 0) )
+				{
+					w_len = ((bytes_length > SerialBufferAvailability) ? (SerialBufferAvailability) : (bytes_length));
+				}
+			}
+
+			InternalBufferAvailability = queue->Free();
+			if( (bytes_length - w_len) <= InternalBufferAvailability )
+				break;
+
+			if( !this->MakeRoom(Lane, bytes_length - w_len, Policy, startMs, TimeoutMs) )
+			{
+				if( (Policy != SerialOverflow::PARTIAL) || ((w_len + InternalBufferAvailability) == 0u) )
+				{
+					this->CountRejected(bytes_length);
+					return 0;
+				}
+
+				// Cut the frame to what fits
+				this->CountRejected(bytes_length - w_len - InternalBufferAvailability);
+				bytes_length = w_len + InternalBufferAvailability;
+				break;
+			}
+		}
 
 		#if SERIAL_ASYNC_DEBUG
-		printf("\nWrite %d bytes\n", bytes_length);
+		printf("\nWrite %d bytes on lane %d\n", bytes_length, Lane);
 		printf("  -> Internal buffer availability: %d bytes\n", InternalBufferAvailability);
 		printf("  -> Serial buffer availability  : %d bytes\n", SerialBufferAvailability);
-		printf("  -> Total capacity : %d bytes\n", InternalBufferAvailability + SerialBufferAvailability);
 		#endif
-		// If size fits in available serial buffer and internal buffer is empty then just send it serial buffer
-		if( (InternalBufferAvailability == SERIAL_ASYNC_STATIC_BUFFER_SIZE) && (SerialBufferAvailability >= bytes_length))
+
+		if( w_len > 0u )
+		{
+			this->serial->write(bytes, w_len);
+			this->bytesSent += w_len;
+			// Sent like a drained frame, it counts against the lane budget the same way
+			this->laneState[Lane].Sent += w_len;
+
+			// The rest of this frame is already on its way, it goes out before any other frame
+			queue->Push(&bytes[w_len], bytes_length - w_len);
+			this->txLane = Lane;
+			this->txFrameLeft = bytes_length - w_len;
+			this->txFrameQueuedUs = micros();
+			if( this->txFrameLeft == 0u )
+			{
+				this->CountLatency(SerialBufferAvailability - w_len);
+			}
+		}
+		else
+		{
+			queue->Push(bytes, bytes_length);
+			this->QueueFrame(Lane, bytes_length);
+		}
+		this->CountAccepted(Lane, bytes_length);
+
+		#if SERIAL_ASYNC_DEBUG
+		printf("Pushed %d bytes into serial buffer and %d bytes into internal buffer\n", w_len, bytes_length - w_len);
+		printf("Internal buffer queued bytes %d\n", queue->Used());
+		#endif
+
+		return bytes_length;
+	}
+
+	template<typename TxIndex, typename RxIndex>
+	uint16_t SerialAsyncBase<TxIndex, RxIndex>::WriteCobsFrame(const uint8_t *Payload, uint16_t Length, uint8_t Lane)
+	{
+		ByteSpan span;
+		CobsEncoder encoder;
+
+		// No ring is larger than 32K, longer payloads would only overflow the size computation
+		if( (Length >= 0x8000u) || (this->Reserve(COBS_ENCODED_SIZE(Length), span, Lane) == 0u) )
+			return 0;
+
+		encoder.Begin(span.First, span.FirstLength, span.Second);
+		encoder.Put(Payload, Length);
+		this->Commit(encoder.End());
+		return Length;
+	}
+
+	template<typename TxIndex, typename RxIndex>
+	uint16_t SerialAsyncBase<TxIndex, RxIndex>::Reserve(uint16_t Length, ByteSpan &Span, uint8_t Lane)
+	{
+		if( Lane >= SERIAL_ASYNC_LANES )
+			return 0;
+		if( this->lanes[Lane] == nullptr )
+			Lane = LANE_BULK;
+
+		// Make room first, the reservation is only inside the internal buffer
+		if( !this->IsTxInterruptEnabled() )
+			this->Drain(this->serial->availableForWrite());
+
+		uint32_t startMs = (this->overflowPolicy == SerialOverflow::BLOCK) ? millis() : 0u;
+		while( Length > this->lanes[Lane]->Free() )
+		{
+			if( (this->overflowPolicy == SerialOverflow::PARTIAL) || !this->MakeRoom(Lane, Length, this->overflowPolicy, startMs, this->overflowTimeoutMs) )
+			{
+				this->CountRejected(Length);
+				return 0;
+			}
+
+			if( !this->IsTxInterruptEnabled() )
+				this->Drain(this->serial->availableForWrite());
+		}
+
+		this->lanes[Lane]->WriteSpan(Span, Length);
+		this->reserveLane = Lane;
+		return Length;
+	}
+
+	template<typename TxIndex, typename RxIndex>
+	uint16_t SerialAsyncBase<TxIndex, RxIndex>::Reserve(ByteSpan &Span, uint8_t Lane)
+	{
+		if( Lane >= SERIAL_ASYNC_LANES )
+			return 0;
+		if( this->lanes[Lane] == nullptr )
+			Lane = LANE_BULK;
+
+		if( !this->IsTxInterruptEnabled() )
+			this->Drain(this->serial->availableForWrite());
+
+		uint16_t Length = this->lanes[Lane]->Free();
+		this->lanes[Lane]->WriteSpan(Span, Length);
+		this->reserveLane = Lane;
+		return Length;
+	}
+
+	template<typename TxIndex, typename RxIndex>
+	void SerialAsyncBase<TxIndex, RxIndex>::Commit(uint16_t Length)
+	{
+		if( Length == 0u )
+			return;
+
+		this->lanes[this->reserveLane]->Commit(Length);
+		this->QueueFrame(this->reserveLane, Length);
+		this->CountAccepted(this->reserveLane, Length);
+
+		// Start sending right away when the serial buffer has room, like WriteBytes does
+		if( !this->IsTxInterruptEnabled() )
+			this->Drain(this->serial->availableForWrite());
+	}
+
+	template<typename TxIndex, typename RxIndex>
+	void SerialAsyncBase<TxIndex, RxIndex>::AttachRx(RxRing *Ring, uint16_t *Frames)
+	{
+		this->rxBuffer = Ring;
+		this->rxFrames = Frames;
+		this->receive = ReceiveHandler;
+	}
+
+	template<typename TxIndex, typename RxIndex>
+	void SerialAsyncBase<TxIndex, RxIndex>::SetFraming(SerialFraming Mode, uint16_t Parameter)
+	{
+		// Transmit only instance, nothing to frame into
+		if( this->rxBuffer == nullptr )
+			return;
+
+		if( (Mode == SerialFraming::LENGTH_PREFIX) && (Parameter != 2u) )
+			Parameter = 1u;
+		if( (Mode == SerialFraming::FIXED_LENGTH) && (Parameter == 0u) )
+			Parameter = 1u;
+
+		this->rxMode = Mode;
+		this->rxParameter = Parameter;
+		this->rxBuffer->Clear();
+		this->rxFrameTail = this->rxFrameHead;
+		this->rxPending = 0;
+		this->rxDiscard = false;
+		this->rxCobs.Reset();
+		this->EndFrame();
+	}
+
+	template<typename TxIndex, typename RxIndex>
+	void SerialAsyncBase<TxIndex, RxIndex>::SetFrameCallback(FrameCallback Function, void *Arg)
+	{
+		this->rxCallback = Function;
+		this->rxCallbackArg = Arg;
+		this->SetFraming(this->rxMode, this->rxParameter);
+	}
+
+	template<typename TxIndex, typename RxIndex>
+	bool SerialAsyncBase<TxIndex, RxIndex>::PeekFrame(ByteSpan &Frame)
+	{
+		if( this->FramesAvailable() == 0u )
+			return false;
+
+		this->rxBuffer->ReadSpan(Frame, this->rxFrames[this->rxFrameTail & this->rxFrameMask]);
+		return true;
+	}
+
+	template<typename TxIndex, typename RxIndex>
+	void SerialAsyncBase<TxIndex, RxIndex>::ReleaseFrame()
+	{
+		if( this->FramesAvailable() == 0u )
+			return;
+
+		this->rxBuffer->Consume(this->rxFrames[this->rxFrameTail & this->rxFrameMask]);
+		this->rxFrameTail++;
+	}
+
+	template<typename TxIndex, typename RxIndex>
+	uint16_t SerialAsyncBase<TxIndex, RxIndex>::ReadBytes(uint8_t *bytes, uint16_t bytes_length)
+	{
+		if( this->rxMode != SerialFraming::RAW )
+			return 0;
+
+		this->Receive();
+		return this->rxBuffer->Pop(bytes, bytes_length);
+	}
+
+	template<typename TxIndex, typename RxIndex>
+	void SerialAsyncBase<TxIndex, RxIndex>::ReceiveHandler(SerialAsyncBase *Self)
+	{
+		Self->Receive();
+	}
+
+	template<typename TxIndex, typename RxIndex>
+	void SerialAsyncBase<TxIndex, RxIndex>::Receive()
+	{
+		if( (this->rxMode == SerialFraming::DISABLED) || this->rxBusy )
+			return;
+
+		this->rxBusy = true;
+		int available = this->serial->available();
+		while( available-- > 0 )
 		{
-			return this->serial->write(bytes, bytes_length);
+			this->ReceiveByte((uint8_t)this->serial->read());
 		}
-		else // received data needs to be splitted and send a part to serial and a part is enqueued
+		this->rxBusy = false;
+	}
+
+	template<typename TxIndex, typename RxIndex>
+	void SerialAsyncBase<TxIndex, RxIndex>::ReceiveByte(uint8_t Byte)
+	{
+		switch( this->rxMode )
 		{
-			// Send to serial next bytes to be written from buffer
-			if( SerialBufferAvailability > 0 )
+		case SerialFraming::RAW:
+			if( this->rxBuffer->Free() == 0u )
+			{
+				this->rxDropped++;
+				return;
+			}
+			this->rxBuffer->Stage(0, Byte);
+			this->rxBuffer->Commit(1);
+			return;
+
+		case SerialFraming::DELIMITER:
+			if( Byte == (uint8_t)this->rxParameter )
 			{
-				// Shift to serial the bytes available internally
-				if( InternalBufferAvailability < SERIAL_ASYNC_STATIC_BUFFER_SIZE)
+				this->EndFrame();
+				return;
+			}
+			break;
+
+		case SerialFraming::LENGTH_PREFIX:
+			if( this->rxPrefixLeft > 0u )
+			{
+				this->rxExpected = (uint16_t)((this->rxExpected << 8) | Byte);
+				if( (--this->rxPrefixLeft == 0u) && (this->rxExpected == 0u) )
 				{
-					// At this point, there is available space inside serial buffer
-					// and there are as well bytes into internal serial
-					// Shift out bytes from internal buffer to serial and place remaining bytes into
-					// correct buffer or both if the case
-
-					// Write data from internal buffer to serial
-					uint16_t w_len = (((SERIAL_ASYNC_STATIC_BUFFER_SIZE - InternalBufferAvailability) > SerialBufferAvailability) ? (SerialBufferAvailability) : (SERIAL_ASYNC_STATIC_BUFFER_SIZE - InternalBufferAvailability));
-					// Loop through all bytes that needs to be send
-					for( uint16_t i = 0; i < w_len; i++ )
-					{
-						this->serial->write(this->BufferPop());
-					}
-					#if SERIAL_ASYNC_DEBUG
-					printf("Transfer %d bytes from internal buffer to serial buffer\n", w_len);
-					#endif
-
-					// Read again the lengths of the buffers
-			        InternalBufferAvailability = this->BufferAvailability();
-			        SerialBufferAvailability = this->serial->availableForWrite();
-
-			        // If there is still available space in serial buffer shift out some of the bytes from request
-			        if( SerialBufferAvailability > 0 )
-			        {
-						// Internal buffer is empty. Write as much possible into serial and push the rest into internal buffer
-						uint16_t w_len = ((bytes_length > SerialBufferAvailability) ? (SerialBufferAvailability) : (bytes_length));
-						this->serial->write(bytes, w_len);
-
-						// push remaining bytes to internal buffer
-						uint16_t remaining_bytes = bytes_length - w_len;
-						this->BufferPush(&bytes[w_len], remaining_bytes);
-
-						#if SERIAL_ASYNC_DEBUG
-						printf("Pushed %d bytes into serial buffer and %d bytes into internal buffer\n", w_len, remaining_bytes);
-						printf("Internal buffer queued bytes %d\n", SERIAL_ASYNC_STATIC_BUFFER_SIZE - this->BufferAvailability());
-						#endif
-			        }
-					else // Serial buffer is full. Append remaining bytes to internal buffer
-					{
-						this->BufferPush(bytes, bytes_length);
-						#if SERIAL_ASYNC_DEBUG
-						printf("Pushed %d bytes into internal buffer\n", bytes_length);
-						#endif
-					}
+					// Empty frame, next byte starts a new prefix
+					this->EndFrame();
 				}
-				else
+				return;
+			}
+			break;
+
+		case SerialFraming::COBS:
+		{
+			uint8_t decoded = 0;
+			switch( this->rxCobs.Push(Byte, decoded) )
+			{
+			case CobsDecoder::DATA:
+				Byte = decoded;
+				break;
+
+			case CobsDecoder::FRAME:
+				// The CRC stays staged behind the frame and is overwritten by the next one
+				this->rxPending -= 2u;
+				this->EndFrame();
+				return;
+
+			case CobsDecoder::CORRUPT:
+				this->rxCorrupt++;
+				this->rxPending = 0;
+				this->rxDiscard = false;
+				this->EndFrame();
+				return;
+
+			default:
+				return;
+			}
+			break;
+		}
+
+		default:
+			break;
+		}
+
+		// Frame bytes are staged after the published data and only published once the frame is complete
+		if( !this->rxDiscard )
+		{
+			if( this->rxPending < this->rxBuffer->Free() )
+				this->rxBuffer->Stage(this->rxPending, Byte);
+			else
+				this->rxDiscard = true;
+		}
+		this->rxPending++;
+
+		if( ((this->rxMode == SerialFraming::FIXED_LENGTH) && (this->rxPending == this->rxParameter)) ||
+			((this->rxMode == SerialFraming::LENGTH_PREFIX) && (this->rxPending == this->rxExpected)) )
+		{
+			this->EndFrame();
+		}
+	}
+
+	template<typename TxIndex, typename RxIndex>
+	void SerialAsyncBase<TxIndex, RxIndex>::EndFrame()
+	{
+		uint16_t length = this->rxPending;
+		bool discard = this->rxDiscard;
+
+		// Ready for the next frame before the callback runs, it may write a reply
+		this->rxPending = 0;
+		this->rxExpected = 0;
+		this->rxDiscard = false;
+		this->rxPrefixLeft = (this->rxMode == SerialFraming::LENGTH_PREFIX) ? (uint8_t)this->rxParameter : 0u;
+
+		if( discard )
+		{
+			this->rxDropped++;
+		}
+		else if( length == 0u )
+		{
+			// Back to back delimiters, nothing to report
+		}
+		else if( this->rxCallback != nullptr )
+		{
+			ByteSpan frame;
+			this->rxBuffer->Commit(length);
+			this->rxBuffer->ReadSpan(frame, length);
+			this->rxCallback(frame, this->rxCallbackArg);
+			this->rxBuffer->Consume(length);
+		}
+		else if( this->FramesAvailable() > this->rxFrameMask )
+		{
+			this->rxDropped++;
+		}
+		else
+		{
+			this->rxBuffer->Commit(length);
+			this->rxFrames[this->rxFrameHead & this->rxFrameMask] = length;
+			this->rxFrameHead++;
+		}
+	}
+
+	template<typename TxIndex, typename RxIndex>
+	void SerialAsyncBase<TxIndex, RxIndex>::MainFunction()
+	{
+		if( this->receive != nullptr )
+			this->receive(this);
+
+		if( (this->statsDumpPeriodMs != 0u) && ((uint32_t)(millis() - this->statsDumpLastMs) >= this->statsDumpPeriodMs) )
+		{
+			this->statsDumpLastMs += this->statsDumpPeriodMs;
+			this->DumpStats();
+		}
+
+		// Check whether there are bytes queued to be send, the ISR does it in interrupt mode
+		if( !this->IsTxInterruptEnabled() && !this->IsTxIdle() )
+		{
+			#if SERIAL_ASYNC_DEBUG
+			printf("Mainfunction write %d bytes\n", this->Drain(this->serial->availableForWrite()));
+			#else
+			this->Drain(this->serial->availableForWrite());
+			#endif
+		}
+	}
+
+	template<typename TxIndex, typename RxIndex>
+	bool SerialAsyncBase<TxIndex, RxIndex>::MakeRoom(uint8_t Lane, uint16_t Length, SerialOverflow Policy, uint32_t StartMs, uint16_t TimeoutMs)
+	{
+		if( Length > this->lanes[Lane]->Capacity() )
+			return false;
+
+		switch( Policy )
+		{
+		case SerialOverflow::DROP_OLDEST:
+			return this->DropOldest(Lane, Length);
+
+		case SerialOverflow::BLOCK:
+			if( (uint32_t)(millis() - StartMs) >= TimeoutMs )
+				return false;
+
+			// About one byte time on the wire, the caller drains again (polled) or the TX interrupt does
+			delayMicroseconds((this->byteTime16thUs >> 4) + 1u);
+			return true;
+
+		default:
+			return false;
+		}
+	}
+
+	template<typename TxIndex, typename RxIndex>
+	bool SerialAsyncBase<TxIndex, RxIndex>::DropOldest(uint8_t Lane, uint16_t Length)
+	{
+		TxLane &lane = this->laneState[Lane];
+		TxRing *queue = this->lanes[Lane];
+		bool dropped = false;
+
+		while( (queue->Free() < Length) && (this->QueuedFrames(Lane) != 0u) )
+		{
+			// Reader side work, keep the TX interrupt out while the tail moves (one frame at a time)
+			uint16_t frame;
+			{
+				Vfb_CriticalSection cs;
+				if( this->QueuedFrames(Lane) == 0u )
 				{
-					// Internal buffer is empty. Write as much possible into serial and push the rest into internal buffer
-					uint16_t w_len = ((bytes_length > SerialBufferAvailability) ? (SerialBufferAvailability) : (bytes_length));
-					this->serial->write(bytes, w_len);
-
-					// push remaining bytes to internal buffer
-					uint16_t remaining_bytes = bytes_length - w_len;
-					this->BufferPush(&bytes[w_len], remaining_bytes);
-					#if SERIAL_ASYNC_DEBUG
-					printf("Pushed %d bytes into serial buffer and %d bytes into internal buffer\n", w_len, remaining_bytes);
-					printf("Internal buffer queued bytes %d\n", SERIAL_ASYNC_STATIC_BUFFER_SIZE - this->BufferAvailability());
-					#endif
+					// The interrupt started the last one meanwhile
+					break;
 				}
+				frame = lane.Frames[lane.FrameTail & this->laneFrameMask];
+
+				// The rest of the frame on the wire sits in front of the queued ones and has to stay
+				queue->Discard((this->txLane == Lane) ? this->txFrameLeft : 0u, frame);
+				lane.FrameTail++;
 			}
-			else // No space in serial buffer. Write everything in internal static buffer
+			dropped = true;
+
+			if( this->stats != nullptr )
 			{
-				this->BufferPush(bytes, bytes_length);
-				#if SERIAL_ASYNC_DEBUG
-				printf("Pushed %d bytes into internal buffer\n", bytes_length);
-				#endif
+				this->stats->BytesDropped += frame;
+				if( this->stats->FramesDropped != 0xFFFFu )
+					this->stats->FramesDropped++;
 			}
 		}
 
-		return bytes_length;
+		return dropped;
+	}
+
+	template<typename TxIndex, typename RxIndex>
+	bool SerialAsyncBase<TxIndex, RxIndex>::IsTxIdle() const
+	{
+		if( this->txFrameLeft != 0u )
+			return false;
+
+		for( uint8_t i = 0; i < SERIAL_ASYNC_LANES; i++ )
+		{
+			if( this->QueuedFrames(i) != 0u )
+				return false;
+		}
+		return true;
+	}
+
+	template<typename TxIndex, typename RxIndex>
+	void SerialAsyncBase<TxIndex, RxIndex>::QueueFrame(uint8_t Lane, uint16_t Length)
+	{
+		TxLane &lane = this->laneState[Lane];
+		uint32_t now = (lane.QueuedUs != nullptr) ? micros() : 0u;
+
+		// The drain may pop frames meanwhile, the newest entry must not change under it
+		Vfb_CriticalSection cs;
+		if( (uint8_t)(lane.FrameHead - lane.FrameTail) > this->laneFrameMask )
+		{
+			lane.Frames[(uint8_t)(lane.FrameHead - 1u) & this->laneFrameMask] += Length;
+		}
+		else
+		{
+			lane.Frames[lane.FrameHead & this->laneFrameMask] = Length;
+			if( lane.QueuedUs != nullptr )
+				lane.QueuedUs[lane.FrameHead & this->laneFrameMask] = now;
+			lane.FrameHead++;
+		}
+	}
+
+	template<typename TxIndex, typename RxIndex>
+	int8_t SerialAsyncBase<TxIndex, RxIndex>::NextLane()
+	{
+		int8_t waiting = -1;
+		uint8_t next = 0;
+
+		for( ; next < SERIAL_ASYNC_LANES; next++ )
+		{
+			if( this->QueuedFrames(next) == 0u )
+				continue;
+
+			TxLane &lane = this->laneState[next];
+			if( (lane.Budget == 0u) || (lane.Sent < lane.Budget) )
+				break;
+
+			if( waiting < 0 )
+				waiting = (int8_t)next;
+		}
+
+		if( next == SERIAL_ASYNC_LANES )
+		{
+			// Only lanes over their budget have frames, nobody to yield to
+			if( waiting < 0 )
+				return -1;
+			next = (uint8_t)waiting;
+		}
+
+		// Lanes above the chosen one yielded, their budget starts over
+		for( uint8_t i = 0; i <= next; i++ )
+		{
+			if( (i < next) || (waiting == (int8_t)next) )
+				this->laneState[i].Sent = 0;
+		}
+		return (int8_t)next;
 	}
 
-	void SerialAsync::MainFunction()
+	template<typename TxIndex, typename RxIndex>
+	uint16_t SerialAsyncBase<TxIndex, RxIndex>::Drain(uint16_t SerialBufferAvailability)
 	{
-		// Check whether there are bytes queued to be send
-		if( this->BufferAvailability() < SERIAL_ASYNC_STATIC_BUFFER_SIZE)
+		uint16_t written = 0;
+
+		while( SerialBufferAvailability > written )
 		{
-			uint16_t InternalBufferAvailability, SerialBufferAvailability;
-	        InternalBufferAvailability = this->BufferAvailability();
-	        SerialBufferAvailability = this->serial->availableForWrite();
+			// Lanes only switch between frames
+			if( this->txFrameLeft == 0u )
+			{
+				int8_t next = this->NextLane();
+				if( next < 0 )
+					break;
+
+				TxLane &lane = this->laneState[next];
+				{
+					Vfb_CriticalSection cs;
+					this->txFrameLeft = lane.Frames[lane.FrameTail & this->laneFrameMask];
+					if( lane.QueuedUs != nullptr )
+						this->txFrameQueuedUs = lane.QueuedUs[lane.FrameTail & this->laneFrameMask];
+					lane.FrameTail++;
+				}
+				this->txLane = (uint8_t)next;
+			}
 
-			uint16_t write_len = (((SERIAL_ASYNC_STATIC_BUFFER_SIZE - InternalBufferAvailability) > SerialBufferAvailability) ? (SerialBufferAvailability) : (SERIAL_ASYNC_STATIC_BUFFER_SIZE - InternalBufferAvailability));
-			// Loop through all bytes that needs to be send
-			for( uint16_t i = 0; i < write_len; i++ )
+			// A frame is at most two contiguous segments (before and after the wrap)
+			TxRing *queue = this->lanes[this->txLane];
+			const uint8_t *span;
+			uint16_t len = queue->ReadSpan(span);
+			if( len > this->txFrameLeft )
 			{
-				this->serial->write(this->BufferPop());
+				len = this->txFrameLeft;
+			}
+			if( len > (SerialBufferAvailability - written) )
+			{
+				len = SerialBufferAvailability - written;
+			}
+
+			this->serial->write(span, len);
+			queue->Consume(len);
+			this->txFrameLeft -= len;
+			this->laneState[this->txLane].Sent += len;
+			written += len;
+
+			if( this->txFrameLeft == 0u )
+			{
+				this->CountLatency(SerialBufferAvailability - written);
 			}
-			#if SERIAL_ASYNC_DEBUG
-			printf("Mainfunction write %d bytes\n", write_len);
-			#endif
 		}
+
+		this->bytesSent += written;
+
+		return written;
 	}
 
+	// Every index type combination SerialAsyncT can pick, the linker drops the unused ones
+	template class SerialAsyncBase<uint8_t, uint8_t>;
+	template class SerialAsyncBase<uint8_t, uint16_t>;
+	template class SerialAsyncBase<uint16_t, uint8_t>;
+	template class SerialAsyncBase<uint16_t, uint16_t>;
+
 } /* namespace Drivers */
@@ -2,11 +2,57 @@
 #define SERIAL_ASYNC_H
 
 #include <Arduino.h>
+#include "ByteRing.h"
+#include "Cobs.h"
+#include "PeriodicTimer.h"
 
+/* Internal TX queue size of the bulk (lowest priority) lane of SerialAsync, power of two. SerialAsyncT picks its own */
 #ifndef SERIAL_ASYNC_STATIC_BUFFER_SIZE
 	#define SERIAL_ASYNC_STATIC_BUFFER_SIZE	1024u
 #endif
 
+/* TX lanes, lane 0 has the highest priority and the last one is the bulk lane */
+#ifndef SERIAL_ASYNC_LANES
+	#define SERIAL_ASYNC_LANES				2u
+#endif
+
+/* TX queue size of every lane above the bulk lane of SerialAsync, power of two, 0 sends every lane through the bulk queue */
+#ifndef SERIAL_ASYNC_PRIORITY_BUFFER_SIZE
+	#define SERIAL_ASYNC_PRIORITY_BUFFER_SIZE	0u
+#endif
+
+/* Frame boundaries kept per TX lane, power of two, default of SerialAsyncT. Frames written to a full list are merged with the newest one */
+#ifndef SERIAL_ASYNC_LANE_FRAMES
+	#define SERIAL_ASYNC_LANE_FRAMES		16u
+#endif
+
+/* Internal RX queue size of SerialAsync, power of two. Complete frames wait here until released, 0 is no receive path */
+#ifndef SERIAL_ASYNC_RX_BUFFER_SIZE
+	#define SERIAL_ASYNC_RX_BUFFER_SIZE	0u
+#endif
+
+/* Complete frames that can wait in the RX queue, power of two, default of SerialAsyncT */
+#ifndef SERIAL_ASYNC_RX_FRAMES
+	#define SERIAL_ASYNC_RX_FRAMES		8u
+#endif
+
+/* Counters, queue high-water marks and the enqueue-to-wire latency histogram (see GetStats()), default of SerialAsyncT */
+#ifndef SERIAL_ASYNC_STATS
+	#define SERIAL_ASYNC_STATS				1
+#endif
+
+/* Latency histogram buckets, bucket N counts frames that took [2^N, 2^(N+1)) us, the last one everything above */
+#ifndef SERIAL_ASYNC_LATENCY_BUCKETS
+	#define SERIAL_ASYNC_LATENCY_BUCKETS	20u
+#endif
+
+/* TX FIFO of the core serial driver, the interrupt refill period is derived from it */
+#ifdef SERIAL_TX_BUFFER_SIZE
+	#define SERIAL_ASYNC_CORE_FIFO_SIZE	SERIAL_TX_BUFFER_SIZE
+#else
+	#define SERIAL_ASYNC_CORE_FIFO_SIZE	64u
+#endif
+
 #ifndef SERIAL_ASYNC_DEBUG
 	#define SERIAL_ASYNC_DEBUG	0
 #endif
@@ -44,49 +90,398 @@ namespace Drivers
 		BAUD_921600 = 921600    // Maximum for many systems
 	};
 
-	class SerialAsync
+	/* How received bytes are cut into frames, see SerialAsync::SetFraming() */
+	enum class SerialFraming : uint8_t
+	{
+		DISABLED,			// RX not used, bytes stay in the serial driver
+		RAW,				// no frames, bytes are read with ReadBytes()
+		DELIMITER,			// frame ends at the delimiter byte (not part of the frame)
+		FIXED_LENGTH,		// every frame has the same length
+		LENGTH_PREFIX,		// 1 or 2 byte length (big endian, not part of the frame) then the frame
+		COBS				// COBS encoded frame with CRC16 and 0x00 delimiter, see Cobs.h and WriteCobsFrame()
+	};
+
+	/* What a write does when its frame doesn't fit, see SerialAsync::SetOverflowPolicy() */
+	enum class SerialOverflow : uint8_t
+	{
+		REJECT,				// nothing is written, returns 0
+		PARTIAL,			// writes what fits, the frame is cut short
+		DROP_OLDEST,		// drops whole queued frames of the lane, oldest first, until it fits
+		BLOCK				// waits for the queue to drain, up to the timeout, then rejects
+	};
+
+	typedef struct
+	{
+		uint32_t BytesSent;				/* bytes handed to the serial driver */
+		uint32_t ElapsedUs;				/* since the last ResetThroughput() */
+		uint16_t LineUsePermille;		/* BytesSent over what the baud rate could carry in ElapsedUs, 10 bits per byte */
+	} SerialAsyncThroughput;
+
+	typedef struct
+	{
+		uint32_t BytesAccepted;								/* bytes queued or written directly */
+		uint32_t BytesRejected;								/* bytes of writes and reservations that didn't fit */
+		uint16_t WritesRejected;
+		uint32_t BytesDropped;								/* queued bytes dropped by DROP_OLDEST */
+		uint16_t FramesDropped;
+		uint32_t RxFramesDropped;
+		uint16_t HighWater[SERIAL_ASYNC_LANES];				/* most bytes ever queued per lane */
+		uint16_t LatencyLog2Us[SERIAL_ASYNC_LATENCY_BUCKETS];	/* frames by time from write to last byte on the wire */
+	} SerialAsyncStats;
+
+	/*
+	 * Queue logic shared by all buffer sizes. TxIndex/RxIndex are the ring counter types, uint8_t
+	 * when every ring on that side is up to 128 bytes. The rings themselves live in SerialAsyncT.
+	 */
+	template<typename TxIndex, typename RxIndex>
+	class SerialAsyncBase
 	{
 	public:
-		SerialAsync(HardwareSerial *serialChannel, uint32_t BaudRate);
-		uint16_t WriteBytes(uint8_t *bytes, uint16_t bytes_length);
-		uint16_t WriteString(const String &str);
+		static const uint8_t LANE_CONTROL = 0;
+		static const uint8_t LANE_BULK = SERIAL_ASYNC_LANES - 1u;
+
+		virtual ~SerialAsyncBase();
+
+		/*
+		 * Every write is one frame of its lane and is sent without bytes of other frames in
+		 * between. When a frame ends the next one comes from the highest priority lane that has
+		 * one queued and budget left (see SetLaneBudget), so a control reply waits for at most
+		 * the rest of the frame on the wire plus the core serial FIFO, not for the whole log queue.
+		 * Lanes need a queue of their own (PrioritySize of SerialAsyncT), without one their frames
+		 * are queued on the bulk lane in write order.
+		 */
+		uint16_t WriteBytes(const uint8_t *bytes, uint16_t bytes_length, uint8_t Lane = LANE_BULK);
+		uint16_t WriteString(const String &str, uint8_t Lane = LANE_BULK);
+		/* Same with its own overflow policy instead of the instance one */
+		uint16_t WriteBytes(const uint8_t *bytes, uint16_t bytes_length, uint8_t Lane, SerialOverflow Policy, uint16_t TimeoutMs = 0);
+		/*
+		 * Binary frame: Payload is COBS encoded with a CRC16 trailer straight into the TX queue, see
+		 * Cobs.h for the format. Needs COBS_ENCODED_SIZE(Length) free bytes (worst case, the frame
+		 * only keeps what it uses) and is all or nothing like Reserve(). Returns Length or 0.
+		 */
+		uint16_t WriteCobsFrame(const uint8_t *Payload, uint16_t Length, uint8_t Lane = LANE_BULK);
+
+		/*
+		 * Overflow policy of WriteBytes() and Reserve(Length, Span), REJECT by default. PARTIAL only
+		 * applies to WriteBytes(), a reservation is all or nothing. BLOCK drains (polled mode) or
+		 * lets the TX interrupt drain for up to TimeoutMs; never use it from an interrupt.
+		 */
+		void SetOverflowPolicy(SerialOverflow Policy, uint16_t TimeoutMs = 0);
+		/*
+		 * Bytes a lane may send before it yields one frame to a lower lane with queued frames,
+		 * the frame that crosses the budget is finished first. 0 (default) is no limit, i.e.
+		 * strict priority over the lanes below.
+		 */
+		void SetLaneBudget(uint8_t Lane, uint16_t Bytes);
+
+		/*
+		 * Zero-copy writes: Reserve() hands out space directly inside the TX queue, the caller
+		 * fills Span.First then Span.Second and publishes the bytes with Commit(). Nothing is
+		 * sent before Commit(), one reservation may be open at a time.
+		 *  - Reserve(Length, Span): all or nothing, returns Length or 0
+		 *  - Reserve(Span): all free space, for writers that don't know their length up front
+		 */
+		uint16_t Reserve(uint16_t Length, ByteSpan &Span, uint8_t Lane = LANE_BULK);
+		uint16_t Reserve(ByteSpan &Span, uint8_t Lane = LANE_BULK);
+		/* Publishes the first Length reserved bytes (may be less than reserved) */
+		void Commit(uint16_t Length);
+
+		/*
+		 * Interrupt driven TX: the queue is refilled into the serial driver from a PeriodicTimer
+		 * callback, about four times per core FIFO drain time, so the line keeps running while
+		 * the main loop is busy. Writers then only copy into the queue and MainFunction() does
+		 * nothing. Returns false when the build has no timer backend or no free timer slot.
+		 */
+		bool EnableTxInterrupt(bool Enable);
+		inline bool IsTxInterruptEnabled() const
+		{
+			return this->txTimer != PeriodicTimer::INVALID_HANDLE;
+		}
+		static void TxInterruptHandler(void *Arg);
+
 		void MainFunction();
-		inline uint16_t AvailableForWrite()
+		inline uint16_t AvailableForWrite(uint8_t Lane = LANE_BULK)
+		{
+			if( Lane >= SERIAL_ASYNC_LANES )
+				return 0;
+			if( this->lanes[Lane] == nullptr )
+				Lane = LANE_BULK;
+
+			// In interrupt mode the serial driver belongs to the ISR, only the queue is ours
+			if( this->IsTxInterruptEnabled() || !this->IsTxIdle() )
+				return this->lanes[Lane]->Free();
+			return this->lanes[Lane]->Free() + (uint16_t)this->serial->availableForWrite();
+		}
+
+		SerialAsyncThroughput GetThroughput();
+		void ResetThroughput();
+
+		/*
+		 * Counters since the last ResetStats(), all zero for an instance without stats. The wire
+		 * time of a frame is estimated from when its last byte enters the core FIFO plus what is
+		 * ahead of it in the FIFO at the baud rate. 16 bit counters saturate instead of wrapping.
+		 */
+		SerialAsyncStats GetStats();
+		void ResetStats();
+
+		/*
+		 * Writes the stats every PeriodMs (0 stops it) from MainFunction() as one frame on Lane.
+		 * Record, little endian: 'S' 'A' <payload length u8> then the payload
+		 *   BytesAccepted u32, BytesRejected u32, WritesRejected u16, BytesDropped u32,
+		 *   FramesDropped u16, RxFramesDropped u32,
+		 *   lanes u8, HighWater u16 x lanes, buckets u8, LatencyLog2Us u16 x buckets
+		 */
+		void SetStatsDump(uint16_t PeriodMs, uint8_t Lane = LANE_BULK);
+
+		/*
+		 * Receive path: MainFunction() moves received bytes into the RX queue and cuts them into
+		 * frames, constant work per byte and no heap. Complete frames are either passed to the
+		 * frame callback or wait in the queue for PeekFrame()/ReleaseFrame(). Frames are views
+		 * into the queue (two parts when they wrap), valid until released or the callback returns.
+		 * A frame that doesn't fit the queue, or finds the frame list full, is dropped whole.
+		 *  - Parameter: delimiter byte, frame length or prefix size (1 or 2) depending on Mode
+		 * In COBS mode frames are decoded as they arrive and only frames with a valid CRC are
+		 * reported, without the CRC; the queue needs room for the payload plus the 2 CRC bytes.
+		 * Needs an RX queue (RxSize of SerialAsyncT), framing stays DISABLED without one.
+		 */
+		/* Runs from MainFunction(). It may reply with any write, bytes that arrive meanwhile are
+		 * picked up by the next MainFunction() call. */
+		typedef void (*FrameCallback)(const ByteSpan &Frame, void *Arg);
+
+		/* Both drop whatever was received so far */
+		void SetFraming(SerialFraming Mode, uint16_t Parameter = 0);
+		void SetFrameCallback(FrameCallback Function, void *Arg = nullptr);
+		bool PeekFrame(ByteSpan &Frame);
+		void ReleaseFrame();
+		inline uint8_t FramesAvailable() const
+		{
+			return (uint8_t)(this->rxFrameHead - this->rxFrameTail);
+		}
+		/* RAW mode only */
+		uint16_t ReadBytes(uint8_t *bytes, uint16_t bytes_length);
+		inline uint32_t GetRxDropped() const
+		{
+			return this->rxDropped;
+		}
+		/* COBS mode: frames dropped for a CRC mismatch or a broken encoding */
+		inline uint32_t GetRxCorrupt() const
 		{
-			return ( ((this->bufferTail - this->bufferHead) + (-((int) (this->bufferTail <= this->bufferHead)) & SERIAL_ASYNC_STATIC_BUFFER_SIZE))) + (((uint16_t)this->serial->availableForWrite()) );
+			return this->rxCorrupt;
 		}
 
+	protected:
+		typedef ByteRingBase<TxIndex> TxRing;
+		typedef ByteRingBase<RxIndex> RxRing;
+
+		/* LaneFrames and RxFrames are the frame list sizes SerialAsyncT attaches, powers of two */
+		SerialAsyncBase(HardwareSerial *serialChannel, uint32_t BaudRate, uint8_t LaneFrames, uint8_t RxFrames);
+
+		/* Set up by SerialAsyncT, a lane without a ring writes to the bulk lane */
+		TxRing *lanes[SERIAL_ASYNC_LANES];
+		/* Frame list of a lane, QueuedUs only with stats */
+		void AttachLane(uint8_t Lane, TxRing *Ring, uint16_t *Frames, uint32_t *QueuedUs);
+		/* nullptr is an instance without stats */
+		void AttachStats(SerialAsyncStats *Stats);
+		/*
+		 * Gives the instance its RX queue and frame list. SerialAsyncT only calls it for RxSize > 0,
+		 * otherwise MainFunction() doesn't reference the receive path and the linker leaves it out.
+		 */
+		void AttachRx(RxRing *Ring, uint16_t *Frames);
+
 	private:
-		uint16_t bufferHead = 0, bufferTail = 0;
-		uint8_t buffer[SERIAL_ASYNC_STATIC_BUFFER_SIZE];
+		typedef struct
+		{
+			uint16_t *Frames;							/* lengths of the queued frames */
+			uint32_t *QueuedUs;							/* write time of the queued frames, nullptr without stats */
+			volatile uint8_t FrameHead;					/* written by the writer only */
+			volatile uint8_t FrameTail;					/* written by the drain only */
+			uint16_t Budget;
+			uint16_t Sent;								/* bytes sent in the current round */
+		} TxLane;
+
+		TxLane laneState[SERIAL_ASYNC_LANES];
+		uint8_t laneFrameMask;						/* frame list entries per lane - 1 */
+		uint8_t txLane = 0;							/* lane of the frame on the wire */
+		uint16_t txFrameLeft = 0;					/* bytes of that frame still queued */
+		uint8_t reserveLane = LANE_BULK;
+		SerialOverflow overflowPolicy = SerialOverflow::REJECT;
+		uint16_t overflowTimeoutMs = 0;
 		HardwareSerial *serial = nullptr;
+		uint32_t baudRate = 0;
+		uint32_t byteTime16thUs = 0;				/* one byte on the wire (10 bits) in 1/16 us */
+
+		SerialAsyncStats *stats = nullptr;
+		uint32_t txFrameQueuedUs = 0;
+		uint16_t statsDumpPeriodMs = 0;
+		uint8_t statsDumpLane = LANE_BULK;
+		uint32_t statsDumpLastMs = 0;
+		int8_t txTimer = PeriodicTimer::INVALID_HANDLE;
+		volatile uint32_t bytesSent = 0;
+		uint32_t throughputStartUs = 0;
 
-		inline uint16_t BufferAvailability()
+		RxRing *rxBuffer = nullptr;
+		void (*receive)(SerialAsyncBase *Self) = nullptr;	/* ReceiveHandler once AttachRx() ran */
+		SerialFraming rxMode = SerialFraming::DISABLED;
+		uint16_t rxParameter = 0;
+		uint16_t rxPending = 0;				/* bytes of the frame being received */
+		uint16_t rxExpected = 0;			/* frame length, 0 while the prefix is received */
+		uint8_t rxPrefixLeft = 0;
+		bool rxDiscard = false;				/* current frame didn't fit, skip it up to its end */
+		bool rxBusy = false;				/* Receive() is running, a frame callback calling MainFunction() doesn't nest it */
+		uint16_t *rxFrames = nullptr;
+		uint8_t rxFrameMask;				/* frame list entries - 1 */
+		uint8_t rxFrameHead = 0, rxFrameTail = 0;
+		uint32_t rxDropped = 0;
+		uint32_t rxCorrupt = 0;
+		CobsDecoder rxCobs;
+		FrameCallback rxCallback = nullptr;
+		void *rxCallbackArg = nullptr;
+
+		static void ReceiveHandler(SerialAsyncBase *Self);
+		void Receive();
+		void ReceiveByte(uint8_t Byte);
+		void EndFrame();
+
+		static_assert((SERIAL_ASYNC_LANES >= 2u) && (SERIAL_ASYNC_LANES <= 8u), "SerialAsync: SERIAL_ASYNC_LANES must be 2 to 8");
+
+		inline uint8_t QueuedFrames(uint8_t Lane) const
+		{
+			return (uint8_t)(this->laneState[Lane].FrameHead - this->laneState[Lane].FrameTail);
+		}
+		bool IsTxIdle() const;
+		/* Frees Length bytes in the lane following Policy, false when it can't */
+		bool MakeRoom(uint8_t Lane, uint16_t Length, SerialOverflow Policy, uint32_t StartMs, uint16_t TimeoutMs);
+		bool DropOldest(uint8_t Lane, uint16_t Length);
+		void CountAccepted(uint8_t Lane, uint16_t Length);
+		void CountRejected(uint16_t Length);
+		/* Frame fully handed to the serial driver, FifoFree is what is left of the core FIFO */
+		void CountLatency(uint16_t FifoFree);
+		void DumpStats();
+		void QueueFrame(uint8_t Lane, uint16_t Length);
+		int8_t NextLane();
+
+		/* Moves queued frames to the serial driver in lane order, one write(buf, len) per contiguous part */
+		uint16_t Drain(uint16_t SerialBufferAvailability);
+	};
+
+	/* Counter type shared by the bulk and priority rings of one instance */
+	template<uint16_t TxSize, uint16_t PrioritySize>
+	struct SerialAsyncTxIndex : ByteRingIndex<((TxSize > PrioritySize) ? TxSize : PrioritySize)>
+	{
+	};
+
+	/* Storage of Count rings of Size bytes for SerialAsyncT, no ring for a Size of 0 */
+	template<uint16_t Size, typename Index, uint8_t Count>
+	class SerialAsyncRings
+	{
+	public:
+		inline ByteRingBase<Index> *Get(uint8_t Ring)
+		{
+			return &this->_Rings[Ring];
+		}
+
+	private:
+		ByteRing<Size, Index> _Rings[Count];
+	};
+
+	template<typename Index, uint8_t Count>
+	class SerialAsyncRings<0u, Index, Count>
+	{
+	public:
+		inline ByteRingBase<Index> *Get(uint8_t)
+		{
+			return nullptr;
+		}
+	};
+
+	/* Array of Count entries for SerialAsyncT, no storage for a Count of 0 */
+	template<typename T, uint16_t Count>
+	class SerialAsyncArray
+	{
+	public:
+		inline T *Get()
 		{
-			return ((this->bufferTail - this->bufferHead) + (-((int) (this->bufferTail <= this->bufferHead)) & SERIAL_ASYNC_STATIC_BUFFER_SIZE));
+			return this->_Items;
 		}
 
-		inline void BufferPush(uint8_t *bytes, uint16_t bytesLen)
+	private:
+		T _Items[Count];
+	};
+
+	template<typename T>
+	class SerialAsyncArray<T, 0u>
+	{
+	public:
+		inline T *Get()
+		{
+			return nullptr;
+		}
+	};
+
+	/*
+	 * SerialAsync with its own queue sizes (powers of two), e.g. a deep bulk queue on the busy
+	 * port and SerialAsyncT<64, 16, 16> on a quiet one. Rings up to 128 bytes use 8 bit counters.
+	 * RxSize 0 (default) is a transmit only instance: no RX queue and no receive code. PrioritySize
+	 * 0 (default) leaves out the lanes above the bulk lane, see WriteBytes().
+	 *  - LaneFrames: frame boundaries kept per lane with a queue, power of two from 2 to 128
+	 *  - RxFrames: complete frames that can wait in the RX queue, power of two up to 128
+	 *  - Stats: counters, high-water marks and latency histogram, see GetStats()
+	 */
+	template<uint16_t TxSize, uint16_t RxSize = SERIAL_ASYNC_RX_BUFFER_SIZE, uint16_t PrioritySize = SERIAL_ASYNC_PRIORITY_BUFFER_SIZE,
+		uint8_t LaneFrames = SERIAL_ASYNC_LANE_FRAMES, uint8_t RxFrames = SERIAL_ASYNC_RX_FRAMES, bool Stats = (SERIAL_ASYNC_STATS == 1)>
+	class SerialAsyncT : public SerialAsyncBase<typename SerialAsyncTxIndex<TxSize, PrioritySize>::Type, typename ByteRingIndex<RxSize>::Type>
+	{
+		typedef typename SerialAsyncTxIndex<TxSize, PrioritySize>::Type TxIndex;
+		typedef typename ByteRingIndex<RxSize>::Type RxIndex;
+
+		/* Lanes with a queue and so a frame list: all of them, or the bulk lane only */
+		static const uint8_t QUEUED_LANES = (PrioritySize != 0u) ? SERIAL_ASYNC_LANES : 1u;
+
+		static_assert((LaneFrames >= 2u) && ((LaneFrames & (LaneFrames - 1u)) == 0u) && (LaneFrames <= 128u),
+			"SerialAsyncT: LaneFrames must be a power of two from 2 to 128");
+		static_assert((RxFrames != 0u) && ((RxFrames & (RxFrames - 1u)) == 0u) && (RxFrames <= 128u),
+			"SerialAsyncT: RxFrames must be a power of two up to 128");
+
+	public:
+		SerialAsyncT(HardwareSerial *serialChannel, uint32_t BaudRate) : SerialAsyncBase<TxIndex, RxIndex>(serialChannel, BaudRate, LaneFrames, RxFrames)
 		{
-			for( uint16_t i = 0; i < bytesLen; i++ )
+			uint16_t *frames = this->_Frames.Get();
+			uint32_t *queuedUs = this->_QueuedUs.Get();
+
+			for( uint8_t i = 0; i < this->LANE_BULK; i++ )
 			{
-				this->buffer[this->bufferHead++] = bytes[i];
-				if( this->bufferHead >=  SERIAL_ASYNC_STATIC_BUFFER_SIZE)
+				if( PrioritySize == 0u )
 				{
-					this->bufferHead = 0;
+					this->AttachLane(i, nullptr, nullptr, nullptr);
+					continue;
 				}
+				this->AttachLane(i, this->_PriorityBuffers.Get(i), &frames[(i + 1u) * LaneFrames], Stats ? &queuedUs[(i + 1u) * LaneFrames] : nullptr);
 			}
-		}
-
-		inline uint8_t BufferPop()
-		{
-			uint8_t result = this->buffer[this->bufferTail++];
-			if( this->bufferTail >= SERIAL_ASYNC_STATIC_BUFFER_SIZE )
+			// The bulk lane always takes the first frame list
+			this->AttachLane(this->LANE_BULK, &this->_Buffer, frames, queuedUs);
+			this->AttachStats(this->_Stats.Get());
+			if( RxSize != 0u )
 			{
-				this->bufferTail = 0;
+				this->AttachRx(this->_RxBuffer.Get(0), this->_RxFrames.Get());
 			}
+		}
 
-			return result;
+	private:
+		ByteRing<TxSize, TxIndex> _Buffer;
+		SerialAsyncArray<uint16_t, QUEUED_LANES * LaneFrames> _Frames;
+		SerialAsyncArray<uint32_t, Stats ? (QUEUED_LANES * LaneFrames) : 0u> _QueuedUs;
+		SerialAsyncArray<SerialAsyncStats, Stats ? 1u : 0u> _Stats;
+		SerialAsyncArray<uint16_t, (RxSize != 0u) ? RxFrames : 0u> _RxFrames;
+		SerialAsyncRings<PrioritySize, TxIndex, SERIAL_ASYNC_LANES - 1u> _PriorityBuffers;
+		SerialAsyncRings<RxSize, RxIndex, 1u> _RxBuffer;
+	};
+
+	/* Sizes from SERIAL_ASYNC_STATIC_BUFFER_SIZE, SERIAL_ASYNC_RX_BUFFER_SIZE and SERIAL_ASYNC_PRIORITY_BUFFER_SIZE */
+	class SerialAsync : public SerialAsyncT<SERIAL_ASYNC_STATIC_BUFFER_SIZE, SERIAL_ASYNC_RX_BUFFER_SIZE, SERIAL_ASYNC_PRIORITY_BUFFER_SIZE>
+	{
+	public:
+		SerialAsync(HardwareSerial *serialChannel, uint32_t BaudRate) : SerialAsyncT(serialChannel, BaudRate)
+		{
 		}
 	};
 
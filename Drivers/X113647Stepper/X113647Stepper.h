@@ -5,9 +5,43 @@
 #ifndef _X113647Stepper_h_
 #define _X113647Stepper_h_
 
-#include "Arduino.h"
+#include "Gpio.h"
+#include "GpioGroup.h"
+#include "FastGpio.h"
 
-class X11Stepper
+/* Coil inputs driven through four independent pins. Pin types can be Drivers::Gpio or Drivers::FastGpio<PinNo>.
+ * Drivers::GpioGroup can be used as CoilsT directly, it switches all four coils with one write per port. */
+template<class In1T, class In2T, class In3T, class In4T>
+class X11Coils
+{
+public:
+	X11Coils(const In1T &in1, const In2T &in2, const In3T &in3, const In4T &in4) : _pinIn1(in1), _pinIn2(in2), _pinIn3(in3), _pinIn4(in4)
+	{
+	}
+
+	/* Only usable with default constructible pins, e.g. FastGpio */
+	X11Coils()
+	{
+	}
+
+	/* Bit 3 drives IN1 ... bit 0 drives IN4 */
+	void Write(uint8_t pattern)
+	{
+		this->_pinIn1.Write( !!(0b00001000 & pattern) );
+		this->_pinIn2.Write( !!(0b00000100 & pattern) );
+		this->_pinIn3.Write( !!(0b00000010 & pattern) );
+		this->_pinIn4.Write( !!(0b00000001 & pattern) );
+	}
+
+private:
+	In1T _pinIn1;
+	In2T _pinIn2;
+	In3T _pinIn3;
+	In4T _pinIn4;
+};
+
+template<class CoilsT>
+class X11StepperT
 {
 public:
 	enum class DIRECTION
@@ -16,12 +50,13 @@ public:
 		BACKWARD = 1,
 	};
 
-	X11Stepper(uint8_t in1, uint8_t in2, uint8_t in3, uint8_t in4) : _pinIn1(in1), _pinIn2(in2), _pinIn3(in3), _pinIn4(in4)
+	X11StepperT(const CoilsT &coils) : _Coils(coils)
+	{
+	}
+
+	/* Only usable with default constructible coils, e.g. X11Coils of FastGpio pins */
+	X11StepperT()
 	{
-		pinMode(this->_pinIn1, OUTPUT);
-		pinMode(this->_pinIn2, OUTPUT);
-		pinMode(this->_pinIn3, OUTPUT);
-		pinMode(this->_pinIn4, OUTPUT);
 	}
 
 	void StepNext()
@@ -43,10 +78,7 @@ public:
 
 	void Stop()
 	{
-		digitalWrite( this->_pinIn1, 0 );
-		digitalWrite( this->_pinIn2, 0 );
-		digitalWrite( this->_pinIn3, 0 );
-		digitalWrite( this->_pinIn4, 0 );
+		this->_Coils.Write(0);
 	}
 
 	void SetDirection(DIRECTION dir)
@@ -57,16 +89,31 @@ public:
 private:
 	const uint8_t STEPS[4] = {0b00001100, 0b00000110, 0b00000011, 0b00001001};
 
-	uint8_t _pinIn1, _pinIn2, _pinIn3, _pinIn4;
+	CoilsT _Coils;
 	uint8_t _CurrentStep = 0;
 	DIRECTION _CurrentDirection = DIRECTION::FORWARD;
 
 	void _Step(uint8_t STEP_NO)
 	{
-		digitalWrite( this->_pinIn1, 0b00001000 & STEPS[STEP_NO] );
-		digitalWrite( this->_pinIn2, 0b00000100 & STEPS[STEP_NO] );
-		digitalWrite( this->_pinIn3, 0b00000010 & STEPS[STEP_NO] );
-		digitalWrite( this->_pinIn4, 0b00000001 & STEPS[STEP_NO] );
+		this->_Coils.Write(STEPS[STEP_NO]);
+	}
+};
+
+/* Coils on a GpioGroup: one port write per step, no intermediate coil states */
+class X11Stepper : public X11StepperT<Drivers::GpioGroup>
+{
+public:
+	X11Stepper(uint8_t in1, uint8_t in2, uint8_t in3, uint8_t in4) :
+		X11StepperT<Drivers::GpioGroup>(_MakeCoils(in1, in2, in3, in4))
+	{
+	}
+
+private:
+	/* Pattern bit 0 drives IN4 ... bit 3 drives IN1 */
+	static Drivers::GpioGroup _MakeCoils(uint8_t in1, uint8_t in2, uint8_t in3, uint8_t in4)
+	{
+		const uint8_t pins[4] = {in4, in3, in2, in1};
+		return Drivers::GpioGroup(pins, 4);
 	}
 };
 